@@ -48,7 +48,13 @@ extern "C" {
 #define UX_DEVICE_APP_MEM_POOL_SIZE              1024
 
 /* USER CODE BEGIN EC */
-
+#if defined(TELEMETRY_USB_CDC) || defined(CAN_GS_USB)
+/* The USB function (CDC-ACM side or gs_usb adapter) allocates the USBX
+   system memory (10 KB), the device thread stack and its RX thread stack
+   from the USBX pool. */
+#undef UX_DEVICE_APP_MEM_POOL_SIZE
+#define UX_DEVICE_APP_MEM_POOL_SIZE              (14 * 1024)
+#endif
 /* USER CODE END EC */
 
 /* Exported macro ------------------------------------------------------------*/
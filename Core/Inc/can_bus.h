@@ -2,6 +2,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include "can_bus_frame.h"
 #include "stm32g4xx_hal.h"
 
 #ifdef __cplusplus
@@ -10,6 +11,64 @@ extern "C" {
 
 typedef void (*can_bus_rx_cb_t)(const uint8_t *data, size_t len, void *user);
 
+typedef void (*can_bus_frame_cb_t)(const can_bus_frame_t *frame, void *user);
+
+/*
+ * Reassembled message with the identifier it arrived on. flags carries
+ * CAN_BUS_FRAME_F_EXT (and the frame format bits for single-frame messages).
+ */
+typedef void (*can_bus_msg_cb_t)(uint32_t id, uint8_t flags,
+                                 const uint8_t *data, size_t len, void *user);
+
+/* Bit timing in time quanta of the FDCAN kernel clock (tseg1 = prop + ph1). */
+typedef struct {
+  uint16_t prescaler;
+  uint16_t tseg1;
+  uint8_t tseg2;
+  uint8_t sjw;
+} can_bus_bit_timing_t;
+
+/* can_bus_configure() mode flags */
+#define CAN_BUS_MODE_FD 0x01u          /* FD frames with bit rate switching */
+#define CAN_BUS_MODE_LISTEN_ONLY 0x02u /* bus monitoring, never drives the bus */
+#define CAN_BUS_MODE_LOOPBACK 0x04u    /* external loopback: TX also received */
+#define CAN_BUS_MODE_ONE_SHOT 0x08u    /* no automatic retransmission */
+
+/* Controller error state as reported by the FDCAN protocol status register. */
+typedef enum {
+  CAN_BUS_STATE_ERROR_ACTIVE = 0,
+  CAN_BUS_STATE_ERROR_WARNING = 1, /* TEC or REC >= 96 */
+  CAN_BUS_STATE_ERROR_PASSIVE = 2, /* TEC or REC >= 128 */
+  CAN_BUS_STATE_BUS_OFF = 3,       /* TEC > 255, controller left the bus */
+} can_bus_state_t;
+
+#ifndef CAN_BUS_LEC_HISTORY_LEN
+#define CAN_BUS_LEC_HISTORY_LEN 8
+#endif
+
+/*
+ * Error / availability counters. Snapshot with can_bus_get_stats().
+ * lec_count[] is indexed by FDCAN_PROTOCOL_ERROR_* (0..6; 7 unused).
+ * lec_history[0] is the most recent protocol error code.
+ */
+typedef struct {
+  can_bus_state_t state;
+  uint8_t tec;
+  uint8_t rec;
+  uint8_t lec_history_len;
+  uint8_t lec_history[CAN_BUS_LEC_HISTORY_LEN];
+  uint32_t lec_count[8];
+  uint32_t warning_count;
+  uint32_t error_passive_count;
+  uint32_t bus_off_count;
+  uint32_t recovery_count;
+  uint32_t last_recovery_ms; /* bus-off -> back on bus, last event */
+  uint32_t max_recovery_ms;
+  uint32_t tx_dropped;       /* sends refused while bus-off/recovering */
+  uint32_t tx_aborted;       /* pending frames flushed on bus-off */
+  uint32_t rx_overflow;      /* RX ring drop-oldest events */
+} can_bus_stats_t;
+
 /* Init with the FDCAN handle that receives on FIFO1 (e.g. &hfdcan2). */
 void can_bus_init(FDCAN_HandleTypeDef *hfdcan);
 
@@ -20,10 +79,52 @@ HAL_StatusTypeDef can_bus_send_bytes(const uint8_t *bytes, size_t len, uint32_t
 HAL_StatusTypeDef can_bus_send_large(const uint8_t *bytes, size_t len, uint32_t std_id);
 
 /*
- * MUST be called periodically from thread/main-loop context.
- * This drains the ISR RX ring, performs reassembly, and invokes subscribers.
+ * Resumable form of can_bus_send_large(). The TX FIFO only holds a few
+ * frames, so a long message usually needs several calls:
+ *
+ *   can_bus_send_large_start(&tx, bytes, len, id);
+ *   ... can_bus_send_large_continue(&tx) until it stops returning HAL_BUSY
+ *
+ * continue() queues as many fragments as the FIFO takes and returns HAL_OK
+ * once the last one is queued, HAL_BUSY if fragments remain (FIFO full or
+ * bus-off recovery; nothing is counted as dropped), HAL_ERROR otherwise.
+ * bytes must stay valid until then. Abandoning a message half way is fine:
+ * receivers drop the partial message when the next seq arrives.
  */
-void can_bus_process_rx(void);
+typedef struct {
+  const uint8_t *bytes;
+  uint16_t len;
+  uint16_t off;
+  uint32_t std_id;
+  uint8_t seq;
+  uint8_t frag_idx;
+  uint8_t frag_cnt;
+  uint8_t marker; /* TX event marker of the first fragment, 0 = none */
+} can_bus_large_tx_t;
+
+HAL_StatusTypeDef can_bus_send_large_start(can_bus_large_tx_t *tx,
+                                           const uint8_t *bytes, size_t len,
+                                           uint32_t std_id);
+HAL_StatusTypeDef can_bus_send_large_continue(can_bus_large_tx_t *tx);
+
+/*
+ * Hardware TX timestamp of a message's first fragment. Call between
+ * can_bus_send_large_start() and the first continue(). Once that frame is
+ * on the bus, can_bus_large_tx_sof_us() gives its start-of-frame time in the
+ * can_bus_time_us() base (HAL_OK); HAL_BUSY until then, HAL_ERROR if the
+ * message was not stamped or the stamp has been reused. Only
+ * CAN_BUS_TX_STAMPS stamps are kept: this is for the odd time-sync
+ * message, not for every send. tx may be a copy of the one sent.
+ */
+void can_bus_send_large_stamp(can_bus_large_tx_t *tx);
+HAL_StatusTypeDef can_bus_large_tx_sof_us(const can_bus_large_tx_t *tx,
+                                          uint64_t *sof_us);
+
+/*
+ * Send one frame as-is (no fragmentation). len must be a valid size for the
+ * frame format (0..8 classic, an FD size for CAN_BUS_FRAME_F_FD).
+ */
+HAL_StatusTypeDef can_bus_send_frame(const can_bus_frame_t *frame);
 
 /*
  * MUST be called periodically from thread/main-loop context.
@@ -31,6 +132,44 @@ void can_bus_process_rx(void);
  */
 void can_bus_process_rx(void);
 
+/*
+ * Stop the controller, apply new bit timing / mode and rejoin the bus.
+ * data may be NULL without CAN_BUS_MODE_FD. Thread context only (the HAL
+ * init sequence polls HAL_GetTick). Pending TX frames are discarded.
+ */
+HAL_StatusTypeDef can_bus_configure(const can_bus_bit_timing_t *nominal,
+                                    const can_bus_bit_timing_t *data,
+                                    uint32_t mode);
+
+/* Go back to the timing and mode the handle had at can_bus_init(). */
+HAL_StatusTypeDef can_bus_restore_defaults(void);
+
+/* FDCAN kernel clock in Hz (what bit timings are counted against). */
+uint32_t can_bus_clock_hz(void);
+
+/* Microsecond time frame timestamps are in: timebase_now_us(). */
+uint64_t can_bus_time_us(void);
+
+/*
+ * Start-of-frame time of the message being delivered to a msg or rx
+ * subscriber (the first fragment's, for a fragmented message). Only
+ * meaningful inside the callback.
+ */
+uint64_t can_bus_msg_sof_us(void);
+
+/* Current controller error state (cheap; safe from any context). */
+can_bus_state_t can_bus_get_state(void);
+
+/* Copy a consistent snapshot of the error counters. */
+void can_bus_get_stats(can_bus_stats_t *out);
+
+/*
+ * Bus-off recovery backoff. The first recovery attempt after a bus-off is made
+ * min_ms after the event; consecutive bus-offs (no stable period in between)
+ * double the delay up to max_ms. min_ms = 0 recovers immediately.
+ */
+void can_bus_set_busoff_backoff(uint32_t min_ms, uint32_t max_ms);
+
 /*
  * Subscribe a callback to RX events (FIFO1).
  * Can be called at startup before interrupts start firing.
@@ -44,6 +183,23 @@ HAL_StatusTypeDef can_bus_subscribe_rx(can_bus_rx_cb_t cb, void *user);
  */
 HAL_StatusTypeDef can_bus_unsubscribe_rx(can_bus_rx_cb_t cb, void *user);
 
+/*
+ * Same deliveries as can_bus_subscribe_rx(), plus the identifier, so a
+ * subscriber can tell senders apart. Fragmented messages are reassembled per
+ * identifier: two nodes sending on different IDs never corrupt each other.
+ */
+HAL_StatusTypeDef can_bus_subscribe_msgs(can_bus_msg_cb_t cb, void *user);
+HAL_StatusTypeDef can_bus_unsubscribe_msgs(can_bus_msg_cb_t cb, void *user);
+
+/*
+ * Subscribe to every received frame before reassembly, with identifier,
+ * flags and timestamp. Frames this node sent with can_bus_send_bytes() /
+ * can_bus_send_large() are reported too, flagged CAN_BUS_FRAME_F_TX, so a
+ * subscriber sees the whole bus. Called from can_bus_process_rx().
+ */
+HAL_StatusTypeDef can_bus_subscribe_frames(can_bus_frame_cb_t cb, void *user);
+HAL_StatusTypeDef can_bus_unsubscribe_frames(can_bus_frame_cb_t cb, void *user);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fragment framing used by can_bus_send_large() / the can_bus reassembler.
+ *
+ * A message longer than one frame is split into CAN FD frames of
+ * CAN_BUS_FRAG_WIRE_LEN bytes, each starting with can_bus_frag_hdr_t. Frames
+ * whose payload does not start with CAN_BUS_FRAG_MAGIC are whole messages.
+ * The receiver keys reassembly by CAN ID: a new seq on the same ID drops the
+ * partial message, and a partial message older than CAN_BUS_REASM_TIMEOUT_MS
+ * is discarded. Fragment i carries bytes [i * data_cap, ...) where data_cap
+ * is the payload size of the first fragment received.
+ *
+ * Plain C with no HAL dependency so host tools can link it as well.
+ */
+
+#define CAN_BUS_FRAG_MAGIC 0x5344u // 'S''D' (arbitrary)
+#define CAN_BUS_FRAG_WIRE_LEN 64   // always send 64B payload frames for frags
+#define CAN_BUS_REASM_TIMEOUT_MS 250u // drop partial message after this many ms
+
+#ifndef CAN_BUS_REASM_MAX_BYTES
+#define CAN_BUS_REASM_MAX_BYTES 2048
+#endif
+
+#ifndef CAN_BUS_REASM_MAX_FRAGS
+#define CAN_BUS_REASM_MAX_FRAGS 64
+#endif
+
+typedef struct __attribute__((packed)) {
+  uint16_t magic;     // CAN_BUS_FRAG_MAGIC, little endian on the wire
+  uint8_t seq;        // message sequence (wrap OK)
+  uint8_t frag_idx;   // 0..frag_cnt-1
+  uint8_t frag_cnt;   // total fragments
+  uint8_t flags;      // bit0=first, bit1=last (optional)
+  uint16_t total_len; // total bytes of reassembled message
+} can_bus_frag_hdr_t;
+
+enum { CAN_BUS_FRAG_F_FIRST = 1u << 0, CAN_BUS_FRAG_F_LAST = 1u << 1 };
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * One CAN / CAN FD frame as can_bus.c reports and sends it (see can_bus.h).
+ *
+ * Plain C with no HAL dependency so protocol code that converts frames
+ * (gs_usb_proto.c) can be built and tested on the host.
+ */
+
+/* can_bus_frame_t.flags */
+#define CAN_BUS_FRAME_F_EXT 0x01u /* 29-bit identifier */
+#define CAN_BUS_FRAME_F_RTR 0x02u /* remote request (classic only) */
+#define CAN_BUS_FRAME_F_FD 0x04u  /* FD format */
+#define CAN_BUS_FRAME_F_BRS 0x08u /* FD data phase at the data bit rate */
+#define CAN_BUS_FRAME_F_ESI 0x10u /* transmitter was error passive (RX) */
+#define CAN_BUS_FRAME_F_TX 0x20u  /* sent by this node (frame subscribers) */
+
+/*
+ * One frame as seen on the wire. RX frames carry the time of their start of
+ * frame, captured by the controller and converted to the can_bus_time_us()
+ * base in the FIFO ISR, so RX ring and interrupt latency do not show.
+ */
+typedef struct {
+  uint64_t timestamp_us;
+  uint32_t id;   /* 11 or 29 bits, see CAN_BUS_FRAME_F_EXT */
+  uint8_t flags; /* CAN_BUS_FRAME_F_* */
+  uint8_t len;   /* payload bytes: 0..8, or an FD size up to 64 */
+  uint8_t data[64];
+} can_bus_frame_t;
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Per-node CAN addressing.
+ *
+ * Every node sends on its own identifiers, so receivers reassemble per
+ * source and boards don't collide on one shared ID. An 11-bit standard ID is
+ * split into a band (upper 5 bits, what kind of traffic, lower wins
+ * arbitration) and the node address (lower 6 bits):
+ *
+ *   id = (band << CAN_NODE_ADDR_BITS) | addr
+ *
+ * The address is either fixed at build time (CAN_NODE_ADDR) or claimed at
+ * startup: the node announces a claim for its preferred address on the CLAIM
+ * band, carrying a 64-bit name derived from the device UID. If two nodes
+ * want the same address the lower name keeps it and the other moves on to
+ * the next free one. Fixed-address nodes always have the lower name.
+ */
+
+#define CAN_NODE_ADDR_BITS 6u
+#define CAN_NODE_ADDR_COUNT (1u << CAN_NODE_ADDR_BITS)
+#define CAN_NODE_ADDR_MASK (CAN_NODE_ADDR_COUNT - 1u)
+
+/* Used while no address is held (before the claim, or if it failed). */
+#define CAN_NODE_ADDR_ANON CAN_NODE_ADDR_MASK
+
+#define CAN_NODE_ID(band, addr)                                                \
+  ((((uint32_t)(band)) << CAN_NODE_ADDR_BITS) |                                \
+   ((uint32_t)(addr) & CAN_NODE_ADDR_MASK))
+#define CAN_NODE_ID_BAND(id) (((uint32_t)(id) & 0x7FFu) >> CAN_NODE_ADDR_BITS)
+#define CAN_NODE_ID_ADDR(id) ((uint32_t)(id) & CAN_NODE_ADDR_MASK)
+
+/* Address claims: classic 8-byte frames, payload = claimant name (LE). */
+#define CAN_NODE_BAND_CLAIM 0x01u
+
+/* How long a claim must stand uncontested before the address is ours. */
+#ifndef CAN_NODE_CLAIM_MS
+#define CAN_NODE_CLAIM_MS 250u
+#endif
+
+/* Upper bound of the name-derived delay before each claim frame. Must leave
+ * the holder time to defend within a claimant's CAN_NODE_CLAIM_MS. */
+#ifndef CAN_NODE_CLAIM_JITTER_MS
+#define CAN_NODE_CLAIM_JITTER_MS 100u
+#endif
+
+#if CAN_NODE_CLAIM_JITTER_MS >= CAN_NODE_CLAIM_MS
+#error "CAN_NODE_CLAIM_JITTER_MS must be below CAN_NODE_CLAIM_MS"
+#endif
+
+/* Define CAN_NODE_ADDR (0..CAN_NODE_ADDR_ANON-1) to pin the address. */
+
+typedef enum {
+  CAN_NODE_UNCLAIMED = 0, /* can_node_init() not called yet */
+  CAN_NODE_CLAIMING = 1,  /* claim sent, waiting out CAN_NODE_CLAIM_MS */
+  CAN_NODE_CLAIMED = 2,   /* address held */
+  CAN_NODE_FAILED = 3,    /* no address available; sending as ANON */
+} can_node_state_t;
+
+/* Start claiming. Call once after can_bus_init(), from thread context. */
+void can_node_init(void);
+
+/* Drive claim timing and retries. Same thread as can_bus_process_rx(). */
+void can_node_poll(uint32_t now_ms);
+
+can_node_state_t can_node_state(void);
+
+/* Address held, or CAN_NODE_ADDR_ANON. Safe from any context. */
+uint8_t can_node_addr(void);
+
+/* This node's identifier in a band. Safe from any context. */
+static inline uint32_t can_node_id(uint8_t band) {
+  return CAN_NODE_ID(band, can_node_addr());
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "can_bus_frame.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * gs_usb (candleLight) USB-CAN adapter protocol, device side.
+ *
+ * The Linux gs_usb driver talks to the adapter with vendor control requests
+ * on interface 0 (bit timing, mode, capabilities) and one "host frame" per
+ * bulk transfer in each direction:
+ *
+ *   [echo_id u32] [can_id u32] [can_dlc u8] [channel u8] [flags u8] [rsvd u8]
+ *   [data: 8 bytes classic / 64 bytes FD] [timestamp_us u32, if enabled]
+ *
+ * All fields are little endian. Frames from the bus carry echo_id
+ * GS_USB_ECHO_ID_RX; frames from the host are echoed back with their echo_id
+ * once queued for transmission, which is how the driver frees TX slots.
+ *
+ * This module only packs/unpacks frames, converts them to and from
+ * can_bus_frame_t and answers control requests; what a start/stop actually
+ * does is left to the ops callbacks. Plain C with no
+ * HAL dependency so it can be exercised on the host.
+ */
+
+// Control requests (bRequest, vendor/interface).
+enum {
+  GS_USB_BREQ_HOST_FORMAT = 0,
+  GS_USB_BREQ_BITTIMING = 1,
+  GS_USB_BREQ_MODE = 2,
+  GS_USB_BREQ_BERR = 3,
+  GS_USB_BREQ_BT_CONST = 4,
+  GS_USB_BREQ_DEVICE_CONFIG = 5,
+  GS_USB_BREQ_TIMESTAMP = 6,
+  GS_USB_BREQ_IDENTIFY = 7,
+  GS_USB_BREQ_GET_USER_ID = 8,
+  GS_USB_BREQ_SET_USER_ID = 9,
+  GS_USB_BREQ_DATA_BITTIMING = 10,
+  GS_USB_BREQ_BT_CONST_EXT = 11,
+  GS_USB_BREQ_SET_TERMINATION = 12,
+  GS_USB_BREQ_GET_TERMINATION = 13,
+  GS_USB_BREQ_GET_STATE = 14,
+};
+
+// Feature bits (BT_CONST) and the matching mode flags (MODE).
+#define GS_USB_FEATURE_LISTEN_ONLY (1u << 0)
+#define GS_USB_FEATURE_LOOP_BACK (1u << 1)
+#define GS_USB_FEATURE_TRIPLE_SAMPLE (1u << 2)
+#define GS_USB_FEATURE_ONE_SHOT (1u << 3)
+#define GS_USB_FEATURE_HW_TIMESTAMP (1u << 4)
+#define GS_USB_FEATURE_IDENTIFY (1u << 5)
+#define GS_USB_FEATURE_USER_ID (1u << 6)
+#define GS_USB_FEATURE_PAD_PKTS (1u << 7)
+#define GS_USB_FEATURE_FD (1u << 8)
+#define GS_USB_FEATURE_BT_CONST_EXT (1u << 10)
+#define GS_USB_FEATURE_TERMINATION (1u << 11)
+#define GS_USB_FEATURE_BERR_REPORTING (1u << 12)
+#define GS_USB_FEATURE_GET_STATE (1u << 13)
+
+#define GS_USB_MODE_RESET 0u
+#define GS_USB_MODE_START 1u
+
+// Host frame flags.
+#define GS_USB_FLAG_OVERFLOW (1u << 0)
+#define GS_USB_FLAG_FD (1u << 1)
+#define GS_USB_FLAG_BRS (1u << 2)
+#define GS_USB_FLAG_ESI (1u << 3)
+
+// can_id flag bits (SocketCAN layout).
+#define GS_USB_CAN_EFF_FLAG 0x80000000u
+#define GS_USB_CAN_RTR_FLAG 0x40000000u
+#define GS_USB_CAN_ERR_FLAG 0x20000000u
+#define GS_USB_CAN_EFF_MASK 0x1FFFFFFFu
+#define GS_USB_CAN_SFF_MASK 0x000007FFu
+
+#define GS_USB_ECHO_ID_RX 0xFFFFFFFFu
+#define GS_USB_HOST_FORMAT_LE 0x0000BEEFu
+
+#define GS_USB_FRAME_HDR_LEN 12u
+#define GS_USB_FRAME_MAX_LEN (GS_USB_FRAME_HDR_LEN + 64u + 4u)
+
+// Controller states reported by GET_STATE (SocketCAN enum can_state).
+enum {
+  GS_USB_STATE_ERROR_ACTIVE = 0,
+  GS_USB_STATE_ERROR_WARNING = 1,
+  GS_USB_STATE_ERROR_PASSIVE = 2,
+  GS_USB_STATE_BUS_OFF = 3,
+  GS_USB_STATE_STOPPED = 4,
+};
+
+typedef struct {
+  uint32_t echo_id;
+  uint32_t can_id; // identifier | GS_USB_CAN_*_FLAG
+  uint8_t len;     // payload bytes (0..8 classic, FD sizes up to 64)
+  uint8_t channel;
+  uint8_t flags; // GS_USB_FLAG_*
+  uint32_t timestamp_us;
+  uint8_t data[64];
+} gs_usb_frame_t;
+
+// Bit timing as sent by the host. tseg1 = prop_seg + phase_seg1.
+typedef struct {
+  uint32_t prop_seg;
+  uint32_t phase_seg1;
+  uint32_t phase_seg2;
+  uint32_t sjw;
+  uint32_t brp;
+} gs_usb_bittiming_t;
+
+// Controller limits reported in BT_CONST / BT_CONST_EXT.
+typedef struct {
+  uint32_t tseg1_min, tseg1_max;
+  uint32_t tseg2_min, tseg2_max;
+  uint32_t sjw_max;
+  uint32_t brp_min, brp_max, brp_inc;
+} gs_usb_bt_const_t;
+
+typedef struct {
+  // Apply bit timing + mode flags and go on the bus. data is NULL unless the
+  // host asked for FD. Return 0 on success.
+  int (*start)(void *user, const gs_usb_bittiming_t *nominal,
+               const gs_usb_bittiming_t *data, uint32_t flags);
+  void (*stop)(void *user);
+  uint32_t (*timestamp_us)(void *user);
+  void (*identify)(void *user, int on); // optional
+  // Fill state (GS_USB_STATE_*) and error counters. Optional.
+  void (*get_state)(void *user, uint32_t *state, uint32_t *rxerr,
+                    uint32_t *txerr);
+} gs_usb_ops_t;
+
+typedef struct {
+  uint32_t features; // GS_USB_FEATURE_*
+  uint32_t fclk_can; // controller clock the host computes timings against
+  gs_usb_bt_const_t nominal;
+  gs_usb_bt_const_t data; // only reported with GS_USB_FEATURE_FD
+  uint32_t sw_version;
+  uint32_t hw_version;
+} gs_usb_caps_t;
+
+typedef struct {
+  const gs_usb_caps_t *caps;
+  const gs_usb_ops_t *ops;
+  void *user;
+
+  gs_usb_bittiming_t nominal;
+  gs_usb_bittiming_t data;
+  uint8_t nominal_set;
+  uint8_t data_set;
+  volatile uint8_t started;
+  volatile uint32_t mode_flags; // flags of the current MODE start
+} gs_usb_dev_t;
+
+void gs_usb_init(gs_usb_dev_t *dev, const gs_usb_caps_t *caps,
+                 const gs_usb_ops_t *ops, void *user);
+
+/*
+ * Handle one vendor control request. For host-to-device requests `out`
+ * holds the data stage; for device-to-host requests the reply is written to
+ * `in` (in_cap bytes available).
+ *
+ * Returns the number of reply bytes (0 for accepted OUT requests), or -1 if
+ * the request is unknown or malformed and the endpoint should stall.
+ */
+int gs_usb_control(gs_usb_dev_t *dev, uint8_t request, uint16_t value,
+                   const uint8_t *out, size_t out_len, uint8_t *in,
+                   size_t in_cap);
+
+// Wire size of a frame sent to the host under the current mode.
+size_t gs_usb_frame_size(const gs_usb_dev_t *dev, uint8_t flags);
+
+// Pack a frame for the IN endpoint. Returns bytes written or 0 if cap is
+// too small.
+size_t gs_usb_frame_pack(const gs_usb_dev_t *dev, const gs_usb_frame_t *f,
+                         uint8_t *out, size_t cap);
+
+// Unpack a frame received on the OUT endpoint. Returns 0 on success, -1 if
+// the transfer is too short or the DLC is invalid.
+int gs_usb_frame_unpack(const uint8_t *in, size_t len, gs_usb_frame_t *f);
+
+// Bus frame to host frame. Identifier type, RTR, FD, BRS and ESI map to the
+// can_id and flag bits; the timestamp keeps its low 32 bits.
+void gs_usb_frame_from_bus(const can_bus_frame_t *in, uint32_t echo_id,
+                           gs_usb_frame_t *out);
+
+// Host frame to bus frame. The identifier is masked to 11 or 29 bits; ESI
+// and the timestamp are the controller's business and are left clear.
+void gs_usb_frame_to_bus(const gs_usb_frame_t *in, can_bus_frame_t *out);
+
+// CAN / CAN FD DLC helpers (len is rounded up to the next FD size).
+uint8_t gs_usb_len_to_dlc(uint8_t len);
+uint8_t gs_usb_dlc_to_len(uint8_t dlc);
+
+#ifdef __cplusplus
+}
+#endif
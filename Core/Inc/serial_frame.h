@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Byte-stream framing shared by the serial links (UART, USB CDC).
+ *
+ * On the wire every frame is
+ *   COBS( [type u8] [payload ...] [crc16 LE] ) 0x00
+ * COBS removes all zero bytes from the body, so 0x00 only ever appears as
+ * the delimiter and a receiver resynchronizes at the next zero after any
+ * corruption. crc16 is CRC-16/CCITT-FALSE over type + payload.
+ *
+ * Plain C with no HAL dependency so host tools can link it as well.
+ */
+
+#define SERIAL_FRAME_TYPE_ROUTER 0x01u // serialized sedsprintf packet
+#define SERIAL_FRAME_TYPE_CAN 0x02u    // raw CAN frame (gateway bridging)
+
+// SERIAL_FRAME_TYPE_CAN payload (little endian):
+//   [timestamp_us u64] [id u32] [flags u8] [len u8] [data: len bytes]
+// flags are can_bus.h CAN_BUS_FRAME_F_* (EXT, RTR, FD, BRS, ESI, TX).
+#define SERIAL_FRAME_CAN_HDR_LEN 14u
+
+#ifndef SERIAL_FRAME_MAX_PAYLOAD
+#define SERIAL_FRAME_MAX_PAYLOAD 512u
+#endif
+
+// Worst-case encoded size of a frame, delimiter included.
+#define SERIAL_FRAME_ENCODED_MAX(payload_len)                                  \
+  ((payload_len) + 3u + ((payload_len) + 3u) / 254u + 1u + 1u)
+
+typedef void (*serial_frame_rx_cb_t)(uint8_t type, const uint8_t *payload,
+                                     size_t len, void *user);
+
+typedef struct {
+  uint8_t buf[SERIAL_FRAME_ENCODED_MAX(SERIAL_FRAME_MAX_PAYLOAD)];
+  size_t len;
+  uint8_t overflow; // current frame too long; skip to next delimiter
+  serial_frame_rx_cb_t cb;
+  void *user;
+  uint32_t frames_ok;
+  uint32_t crc_errors;
+  uint32_t framing_errors; // bad COBS or oversize
+} serial_frame_decoder_t;
+
+uint16_t serial_frame_crc16(uint16_t crc, const uint8_t *data, size_t len);
+
+// Encode one frame into out. Returns bytes written (delimiter included) or 0
+// if out_cap is too small or payload is longer than SERIAL_FRAME_MAX_PAYLOAD.
+size_t serial_frame_encode(uint8_t type, const uint8_t *payload, size_t len,
+                           uint8_t *out, size_t out_cap);
+
+void serial_frame_decoder_init(serial_frame_decoder_t *d,
+                               serial_frame_rx_cb_t cb, void *user);
+
+// Feed received bytes (any chunking). Calls cb once per valid frame.
+void serial_frame_decoder_feed(serial_frame_decoder_t *d, const uint8_t *data,
+                               size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -55,7 +55,11 @@ void DebugMon_Handler(void);
 void USB_LP_IRQHandler(void);
 void TIM6_DAC_IRQHandler(void);
 /* USER CODE BEGIN EFP */
-
+void TIM2_IRQHandler(void);
+void FDCAN2_IT0_IRQHandler(void);
+void DMA1_Channel2_IRQHandler(void);
+void DMA1_Channel3_IRQHandler(void);
+void USART1_IRQHandler(void);
 /* USER CODE END EFP */
 
 #ifdef __cplusplus
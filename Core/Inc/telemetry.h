@@ -1,5 +1,12 @@
 #pragma once
 #include "sedsprintf.h"
+#include "telemetry_dedup.h"
+#include "telemetry_egress.h"
+#include "telemetry_heap.h"
+#include "telemetry_ingress.h"
+#include "telemetry_priority.h"
+#include "telemetry_route.h"
+#include "telemetry_stage.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -21,20 +28,108 @@ extern RouterState g_router;
 
 // Transmit and radio handlers implemented in telemetry.c
 SedsResult tx_send(const uint8_t *bytes, size_t len, void *user);
+SedsResult uart_tx_send(const uint8_t *bytes, size_t len, void *user);
+#ifdef TELEMETRY_USB_CDC
+SedsResult usb_tx_send(const uint8_t *bytes, size_t len, void *user);
+#endif
 
 SedsResult on_sd_packet(const SedsPacketView *pkt, void *user);
 
 // Initialize router once; safe to call multiple times.
 SedsResult init_telemetry_router(void);
 
-// Log a telemetry sample (1+ floats) with the given SedsDataType.
+// Log with an explicit element kind. queue=0 sends synchronously (thread
+// context only); queue=1 stages small payloads (ISR-safe) or queues larger
+// ones. With TELEMETRY_CHECK_ELEMENT_COUNT, a count that disagrees with
+// telemetry_schema.h returns SEDS_BAD_ARG. Normally called through the typed
+// macros below rather than directly.
+SedsResult log_telemetry_typed(SedsDataType data_type, const void *data,
+                               size_t element_count, size_t element_size,
+                               SedsElemKind kind, uint8_t queue);
+
+// Untyped entry points: the element kind is guessed from element_size
+// (4/8 bytes -> float, else unsigned). Kept for existing callers; integer
+// data should use log_telemetry_typed_* instead.
 SedsResult log_telemetry_synchronous(SedsDataType data_type, const void *data,
                                      size_t element_count, size_t element_size);
 
+// Small payloads (<= TELEMETRY_STAGE_MAX_BYTES) go through the staging ring,
+// so this is safe from several threads and from ISRs. Larger payloads are
+// logged directly and must come from thread context.
 SedsResult log_telemetry_asynchronous(SedsDataType data_type, const void *data,
                                       size_t element_count,
                                       size_t element_size);
 
+// Same contract as log_telemetry_asynchronous(); always staged. Use from ISRs.
+SedsResult log_telemetry_from_isr(SedsDataType data_type, const void *data,
+                                  size_t element_count, size_t element_size);
+
+/* ---------------- Compile-time typed logging ----------------
+ *
+ * SEDS_ELEM_KIND_OF(x) maps the C type of x to its SedsElemKind; unsupported
+ * types (structs, pointers) fail to compile.
+ *
+ *   float accel[3];  log_telemetry_array_async(SEDS_DT_..., accel);
+ *   uint32_t cnt;    log_telemetry_typed_async(SEDS_DT_..., &cnt, 1);
+ *
+ * The log_<t>_async/sync inline wrappers are the fixed-type fast paths for
+ * hot loops (constant element size, no kind lookup at runtime).
+ */
+#define SEDS_ELEM_KIND_OF(x)                                                   \
+  _Generic((x),                                                                \
+      float: SEDS_EK_FLOAT, double: SEDS_EK_FLOAT,                             \
+      signed char: SEDS_EK_SIGNED, short: SEDS_EK_SIGNED,                      \
+      int: SEDS_EK_SIGNED, long: SEDS_EK_SIGNED, long long: SEDS_EK_SIGNED,    \
+      char: SEDS_EK_UNSIGNED, unsigned char: SEDS_EK_UNSIGNED,                 \
+      unsigned short: SEDS_EK_UNSIGNED, unsigned int: SEDS_EK_UNSIGNED,        \
+      unsigned long: SEDS_EK_UNSIGNED, unsigned long long: SEDS_EK_UNSIGNED,   \
+      _Bool: SEDS_EK_UNSIGNED)
+
+#define log_telemetry_typed_async(data_type, ptr, count)                       \
+  log_telemetry_typed((data_type), (ptr), (count), sizeof(*(ptr)),             \
+                      SEDS_ELEM_KIND_OF(*(ptr)), 1)
+
+#define log_telemetry_typed_sync(data_type, ptr, count)                        \
+  log_telemetry_typed((data_type), (ptr), (count), sizeof(*(ptr)),            \
+                      SEDS_ELEM_KIND_OF(*(ptr)), 0)
+
+// Arrays only: passing a pointer is a compile error (count would be wrong).
+#define SEDS_ARRAY_COUNT_(arr)                                                 \
+  (sizeof(arr) / sizeof((arr)[0]) +                                            \
+   0 * sizeof(struct {                                                         \
+     int not_an_array_ : __builtin_types_compatible_p(__typeof__(arr),         \
+                                                      __typeof__(&(arr)[0]))   \
+                             ? -1                                              \
+                             : 1;                                              \
+   }))
+
+#define log_telemetry_array_async(data_type, arr)                              \
+  log_telemetry_typed_async((data_type), (arr), SEDS_ARRAY_COUNT_(arr))
+
+#define log_telemetry_array_sync(data_type, arr)                               \
+  log_telemetry_typed_sync((data_type), (arr), SEDS_ARRAY_COUNT_(arr))
+
+#define SEDS_DEFINE_TYPED_LOGGER_(name, ctype, kind)                           \
+  static inline SedsResult log_##name##_async(SedsDataType dt,                 \
+                                              const ctype *v, size_t n) {      \
+    return log_telemetry_typed(dt, v, n, sizeof(ctype), kind, 1);              \
+  }                                                                            \
+  static inline SedsResult log_##name##_sync(SedsDataType dt, const ctype *v,  \
+                                             size_t n) {                       \
+    return log_telemetry_typed(dt, v, n, sizeof(ctype), kind, 0);              \
+  }
+
+SEDS_DEFINE_TYPED_LOGGER_(f32, float, SEDS_EK_FLOAT)
+SEDS_DEFINE_TYPED_LOGGER_(f64, double, SEDS_EK_FLOAT)
+SEDS_DEFINE_TYPED_LOGGER_(u8, uint8_t, SEDS_EK_UNSIGNED)
+SEDS_DEFINE_TYPED_LOGGER_(u16, uint16_t, SEDS_EK_UNSIGNED)
+SEDS_DEFINE_TYPED_LOGGER_(u32, uint32_t, SEDS_EK_UNSIGNED)
+SEDS_DEFINE_TYPED_LOGGER_(u64, uint64_t, SEDS_EK_UNSIGNED)
+SEDS_DEFINE_TYPED_LOGGER_(i8, int8_t, SEDS_EK_SIGNED)
+SEDS_DEFINE_TYPED_LOGGER_(i16, int16_t, SEDS_EK_SIGNED)
+SEDS_DEFINE_TYPED_LOGGER_(i32, int32_t, SEDS_EK_SIGNED)
+SEDS_DEFINE_TYPED_LOGGER_(i64, int64_t, SEDS_EK_SIGNED)
+
 SedsResult dispatch_tx_queue(void);
 
 void rx_asynchronous(const uint8_t *bytes, size_t len);
@@ -50,10 +145,94 @@ SedsResult print_telemetry_error(int32_t error_code);
 SedsResult log_error_asyncronous(const char* fmt, ...);
 SedsResult log_error_syncronous(const char* fmt, ...);
 
+/* ---------------- Deferred (binary) error logging ----------------
+ *
+ * LOG_ERROR_DEFERRED_ASYNC/SYNC("fmt", args...) do not format on the target.
+ * The format string literal is placed in the non-loaded .seds_fmt ELF
+ * section and its address there is sent as a 32-bit ID, followed by the
+ * arguments as raw 32-bit words. tools/seds_fmt_decode.py rebuilds the text
+ * from the ELF on the host.
+ *
+ * Payload (TELEMETRY_DEFERRED_DATA_TYPE, bytes):
+ *   [0x1B 'F' nwords 0] [fmt_id u32 LE] [arg u32 LE] * nwords
+ *
+ * The records have a data type of their own: every consumer renders
+ * SEDS_DT_GENERIC_ERROR as text, and a binary blob there would show up as
+ * garbage on anything not running the decoder. That type,
+ * TELEMETRY_DEFERRED_DATA_TYPE, is set in telemetry_schema.h and exists only
+ * with TELEMETRY_DEFERRED_ERRORS (or an explicit TELEMETRY_DEFERRED_DATA_TYPE);
+ * without it log_error_deferred() returns SEDS_ERR.
+ *
+ * Arguments are converted to uint32_t. Integers and chars work as-is; cast
+ * pointers to (uintptr_t); pass floats with SEDS_FMT_F32(x) and 64-bit
+ * integers (%ll*) with SEDS_FMT_U64(x). %s is not supported (the host only
+ * sees the pointer value). More than TELEMETRY_DEFERRED_MAX_WORDS argument
+ * words is a compile error.
+ *
+ * With TELEMETRY_DEFERRED_ERRORS defined, log_error_asyncronous() and
+ * log_error_syncronous() themselves expand to the deferred form, so every
+ * call site must pass a string literal format.
+ */
+#define TELEMETRY_DEFERRED_MAGIC0 0x1Bu
+#define TELEMETRY_DEFERRED_MAGIC1 ((uint8_t)'F')
+#define TELEMETRY_DEFERRED_MAX_WORDS 6u // 8 + 4 + 6*4 = 36 bytes worst case
+
+SedsResult log_error_deferred(uint32_t fmt_id, const uint32_t *words,
+                              size_t nwords, uint8_t queue);
+
+#define SEDS_FMT_ID(fmt)                                                       \
+  __extension__({                                                              \
+    static const char seds_fmt_str_[]                                          \
+        __attribute__((section(".seds_fmt"), used)) = fmt;                     \
+    (uint32_t)(uintptr_t)seds_fmt_str_;                                        \
+  })
+
+#define SEDS_FMT_F32(x)                                                        \
+  (((union { float f; uint32_t u; }){.f = (float)(x)}).u)
+
+#define SEDS_FMT_U64(x)                                                        \
+  (uint32_t)(uint64_t)(x), (uint32_t)((uint64_t)(x) >> 32)
+
+#define SEDS_FMT_WORDS_(...) ((const uint32_t[]){0u, ##__VA_ARGS__})
+
+#define SEDS_FMT_NWORDS_(...)                                                  \
+  (sizeof(SEDS_FMT_WORDS_(__VA_ARGS__)) / sizeof(uint32_t) - 1u)
+
+#define SEDS_LOG_DEFERRED_(queue, fmt, ...)                                    \
+  __extension__({                                                              \
+    _Static_assert(SEDS_FMT_NWORDS_(__VA_ARGS__) <=                            \
+                       TELEMETRY_DEFERRED_MAX_WORDS,                           \
+                   "too many arguments for a deferred error record");          \
+    log_error_deferred(SEDS_FMT_ID(fmt), SEDS_FMT_WORDS_(__VA_ARGS__) + 1,     \
+                       SEDS_FMT_NWORDS_(__VA_ARGS__), (queue));                \
+  })
+
+#define LOG_ERROR_DEFERRED_ASYNC(fmt, ...)                                     \
+  SEDS_LOG_DEFERRED_(1, fmt, ##__VA_ARGS__)
+#define LOG_ERROR_DEFERRED_SYNC(fmt, ...)                                      \
+  SEDS_LOG_DEFERRED_(0, fmt, ##__VA_ARGS__)
+
+#ifdef TELEMETRY_DEFERRED_ERRORS
+#define log_error_asyncronous(fmt, ...) LOG_ERROR_DEFERRED_ASYNC(fmt, ##__VA_ARGS__)
+#define log_error_syncronous(fmt, ...) LOG_ERROR_DEFERRED_SYNC(fmt, ##__VA_ARGS__)
+#endif
+
 SedsResult telemetry_timesync_request(void);
 
+// Log the CAN controller health record (state, TEC/REC, bus-off and recovery
+// counters, LEC history) as TELEMETRY_CAN_STATUS_WORDS uint32 words, laid out
+// as in telemetry_schema.h. No-op unless TELEMETRY_CAN_STATUS_DATA_TYPE is
+// set; the counters stay readable through can_bus_get_stats().
+SedsResult telemetry_log_can_status(void);
+
+// Synchronized (master) time since the master's boot. Safe from any context.
+uint64_t telemetry_now_us(void);
 uint64_t telemetry_now_ms(void);
 
+// Synchronized time of an earlier timebase_now_us() reading, with the current
+// sync model. Lets ISRs stamp with the raw timebase and convert later.
+uint64_t telemetry_time_us_at(uint64_t local_us);
+
 uint64_t telemetry_unix_ms(void);
 uint64_t telemetry_unix_s(void);
 uint8_t  telemetry_unix_is_valid(void);
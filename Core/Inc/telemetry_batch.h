@@ -0,0 +1,109 @@
+#pragma once
+#include "sedsprintf.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Per-data-type batching / decimation stage (telemetry_batch.c).
+ *
+ * Sits between the staging ring and the router: telemetry_stage_drain() offers
+ * every staged record here first. Records of a configured type are decimated
+ * and accumulated into one packet per stream instead of one packet per
+ * sample, so the router header and CAN fragment overhead is paid once per
+ * batch. Everything runs in the telemetry thread; only the configuration
+ * calls may come from other threads.
+ *
+ * init_telemetry_router() configures the streams listed in
+ * telemetry_batches.h; telemetry_batch_configure() adds or changes one at
+ * run time.
+ *
+ * Only records that went through the staging ring (async logs of up to
+ * TELEMETRY_STAGE_MAX_BYTES) are batched; sync logs bypass this stage.
+ *
+ * The batched packet is logged as `out_type` with element_count = samples x
+ * elements (RAW) or 3 x elements floats laid out [min..][max..][mean..]
+ * (SUMMARY), timestamped with the first sample. `out_type` must be a
+ * variable-length type in the schema.
+ *
+ * With TELEMETRY_BATCH_CODEC_GORILLA a RAW batch is instead sent as one
+ * Gorilla-coded byte blob (per-sample timestamps + XOR-coded values) that
+ * receivers expand with telemetry_gorilla_decode(). Sample times are kept
+ * in microseconds all the way into the blob; only the router timestamp of
+ * the packet is in milliseconds.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef TELEMETRY_BATCH_STREAMS
+#define TELEMETRY_BATCH_STREAMS 4u
+#endif
+
+#ifndef TELEMETRY_BATCH_MAX_BYTES
+#define TELEMETRY_BATCH_MAX_BYTES 256u // raw sample bytes per batch
+#endif
+
+#ifndef TELEMETRY_BATCH_MAX_SAMPLES
+#define TELEMETRY_BATCH_MAX_SAMPLES 32u
+#endif
+
+typedef enum {
+  TELEMETRY_BATCH_RAW = 0,     // concatenate kept samples
+  TELEMETRY_BATCH_SUMMARY = 1, // per-element min/max/mean as floats
+} TelemetryBatchMode;
+
+typedef enum {
+  TELEMETRY_BATCH_CODEC_NONE = 0,
+  TELEMETRY_BATCH_CODEC_GORILLA = 1, // telemetry_gorilla.h, RAW mode only
+} TelemetryBatchCodec;
+
+typedef struct {
+  SedsDataType data_type; // input stream
+  SedsDataType out_type;  // packet type for the batch (variable length)
+  uint16_t decimate;      // keep 1 of every N samples (0 or 1 = keep all)
+  uint16_t max_samples;   // flush after this many kept samples (0 = buffer cap)
+  uint16_t max_age_ms;    // flush when the oldest sample is this old (0 = off)
+  uint8_t mode;           // TelemetryBatchMode
+  uint8_t codec;          // TelemetryBatchCodec
+} TelemetryBatchConfig;
+
+typedef struct {
+  uint32_t samples_in;
+  uint32_t samples_kept;
+  uint32_t batches_out;
+  uint32_t bytes_out; // payload bytes handed to the router
+  uint32_t raw_bytes; // kept sample bytes + 8 per timestamp, before batching
+} TelemetryBatchStats;
+
+// Effective compression ratio of a stream (raw_bytes / bytes_out), 0 if
+// nothing has been sent yet.
+static inline float telemetry_batch_ratio(const TelemetryBatchStats *st) {
+  return (st && st->bytes_out) ? (float)st->raw_bytes / (float)st->bytes_out
+                               : 0.0f;
+}
+
+// Add a stream or update an existing one (takes effect at the next flush).
+// SEDS_ERR if all TELEMETRY_BATCH_STREAMS slots are in use.
+SedsResult telemetry_batch_configure(const TelemetryBatchConfig *cfg);
+
+// Flush and remove a stream; its samples go straight to the router again.
+SedsResult telemetry_batch_remove(SedsDataType data_type);
+
+SedsResult telemetry_batch_get_stats(SedsDataType data_type,
+                                     TelemetryBatchStats *out);
+
+// Telemetry thread only. `ts_us` is the record's synchronized time
+// (telemetry_time_us_at()). Returns 1 if the record was consumed (batched or
+// decimated away), 0 if the type is not batched and should be logged as is.
+int telemetry_batch_submit(SedsDataType data_type, const void *data,
+                           size_t element_count, size_t element_size,
+                           SedsElemKind kind, uint64_t ts_us);
+
+// Telemetry thread only. Flushes batches older than their max_age_ms;
+// `now_us` is telemetry_now_us().
+void telemetry_batch_poll(uint64_t now_us);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+#include "telemetry_batch.h"
+
+#include <stdio.h>
+
+/*
+ * Batched streams configured by init_telemetry_router().
+ *
+ * One row per stream:
+ *   X(data_type, out_type, decimate, max_samples, max_age_ms, mode, codec)
+ * with mode RAW or SUMMARY (TELEMETRY_BATCH_<x>) and codec NONE or GORILLA
+ * (TELEMETRY_BATCH_CODEC_<x>); see TelemetryBatchConfig. Only fixed-size
+ * numeric types logged asynchronously gain anything, and out_type must be a
+ * variable-length type in the schema, e.g.
+ *   X(SEDS_DT_IMU_DATA, SEDS_DT_IMU_BATCH, 1, 16, 100, RAW, GORILLA)
+ *
+ * Default: none. The gateway's own types are text, errors and time sync,
+ * none of which may be batched; a board logging sensor streams lists them
+ * here or defines TELEMETRY_BATCHES in its build configuration.
+ */
+#ifndef TELEMETRY_BATCHES
+#define TELEMETRY_BATCHES(X)
+#endif
+
+#define TELEMETRY_BATCH_STREAM_(dt, out, decim, samples, age, md, cdc)        \
+  do {                                                                         \
+    const TelemetryBatchConfig cfg_ = {                                        \
+        .data_type = (dt),                                                     \
+        .out_type = (out),                                                     \
+        .decimate = (uint16_t)(decim),                                         \
+        .max_samples = (uint16_t)(samples),                                    \
+        .max_age_ms = (uint16_t)(age),                                         \
+        .mode = (uint8_t)TELEMETRY_BATCH_##md,                                 \
+        .codec = (uint8_t)TELEMETRY_BATCH_CODEC_##cdc,                         \
+    };                                                                         \
+    if (telemetry_batch_configure(&cfg_) != SEDS_OK)                           \
+      printf("Error: cannot batch data type %d\r\n", (int)(dt));               \
+  } while (0);
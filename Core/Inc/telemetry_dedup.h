@@ -0,0 +1,53 @@
+#pragma once
+#include "sedsprintf.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Duplicate cache (telemetry_dedup.c).
+ *
+ * Relay loop suppression. Every packet received on a link is checked against
+ * a small cache of recently seen packets (keyed on a hash of the serialized
+ * bytes, which carry sender, type and timestamp) and dropped if it was seen
+ * within TELEMETRY_DEDUP_WINDOW_MS. Packets this node sends are noted too, so
+ * a copy echoed back by another gateway is dropped as well.
+ *
+ * Together with the no-reflection rule (a packet is never relayed back to
+ * the side it came from; the routing table cannot allow src == dst), this
+ * keeps two or more relaying gateways on one bus from amplifying traffic.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef TELEMETRY_DEDUP
+#define TELEMETRY_DEDUP 1
+#endif
+
+#ifndef TELEMETRY_DEDUP_ENTRIES
+#define TELEMETRY_DEDUP_ENTRIES 64u // 4 times a power of two; 8 B each
+#endif
+
+#ifndef TELEMETRY_DEDUP_WINDOW_MS
+#define TELEMETRY_DEDUP_WINDOW_MS 500u
+#endif
+
+typedef struct {
+  uint32_t checked;
+  uint32_t duplicates;
+  uint32_t noted;   // own transmissions recorded
+  uint32_t evicted; // live entries pushed out (cache too small for the load)
+} TelemetryDedupStats;
+
+// 1 if the packet was seen within the window, else 0. Records it either way.
+int telemetry_dedup_check(const uint8_t *bytes, size_t len);
+
+// Record a packet this node sends, without counting it as checked.
+void telemetry_dedup_note(const uint8_t *bytes, size_t len);
+
+void telemetry_dedup_get_stats(TelemetryDedupStats *out);
+
+#ifdef __cplusplus
+}
+#endif
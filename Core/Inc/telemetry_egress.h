@@ -0,0 +1,112 @@
+#pragma once
+#include "sedsprintf.h"
+#include "telemetry_priority.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Per-side egress queues (telemetry_egress.c).
+ *
+ * Every router side gets its own bounded output queue. The router's side TX
+ * callbacks only enqueue; telemetry_egress_poll() (telemetry thread) drains
+ * each queue independently into its link and stops at the first "busy", so
+ * a slow or stalled link (USB host not reading, UART at 115200, CAN bus-off)
+ * backs up only its own queue while the others keep draining.
+ *
+ * When a queue is full the policy decides what goes: the new packet
+ * (DROP_NEWEST) or the oldest queued ones (DROP_OLDEST, the default, so a
+ * link that comes back gets current data). Packets that waited longer than
+ * TELEMETRY_EGRESS_MAX_AGE_MS are dropped before sending (0 disables).
+ *
+ * Each side has a queue per priority class; a poll serves HIGH before BULK.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef TELEMETRY_EGRESS_QUEUES
+#define TELEMETRY_EGRESS_QUEUES 1
+#endif
+
+#ifndef TELEMETRY_EGRESS_MAX_SIDES
+#define TELEMETRY_EGRESS_MAX_SIDES 3u
+#endif
+
+#ifndef TELEMETRY_EGRESS_QUEUE_BYTES
+#define TELEMETRY_EGRESS_QUEUE_BYTES 2048u // per side; 8 B overhead per packet
+#endif
+
+// HIGH queue per side. High packets too big for it are queued as BULK.
+#ifndef TELEMETRY_EGRESS_HIGH_QUEUE_BYTES
+#define TELEMETRY_EGRESS_HIGH_QUEUE_BYTES 512u
+#endif
+
+// Largest packet that is queued; bigger ones are sent directly, once.
+#ifndef TELEMETRY_EGRESS_MAX_PACKET
+#define TELEMETRY_EGRESS_MAX_PACKET 640u
+#endif
+
+#ifndef TELEMETRY_EGRESS_MAX_AGE_MS
+#define TELEMETRY_EGRESS_MAX_AGE_MS 1000u
+#endif
+
+// Packets handed to one link per poll, so one busy side cannot starve the
+// rest of the loop.
+#ifndef TELEMETRY_EGRESS_POLL_BUDGET
+#define TELEMETRY_EGRESS_POLL_BUDGET 8u
+#endif
+
+typedef enum {
+  TELEMETRY_EGRESS_DROP_NEWEST = 0,
+  TELEMETRY_EGRESS_DROP_OLDEST = 1,
+} TelemetryEgressPolicy;
+
+typedef enum {
+  TELEMETRY_EGRESS_SENT = 0,   // link took the whole packet
+  TELEMETRY_EGRESS_BUSY = 1,   // try again on a later poll
+  TELEMETRY_EGRESS_FAILED = 2, // give up on this packet
+} TelemetryEgressResult;
+
+// Link send hook. first is 1 on the first attempt for a packet and 0 on
+// retries after TELEMETRY_EGRESS_BUSY (bytes are unchanged between them).
+// A HIGH packet may be offered between retries of a BULK one.
+typedef TelemetryEgressResult (*TelemetryEgressSendFn)(const uint8_t *bytes,
+                                                       size_t len,
+                                                       uint8_t first,
+                                                       TelemetryPriority prio,
+                                                       void *user);
+
+typedef struct {
+  uint32_t enqueued;
+  uint32_t sent;
+  uint32_t dropped_newest;  // queue full, DROP_NEWEST
+  uint32_t dropped_oldest;  // evicted to make room, DROP_OLDEST
+  uint32_t expired;         // older than TELEMETRY_EGRESS_MAX_AGE_MS
+  uint32_t failed;          // link returned FAILED
+  uint32_t busy;            // polls that stopped at a busy link
+  uint32_t oversize;        // > TELEMETRY_EGRESS_MAX_PACKET, sent directly
+  uint32_t sent_high;       // of sent, HIGH class
+  uint16_t depth_bytes;     // BULK queue
+  uint16_t high_water_bytes;
+  uint16_t depth_packets;
+  uint16_t depth_high_packets;
+} TelemetryEgressStats;
+
+// Register a side. Returns its index, or -1 when all slots are taken.
+int32_t telemetry_egress_add(const char *name, TelemetryEgressSendFn send,
+                             void *user, TelemetryEgressPolicy policy);
+
+// Queue one packet (thread context). SEDS_OK if queued, SEDS_IO if dropped.
+SedsResult telemetry_egress_push(int32_t side, TelemetryPriority prio,
+                                 const uint8_t *bytes, size_t len);
+
+// Telemetry thread only.
+void telemetry_egress_poll(void);
+
+void telemetry_egress_set_policy(int32_t side, TelemetryEgressPolicy policy);
+void telemetry_egress_get_stats(int32_t side, TelemetryEgressStats *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,79 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Gorilla-style time-series codec for batched telemetry (telemetry_gorilla.c).
+ *
+ * Encodes one batch of N samples (each `elem_count` elements of `elem_size`
+ * bytes) with per-sample timestamps:
+ *   - timestamps as delta-of-delta in variable-width buckets,
+ *   - 4- and 8-byte values column by column, each XORed with the previous
+ *     value of the same element and stored as (leading zeros, meaningful bits),
+ *   - other element sizes are stored verbatim after the timestamps.
+ *
+ * Packet layout (little-endian, bit stream MSB-first):
+ *   [0x1B 'G'] [flags|kind] [elem_size] [elem_count] [n u16] [t0 u64]
+ *   [n-1 timestamp codes] [values]
+ *
+ * Timestamps are microseconds: t0 since router start (the packet's router
+ * timestamp is t0 / 1000), the per-sample times as offsets from it.
+ *
+ * Plain C with no HAL or ThreadX dependency: the same file is the firmware
+ * encoder and, through gateway_portable in tools/, the host decoder that
+ * gwdecode --expand uses.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TELEMETRY_GORILLA_MAGIC0 0x1Bu
+#define TELEMETRY_GORILLA_MAGIC1 0x47u // 'G'
+#define TELEMETRY_GORILLA_HEADER_BYTES 15u
+
+#define TELEMETRY_GORILLA_FLAG_STORED 0x80u // values not XOR coded
+#define TELEMETRY_GORILLA_KIND_MASK 0x0Fu
+
+typedef struct {
+  uint8_t kind;       // SedsElemKind of the elements
+  uint8_t elem_size;  // bytes per element
+  uint8_t elem_count; // elements per sample
+  uint8_t stored;     // 1 if values are verbatim
+  uint16_t n;         // samples
+  uint64_t t0;        // timestamp of the first sample, us
+} TelemetryGorillaHeader;
+
+// Worst-case encoded size for a batch.
+#define TELEMETRY_GORILLA_MAX_ENCODED(n, sample_bytes)                         \
+  (TELEMETRY_GORILLA_HEADER_BYTES + (size_t)(n) * 5u +                         \
+   (size_t)(n) * (size_t)(sample_bytes) * 2u)
+
+// Encode `n` samples laid out back to back in `samples`. `ts_off[i]` is the
+// timestamp of sample i relative to `t0`, in us (ts_off[0] is ignored).
+// Returns the encoded length, or 0 if `out_cap` is too small or the
+// arguments are invalid.
+size_t telemetry_gorilla_encode(uint8_t *out, size_t out_cap,
+                                const void *samples, const uint32_t *ts_off,
+                                uint16_t n, uint8_t elem_size,
+                                uint8_t elem_count, uint8_t kind, uint64_t t0);
+
+// 1 if `data` starts with a Gorilla batch header.
+int telemetry_gorilla_is_packet(const uint8_t *data, size_t len);
+
+// Parse the header only. Returns 0 on success, -1 if malformed.
+int telemetry_gorilla_header(const uint8_t *data, size_t len,
+                             TelemetryGorillaHeader *hdr);
+
+// Decode a batch. Samples are written back to back into `samples_out`
+// (n * elem_size * elem_count bytes) and per-sample absolute timestamps in us
+// into `ts_out` (n entries, may be NULL). Returns the number of samples, or -1
+// if the packet is malformed or an output buffer is too small.
+int telemetry_gorilla_decode(const uint8_t *data, size_t len,
+                             TelemetryGorillaHeader *hdr, void *samples_out,
+                             size_t samples_cap, uint64_t *ts_out,
+                             size_t ts_cap);
+
+#ifdef __cplusplus
+}
+#endif
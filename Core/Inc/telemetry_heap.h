@@ -0,0 +1,58 @@
+#pragma once
+#include <stdint.h>
+
+/*
+ * Rust heap (telemetry_hooks.c).
+ *
+ * telemetryMalloc() serves requests up to the largest size class from
+ * fixed-size TX_BLOCK_POOLs (O(1), no fragmentation). Larger requests, and
+ * requests whose class is exhausted, fall back to the TX_BYTE_POOL.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TELEMETRY_HEAP_CLASSES 5u
+
+typedef struct {
+  uint16_t block_size;
+  uint16_t blocks;
+  uint16_t in_use;
+  uint16_t high_water;
+  uint32_t allocs;
+  uint32_t spills; // class exhausted, request went to the byte pool
+} TelemetryHeapClassStats;
+
+typedef struct {
+  TelemetryHeapClassStats cls[TELEMETRY_HEAP_CLASSES];
+  uint32_t pool_bytes;         // byte pool size
+  uint32_t pool_available;     // bytes currently free in the byte pool
+  uint32_t pool_min_available; // low-water mark of pool_available
+  uint32_t pool_fragments;     // free/used blocks in the byte pool
+  uint32_t pool_allocs;
+  uint32_t failures; // requests that returned NULL
+} TelemetryHeapStats;
+
+void telemetry_heap_get_stats(TelemetryHeapStats *out);
+
+/*
+ * Allocation profiler (TELEMETRY_HEAP_PROFILE, CMake option of the same name).
+ * Tracks live/peak bytes and, per power-of-two request size, allocation
+ * counts, live bytes and lifetimes. Sizes that keep old blocks alive are
+ * leak candidates. Compiled out entirely when the option is off.
+ */
+#ifdef TELEMETRY_HEAP_PROFILE
+#define TELEMETRY_HEAP_PROFILE_OUT_CONSOLE 0x01u
+#define TELEMETRY_HEAP_PROFILE_OUT_TELEMETRY 0x02u // SEDS_DT_MESSAGE_DATA lines
+
+void telemetry_heap_profile_dump(uint8_t outputs);
+void telemetry_heap_profile_reset_peak(void);
+#else
+#define telemetry_heap_profile_dump(outputs) ((void)0)
+#define telemetry_heap_profile_reset_peak() ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
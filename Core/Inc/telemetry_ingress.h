@@ -0,0 +1,77 @@
+#pragma once
+#include "sedsprintf.h"
+#include "telemetry_peek.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Ingress pre-filter (telemetry_ingress.c).
+ *
+ * Every serialized packet received on a link is classified by peeking at its
+ * data type before it is queued into the router, where full deserialization
+ * happens:
+ *   ROUTE    queue into the router (the default for every type)
+ *   FORWARD  relay the bytes to the other sides as-is, skipping the router
+ *            (still subject to the routing table)
+ *   DROP     discard
+ * Verdicts are kept in per-type bitmaps set with telemetry_ingress_set().
+ *
+ * Wire-format assumption: the data type is a ULEB128 varint starting
+ * TELEMETRY_INGRESS_TYPE_OFFSET bytes into the serialized packet. The
+ * ingress_peek host test (tools/tests) checks this against packets the
+ * router library serializes; adjust the offset if that test fails after a
+ * sedsprintf update.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Off by default: TELEMETRY_INGRESS_TYPE_OFFSET has not been checked against
+// the pinned sedsprintf_rs yet. With the filter off every packet goes to the
+// router.
+#ifndef TELEMETRY_INGRESS_FILTER
+#define TELEMETRY_INGRESS_FILTER 0
+#endif
+
+// Anything shorter is not a router packet (e.g. a raw classic CAN frame).
+#ifndef TELEMETRY_INGRESS_MIN_LEN
+#define TELEMETRY_INGRESS_MIN_LEN (TELEMETRY_INGRESS_TYPE_OFFSET + 1u)
+#endif
+
+// Types at or above this have no bitmap entry and get the unknown verdict.
+#ifndef TELEMETRY_INGRESS_MAX_TYPES
+#define TELEMETRY_INGRESS_MAX_TYPES 64u
+#endif
+
+#ifndef TELEMETRY_INGRESS_UNKNOWN_VERDICT
+#define TELEMETRY_INGRESS_UNKNOWN_VERDICT TELEMETRY_INGRESS_ROUTE
+#endif
+
+typedef enum {
+  TELEMETRY_INGRESS_ROUTE = 0,
+  TELEMETRY_INGRESS_FORWARD = 1,
+  TELEMETRY_INGRESS_DROP = 2,
+  TELEMETRY_INGRESS_VERDICTS
+} TelemetryIngressVerdict;
+
+typedef struct {
+  uint32_t routed;
+  uint32_t forwarded;
+  uint32_t dropped; // by type, plus runts
+  uint32_t runt;    // too short to hold a header
+  uint32_t unknown; // type >= TELEMETRY_INGRESS_MAX_TYPES
+} TelemetryIngressStats;
+
+void telemetry_ingress_set(SedsDataType data_type,
+                           TelemetryIngressVerdict verdict);
+
+// Classify one packet and count the verdict. Any thread.
+TelemetryIngressVerdict telemetry_ingress_classify(const uint8_t *bytes,
+                                                   size_t len);
+
+void telemetry_ingress_get_stats(TelemetryIngressStats *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Header peek on a serialized router packet (telemetry_peek.c): the data
+ * type, read without deserializing the packet. The ingress filter, routing
+ * table and CAN ID selection classify by it on the board, and gwdecode
+ * labels reassembled packets with it.
+ *
+ * Wire-format assumption: the data type is a ULEB128 varint starting
+ * TELEMETRY_INGRESS_TYPE_OFFSET bytes into the serialized packet (see
+ * telemetry_ingress.h).
+ *
+ * Plain C with no HAL or sedsprintf dependency so host tools can link it as
+ * well.
+ */
+
+#ifndef TELEMETRY_INGRESS_TYPE_OFFSET
+#define TELEMETRY_INGRESS_TYPE_OFFSET 0u
+#endif
+
+// Data type of a serialized packet, or -1 if the header is cut short.
+int32_t telemetry_peek_data_type(const uint8_t *bytes, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
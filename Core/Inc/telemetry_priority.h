@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+
+/*
+ * Priority classes and CAN bands (telemetry.c).
+ *
+ * Time sync, alarms and commands must not wait behind bulk logs: for time
+ * sync the queueing delay is offset error. Every type has a CAN band in
+ * TELEMETRY_SCHEMA (telemetry_schema.h). On the bus the band is the upper
+ * part of the ID, so arbitration orders traffic by band before anything
+ * else, whichever node is logging the most.
+ *
+ * Bands up to TELEMETRY_CAN_BAND_HIGH_LAST are the HIGH class. On TX they
+ * have their own egress queue per side, served first. On RX they are handed
+ * to the router straight away instead of being queued behind bulk packets.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  TELEMETRY_PRIO_BULK = 0,
+  TELEMETRY_PRIO_HIGH = 1,
+  TELEMETRY_PRIO_CLASSES
+} TelemetryPriority;
+
+// CAN ID bands of the router traffic (can_node.h); lower wins arbitration.
+// Each node sends under CAN_NODE_ID(band, its address), and receivers accept
+// every band from TIME to BULK from any address. Not overridable: all boards
+// must agree.
+#define TELEMETRY_CAN_BAND_TIME 0x02u    // time sync
+#define TELEMETRY_CAN_BAND_ALARM 0x03u   // errors, aborts
+#define TELEMETRY_CAN_BAND_COMMAND 0x04u // commands and their acks
+#define TELEMETRY_CAN_BAND_STATUS 0x08u  // periodic state
+#define TELEMETRY_CAN_BAND_BULK 0x10u    // logs, and types not in the schema
+#define TELEMETRY_CAN_BAND_HIGH_LAST TELEMETRY_CAN_BAND_COMMAND
+
+// Band of a data type (as from telemetry_peek_data_type(); -1 is BULK).
+uint8_t telemetry_can_band_of(int32_t data_type);
+
+// Class of a data type (as from telemetry_peek_data_type(); -1 is BULK).
+TelemetryPriority telemetry_priority_of(int32_t data_type);
+
+#ifdef __cplusplus
+}
+#endif
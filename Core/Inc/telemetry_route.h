@@ -0,0 +1,90 @@
+#pragma once
+#include "sedsprintf.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Routing table (telemetry_route.c).
+ *
+ * Decides, per data type, source side and destination side, whether a packet
+ * goes out on a link: allow, deny, or allow up to a rate (token bucket per
+ * rule). With the table enabled the router runs as a sink and the gateway
+ * relays received packets itself (telemetry.c); packets this node logs use
+ * TELEMETRY_ROUTE_LOCAL as their source.
+ *
+ * Rules are applied in order and a later rule overrides an earlier one for
+ * the cells both match, so a table reads "deny everything to the radio, then
+ * allow these". Cells no rule matches are allowed; src == dst is always
+ * denied. telemetry_route_load()
+ * compiles the rules into a [type][src][dst] byte table and swaps it in
+ * atomically; it can be called again at any time. The default rules are in
+ * telemetry_routes.h.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Off by default: the table classifies by telemetry_peek_data_type(), whose
+// offset (telemetry_ingress.h) has not been checked against the pinned
+// sedsprintf_rs yet. Turn on once ingress_peek_test passes against it.
+#ifndef TELEMETRY_ROUTE_TABLE
+#define TELEMETRY_ROUTE_TABLE 0
+#endif
+
+// Types at or above this share one row, matched only by ANY_TYPE rules.
+#ifndef TELEMETRY_ROUTE_MAX_TYPES
+#define TELEMETRY_ROUTE_MAX_TYPES 32u
+#endif
+
+#ifndef TELEMETRY_ROUTE_MAX_LIMITERS
+#define TELEMETRY_ROUTE_MAX_LIMITERS 8u // RATE rules per table
+#endif
+
+typedef enum {
+  TELEMETRY_ROUTE_LOCAL = 0, // source only: logged on this node
+  TELEMETRY_ROUTE_CAN = 1,
+  TELEMETRY_ROUTE_UART = 2,
+  TELEMETRY_ROUTE_USB = 3,
+  TELEMETRY_ROUTE_SIDES
+} TelemetryRouteSide;
+
+#define TELEMETRY_ROUTE_ANY_TYPE 0xFFFFu
+#define TELEMETRY_ROUTE_ANY_SIDE 0xFFu
+
+typedef enum {
+  TELEMETRY_ROUTE_DENY = 0,
+  TELEMETRY_ROUTE_ALLOW = 1,
+  TELEMETRY_ROUTE_RATE = 2, // allow up to rate_per_s, bursts up to burst
+} TelemetryRouteAction;
+
+typedef struct {
+  uint16_t data_type; // SedsDataType or TELEMETRY_ROUTE_ANY_TYPE
+  uint8_t src;        // TelemetryRouteSide or TELEMETRY_ROUTE_ANY_SIDE
+  uint8_t dst;        // TelemetryRouteSide (not LOCAL) or ANY_SIDE
+  uint8_t action;     // TelemetryRouteAction
+  uint16_t rate_per_s;
+  uint16_t burst;
+} TelemetryRouteRule;
+
+typedef struct {
+  uint32_t allowed;
+  uint32_t denied;
+  uint32_t rate_limited;
+  uint32_t loads;
+} TelemetryRouteStats;
+
+// Compile and activate a rule set. SEDS_BAD_ARG (old table kept) on an
+// invalid side or action, or more than TELEMETRY_ROUTE_MAX_LIMITERS RATE rules.
+SedsResult telemetry_route_load(const TelemetryRouteRule *rules, size_t count);
+
+// 1 if a packet of data_type may go from src to dst now (takes a token on
+// RATE cells). Any thread.
+int telemetry_route_check(int32_t data_type, TelemetryRouteSide src,
+                          TelemetryRouteSide dst);
+
+void telemetry_route_get_stats(TelemetryRouteStats *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+#include "telemetry_route.h"
+#include "telemetry_schema.h"
+
+/*
+ * Gateway routing rules loaded by init_telemetry_router().
+ *
+ * One row per rule:
+ *   X(data_type, src, dst, action, rate_per_s, burst)
+ * with src/dst one of LOCAL, CAN, UART, USB or ANY (TELEMETRY_ROUTE_<x>),
+ * data_type a SedsDataType or TELEMETRY_ROUTE_ANY_TYPE, and action DENY,
+ * ALLOW or RATE. Later rows override earlier ones; anything not matched is
+ * allowed. See telemetry_route.h.
+ *
+ * Default: everything between CAN and USB, but only what the ground station
+ * needs over the radio (UART): messages rate limited, errors (text and
+ * deferred) always.
+ */
+// Deferred errors, when built in (telemetry_schema.h), go wherever the
+// text errors go.
+#ifdef TELEMETRY_DEFERRED_DATA_TYPE
+#define TELEMETRY_ROUTES_DEFERRED_(X)                                          \
+  X(TELEMETRY_DEFERRED_DATA_TYPE, ANY, UART, ALLOW, 0, 0)
+#else
+#define TELEMETRY_ROUTES_DEFERRED_(X)
+#endif
+
+#ifndef TELEMETRY_ROUTES
+#define TELEMETRY_ROUTES(X)                                                    \
+  X(TELEMETRY_ROUTE_ANY_TYPE, ANY, UART, DENY, 0, 0)                           \
+  X(SEDS_DT_MESSAGE_DATA, ANY, UART, RATE, 10, 20)                             \
+  X(SEDS_DT_GENERIC_ERROR, ANY, UART, ALLOW, 0, 0)                             \
+  TELEMETRY_ROUTES_DEFERRED_(X)
+#endif
+
+#define TELEMETRY_ROUTE_RULE_(dt, src, dst, action, rate, burst)               \
+  {(uint16_t)(dt),                                                             \
+   (uint8_t)TELEMETRY_ROUTE_##src,                                             \
+   (uint8_t)TELEMETRY_ROUTE_##dst,                                             \
+   (uint8_t)TELEMETRY_ROUTE_##action,                                          \
+   (uint16_t)(rate),                                                           \
+   (uint16_t)(burst)},
+
+// TELEMETRY_ROUTE_ANY used as a side in the rows above.
+#define TELEMETRY_ROUTE_ANY TELEMETRY_ROUTE_ANY_SIDE
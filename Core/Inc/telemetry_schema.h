@@ -0,0 +1,93 @@
+#pragma once
+#include "sedsprintf.h"
+#include <stddef.h>
+
+/*
+ * Board-side view of the telemetry schema.
+ *
+ * One row per data type this board logs or relays:
+ *   X(data_type, element_count, can_band)
+ * element_count is the number of elements a packet of that type carries;
+ * 0 means variable length (strings, blobs). can_band is TIME, ALARM,
+ * COMMAND, STATUS or BULK (TELEMETRY_CAN_BAND_<x> in telemetry_priority.h):
+ * the CAN ID band the type is sent in, and with it its priority class.
+ *
+ * Must agree with the sedsprintf schema, and the bands must agree across
+ * every board on the bus. Unknown types are treated as variable length and
+ * sent as BULK.
+ *
+ * The deferred error type (telemetry.h) is only listed when deferred error
+ * logging is built in: the sedsprintf schema must then carry a
+ * variable-length byte type for it, SEDS_DT_DEFERRED_ERROR unless
+ * TELEMETRY_DEFERRED_DATA_TYPE names another one. It must be a type of its
+ * own, not one of the rows below.
+ *
+ * The same goes for the CAN health record (telemetry_log_can_status()):
+ * with TELEMETRY_CAN_STATUS the schema must carry a fixed-length uint32 type
+ * of TELEMETRY_CAN_STATUS_WORDS elements for it, SEDS_DT_CAN_STATUS unless
+ * TELEMETRY_CAN_STATUS_DATA_TYPE names another one.
+ */
+#if defined(TELEMETRY_DEFERRED_ERRORS) && !defined(TELEMETRY_DEFERRED_DATA_TYPE)
+#define TELEMETRY_DEFERRED_DATA_TYPE SEDS_DT_DEFERRED_ERROR
+#endif
+
+#ifdef TELEMETRY_DEFERRED_DATA_TYPE
+#define TELEMETRY_SCHEMA_DEFERRED_(X) X(TELEMETRY_DEFERRED_DATA_TYPE, 0, ALARM)
+#else
+#define TELEMETRY_SCHEMA_DEFERRED_(X)
+#endif
+
+#if defined(TELEMETRY_CAN_STATUS) && !defined(TELEMETRY_CAN_STATUS_DATA_TYPE)
+#define TELEMETRY_CAN_STATUS_DATA_TYPE SEDS_DT_CAN_STATUS
+#endif
+
+// Word layout of the CAN health record.
+enum {
+  TELEMETRY_CAN_STATUS_STATE = 0, // can_bus_state_t
+  TELEMETRY_CAN_STATUS_TEC,
+  TELEMETRY_CAN_STATUS_REC,
+  TELEMETRY_CAN_STATUS_WARNING_COUNT,
+  TELEMETRY_CAN_STATUS_ERROR_PASSIVE_COUNT,
+  TELEMETRY_CAN_STATUS_BUS_OFF_COUNT,
+  TELEMETRY_CAN_STATUS_RECOVERY_COUNT,
+  TELEMETRY_CAN_STATUS_LAST_RECOVERY_MS,
+  TELEMETRY_CAN_STATUS_MAX_RECOVERY_MS,
+  TELEMETRY_CAN_STATUS_TX_DROPPED,
+  TELEMETRY_CAN_STATUS_TX_ABORTED,
+  TELEMETRY_CAN_STATUS_RX_OVERFLOW,
+  // Last 8 LECs, one per nibble, newest in the low nibble; 0 = none.
+  TELEMETRY_CAN_STATUS_LEC_HISTORY,
+  TELEMETRY_CAN_STATUS_WORDS
+};
+
+#ifdef TELEMETRY_CAN_STATUS_DATA_TYPE
+#define TELEMETRY_SCHEMA_CAN_STATUS_(X)                                        \
+  X(TELEMETRY_CAN_STATUS_DATA_TYPE, TELEMETRY_CAN_STATUS_WORDS, STATUS)
+#else
+#define TELEMETRY_SCHEMA_CAN_STATUS_(X)
+#endif
+
+#define TELEMETRY_SCHEMA(X)                                                    \
+  X(SEDS_DT_MESSAGE_DATA, 0, BULK)                                             \
+  X(SEDS_DT_GENERIC_ERROR, 0, ALARM)                                           \
+  TELEMETRY_SCHEMA_DEFERRED_(X)                                                \
+  TELEMETRY_SCHEMA_CAN_STATUS_(X)                                              \
+  X(SEDS_DT_TIME_SYNC_REQUEST, 2, TIME)                                        \
+  X(SEDS_DT_TIME_SYNC_RESPONSE, 4, TIME)                                       \
+  X(SEDS_DT_TIME_SYNC_ANNOUNCE, 2, TIME)
+
+#ifndef TELEMETRY_CHECK_ELEMENT_COUNT
+#define TELEMETRY_CHECK_ELEMENT_COUNT 1
+#endif
+
+static inline size_t telemetry_expected_count(SedsDataType data_type) {
+  switch (data_type) {
+#define TELEMETRY_SCHEMA_COUNT_CASE_(dt, count, band)                          \
+  case dt:                                                                     \
+    return (count);
+    TELEMETRY_SCHEMA(TELEMETRY_SCHEMA_COUNT_CASE_)
+#undef TELEMETRY_SCHEMA_COUNT_CASE_
+  default:
+    return 0;
+  }
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "sedsprintf.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * ISR / multi-producer staging (telemetry_stage.c).
+ *
+ * Lock-free MPSC ring in front of the router. Safe from any thread and from
+ * ISRs: a push is a CAS plus a small memcpy and never touches the router or
+ * the Rust heap. The telemetry thread drains it with telemetry_stage_drain().
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef TELEMETRY_STAGE_MAX_BYTES
+#define TELEMETRY_STAGE_MAX_BYTES 32u // payload bytes per staged record
+#endif
+
+typedef struct {
+  uint32_t pushed;
+  uint32_t dropped;    // ring full
+  uint32_t high_water; // max backlog seen by the consumer
+  uint32_t depth;
+} TelemetryStageStats;
+
+// Stage one record. SEDS_ERR if the ring is full, SEDS_BAD_ARG if the
+// payload exceeds TELEMETRY_STAGE_MAX_BYTES.
+SedsResult telemetry_stage_push(SedsDataType data_type, const void *data,
+                                size_t element_count, size_t element_size,
+                                SedsElemKind kind);
+
+// Telemetry thread only. Pops up to max_records (0 = all) into the router TX
+// queue; returns the number drained.
+size_t telemetry_stage_drain(size_t max_records);
+
+void telemetry_stage_get_stats(TelemetryStageStats *out);
+
+#ifdef __cplusplus
+}
+#endif
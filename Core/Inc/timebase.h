@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Monotonic 64-bit clock for the whole stack: frame timestamps (can_bus),
+ * the time sync local clock (telemetry) and everything timed from those.
+ *
+ * TIM2 runs free as a 32-bit up-counter at TIMEBASE_HZ; its update
+ * interrupt counts the wraps. Readers are lock-free and safe from any
+ * context, including ISRs that preempt the update interrupt and code
+ * running with interrupts masked: a wrap the interrupt has not counted yet
+ * is taken from the pending update flag.
+ *
+ * Time starts at timebase_init() and reads 0 before it. It does not depend
+ * on HAL_GetTick() or the ThreadX tick.
+ */
+
+#ifndef TIMEBASE_HZ
+#define TIMEBASE_HZ 8000000u /* 125 ns; TIM2's clock must be a multiple */
+#endif
+
+/* Start TIM2 and its wrap interrupt. Call once, after the clock setup.
+ * Traps in Error_Handler() if TIM2's clock (PCLK1: 16 MHz, HSI) is not
+ * a whole multiple of TIMEBASE_HZ: the clock would silently run fast or
+ * slow by the prescaler's rounding. */
+void timebase_init(void);
+
+uint64_t timebase_now_ns(void);
+uint64_t timebase_now_us(void);
+uint64_t timebase_now_ms(void);
+
+/* TIM2 update interrupt (stm32g4xx_it.c). */
+void timebase_irq_handler(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "serial_frame.h"
+#include "stm32g4xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Framed serial link over a DMA-driven UART (radio / ground link).
+ *
+ *  - Frames use serial_frame.h (COBS + CRC-16, 0x00 delimited).
+ *  - TX: two DMA buffers in ping-pong. Senders append encoded frames to the
+ *    idle buffer while DMA drains the other; the TX-complete interrupt swaps
+ *    them. No per-byte interrupts.
+ *  - RX: circular DMA with idle-line detection. The ISR only records the DMA
+ *    write position; uart_link_process_rx() decodes in thread context.
+ *
+ * The UART handle must have hdmarx (circular) and hdmatx (normal) linked in
+ * HAL_UART_MspInit.
+ */
+
+// PCLK2 is 16 MHz (HSI) and the UART oversamples by 16, so only divisors of
+// 1 MHz are exact: 921600 would come out as 941176 baud (+2.1%).
+#ifndef UART_LINK_BAUD
+#define UART_LINK_BAUD 1000000u
+#endif
+
+#ifndef UART_LINK_TX_BUF_SIZE
+#define UART_LINK_TX_BUF_SIZE 1024u // per ping-pong half
+#endif
+
+#ifndef UART_LINK_RX_BUF_SIZE
+#define UART_LINK_RX_BUF_SIZE 1024u // circular DMA buffer
+#endif
+
+#ifndef UART_LINK_MAX_SUBSCRIBERS
+#define UART_LINK_MAX_SUBSCRIBERS 4
+#endif
+
+typedef struct {
+  uint32_t tx_frames;
+  uint32_t tx_bytes;
+  uint32_t tx_dropped; // no room in the fill buffer
+  uint32_t rx_bytes;
+  uint32_t rx_frames;
+  uint32_t rx_crc_errors;
+  uint32_t rx_framing_errors;
+  uint32_t rx_overruns; // DMA lapped the reader; bytes lost
+  uint32_t uart_errors; // HAL_UART_ErrorCallback events
+} uart_link_stats_t;
+
+/* Start the link on an initialized UART; baud = 0 keeps the current rate. */
+HAL_StatusTypeDef uart_link_init(UART_HandleTypeDef *huart, uint32_t baud);
+
+/* Change the baud rate (restarts reception; queued TX is flushed first). */
+HAL_StatusTypeDef uart_link_set_baud(uint32_t baud);
+
+/* Frame and queue one payload. HAL_BUSY if the TX buffer is full. */
+HAL_StatusTypeDef uart_link_send(uint8_t type, const uint8_t *data, size_t len);
+
+/* Subscribe to received frames (all types). */
+HAL_StatusTypeDef uart_link_subscribe_rx(serial_frame_rx_cb_t cb, void *user);
+
+/*
+ * MUST be called periodically from thread context.
+ * Decodes bytes the RX DMA has written since the last call.
+ */
+void uart_link_process_rx(void);
+
+void uart_link_get_stats(uart_link_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
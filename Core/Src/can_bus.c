@@ -17,6 +17,12 @@
 //  - One producer (ISR) and one consumer (thread calling can_bus_process_rx()).
 //  - You can call can_bus_process_rx() from a ThreadX thread, or main
 //  superloop.
+//  - Error/status interrupts are tracked in ISR context; bus-off recovery is
+//  driven from can_bus_process_rx() with a configurable backoff.
+//  - Every RX frame keeps its identifier, flags and start-of-frame timestamp,
+//  so frame subscribers (bus capture, USB-CAN adapter) see the bus as it was.
+//  - Messages can ask for a hardware TX timestamp (TX event FIFO), which
+//  together with the RX one gives time sync both ends of a frame.
 //
 // IMPORTANT CONCURRENCY NOTE:
 //  `volatile` head/tail alone does NOT guarantee publish/consume ordering for
@@ -25,6 +31,8 @@
 //  ensure the consumer sees the slot contents after observing `head` (acquire).
 
 #include "can_bus.h"
+#include "can_bus_frag.h"
+#include "timebase.h"
 #include <stdint.h>
 #include <string.h>
 
@@ -40,6 +48,14 @@
 #define CAN_BUS_MAX_SUBSCRIBERS 8
 #endif
 
+#ifndef CAN_BUS_MAX_FRAME_SUBSCRIBERS
+#define CAN_BUS_MAX_FRAME_SUBSCRIBERS 4
+#endif
+
+#ifndef CAN_BUS_MAX_MSG_SUBSCRIBERS
+#define CAN_BUS_MAX_MSG_SUBSCRIBERS 4
+#endif
+
 // =========================
 // FD DLC helpers
 // =========================
@@ -90,6 +106,12 @@ static uint32_t can_bus_len_to_dlc(size_t len) {
   }
 }
 
+static int can_bus_len_valid(size_t len, int fd) {
+  if (!fd)
+    return len <= 8;
+  return can_bus_len_to_dlc(len) != 0xFFFFFFFFu;
+}
+
 static size_t can_bus_round_up_fd_len(size_t len) {
   if (len <= 8)
     return len;
@@ -110,6 +132,49 @@ static size_t can_bus_round_up_fd_len(size_t len) {
   return 64;
 }
 
+// =========================
+// Timebase
+// =========================
+//
+// All times come from the TIM2 timebase (timebase.c): 64-bit microseconds,
+// safe to read from the FDCAN ISRs and with interrupts masked.
+
+uint64_t can_bus_time_us(void) { return timebase_now_us(); }
+
+// The controller stamps RX frames and TX events at start of frame with a
+// 16-bit counter. Its internal counter counts nominal bit times, which the
+// faster FD data phase makes useless as a clock, so the stamps come from
+// TIM3 instead (the G4's external timestamp source), free running at 1 MHz.
+// The ISRs turn a stamp into can_bus_time_us() by its age: the counter now
+// minus the stamp, unambiguous as long as the frame is read within 65 ms of
+// its SOF.
+
+static void can_bus_tscnt_init(void) {
+  __HAL_RCC_TIM3_CLK_ENABLE();
+  TIM3->CR1 = 0;
+  TIM3->PSC = HAL_RCC_GetPCLK1Freq() / 1000000u - 1u;
+  TIM3->ARR = 0xFFFFu;
+  TIM3->EGR = TIM_EGR_UG; // load the prescaler
+  TIM3->CR1 = TIM_CR1_CEN;
+}
+
+typedef struct {
+  uint64_t now_us;
+  uint16_t cnt;
+} can_bus_ts_ref_t;
+
+static inline can_bus_ts_ref_t can_bus_ts_ref(void) {
+  can_bus_ts_ref_t r;
+  r.cnt = (uint16_t)TIM3->CNT;
+  r.now_us = can_bus_time_us();
+  return r;
+}
+
+static inline uint64_t can_bus_ts_to_us(const can_bus_ts_ref_t *ref,
+                                        uint32_t stamp) {
+  return ref->now_us - (uint16_t)(ref->cnt - (uint16_t)stamp);
+}
+
 // =========================
 // Subscriber fanout
 // =========================
@@ -119,38 +184,55 @@ typedef struct {
   void *user;
 } can_bus_sub_t;
 
+typedef struct {
+  can_bus_frame_cb_t cb;
+  void *user;
+} can_bus_frame_sub_t;
+
+typedef struct {
+  can_bus_msg_cb_t cb;
+  void *user;
+} can_bus_msg_sub_t;
+
 static FDCAN_HandleTypeDef *g_hfdcan = NULL;
 static can_bus_sub_t g_subs[CAN_BUS_MAX_SUBSCRIBERS];
+static can_bus_frame_sub_t g_frame_subs[CAN_BUS_MAX_FRAME_SUBSCRIBERS];
+static can_bus_msg_sub_t g_msg_subs[CAN_BUS_MAX_MSG_SUBSCRIBERS];
+static uint64_t g_msg_sof_us; // message being delivered
 
-static inline void can_bus_notify_rx(const uint8_t *data, size_t len) {
+uint64_t can_bus_msg_sof_us(void) { return g_msg_sof_us; }
+
+static inline void can_bus_notify_rx(uint32_t id, uint8_t flags,
+                                     const uint8_t *data, size_t len,
+                                     uint64_t sof_us) {
+  g_msg_sof_us = sof_us;
   for (unsigned i = 0; i < CAN_BUS_MAX_SUBSCRIBERS; i++) {
     can_bus_rx_cb_t cb = g_subs[i].cb;
     if (cb)
       cb(data, len, g_subs[i].user);
   }
+  for (unsigned i = 0; i < CAN_BUS_MAX_MSG_SUBSCRIBERS; i++) {
+    can_bus_msg_cb_t cb = g_msg_subs[i].cb;
+    if (cb)
+      cb(id, flags, data, len, g_msg_subs[i].user);
+  }
 }
 
-// =========================
-// Fragmentation protocol
-// =========================
-//
-// We mark fragment frames by a magic header at the start of payload.
-// You can use a dedicated CAN ID range too, but magic is simplest.
-
-#define CAN_BUS_FRAG_MAGIC 0x5344u // 'S''D' (arbitrary)
-#define CAN_BUS_FRAG_WIRE_LEN 64   // always send 64B payload frames for frags
-#define CAN_BUS_REASM_TIMEOUT_MS 250u // drop partial message after this many ms
-
-typedef struct __attribute__((packed)) {
-  uint16_t magic;     // CAN_BUS_FRAG_MAGIC
-  uint8_t seq;        // message sequence (wrap OK)
-  uint8_t frag_idx;   // 0..frag_cnt-1
-  uint8_t frag_cnt;   // total fragments
-  uint8_t flags;      // bit0=first, bit1=last (optional)
-  uint16_t total_len; // total bytes of reassembled message
-} can_bus_frag_hdr_t;
+static inline int can_bus_have_frame_subs(void) {
+  for (unsigned i = 0; i < CAN_BUS_MAX_FRAME_SUBSCRIBERS; i++) {
+    if (g_frame_subs[i].cb)
+      return 1;
+  }
+  return 0;
+}
 
-enum { CAN_BUS_FRAG_F_FIRST = 1u << 0, CAN_BUS_FRAG_F_LAST = 1u << 1 };
+static inline void can_bus_notify_frame(const can_bus_frame_t *f) {
+  for (unsigned i = 0; i < CAN_BUS_MAX_FRAME_SUBSCRIBERS; i++) {
+    can_bus_frame_cb_t cb = g_frame_subs[i].cb;
+    if (cb)
+      cb(f, g_frame_subs[i].user);
+  }
+}
 
 // =========================
 // RX ring buffer (ISR -> thread)
@@ -163,15 +245,10 @@ enum { CAN_BUS_FRAG_F_FIRST = 1u << 0, CAN_BUS_FRAG_F_LAST = 1u << 1 };
 #define CAN_BUS_RX_RING_DEPTH 64
 #endif
 
-typedef struct {
-  uint32_t std_id; // 11-bit ID in lower bits (we only handle standard here)
-  uint8_t len;     // payload bytes (0..64)
-  uint8_t data[64];
-} can_bus_rx_frame_t;
-
 static volatile uint16_t g_rx_head = 0;
 static volatile uint16_t g_rx_tail = 0;
-static can_bus_rx_frame_t g_rx_ring[CAN_BUS_RX_RING_DEPTH];
+static can_bus_frame_t g_rx_ring[CAN_BUS_RX_RING_DEPTH];
+static volatile uint32_t g_rx_overflow = 0;
 
 static inline uint16_t rb_next(uint16_t v) {
   v++;
@@ -192,7 +269,8 @@ static inline int rb_is_full(void) { return rb_next(g_rx_head) == g_rx_tail; }
 // Memory ordering:
 //  - We must ensure slot writes are visible before publishing head.
 //  - `__DMB()` acts as a release barrier here.
-static inline void rb_push_drop_oldest(uint32_t std_id, const uint8_t *data,
+static inline void rb_push_drop_oldest(uint32_t id, uint8_t flags,
+                                       uint64_t ts_us, const uint8_t *data,
                                        uint8_t len) {
   if (len > 64)
     len = 64;
@@ -200,11 +278,14 @@ static inline void rb_push_drop_oldest(uint32_t std_id, const uint8_t *data,
   if (rb_is_full()) {
     // drop oldest
     g_rx_tail = rb_next(g_rx_tail);
+    g_rx_overflow++;
   }
 
   uint16_t h = g_rx_head;
 
-  g_rx_ring[h].std_id = std_id;
+  g_rx_ring[h].timestamp_us = ts_us;
+  g_rx_ring[h].id = id;
+  g_rx_ring[h].flags = flags;
   g_rx_ring[h].len = len;
   memcpy(g_rx_ring[h].data, data, len);
 
@@ -218,7 +299,7 @@ static inline void rb_push_drop_oldest(uint32_t std_id, const uint8_t *data,
 //  - After observing head != tail, we must ensure subsequent reads of the slot
 //    see the writes that happened-before the producer published head.
 //  - `__DMB()` acts as an acquire barrier here.
-static inline int rb_pop(can_bus_rx_frame_t *out) {
+static inline int rb_pop(can_bus_frame_t *out) {
   uint16_t t = g_rx_tail;
   uint16_t h = g_rx_head;
 
@@ -239,26 +320,26 @@ static inline int rb_pop(can_bus_rx_frame_t *out) {
 // Reassembly state
 // =========================
 
+// Slots are keyed by identifier, so this bounds how many senders can be
+// mid-message at once. With per-node IDs that is the number of nodes sending
+// fragmented messages concurrently; beyond it the stalest partial is dropped.
 #ifndef CAN_BUS_REASM_SLOTS
 #define CAN_BUS_REASM_SLOTS 4
 #endif
 
-#ifndef CAN_BUS_REASM_MAX_BYTES
-#define CAN_BUS_REASM_MAX_BYTES 2048
-#endif
-
-#ifndef CAN_BUS_REASM_MAX_FRAGS
-#define CAN_BUS_REASM_MAX_FRAGS 64
-#endif
+// Slot key: 29-bit identifier plus this bit for extended frames, so an
+// 11-bit and a 29-bit sender with the same numeric ID never share a slot.
+#define CAN_BUS_REASM_KEY_EXT 0x80000000u
 
 typedef struct {
   uint8_t active;
-  uint32_t std_id; // which CAN ID this slot is for
+  uint32_t key; // which CAN ID this slot is for (see CAN_BUS_REASM_KEY_EXT)
   uint8_t seq;
   uint8_t frag_cnt;
   uint16_t total_len;
   uint8_t data_cap; // payload bytes per frag (wire_len - hdr)
   uint32_t last_tick_ms;
+  uint64_t sof_us; // first fragment's start of frame
   uint64_t got_mask[(CAN_BUS_REASM_MAX_FRAGS + 63) / 64];
   uint16_t got_count;
   uint8_t buf[CAN_BUS_REASM_MAX_BYTES];
@@ -268,24 +349,28 @@ static can_bus_reasm_slot_t g_reasm[CAN_BUS_REASM_SLOTS];
 
 static void reasm_reset(can_bus_reasm_slot_t *s) {
   s->active = 0;
-  s->std_id = 0;
+  s->key = 0;
   s->seq = 0;
   s->frag_cnt = 0;
   s->total_len = 0;
   s->data_cap = 0;
   s->last_tick_ms = 0;
+  s->sof_us = 0;
   s->got_count = 0;
   memset(s->got_mask, 0, sizeof(s->got_mask));
 }
 
-static can_bus_reasm_slot_t *reasm_get_slot(uint32_t std_id, uint8_t seq,
+static can_bus_reasm_slot_t *reasm_get_slot(uint32_t key, uint8_t seq,
                                             uint32_t now_ms) {
-  // First try to find existing active slot for std_id
+  // First try to find existing active slot for this sender
   for (unsigned i = 0; i < CAN_BUS_REASM_SLOTS; i++) {
-    if (g_reasm[i].active && g_reasm[i].std_id == std_id) {
-      // If sequence changed, drop partial and reuse slot
+    if (g_reasm[i].active && g_reasm[i].key == key) {
+      // If sequence changed, drop partial and reuse slot for the new message
       if (g_reasm[i].seq != seq) {
         reasm_reset(&g_reasm[i]);
+        g_reasm[i].active = 1;
+        g_reasm[i].key = key;
+        g_reasm[i].seq = seq;
       }
       g_reasm[i].last_tick_ms = now_ms;
       return &g_reasm[i];
@@ -297,7 +382,7 @@ static can_bus_reasm_slot_t *reasm_get_slot(uint32_t std_id, uint8_t seq,
     if (!g_reasm[i].active) {
       reasm_reset(&g_reasm[i]);
       g_reasm[i].active = 1;
-      g_reasm[i].std_id = std_id;
+      g_reasm[i].key = key;
       g_reasm[i].seq = seq;
       g_reasm[i].last_tick_ms = now_ms;
       return &g_reasm[i];
@@ -316,7 +401,7 @@ static can_bus_reasm_slot_t *reasm_get_slot(uint32_t std_id, uint8_t seq,
   }
   reasm_reset(&g_reasm[stalest]);
   g_reasm[stalest].active = 1;
-  g_reasm[stalest].std_id = std_id;
+  g_reasm[stalest].key = key;
   g_reasm[stalest].seq = seq;
   g_reasm[stalest].last_tick_ms = now_ms;
   return &g_reasm[stalest];
@@ -346,7 +431,12 @@ static void reasm_expire_old(uint32_t now_ms) {
 }
 
 // Handle one RX frame (thread context)
-static void handle_rx_frame(const can_bus_rx_frame_t *f, uint32_t now_ms) {
+static void handle_rx_frame(const can_bus_frame_t *f, uint32_t now_ms) {
+  // Remote frames carry no payload for the byte subscribers, and our own
+  // mirrored transmissions are for frame subscribers only.
+  if (f->flags & (CAN_BUS_FRAME_F_RTR | CAN_BUS_FRAME_F_TX))
+    return;
+
   // Check if this is a fragment frame
   if (f->len >= sizeof(can_bus_frag_hdr_t)) {
     can_bus_frag_hdr_t hdr;
@@ -370,7 +460,9 @@ static void handle_rx_frame(const can_bus_rx_frame_t *f, uint32_t now_ms) {
 
       // We expect fixed 64B wire frames for frags by default.
       // But tolerate smaller frames as long as consistent.
-      can_bus_reasm_slot_t *s = reasm_get_slot(f->std_id, hdr.seq, now_ms);
+      const uint32_t key =
+          f->id | ((f->flags & CAN_BUS_FRAME_F_EXT) ? CAN_BUS_REASM_KEY_EXT : 0u);
+      can_bus_reasm_slot_t *s = reasm_get_slot(key, hdr.seq, now_ms);
 
       // If slot was newly created (or reset), initialize message params
       if (s->frag_cnt == 0) {
@@ -408,13 +500,16 @@ static void handle_rx_frame(const can_bus_rx_frame_t *f, uint32_t now_ms) {
         bit_set(s->got_mask, hdr.frag_idx);
         s->got_count++;
         memcpy(&s->buf[off], payload, take);
+        if (hdr.frag_idx == 0)
+          s->sof_us = f->timestamp_us;
       }
 
       s->last_tick_ms = now_ms;
 
       // Complete?
       if (s->got_count == s->frag_cnt) {
-        can_bus_notify_rx(s->buf, s->total_len);
+        can_bus_notify_rx(f->id, (uint8_t)(f->flags & CAN_BUS_FRAME_F_EXT),
+                          s->buf, s->total_len, s->sof_us);
         reasm_reset(s);
       }
 
@@ -423,27 +518,461 @@ static void handle_rx_frame(const can_bus_rx_frame_t *f, uint32_t now_ms) {
   }
 
   // Not a fragment frame: deliver raw CAN payload
-  can_bus_notify_rx(f->data, f->len);
+  can_bus_notify_rx(f->id, f->flags, f->data, f->len, f->timestamp_us);
+}
+
+// =========================
+// Error state / bus-off recovery
+// =========================
+//
+// The FDCAN raises EW/EP/BO status-change and protocol-error interrupts; the
+// ISR only records state and counters. On bus-off the controller sets
+// CCCR.INIT and stays off the bus until software clears it, so the thread
+// side (can_bus_process_rx) clears INIT once the backoff delay has elapsed.
+// The controller then rejoins after 128 x 11 recessive bits on its own.
+//
+// While bus-off (or waiting for the rejoin), sends are refused with HAL_BUSY
+// so callers do not fill the TX FIFO with frames that would go out stale and
+// break fragment sequences. Frames already pending in the TX FIFO are aborted
+// on entry for the same reason (CAN_BUS_BUSOFF_FLUSH_TX).
+
+#ifndef CAN_BUS_BUSOFF_BACKOFF_MIN_MS
+#define CAN_BUS_BUSOFF_BACKOFF_MIN_MS 0u // fast recovery by default
+#endif
+
+#ifndef CAN_BUS_BUSOFF_BACKOFF_MAX_MS
+#define CAN_BUS_BUSOFF_BACKOFF_MAX_MS 1000u
+#endif
+
+// A bus-off that occurs more than this long after the last recovery resets
+// the backoff to the minimum.
+#ifndef CAN_BUS_BUSOFF_STABLE_MS
+#define CAN_BUS_BUSOFF_STABLE_MS 5000u
+#endif
+
+#ifndef CAN_BUS_BUSOFF_FLUSH_TX
+#define CAN_BUS_BUSOFF_FLUSH_TX 1
+#endif
+
+#define CAN_BUS_ERROR_STATUS_ITS                                               \
+  (FDCAN_IT_BUS_OFF | FDCAN_IT_ERROR_PASSIVE | FDCAN_IT_ERROR_WARNING |        \
+   FDCAN_IT_ARB_PROTOCOL_ERROR | FDCAN_IT_DATA_PROTOCOL_ERROR)
+
+static can_bus_stats_t g_err; // written by ISR + thread, read via snapshot
+static volatile uint8_t g_busoff_pending = 0; // ISR -> thread: INIT is set
+static volatile uint8_t g_recovering = 0;     // INIT cleared, awaiting rejoin
+static volatile uint8_t g_reconfiguring = 0;  // can_bus_configure() running
+static volatile uint32_t g_busoff_tick = 0;
+static uint32_t g_backoff_min_ms = CAN_BUS_BUSOFF_BACKOFF_MIN_MS;
+static uint32_t g_backoff_max_ms = CAN_BUS_BUSOFF_BACKOFF_MAX_MS;
+static uint32_t g_backoff_ms = CAN_BUS_BUSOFF_BACKOFF_MIN_MS;
+static uint32_t g_last_recovered_tick = 0;
+
+static inline uint32_t can_bus_irq_save(void) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  return primask;
+}
+
+static inline void can_bus_irq_restore(uint32_t primask) {
+  __set_PRIMASK(primask);
+}
+
+static void err_record_lec(uint32_t lec) {
+  lec &= 0x7u;
+  if (lec == FDCAN_PROTOCOL_ERROR_NONE || lec == FDCAN_PROTOCOL_ERROR_NO_CHANGE)
+    return;
+
+  g_err.lec_count[lec]++;
+  memmove(&g_err.lec_history[1], &g_err.lec_history[0],
+          CAN_BUS_LEC_HISTORY_LEN - 1);
+  g_err.lec_history[0] = (uint8_t)lec;
+  if (g_err.lec_history_len < CAN_BUS_LEC_HISTORY_LEN)
+    g_err.lec_history_len++;
+}
+
+// Counters the thread bumps while the error ISR may be updating g_err.
+static void err_count_tx_dropped(void) {
+  uint32_t pm = can_bus_irq_save();
+  g_err.tx_dropped++;
+  can_bus_irq_restore(pm);
+}
+
+// Bus-off entry: arm the backoff timer for err_poll(). IRQs masked.
+static void err_enter_bus_off(void) {
+  uint32_t now = (uint32_t)timebase_now_ms();
+  if ((uint32_t)(now - g_last_recovered_tick) > CAN_BUS_BUSOFF_STABLE_MS)
+    g_backoff_ms = g_backoff_min_ms;
+  g_busoff_tick = now;
+  g_recovering = 0;
+  g_busoff_pending = 1;
+}
+
+// Refresh state + TEC/REC from the controller. ISR or thread (IRQs masked).
+static void err_refresh(FDCAN_HandleTypeDef *hfdcan) {
+  FDCAN_ProtocolStatusTypeDef ps;
+  FDCAN_ErrorCountersTypeDef ec;
+
+  if (HAL_FDCAN_GetProtocolStatus(hfdcan, &ps) != HAL_OK)
+    return;
+  if (HAL_FDCAN_GetErrorCounters(hfdcan, &ec) == HAL_OK) {
+    g_err.tec = (uint8_t)ec.TxErrorCnt;
+    g_err.rec = (uint8_t)ec.RxErrorCnt;
+  }
+
+  // Reading PSR resets LEC/DLEC, so fold them into the history here.
+  err_record_lec(ps.LastErrorCode);
+  err_record_lec(ps.DataLastErrorCode);
+
+  can_bus_state_t st = CAN_BUS_STATE_ERROR_ACTIVE;
+  if (ps.BusOff)
+    st = CAN_BUS_STATE_BUS_OFF;
+  else if (ps.ErrorPassive)
+    st = CAN_BUS_STATE_ERROR_PASSIVE;
+  else if (ps.Warning)
+    st = CAN_BUS_STATE_ERROR_WARNING;
+
+  if (st != g_err.state) {
+    if (st == CAN_BUS_STATE_BUS_OFF) {
+      g_err.bus_off_count++;
+      err_enter_bus_off();
+    } else if (st == CAN_BUS_STATE_ERROR_PASSIVE)
+      g_err.error_passive_count++;
+    else if (st == CAN_BUS_STATE_ERROR_WARNING)
+      g_err.warning_count++;
+  }
+  g_err.state = st;
+}
+
+static void err_reset(void) {
+  uint32_t pm = can_bus_irq_save();
+  memset(&g_err, 0, sizeof(g_err));
+  g_busoff_pending = 0;
+  g_recovering = 0;
+  g_backoff_ms = g_backoff_min_ms;
+  can_bus_irq_restore(pm);
+}
+
+// Thread context: flush TX, run the backoff timer, clear INIT, watch rejoin.
+static void err_poll(uint32_t now_ms) {
+  if (!g_hfdcan || g_reconfiguring)
+    return;
+
+  if (g_busoff_pending) {
+#if CAN_BUS_BUSOFF_FLUSH_TX
+    uint32_t pending = g_hfdcan->Instance->TXBRP;
+    if (pending) {
+      (void)HAL_FDCAN_AbortTxRequest(g_hfdcan, pending);
+      uint32_t pm = can_bus_irq_save();
+      g_err.tx_aborted += (uint32_t)__builtin_popcount(pending);
+      can_bus_irq_restore(pm);
+    }
+#endif
+
+    if ((uint32_t)(now_ms - g_busoff_tick) < g_backoff_ms)
+      return;
+
+    uint32_t pm = can_bus_irq_save();
+    g_busoff_pending = 0;
+    g_recovering = 1;
+    CLEAR_BIT(g_hfdcan->Instance->CCCR, FDCAN_CCCR_INIT);
+    can_bus_irq_restore(pm);
+
+    // Next consecutive bus-off waits longer.
+    g_backoff_ms = (g_backoff_ms == 0u) ? 1u : g_backoff_ms * 2u;
+    if (g_backoff_ms > g_backoff_max_ms)
+      g_backoff_ms = g_backoff_max_ms;
+    return;
+  }
+
+  if (g_recovering) {
+    uint32_t pm = can_bus_irq_save();
+    err_refresh(g_hfdcan);
+    int back = (g_err.state != CAN_BUS_STATE_BUS_OFF);
+    if (back) {
+      uint32_t dt = (uint32_t)(now_ms - g_busoff_tick);
+      g_recovering = 0;
+      g_err.recovery_count++;
+      g_err.last_recovery_ms = dt;
+      if (dt > g_err.max_recovery_ms)
+        g_err.max_recovery_ms = dt;
+      g_last_recovered_tick = now_ms;
+    }
+    can_bus_irq_restore(pm);
+  }
+}
+
+static inline int can_bus_tx_blocked(void) {
+  return g_busoff_pending || g_recovering || g_reconfiguring;
+}
+
+can_bus_state_t can_bus_get_state(void) { return g_err.state; }
+
+void can_bus_get_stats(can_bus_stats_t *out) {
+  if (!out)
+    return;
+  uint32_t pm = can_bus_irq_save();
+  *out = g_err;
+  out->rx_overflow = g_rx_overflow;
+  can_bus_irq_restore(pm);
+}
+
+void can_bus_set_busoff_backoff(uint32_t min_ms, uint32_t max_ms) {
+  if (max_ms < min_ms)
+    max_ms = min_ms;
+  uint32_t pm = can_bus_irq_save();
+  g_backoff_min_ms = min_ms;
+  g_backoff_max_ms = max_ms;
+  if (g_backoff_ms < min_ms || g_backoff_ms > max_ms)
+    g_backoff_ms = min_ms;
+  can_bus_irq_restore(pm);
+}
+
+// =========================
+// TX timestamps
+// =========================
+//
+// A stamped first fragment is queued with FDCAN_STORE_TX_EVENTS and a
+// message marker. When it has been sent, the TX event ISR files its SOF time
+// in the slot of that marker. Markers run 1..255 and only stamped messages
+// use them, so a slot is not reused for CAN_BUS_TX_STAMPS stamps.
+
+#ifndef CAN_BUS_TX_STAMPS
+#define CAN_BUS_TX_STAMPS 4
+#endif
+
+typedef struct {
+  uint8_t armed;  // marker the slot waits for
+  uint8_t marker; // marker the stamp belongs to, 0 until it arrives
+  uint64_t sof_us;
+} can_bus_tx_stamp_t;
+
+static can_bus_tx_stamp_t g_tx_stamps[CAN_BUS_TX_STAMPS]; // ISR + thread
+static uint8_t g_tx_marker = 0;
+
+void can_bus_send_large_stamp(can_bus_large_tx_t *tx) {
+  if (!tx || tx->frag_cnt == 0)
+    return;
+  if (++g_tx_marker == 0)
+    g_tx_marker = 1;
+  tx->marker = g_tx_marker;
+
+  can_bus_tx_stamp_t *s = &g_tx_stamps[tx->marker % CAN_BUS_TX_STAMPS];
+  uint32_t pm = can_bus_irq_save();
+  s->armed = tx->marker;
+  s->marker = 0;
+  can_bus_irq_restore(pm);
+}
+
+HAL_StatusTypeDef can_bus_large_tx_sof_us(const can_bus_large_tx_t *tx,
+                                          uint64_t *sof_us) {
+  if (!tx || !sof_us || tx->marker == 0)
+    return HAL_ERROR;
+
+  const can_bus_tx_stamp_t *s = &g_tx_stamps[tx->marker % CAN_BUS_TX_STAMPS];
+  uint32_t pm = can_bus_irq_save();
+  const can_bus_tx_stamp_t v = *s;
+  can_bus_irq_restore(pm);
+
+  if (v.armed != tx->marker)
+    return HAL_ERROR;
+  if (v.marker != tx->marker)
+    return HAL_BUSY;
+  *sof_us = v.sof_us;
+  return HAL_OK;
 }
 
 // =========================
 // Public API
 // =========================
 
+static FDCAN_InitTypeDef g_default_init; // handle config at can_bus_init()
+
+// Controller is initialized (INIT set); route traffic and go on the bus.
+// No filter elements are configured, so the global filter decides: accept
+// everything into FIFO1, which is the FIFO the ISR drains. Timestamps come
+// from TIM3 (see can_bus_tscnt_init()).
+static HAL_StatusTypeDef can_bus_start(FDCAN_HandleTypeDef *hfdcan) {
+  if (HAL_FDCAN_ConfigGlobalFilter(hfdcan, FDCAN_ACCEPT_IN_RX_FIFO1,
+                                   FDCAN_ACCEPT_IN_RX_FIFO1,
+                                   FDCAN_FILTER_REMOTE,
+                                   FDCAN_FILTER_REMOTE) != HAL_OK)
+    return HAL_ERROR;
+  if (HAL_FDCAN_ConfigTimestampCounter(hfdcan, FDCAN_TIMESTAMP_PRESC_1) !=
+          HAL_OK ||
+      HAL_FDCAN_EnableTimestampCounter(hfdcan, FDCAN_TIMESTAMP_EXTERNAL) !=
+          HAL_OK)
+    return HAL_ERROR;
+  if (HAL_FDCAN_ActivateNotification(hfdcan,
+                                     FDCAN_IT_RX_FIFO1_NEW_MESSAGE |
+                                         FDCAN_IT_TX_EVT_FIFO_NEW_DATA |
+                                         CAN_BUS_ERROR_STATUS_ITS,
+                                     0) != HAL_OK)
+    return HAL_ERROR;
+  return HAL_FDCAN_Start(hfdcan);
+}
+
 void can_bus_init(FDCAN_HandleTypeDef *hfdcan) {
   g_hfdcan = hfdcan;
+  g_default_init = hfdcan->Init;
   // subscribers static-zeroed
-  HAL_FDCAN_ActivateNotification(hfdcan, FDCAN_IT_RX_FIFO1_NEW_MESSAGE, 0);
-  HAL_FDCAN_Start(hfdcan);
+  err_reset();
+  can_bus_tscnt_init();
+  (void)can_bus_start(hfdcan);
 
   // reset rings + reasm
   g_rx_head = 0;
   g_rx_tail = 0;
+  g_rx_overflow = 0;
   for (unsigned i = 0; i < CAN_BUS_REASM_SLOTS; i++) {
     reasm_reset(&g_reasm[i]);
   }
 }
 
+// Stop, re-run the HAL init with `init`, restart. Senders see HAL_BUSY for
+// the duration; the bus-off state machine starts over.
+static HAL_StatusTypeDef can_bus_reinit(const FDCAN_InitTypeDef *init) {
+  if (!g_hfdcan)
+    return HAL_ERROR;
+
+  g_reconfiguring = 1;
+  (void)HAL_FDCAN_Stop(g_hfdcan);
+  g_hfdcan->Init = *init;
+  HAL_StatusTypeDef st = HAL_FDCAN_Init(g_hfdcan);
+  err_reset();
+  if (st == HAL_OK)
+    st = can_bus_start(g_hfdcan);
+  g_reconfiguring = 0;
+  return st;
+}
+
+HAL_StatusTypeDef can_bus_configure(const can_bus_bit_timing_t *nominal,
+                                    const can_bus_bit_timing_t *data,
+                                    uint32_t mode) {
+  if (!g_hfdcan || !nominal)
+    return HAL_ERROR;
+  if ((mode & CAN_BUS_MODE_FD) && !data)
+    return HAL_ERROR;
+
+  if (!IS_FDCAN_NOMINAL_PRESCALER(nominal->prescaler) ||
+      !IS_FDCAN_NOMINAL_TSEG1(nominal->tseg1) ||
+      !IS_FDCAN_NOMINAL_TSEG2(nominal->tseg2) ||
+      !IS_FDCAN_NOMINAL_SJW(nominal->sjw))
+    return HAL_ERROR;
+
+  FDCAN_InitTypeDef init = g_default_init;
+  init.NominalPrescaler = nominal->prescaler;
+  init.NominalTimeSeg1 = nominal->tseg1;
+  init.NominalTimeSeg2 = nominal->tseg2;
+  init.NominalSyncJumpWidth = nominal->sjw;
+
+  if (mode & CAN_BUS_MODE_FD) {
+    if (!IS_FDCAN_DATA_PRESCALER(data->prescaler) ||
+        !IS_FDCAN_DATA_TSEG1(data->tseg1) ||
+        !IS_FDCAN_DATA_TSEG2(data->tseg2) || !IS_FDCAN_DATA_SJW(data->sjw))
+      return HAL_ERROR;
+    init.FrameFormat = FDCAN_FRAME_FD_BRS;
+    init.DataPrescaler = data->prescaler;
+    init.DataTimeSeg1 = data->tseg1;
+    init.DataTimeSeg2 = data->tseg2;
+    init.DataSyncJumpWidth = data->sjw;
+  } else {
+    init.FrameFormat = FDCAN_FRAME_CLASSIC;
+  }
+
+  // Listen-only + loopback together is the controller's internal loopback:
+  // frames come back without ever driving the bus.
+  const uint32_t lo_lb = mode & (CAN_BUS_MODE_LISTEN_ONLY | CAN_BUS_MODE_LOOPBACK);
+  if (lo_lb == (CAN_BUS_MODE_LISTEN_ONLY | CAN_BUS_MODE_LOOPBACK))
+    init.Mode = FDCAN_MODE_INTERNAL_LOOPBACK;
+  else if (lo_lb == CAN_BUS_MODE_LISTEN_ONLY)
+    init.Mode = FDCAN_MODE_BUS_MONITORING;
+  else if (lo_lb == CAN_BUS_MODE_LOOPBACK)
+    init.Mode = FDCAN_MODE_EXTERNAL_LOOPBACK;
+  else
+    init.Mode = FDCAN_MODE_NORMAL;
+
+  init.AutoRetransmission = (mode & CAN_BUS_MODE_ONE_SHOT) ? DISABLE : ENABLE;
+
+  return can_bus_reinit(&init);
+}
+
+HAL_StatusTypeDef can_bus_restore_defaults(void) {
+  return can_bus_reinit(&g_default_init);
+}
+
+uint32_t can_bus_clock_hz(void) {
+  // CKDIV is shared by all FDCAN instances: 0 = /1, n = /(2n).
+  const uint32_t ckdiv = FDCAN_CONFIG->CKDIV & FDCAN_CKDIV_PDIV;
+  const uint32_t f = HAL_RCCEx_GetPeriphCLKFreq(RCC_PERIPHCLK_FDCAN);
+  return ckdiv ? f / (2u * ckdiv) : f;
+}
+
+HAL_StatusTypeDef can_bus_subscribe_frames(can_bus_frame_cb_t cb, void *user) {
+  if (!cb)
+    return HAL_ERROR;
+
+  for (unsigned i = 0; i < CAN_BUS_MAX_FRAME_SUBSCRIBERS; i++) {
+    if (g_frame_subs[i].cb == cb && g_frame_subs[i].user == user)
+      return HAL_ERROR;
+  }
+  for (unsigned i = 0; i < CAN_BUS_MAX_FRAME_SUBSCRIBERS; i++) {
+    if (g_frame_subs[i].cb == NULL) {
+      g_frame_subs[i].cb = cb;
+      g_frame_subs[i].user = user;
+      return HAL_OK;
+    }
+  }
+  return HAL_ERROR;
+}
+
+HAL_StatusTypeDef can_bus_unsubscribe_frames(can_bus_frame_cb_t cb,
+                                             void *user) {
+  if (!cb)
+    return HAL_ERROR;
+
+  for (unsigned i = 0; i < CAN_BUS_MAX_FRAME_SUBSCRIBERS; i++) {
+    if (g_frame_subs[i].cb == cb && g_frame_subs[i].user == user) {
+      g_frame_subs[i].cb = NULL;
+      g_frame_subs[i].user = NULL;
+      return HAL_OK;
+    }
+  }
+  return HAL_ERROR;
+}
+
+HAL_StatusTypeDef can_bus_subscribe_msgs(can_bus_msg_cb_t cb, void *user) {
+  if (!cb)
+    return HAL_ERROR;
+
+  for (unsigned i = 0; i < CAN_BUS_MAX_MSG_SUBSCRIBERS; i++) {
+    if (g_msg_subs[i].cb == cb && g_msg_subs[i].user == user)
+      return HAL_ERROR;
+  }
+  for (unsigned i = 0; i < CAN_BUS_MAX_MSG_SUBSCRIBERS; i++) {
+    if (g_msg_subs[i].cb == NULL) {
+      g_msg_subs[i].cb = cb;
+      g_msg_subs[i].user = user;
+      return HAL_OK;
+    }
+  }
+  return HAL_ERROR;
+}
+
+HAL_StatusTypeDef can_bus_unsubscribe_msgs(can_bus_msg_cb_t cb, void *user) {
+  if (!cb)
+    return HAL_ERROR;
+
+  for (unsigned i = 0; i < CAN_BUS_MAX_MSG_SUBSCRIBERS; i++) {
+    if (g_msg_subs[i].cb == cb && g_msg_subs[i].user == user) {
+      g_msg_subs[i].cb = NULL;
+      g_msg_subs[i].user = NULL;
+      return HAL_OK;
+    }
+  }
+  return HAL_ERROR;
+}
+
 HAL_StatusTypeDef can_bus_subscribe_rx(can_bus_rx_cb_t cb, void *user) {
   if (!cb)
     return HAL_ERROR;
@@ -476,47 +1005,105 @@ HAL_StatusTypeDef can_bus_unsubscribe_rx(can_bus_rx_cb_t cb, void *user) {
   return HAL_ERROR;
 }
 
-// Send a single CAN/CAN-FD payload up to 64 bytes.
-// If len is not an exact FD size, it rounds up and zero-pads.
-HAL_StatusTypeDef can_bus_send_bytes(const uint8_t *bytes, size_t len,
-                                     uint32_t std_id) {
-  if (!g_hfdcan)
+// Queue one frame exactly as described (identifier type, RTR, FD, BRS).
+// A nonzero marker asks for a TX event (see can_bus_send_large_stamp()).
+static HAL_StatusTypeDef can_bus_queue_frame(const can_bus_frame_t *frame,
+                                             uint8_t marker) {
+  if (!g_hfdcan || !frame)
     return HAL_ERROR;
-  if (!bytes || len == 0)
-    return HAL_ERROR;
-
-  if (len > 64)
-    len = 64;
 
-  size_t wire_len = can_bus_round_up_fd_len(len);
-  uint32_t dlc = can_bus_len_to_dlc(wire_len);
-  if (dlc == 0xFFFFFFFFu)
+  const int fd = (frame->flags & CAN_BUS_FRAME_F_FD) != 0;
+  if (!can_bus_len_valid(frame->len, fd))
+    return HAL_ERROR;
+  if (fd && (frame->flags & CAN_BUS_FRAME_F_RTR))
     return HAL_ERROR;
 
+  if (can_bus_tx_blocked()) {
+    err_count_tx_dropped();
+    return HAL_BUSY;
+  }
+  if (HAL_FDCAN_GetTxFifoFreeLevel(g_hfdcan) == 0)
+    return HAL_BUSY;
+
   FDCAN_TxHeaderTypeDef txHeader;
   memset(&txHeader, 0, sizeof(txHeader));
 
-  txHeader.Identifier = std_id & 0x7FFu;
-  txHeader.IdType = FDCAN_STANDARD_ID;
-  txHeader.TxFrameType = FDCAN_DATA_FRAME;
+  if (frame->flags & CAN_BUS_FRAME_F_EXT) {
+    txHeader.Identifier = frame->id & 0x1FFFFFFFu;
+    txHeader.IdType = FDCAN_EXTENDED_ID;
+  } else {
+    txHeader.Identifier = frame->id & 0x7FFu;
+    txHeader.IdType = FDCAN_STANDARD_ID;
+  }
+  txHeader.TxFrameType = (frame->flags & CAN_BUS_FRAME_F_RTR)
+                             ? FDCAN_REMOTE_FRAME
+                             : FDCAN_DATA_FRAME;
 
-  txHeader.DataLength = dlc; // DLC code (HAL expects this)
+  txHeader.DataLength = can_bus_len_to_dlc(frame->len); // DLC code
   txHeader.ErrorStateIndicator = FDCAN_ESI_ACTIVE;
-  txHeader.BitRateSwitch = FDCAN_BRS_OFF;
-  txHeader.FDFormat = FDCAN_FD_CAN;
-  txHeader.TxEventFifoControl = FDCAN_NO_TX_EVENTS;
-  txHeader.MessageMarker = 0;
+  txHeader.BitRateSwitch =
+      (frame->flags & CAN_BUS_FRAME_F_BRS) ? FDCAN_BRS_ON : FDCAN_BRS_OFF;
+  txHeader.FDFormat = fd ? FDCAN_FD_CAN : FDCAN_CLASSIC_CAN;
+  txHeader.TxEventFifoControl =
+      marker ? FDCAN_STORE_TX_EVENTS : FDCAN_NO_TX_EVENTS;
+  txHeader.MessageMarker = marker;
+
+  return HAL_FDCAN_AddMessageToTxFifoQ(g_hfdcan, &txHeader,
+                                       (uint8_t *)frame->data);
+}
 
-  uint8_t txData[64] = {0};
-  memcpy(txData, bytes, len);
+HAL_StatusTypeDef can_bus_send_frame(const can_bus_frame_t *frame) {
+  return can_bus_queue_frame(frame, 0);
+}
 
-  return HAL_FDCAN_AddMessageToTxFifoQ(g_hfdcan, &txHeader, txData);
+// Send a single CAN/CAN-FD payload up to 64 bytes.
+// If len is not an exact FD size, it rounds up and zero-pads.
+static HAL_StatusTypeDef can_bus_send_fd_bytes(const uint8_t *bytes,
+                                               size_t len, uint32_t std_id,
+                                               uint8_t marker) {
+  if (!g_hfdcan)
+    return HAL_ERROR;
+  if (!bytes || len == 0)
+    return HAL_ERROR;
+
+  if (len > 64)
+    len = 64;
+
+  can_bus_frame_t f;
+  f.timestamp_us = 0;
+  f.id = std_id & 0x7FFu;
+  f.flags = CAN_BUS_FRAME_F_FD;
+  f.len = (uint8_t)can_bus_round_up_fd_len(len);
+  memcpy(f.data, bytes, len);
+  memset(f.data + len, 0, f.len - len);
+
+  HAL_StatusTypeDef st = can_bus_queue_frame(&f, marker);
+  if (st == HAL_OK && can_bus_have_frame_subs()) {
+    // The controller does not receive its own frames; mirror them so a bus
+    // capture also shows what this node sent. The ring is normally filled
+    // by the ISR only, so push with IRQs masked.
+    uint32_t pm = can_bus_irq_save();
+    rb_push_drop_oldest(f.id, f.flags | CAN_BUS_FRAME_F_TX, can_bus_time_us(),
+                        f.data, f.len);
+    can_bus_irq_restore(pm);
+  }
+  return st;
+}
+
+HAL_StatusTypeDef can_bus_send_bytes(const uint8_t *bytes, size_t len,
+                                     uint32_t std_id) {
+  return can_bus_send_fd_bytes(bytes, len, std_id, 0);
 }
 
 // Send an arbitrarily large buffer by fragmenting into multiple CAN FD frames.
 // This uses fixed 64B frames (DLC=64) and a small header in each frame.
-HAL_StatusTypeDef can_bus_send_large(const uint8_t *bytes, size_t len,
-                                     uint32_t std_id) {
+HAL_StatusTypeDef can_bus_send_large_start(can_bus_large_tx_t *tx,
+                                           const uint8_t *bytes, size_t len,
+                                           uint32_t std_id) {
+  if (!tx)
+    return HAL_ERROR;
+  tx->frag_cnt = 0;
+  tx->marker = 0;
   if (!g_hfdcan)
     return HAL_ERROR;
   if (!bytes || len == 0)
@@ -524,9 +1111,6 @@ HAL_StatusTypeDef can_bus_send_large(const uint8_t *bytes, size_t len,
   if (len > 0xFFFFu)
     return HAL_ERROR; // header uses u16 total_len
 
-  static uint8_t g_seq = 0;
-  uint8_t seq = g_seq++;
-
   const size_t hdr_sz = sizeof(can_bus_frag_hdr_t);
   const size_t wire_len = CAN_BUS_FRAG_WIRE_LEN;
   if (wire_len > 64)
@@ -542,50 +1126,92 @@ HAL_StatusTypeDef can_bus_send_large(const uint8_t *bytes, size_t len,
   if (frag_cnt_sz > 255)
     return HAL_ERROR;
 
-  uint8_t frag_cnt = (uint8_t)frag_cnt_sz;
+  static uint8_t g_seq = 0;
+  tx->bytes = bytes;
+  tx->len = (uint16_t)len;
+  tx->off = 0;
+  tx->std_id = std_id;
+  tx->seq = g_seq++;
+  tx->frag_idx = 0;
+  tx->frag_cnt = (uint8_t)frag_cnt_sz;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef can_bus_send_large_continue(can_bus_large_tx_t *tx) {
+  if (!tx || tx->frag_cnt == 0)
+    return HAL_ERROR;
+
+  const size_t hdr_sz = sizeof(can_bus_frag_hdr_t);
+  const size_t wire_len = CAN_BUS_FRAG_WIRE_LEN;
+  const size_t data_cap = wire_len - hdr_sz;
+
+  while (tx->frag_idx < tx->frag_cnt) {
+    // Check before building the frame so a full FIFO or a bus-off wait is a
+    // quiet "later" rather than a dropped send.
+    if (can_bus_tx_blocked() || HAL_FDCAN_GetTxFifoFreeLevel(g_hfdcan) == 0)
+      return HAL_BUSY;
 
-  size_t off = 0;
-  for (uint8_t idx = 0; idx < frag_cnt; idx++) {
     uint8_t frame[64] = {0};
 
     can_bus_frag_hdr_t hdr;
     hdr.magic = CAN_BUS_FRAG_MAGIC;
-    hdr.seq = seq;
-    hdr.frag_idx = idx;
-    hdr.frag_cnt = frag_cnt;
+    hdr.seq = tx->seq;
+    hdr.frag_idx = tx->frag_idx;
+    hdr.frag_cnt = tx->frag_cnt;
     hdr.flags = 0;
-    if (idx == 0)
+    if (tx->frag_idx == 0)
       hdr.flags |= CAN_BUS_FRAG_F_FIRST;
-    if (idx == (uint8_t)(frag_cnt - 1))
+    if (tx->frag_idx == (uint8_t)(tx->frag_cnt - 1))
       hdr.flags |= CAN_BUS_FRAG_F_LAST;
-    hdr.total_len = (uint16_t)len;
+    hdr.total_len = tx->len;
 
     memcpy(frame, &hdr, hdr_sz);
 
-    size_t take = len - off;
+    size_t take = (size_t)tx->len - tx->off;
     if (take > data_cap)
       take = data_cap;
-    memcpy(frame + hdr_sz, bytes + off, take);
-    off += take;
+    memcpy(frame + hdr_sz, tx->bytes + tx->off, take);
 
     // send a fixed 64-byte payload frame (pads zeros)
-    HAL_StatusTypeDef st = can_bus_send_bytes(frame, wire_len, std_id);
+    HAL_StatusTypeDef st = can_bus_send_fd_bytes(
+        frame, wire_len, tx->std_id, tx->frag_idx == 0 ? tx->marker : 0u);
     if (st != HAL_OK)
       return st;
+
+    tx->off = (uint16_t)(tx->off + take);
+    tx->frag_idx++;
   }
 
   return HAL_OK;
 }
 
+// One-shot form: queues what fits and gives up on the rest (HAL_BUSY).
+HAL_StatusTypeDef can_bus_send_large(const uint8_t *bytes, size_t len,
+                                     uint32_t std_id) {
+  if (g_hfdcan && can_bus_tx_blocked()) {
+    err_count_tx_dropped();
+    return HAL_BUSY; // don't start a sequence we can't finish
+  }
+
+  can_bus_large_tx_t tx;
+  HAL_StatusTypeDef st = can_bus_send_large_start(&tx, bytes, len, std_id);
+  if (st != HAL_OK)
+    return st;
+  return can_bus_send_large_continue(&tx);
+}
+
 // Call this periodically from thread/main-loop context.
 // It drains the ISR ring buffer, expires old partial reassembly slots,
-// reassembles fragmented messages, and notifies subscribers.
+// reassembles fragmented messages, and notifies subscribers. It also drives
+// bus-off recovery, so call it even when no traffic is expected.
 void can_bus_process_rx(void) {
-  uint32_t now = HAL_GetTick();
+  uint32_t now = (uint32_t)timebase_now_ms();
+  err_poll(now);
   reasm_expire_old(now);
 
-  can_bus_rx_frame_t f;
+  can_bus_frame_t f;
   while (rb_pop(&f)) {
+    can_bus_notify_frame(&f);
     handle_rx_frame(&f, now);
   }
 }
@@ -612,15 +1238,73 @@ void HAL_FDCAN_RxFifo1Callback(FDCAN_HandleTypeDef *hfdcan,
       break;
     }
 
-    // Only handle standard IDs here; extend as needed
-    uint32_t std_id = hdr.Identifier & 0x7FFu;
+    uint8_t flags = 0;
+    uint32_t id;
+    if (hdr.IdType == FDCAN_EXTENDED_ID) {
+      flags |= CAN_BUS_FRAME_F_EXT;
+      id = hdr.Identifier & 0x1FFFFFFFu;
+    } else {
+      id = hdr.Identifier & 0x7FFu;
+    }
+    if (hdr.RxFrameType == FDCAN_REMOTE_FRAME)
+      flags |= CAN_BUS_FRAME_F_RTR;
+    if (hdr.FDFormat == FDCAN_FD_CAN)
+      flags |= CAN_BUS_FRAME_F_FD;
+    if (hdr.BitRateSwitch == FDCAN_BRS_ON)
+      flags |= CAN_BUS_FRAME_F_BRS;
+    if (hdr.ErrorStateIndicator == FDCAN_ESI_PASSIVE)
+      flags |= CAN_BUS_FRAME_F_ESI;
 
     // hdr.DataLength is DLC code in HAL
     size_t len = can_bus_dlc_to_len(hdr.DataLength);
-    if (len > 64)
-      len = 64;
+    if (len > 8 && !(flags & CAN_BUS_FRAME_F_FD))
+      len = 8; // classic DLC 9..15 still carries 8 bytes
+
+    // Reference taken after the fetch: a frame whose SOF follows an earlier
+    // reference would wrap to ~65 ms in the past.
+    const can_bus_ts_ref_t ref = can_bus_ts_ref();
 
     // Push into ring; drop-oldest on overflow
-    rb_push_drop_oldest(std_id, data, (uint8_t)len);
+    rb_push_drop_oldest(id, flags, can_bus_ts_to_us(&ref, hdr.RxTimestamp),
+                        data, (uint8_t)len);
   }
 }
+
+// TX event ISR: a frame queued with a marker has been sent. Files its SOF
+// time for can_bus_large_tx_sof_us(). GetTxEvent fails once the event FIFO
+// is empty.
+void HAL_FDCAN_TxEventFifoCallback(FDCAN_HandleTypeDef *hfdcan,
+                                   uint32_t TxEventFifoITs) {
+  if (hfdcan != g_hfdcan ||
+      (TxEventFifoITs & FDCAN_IT_TX_EVT_FIFO_NEW_DATA) == 0)
+    return;
+
+  FDCAN_TxEventFifoTypeDef evt;
+  while (HAL_FDCAN_GetTxEvent(hfdcan, &evt) == HAL_OK) {
+    const uint8_t marker = (uint8_t)evt.MessageMarker;
+    can_bus_tx_stamp_t *s = &g_tx_stamps[marker % CAN_BUS_TX_STAMPS];
+    if (marker == 0 || s->armed != marker)
+      continue;
+    // Per event, after the fetch, so the stamp never leads the reference.
+    const can_bus_ts_ref_t ref = can_bus_ts_ref();
+    s->sof_us = can_bus_ts_to_us(&ref, evt.TxTimestamp);
+    s->marker = marker;
+  }
+}
+
+// Error-status ISR: EW / EP / BO changed. Record state; recovery happens in
+// thread context so the backoff timer and TX flush stay out of the ISR.
+void HAL_FDCAN_ErrorStatusCallback(FDCAN_HandleTypeDef *hfdcan,
+                                   uint32_t ErrorStatusITs) {
+  (void)ErrorStatusITs;
+  if (hfdcan != g_hfdcan)
+    return;
+  err_refresh(hfdcan);
+}
+
+// Protocol-error ISR (PEA/PED): capture LEC history + TEC/REC.
+void HAL_FDCAN_ErrorCallback(FDCAN_HandleTypeDef *hfdcan) {
+  if (hfdcan != g_hfdcan)
+    return;
+  err_refresh(hfdcan);
+}
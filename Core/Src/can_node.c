@@ -0,0 +1,203 @@
+// can_node.c
+//
+// Node address claim for per-node CAN identifiers. See can_node.h.
+//
+//  - Name: 64 bits mixed from the device UID, so every board has a stable,
+//    distinct name without configuration. Bit 63 is clear for fixed-address
+//    nodes and set for dynamic ones: lower name wins, so a configured address
+//    always beats a dynamic claim.
+//  - Claim: one classic frame on CAN_NODE_ID(CLAIM, addr) carrying the name.
+//    A claim for our address with a lower name sends us to the next free
+//    address; one with a higher name is answered with our own claim again.
+//    The address is ours once CAN_NODE_CLAIM_MS pass without a lower claim.
+//  - Claims seen for other addresses are remembered, so a node that has to
+//    move skips addresses already known to be held.
+//  - Every claim frame goes out after a delay of up to
+//    CAN_NODE_CLAIM_JITTER_MS drawn from the name and a per-node counter.
+//    Two claims for the same address share a CAN ID, so sent at the same
+//    instant they would collide in the data field and retry in lockstep
+//    instead of arbitrating; boards that power up together, or lose the
+//    same address at once, spread out this way.
+//  - Everything but can_node_addr()/can_node_state() runs in the thread that
+//    calls can_bus_process_rx(), which delivers the claim frames.
+
+#include "can_node.h"
+#include "can_bus.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(CAN_NODE_ADDR) && ((CAN_NODE_ADDR) >= CAN_NODE_ADDR_ANON)
+#error "CAN_NODE_ADDR must be below CAN_NODE_ADDR_ANON"
+#endif
+
+#define CAN_NODE_NAME_DYNAMIC (1ull << 63)
+
+static volatile can_node_state_t g_state = CAN_NODE_UNCLAIMED;
+static volatile uint8_t g_addr = CAN_NODE_ADDR_ANON;
+
+static uint64_t g_name;
+static uint64_t g_taken;      // addresses claimed by other nodes
+static uint8_t g_candidate;   // address being claimed or held
+static uint8_t g_send_claim;  // claim frame still to be queued
+static uint32_t g_claim_ms;   // when the current claim went out
+static uint32_t g_send_at_ms; // when the pending claim may go out
+static uint8_t g_send_armed;  // g_send_at_ms is set
+static uint32_t g_claims;     // claims sent, varies the delay
+static uint8_t g_subscribed;
+
+// =========================
+// Name
+// =========================
+
+static uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ull;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBull;
+  x ^= x >> 31;
+  return x;
+}
+
+static uint64_t node_name(void) {
+  const uint64_t uid =
+      ((uint64_t)HAL_GetUIDw1() << 32) | (uint64_t)HAL_GetUIDw0();
+  const uint64_t name = mix64(uid ^ mix64((uint64_t)HAL_GetUIDw2()));
+#ifdef CAN_NODE_ADDR
+  return name & ~CAN_NODE_NAME_DYNAMIC;
+#else
+  return name | CAN_NODE_NAME_DYNAMIC;
+#endif
+}
+
+// =========================
+// Claim state machine
+// =========================
+
+static void start_claim(uint8_t addr) {
+  g_candidate = addr;
+  g_addr = CAN_NODE_ADDR_ANON;
+  g_state = CAN_NODE_CLAIMING;
+  g_send_claim = 1;
+  g_send_armed = 0;
+}
+
+static uint32_t claim_delay_ms(void) {
+  return (uint32_t)(mix64(g_name + g_claims) % (CAN_NODE_CLAIM_JITTER_MS + 1u));
+}
+
+static void fail(void) {
+  g_addr = CAN_NODE_ADDR_ANON;
+  g_state = CAN_NODE_FAILED;
+  g_send_claim = 0;
+}
+
+static void claim_lost(void) {
+  g_taken |= 1ull << g_candidate;
+#ifdef CAN_NODE_ADDR
+  // Two nodes configured with the same address: the lower name keeps it.
+  fail();
+#else
+  for (unsigned i = 1; i < CAN_NODE_ADDR_ANON; i++) {
+    const uint8_t a = (uint8_t)((g_candidate + i) % CAN_NODE_ADDR_ANON);
+    if (!((g_taken >> a) & 1u)) {
+      start_claim(a);
+      return;
+    }
+  }
+  fail();
+#endif
+}
+
+static int send_claim(void) {
+  can_bus_frame_t f;
+  memset(&f, 0, sizeof(f));
+  f.id = CAN_NODE_ID(CAN_NODE_BAND_CLAIM, g_candidate);
+  f.len = 8;
+  for (unsigned i = 0; i < 8; i++)
+    f.data[i] = (uint8_t)(g_name >> (8u * i));
+  return can_bus_send_frame(&f) == HAL_OK;
+}
+
+static void on_msg(uint32_t id, uint8_t flags, const uint8_t *data,
+                   size_t len, void *user) {
+  (void)user;
+  if (flags & CAN_BUS_FRAME_F_EXT)
+    return;
+  if (CAN_NODE_ID_BAND(id) != CAN_NODE_BAND_CLAIM || len != 8)
+    return;
+
+  uint64_t name = 0;
+  for (unsigned i = 0; i < 8; i++)
+    name |= (uint64_t)data[i] << (8u * i);
+  const uint8_t addr = (uint8_t)CAN_NODE_ID_ADDR(id);
+  if (name == g_name || addr == CAN_NODE_ADDR_ANON)
+    return; // our own claim (loopback), or nonsense
+
+  if ((g_state == CAN_NODE_CLAIMING || g_state == CAN_NODE_CLAIMED) &&
+      addr == g_candidate) {
+    if (name < g_name)
+      claim_lost();
+    else
+      g_send_claim = 1; // defend
+    return;
+  }
+  g_taken |= 1ull << addr;
+}
+
+// =========================
+// Public API
+// =========================
+
+void can_node_init(void) {
+  if (g_state != CAN_NODE_UNCLAIMED)
+    return;
+
+  if (!g_subscribed) {
+    if (can_bus_subscribe_msgs(on_msg, NULL) != HAL_OK) {
+      fail();
+      return;
+    }
+    g_subscribed = 1;
+  }
+
+  g_name = node_name();
+#ifdef CAN_NODE_ADDR
+  start_claim((uint8_t)(CAN_NODE_ADDR));
+#else
+  start_claim((uint8_t)(g_name % CAN_NODE_ADDR_ANON));
+#endif
+}
+
+void can_node_poll(uint32_t now_ms) {
+  if (g_state != CAN_NODE_CLAIMING && g_state != CAN_NODE_CLAIMED)
+    return;
+
+  if (g_send_claim) {
+    if (!g_send_armed) {
+      g_send_at_ms = now_ms + claim_delay_ms();
+      g_send_armed = 1;
+    }
+    if ((int32_t)(now_ms - g_send_at_ms) < 0)
+      return;
+    // FIFO full or bus-off: try again next poll.
+    if (!send_claim())
+      return;
+    g_send_claim = 0;
+    g_send_armed = 0;
+    g_claims++;
+    if (g_state == CAN_NODE_CLAIMING)
+      g_claim_ms = now_ms;
+    return;
+  }
+
+  if (g_state == CAN_NODE_CLAIMING &&
+      (uint32_t)(now_ms - g_claim_ms) >= CAN_NODE_CLAIM_MS) {
+    g_addr = g_candidate;
+    g_state = CAN_NODE_CLAIMED;
+  }
+}
+
+can_node_state_t can_node_state(void) { return g_state; }
+
+uint8_t can_node_addr(void) { return g_addr; }
@@ -0,0 +1,358 @@
+// gs_usb_proto.c
+//
+// gs_usb host frame packing and control request handling. See gs_usb_proto.h.
+//
+// Control requests arrive in USB interrupt context on the target, so the
+// handlers here only validate and copy; start/stop go straight to the ops
+// callbacks, which are expected to defer anything slow.
+
+#include "gs_usb_proto.h"
+
+#include <string.h>
+
+// =========================
+// Little-endian helpers
+// =========================
+
+static uint32_t rd32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+static uint8_t *wr32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+  return p + 4;
+}
+
+// =========================
+// DLC helpers
+// =========================
+
+static const uint8_t dlc_len[16] = {0, 1,  2,  3,  4,  5,  6,  7,
+                                    8, 12, 16, 20, 24, 32, 48, 64};
+
+uint8_t gs_usb_dlc_to_len(uint8_t dlc) { return dlc_len[dlc & 0xFu]; }
+
+uint8_t gs_usb_len_to_dlc(uint8_t len) {
+  if (len <= 8)
+    return len;
+  for (uint8_t dlc = 9; dlc < 16; dlc++) {
+    if (len <= dlc_len[dlc])
+      return dlc;
+  }
+  return 15;
+}
+
+// =========================
+// Host frames
+// =========================
+
+size_t gs_usb_frame_size(const gs_usb_dev_t *dev, uint8_t flags) {
+  size_t n = GS_USB_FRAME_HDR_LEN + ((flags & GS_USB_FLAG_FD) ? 64u : 8u);
+  if (dev && (dev->mode_flags & GS_USB_FEATURE_HW_TIMESTAMP))
+    n += 4u;
+  return n;
+}
+
+size_t gs_usb_frame_pack(const gs_usb_dev_t *dev, const gs_usb_frame_t *f,
+                         uint8_t *out, size_t cap) {
+  if (!f || !out)
+    return 0;
+
+  const size_t n = gs_usb_frame_size(dev, f->flags);
+  if (cap < n)
+    return 0;
+
+  const size_t data_cap = (f->flags & GS_USB_FLAG_FD) ? 64u : 8u;
+  uint8_t len = f->len;
+  if (len > data_cap)
+    len = (uint8_t)data_cap;
+
+  uint8_t *p = wr32(out, f->echo_id);
+  p = wr32(p, f->can_id);
+  *p++ = gs_usb_len_to_dlc(len);
+  *p++ = f->channel;
+  *p++ = f->flags;
+  *p++ = 0;
+
+  memcpy(p, f->data, len);
+  memset(p + len, 0, data_cap - len);
+  p += data_cap;
+
+  if (dev && (dev->mode_flags & GS_USB_FEATURE_HW_TIMESTAMP))
+    p = wr32(p, f->timestamp_us);
+
+  return (size_t)(p - out);
+}
+
+int gs_usb_frame_unpack(const uint8_t *in, size_t len, gs_usb_frame_t *f) {
+  if (!in || !f || len < GS_USB_FRAME_HDR_LEN)
+    return -1;
+
+  f->echo_id = rd32(in);
+  f->can_id = rd32(in + 4);
+  const uint8_t dlc = in[8];
+  f->channel = in[9];
+  f->flags = in[10];
+  f->timestamp_us = 0;
+
+  if (dlc > 15)
+    return -1;
+
+  const int fd = (f->flags & GS_USB_FLAG_FD) != 0;
+  if (len < GS_USB_FRAME_HDR_LEN + (fd ? 64u : 8u))
+    return -1;
+
+  // Classic DLC 9..15 still means 8 bytes. For RTR frames len is the
+  // requested DLC and the data bytes are ignored.
+  f->len = fd ? gs_usb_dlc_to_len(dlc) : (dlc > 8 ? 8 : dlc);
+  memcpy(f->data, in + GS_USB_FRAME_HDR_LEN, fd ? 64u : 8u);
+  return 0;
+}
+
+// =========================
+// Bus frames
+// =========================
+
+void gs_usb_frame_from_bus(const can_bus_frame_t *in, uint32_t echo_id,
+                           gs_usb_frame_t *out) {
+  out->echo_id = echo_id;
+  out->can_id = in->id;
+  if (in->flags & CAN_BUS_FRAME_F_EXT)
+    out->can_id |= GS_USB_CAN_EFF_FLAG;
+  if (in->flags & CAN_BUS_FRAME_F_RTR)
+    out->can_id |= GS_USB_CAN_RTR_FLAG;
+  out->flags = 0;
+  if (in->flags & CAN_BUS_FRAME_F_FD)
+    out->flags |= GS_USB_FLAG_FD;
+  if (in->flags & CAN_BUS_FRAME_F_BRS)
+    out->flags |= GS_USB_FLAG_BRS;
+  if (in->flags & CAN_BUS_FRAME_F_ESI)
+    out->flags |= GS_USB_FLAG_ESI;
+  out->len = in->len > 64u ? 64u : in->len;
+  out->channel = 0;
+  out->timestamp_us = (uint32_t)in->timestamp_us;
+  memcpy(out->data, in->data, out->len);
+}
+
+void gs_usb_frame_to_bus(const gs_usb_frame_t *in, can_bus_frame_t *out) {
+  out->timestamp_us = 0;
+  out->flags = 0;
+  if (in->can_id & GS_USB_CAN_EFF_FLAG) {
+    out->flags |= CAN_BUS_FRAME_F_EXT;
+    out->id = in->can_id & GS_USB_CAN_EFF_MASK;
+  } else {
+    out->id = in->can_id & GS_USB_CAN_SFF_MASK;
+  }
+  if (in->can_id & GS_USB_CAN_RTR_FLAG)
+    out->flags |= CAN_BUS_FRAME_F_RTR;
+  if (in->flags & GS_USB_FLAG_FD)
+    out->flags |= CAN_BUS_FRAME_F_FD;
+  if (in->flags & GS_USB_FLAG_BRS)
+    out->flags |= CAN_BUS_FRAME_F_BRS;
+  out->len = in->len;
+  memcpy(out->data, in->data, sizeof(out->data));
+}
+
+// =========================
+// Control requests
+// =========================
+
+#define GS_USB_BITTIMING_LEN 20u
+#define GS_USB_BT_CONST_LEN 40u
+#define GS_USB_BT_CONST_EXT_LEN 72u
+#define GS_USB_DEVICE_CONFIG_LEN 12u
+
+// Mode flags we pass through: the ones whose feature bit the device reports.
+#define GS_USB_MODE_FLAG_MASK                                                  \
+  (GS_USB_FEATURE_LISTEN_ONLY | GS_USB_FEATURE_LOOP_BACK |                     \
+   GS_USB_FEATURE_TRIPLE_SAMPLE | GS_USB_FEATURE_ONE_SHOT |                    \
+   GS_USB_FEATURE_HW_TIMESTAMP | GS_USB_FEATURE_PAD_PKTS |                     \
+   GS_USB_FEATURE_FD | GS_USB_FEATURE_BERR_REPORTING)
+
+static void bittiming_read(const uint8_t *p, gs_usb_bittiming_t *bt) {
+  bt->prop_seg = rd32(p);
+  bt->phase_seg1 = rd32(p + 4);
+  bt->phase_seg2 = rd32(p + 8);
+  bt->sjw = rd32(p + 12);
+  bt->brp = rd32(p + 16);
+}
+
+static int bittiming_valid(const gs_usb_bittiming_t *bt,
+                           const gs_usb_bt_const_t *c) {
+  const uint32_t tseg1 = bt->prop_seg + bt->phase_seg1;
+  if (tseg1 < c->tseg1_min || tseg1 > c->tseg1_max)
+    return 0;
+  if (bt->phase_seg2 < c->tseg2_min || bt->phase_seg2 > c->tseg2_max)
+    return 0;
+  if (bt->sjw == 0 || bt->sjw > c->sjw_max)
+    return 0;
+  if (bt->brp < c->brp_min || bt->brp > c->brp_max)
+    return 0;
+  return 1;
+}
+
+static uint8_t *bt_const_write(uint8_t *p, const gs_usb_bt_const_t *c) {
+  p = wr32(p, c->tseg1_min);
+  p = wr32(p, c->tseg1_max);
+  p = wr32(p, c->tseg2_min);
+  p = wr32(p, c->tseg2_max);
+  p = wr32(p, c->sjw_max);
+  p = wr32(p, c->brp_min);
+  p = wr32(p, c->brp_max);
+  return wr32(p, c->brp_inc);
+}
+
+static int gs_usb_mode(gs_usb_dev_t *dev, uint32_t mode, uint32_t flags) {
+  if (mode == GS_USB_MODE_RESET) {
+    if (dev->started && dev->ops->stop)
+      dev->ops->stop(dev->user);
+    dev->started = 0;
+    dev->mode_flags = 0;
+    return 0;
+  }
+  if (mode != GS_USB_MODE_START)
+    return -1;
+
+  if (flags & ~(dev->caps->features & GS_USB_MODE_FLAG_MASK))
+    return -1;
+  if (!dev->nominal_set)
+    return -1;
+  const int fd = (flags & GS_USB_FEATURE_FD) != 0;
+  if (fd && !dev->data_set)
+    return -1;
+
+  if (dev->started && dev->ops->stop)
+    dev->ops->stop(dev->user);
+  dev->started = 0;
+
+  // Frame sizes depend on the flags, so publish them before frames flow.
+  dev->mode_flags = flags;
+  if (!dev->ops->start ||
+      dev->ops->start(dev->user, &dev->nominal, fd ? &dev->data : NULL,
+                      flags) != 0) {
+    dev->mode_flags = 0;
+    return -1;
+  }
+  dev->started = 1;
+  return 0;
+}
+
+void gs_usb_init(gs_usb_dev_t *dev, const gs_usb_caps_t *caps,
+                 const gs_usb_ops_t *ops, void *user) {
+  memset(dev, 0, sizeof(*dev));
+  dev->caps = caps;
+  dev->ops = ops;
+  dev->user = user;
+}
+
+int gs_usb_control(gs_usb_dev_t *dev, uint8_t request, uint16_t value,
+                   const uint8_t *out, size_t out_len, uint8_t *in,
+                   size_t in_cap) {
+  if (!dev || !dev->caps || !dev->ops)
+    return -1;
+
+  const gs_usb_caps_t *caps = dev->caps;
+
+  // wValue is the channel for everything but the two device-wide requests;
+  // there is exactly one.
+  if (value != 0 && request != GS_USB_BREQ_HOST_FORMAT &&
+      request != GS_USB_BREQ_DEVICE_CONFIG)
+    return -1;
+
+  switch (request) {
+  case GS_USB_BREQ_HOST_FORMAT:
+    // Older drivers announce their byte order; we only speak little endian.
+    if (out_len < 4 || rd32(out) != GS_USB_HOST_FORMAT_LE)
+      return -1;
+    return 0;
+
+  case GS_USB_BREQ_BITTIMING:
+  case GS_USB_BREQ_DATA_BITTIMING: {
+    const int data = (request == GS_USB_BREQ_DATA_BITTIMING);
+    if (data && !(caps->features & GS_USB_FEATURE_FD))
+      return -1;
+    if (out_len < GS_USB_BITTIMING_LEN)
+      return -1;
+    gs_usb_bittiming_t bt;
+    bittiming_read(out, &bt);
+    if (!bittiming_valid(&bt, data ? &caps->data : &caps->nominal))
+      return -1;
+    if (data) {
+      dev->data = bt;
+      dev->data_set = 1;
+    } else {
+      dev->nominal = bt;
+      dev->nominal_set = 1;
+    }
+    return 0;
+  }
+
+  case GS_USB_BREQ_MODE:
+    if (out_len < 8)
+      return -1;
+    return gs_usb_mode(dev, rd32(out), rd32(out + 4));
+
+  case GS_USB_BREQ_BT_CONST: {
+    if (in_cap < GS_USB_BT_CONST_LEN)
+      return -1;
+    uint8_t *p = wr32(in, caps->features);
+    p = wr32(p, caps->fclk_can);
+    p = bt_const_write(p, &caps->nominal);
+    return (int)(p - in);
+  }
+
+  case GS_USB_BREQ_BT_CONST_EXT: {
+    if (!(caps->features & GS_USB_FEATURE_BT_CONST_EXT) ||
+        in_cap < GS_USB_BT_CONST_EXT_LEN)
+      return -1;
+    uint8_t *p = wr32(in, caps->features);
+    p = wr32(p, caps->fclk_can);
+    p = bt_const_write(p, &caps->nominal);
+    p = bt_const_write(p, &caps->data);
+    return (int)(p - in);
+  }
+
+  case GS_USB_BREQ_DEVICE_CONFIG: {
+    if (in_cap < GS_USB_DEVICE_CONFIG_LEN)
+      return -1;
+    in[0] = in[1] = in[2] = 0; // reserved
+    in[3] = 0;                 // icount: number of channels - 1
+    uint8_t *p = wr32(in + 4, caps->sw_version);
+    p = wr32(p, caps->hw_version);
+    return (int)(p - in);
+  }
+
+  case GS_USB_BREQ_TIMESTAMP:
+    if (!(caps->features & GS_USB_FEATURE_HW_TIMESTAMP) || in_cap < 4 ||
+        !dev->ops->timestamp_us)
+      return -1;
+    wr32(in, dev->ops->timestamp_us(dev->user));
+    return 4;
+
+  case GS_USB_BREQ_IDENTIFY:
+    if (!(caps->features & GS_USB_FEATURE_IDENTIFY) || out_len < 4)
+      return -1;
+    if (dev->ops->identify)
+      dev->ops->identify(dev->user, rd32(out) != 0);
+    return 0;
+
+  case GS_USB_BREQ_GET_STATE: {
+    if (!(caps->features & GS_USB_FEATURE_GET_STATE) || in_cap < 12)
+      return -1;
+    uint32_t state = GS_USB_STATE_STOPPED, rxerr = 0, txerr = 0;
+    if (dev->started && dev->ops->get_state)
+      dev->ops->get_state(dev->user, &state, &rxerr, &txerr);
+    uint8_t *p = wr32(in, state);
+    p = wr32(p, rxerr);
+    p = wr32(p, txerr);
+    return (int)(p - in);
+  }
+
+  default:
+    return -1;
+  }
+}
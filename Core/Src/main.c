@@ -22,7 +22,9 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
-
+#include "can_bus.h"
+#include "timebase.h"
+#include "uart_link.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -51,6 +53,8 @@ PCD_HandleTypeDef hpcd_USB_FS;
 
 DMA_HandleTypeDef hdma_dma_generator0;
 /* USER CODE BEGIN PV */
+DMA_HandleTypeDef hdma_usart1_rx;
+DMA_HandleTypeDef hdma_usart1_tx;
 
 /* USER CODE END PV */
 
@@ -106,6 +110,12 @@ int main(void)
   MX_USART1_UART_Init();
   MX_USB_PCD_Init();
   /* USER CODE BEGIN 2 */
+  timebase_init();
+  can_bus_init(&hfdcan2);
+  if (uart_link_init(&huart1, UART_LINK_BAUD) != HAL_OK)
+  {
+    Error_Handler();
+  }
 
   /* USER CODE END 2 */
 
@@ -1,10 +1,19 @@
 // telemetry.c
 #include "telemetry.h"
+#include "telemetry_batches.h"
+#include "telemetry_routes.h"
+#include "telemetry_schema.h"
 
 #include "app_threadx.h" // brings in tx_api.h usually
 #include "can_bus.h"
+#include "can_node.h"
 #include "sedsprintf.h"
 #include "stm32g4xx_hal.h"
+#include "timebase.h"
+#include "uart_link.h"
+#ifdef TELEMETRY_USB_CDC
+#include "ux_device_cdc_acm.h"
+#endif
 
 #include <stdarg.h>
 #include <stdint.h>
@@ -24,70 +33,117 @@ static void print_data_no_telem(void *data, size_t len) {
 #define UNUSED_FUNCTION
 #endif
 
-static uint8_t g_can_rx_subscribed = 0;
-static int32_t g_can_side_id = -1;
-
-#ifndef TX_TIMER_TICKS_PER_SECOND
-#error "TX_TIMER_TICKS_PER_SECOND must be defined by ThreadX."
+// Serial (USART1, COBS framed) router side next to CAN.
+#ifndef TELEMETRY_UART_SIDE
+#define TELEMETRY_UART_SIDE 1
 #endif
 
-/* ---------------- ThreadX clock helpers (32->64 extender) ---------------- */
-static uint64_t tx_raw_now_ms(void *user) {
-  (void)user;
-
-  static uint32_t last_ticks32 = 0;
-  static uint64_t high = 0;
+// Mirror every CAN frame (timestamped, own transmissions included) to the
+// serial links as SERIAL_FRAME_TYPE_CAN, for host-side bus captures. Costs
+// ~80 bytes of link bandwidth per FD frame, so off unless asked for.
+#ifndef TELEMETRY_CAN_TAP
+#define TELEMETRY_CAN_TAP 0
+#endif
 
-  uint32_t cur32 = (uint32_t)tx_time_get();
-  if (cur32 < last_ticks32) {
-    high += (1ULL << 32);
-  }
-  last_ticks32 = cur32;
+// Boards on firmware from before per-node IDs send everything on the one
+// shared ID 0x03, which is band 0 in the per-node scheme and used by no
+// current board. Accept it while the fleet is migrated; set to 0 once every
+// board sends per-node IDs. (The controller's global filter already accepts
+// every standard ID.)
+#ifndef TELEMETRY_CAN_ACCEPT_LEGACY_ID
+#define TELEMETRY_CAN_ACCEPT_LEGACY_ID 1
+#endif
+#define TELEMETRY_CAN_LEGACY_ID 0x03u
 
-  uint64_t ticks64 = high | (uint64_t)cur32;
-  return (ticks64 * 1000ULL) / (uint64_t)TX_TIMER_TICKS_PER_SECOND;
-}
+static uint8_t g_can_rx_subscribed = 0;
+#if TELEMETRY_CAN_TAP
+static uint8_t g_can_tap_subscribed = 0;
+#endif
+static int32_t g_can_side_id = -1;
+#if TELEMETRY_UART_SIDE
+static uint8_t g_uart_rx_subscribed = 0;
+static int32_t g_uart_side_id = -1;
+#endif
+#ifdef TELEMETRY_USB_CDC
+static uint8_t g_usb_rx_subscribed = 0;
+static int32_t g_usb_side_id = -1;
+#endif
 
 /* ---------------- Time sync state (software-only; does NOT affect ThreadX scheduling) ----------------
  *
- * telemetry_now_ms()  = tx_raw_now_ms() + g_master_offset_ms
+ * local               = timebase_now_us() (TIM2), the clock FDCAN RX/TX timestamps are in
+ * telemetry_now_us()  = local + offset + rate * (local - ref)   (see TimesyncModel)
+ * telemetry_now_ms()  = telemetry_now_us() / 1000
  * telemetry_unix_ms() = telemetry_now_ms() + g_unix_base_ms   (if valid)
  *
  * Master (RF/GPS board):
- *  - g_master_offset_ms stays 0 (it IS the master)
+ *  - the model stays at zero offset and rate (it IS the master)
  *  - telemetry_set_unix_time_ms() updates g_unix_base_ms from GPS unix
  *  - responds to TIME_SYNC_REQUEST packets
  *  - announces unix time periodically
  *
  * Client boards:
- *  - g_master_offset_ms is adjusted from TIME_SYNC_RESPONSE (NTP math)
+ *  - the model is steered from TIME_SYNC_RESPONSE (see on_timesync)
  *  - g_unix_base_ms is learned from TIME_SYNC_ANNOUNCE from master
  */
-static volatile int64_t  g_master_offset_ms = 0;   // ms
-static volatile uint64_t g_last_delay_ms    = 0;   // ms (from last NTP response)
+typedef struct {
+  uint64_t ref_us;    // local time of the last correction
+  int64_t  offset_us; // master - local at ref_us
+  int32_t  rate_ppb;  // master clock rate against ours, parts per billion
+} TimesyncModel;
+
+static TimesyncModel     g_ts_model;                // read from any context
+static volatile uint64_t g_last_delay_us    = 0;   // us (from last response round trip)
 static volatile int64_t  g_unix_base_ms     = 0;   // ms
 static volatile uint8_t  g_unix_valid       = 0;
 
-static inline int64_t telemetry_master_offset_ms_get(void) {
-  return (int64_t)g_master_offset_ms;
+static inline uint64_t telemetry_last_delay_us_get(void) {
+  return (uint64_t)g_last_delay_us;
+}
+static inline void telemetry_last_delay_us_set(uint64_t d) {
+  g_last_delay_us = d;
 }
-static inline void telemetry_master_offset_ms_set(int64_t off) {
-  g_master_offset_ms = off;
+
+static inline uint32_t timesync_lock(void) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  return primask;
 }
-static inline uint64_t telemetry_last_delay_ms_get(void) {
-  return (uint64_t)g_last_delay_ms;
+
+static inline void timesync_unlock(uint32_t primask) { __set_PRIMASK(primask); }
+
+static inline int64_t model_offset_at(const TimesyncModel *m, uint64_t local_us) {
+  const int64_t dt = (int64_t)(local_us - m->ref_us);
+  return m->offset_us + dt * (int64_t)m->rate_ppb / 1000000000LL;
 }
-static inline void telemetry_last_delay_ms_set(uint64_t d) {
-  g_last_delay_ms = d;
+
+static void model_set(uint64_t ref_us, int64_t offset_us, int32_t rate_ppb) {
+  const uint32_t pm = timesync_lock();
+  g_ts_model.ref_us = ref_us;
+  g_ts_model.offset_us = offset_us;
+  g_ts_model.rate_ppb = rate_ppb;
+  timesync_unlock(pm);
 }
 
 /* Public helpers */
-uint64_t telemetry_now_ms(void) {
-  int64_t t = (int64_t)tx_raw_now_ms(NULL) + telemetry_master_offset_ms_get();
+uint64_t telemetry_time_us_at(uint64_t local_us) {
+  const uint32_t pm = timesync_lock();
+  const TimesyncModel m = g_ts_model;
+  timesync_unlock(pm);
+
+  int64_t t = (int64_t)local_us + model_offset_at(&m, local_us);
   if (t < 0) t = 0;
   return (uint64_t)t;
 }
 
+uint64_t telemetry_now_us(void) {
+  return telemetry_time_us_at(timebase_now_us());
+}
+
+uint64_t telemetry_now_ms(void) {
+  return telemetry_now_us() / 1000ULL;
+}
+
 uint64_t telemetry_unix_ms(void) {
   if (!g_unix_valid) return 0;
   int64_t t = (int64_t)telemetry_now_ms() + (int64_t)g_unix_base_ms;
@@ -115,48 +171,349 @@ void telemetry_set_unix_time_ms(uint64_t unix_ms) {
 
 static uint64_t node_now_since_ms(void *user);
 
+#if !TELEMETRY_TIME_MASTER
 /* ---------------- NTP math ---------------- */
 static void compute_offset_delay(uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4,
-                                 int64_t *offset_ms, uint64_t *delay_ms) {
+                                 int64_t *offset_us, uint64_t *delay_us) {
   const int64_t o = ((int64_t)(t2 - t1) + (int64_t)(t3 - t4)) / 2;
   const int64_t d = (int64_t)(t4 - t1) - (int64_t)(t3 - t2);
-  *offset_ms = o;
-  *delay_ms = (d < 0) ? 0 : (uint64_t)d;
+  *offset_us = o;
+  *delay_us = (d < 0) ? 0 : (uint64_t)d;
 }
 
+/* ---------------- Clock servo (clients) ----------------
+ *
+ * A sample is the master's offset from the local clock at one local instant.
+ * Precise samples come from the FDCAN timestamps of one request frame (the
+ * client's TX event and the master's RX stamp of the same start of frame);
+ * they first step the clock, then a second one gives the rate, then a PI loop
+ * keeps both. Round-trip (NTP) samples are only used while no precise sample
+ * has arrived within NET_TIMESYNC_HOLDOVER_MS, and only to smooth the offset.
+ */
 #ifndef NET_TIMESYNC_MAX_STEP_MS
-#define NET_TIMESYNC_MAX_STEP_MS 30000
+#define NET_TIMESYNC_MAX_STEP_MS 30000   // larger errors are outliers, ignored
 #endif
 
 #ifndef NET_TIMESYNC_SMOOTH_DIV
-#define NET_TIMESYNC_SMOOTH_DIV 4
+#define NET_TIMESYNC_SMOOTH_DIV 4        // round-trip samples: fraction of the error applied
+#endif
+
+#ifndef NET_TIMESYNC_RESTEP_US
+#define NET_TIMESYNC_RESTEP_US 1000      // precise error that steps instead of steering
 #endif
 
-static void client_apply_offset_ms(int64_t offset_ms) {
-  if (offset_ms > NET_TIMESYNC_MAX_STEP_MS || offset_ms < -NET_TIMESYNC_MAX_STEP_MS) {
+#ifndef NET_TIMESYNC_MAX_RATE_PPB
+#define NET_TIMESYNC_MAX_RATE_PPB 500000 // crystal tolerance of both boards together
+#endif
+
+#ifndef NET_TIMESYNC_HOLDOVER_MS
+#define NET_TIMESYNC_HOLDOVER_MS 10000
+#endif
+
+#define NET_TIMESYNC_P_DIV 2             // offset: half the error per sample
+#define NET_TIMESYNC_I_DIV 4             // rate: a quarter of the error rate per sample
+
+typedef enum {
+  TIMESYNC_UNSYNCED = 0,
+  TIMESYNC_COARSE,  // round-trip samples only
+  TIMESYNC_STEPPED, // one precise sample, rate unknown
+  TIMESYNC_LOCKED,
+} TimesyncState;
+
+static TimesyncState g_ts_state = TIMESYNC_UNSYNCED;
+static uint64_t g_ts_last_local_us;   // last precise sample
+static int64_t  g_ts_last_offset_us;
+
+static inline int32_t clamp_rate(int64_t ppb) {
+  if (ppb >  NET_TIMESYNC_MAX_RATE_PPB) return  NET_TIMESYNC_MAX_RATE_PPB;
+  if (ppb < -NET_TIMESYNC_MAX_RATE_PPB) return -NET_TIMESYNC_MAX_RATE_PPB;
+  return (int32_t)ppb;
+}
+
+static void client_apply_sample(uint64_t local_us, int64_t offset_us, uint8_t precise) {
+  const TimesyncModel m = g_ts_model; // only this thread writes it
+  const int64_t predicted = model_offset_at(&m, local_us);
+  const int64_t err = offset_us - predicted;
+  const int64_t max_step_us = (int64_t)NET_TIMESYNC_MAX_STEP_MS * 1000;
+
+  if (g_ts_state != TIMESYNC_UNSYNCED && (err > max_step_us || err < -max_step_us)) {
+    return;
+  }
+
+  if (!precise) {
+    if (g_ts_state >= TIMESYNC_STEPPED &&
+        local_us - g_ts_last_local_us < (uint64_t)NET_TIMESYNC_HOLDOVER_MS * 1000u) {
+      return; // the hardware stamps are better
+    }
+    if (g_ts_state == TIMESYNC_UNSYNCED) {
+      model_set(local_us, offset_us, 0);
+    } else {
+      // Smooth to avoid jitter; keep whatever rate was learned.
+      model_set(local_us, predicted + err / (int64_t)NET_TIMESYNC_SMOOTH_DIV, m.rate_ppb);
+    }
+    g_ts_state = TIMESYNC_COARSE;
     return;
   }
 
-  // Smooth to avoid jitter
-  int64_t step = offset_ms / (int64_t)NET_TIMESYNC_SMOOTH_DIV;
-  if (step == 0) {
-    if (offset_ms > 0) step = 1;
-    else if (offset_ms < 0) step = -1;
+  const uint64_t dt = local_us - g_ts_last_local_us;
+  if (g_ts_state == TIMESYNC_STEPPED && dt > 0) {
+    // Second precise sample: the rate is what the offset moved by.
+    const int64_t ppb = (offset_us - g_ts_last_offset_us) * 1000000000LL / (int64_t)dt;
+    model_set(local_us, offset_us, clamp_rate(ppb));
+    g_ts_state = TIMESYNC_LOCKED;
+  } else if (g_ts_state == TIMESYNC_LOCKED && dt > 0 &&
+             err < NET_TIMESYNC_RESTEP_US && err > -NET_TIMESYNC_RESTEP_US) {
+    const int64_t ppb = (int64_t)m.rate_ppb +
+                        err * 1000000000LL / (int64_t)dt / NET_TIMESYNC_I_DIV;
+    model_set(local_us, predicted + err / NET_TIMESYNC_P_DIV, clamp_rate(ppb));
+  } else {
+    // First precise sample, or lost lock: step, keep any rate learned.
+    model_set(local_us, offset_us, m.rate_ppb);
+    g_ts_state = TIMESYNC_STEPPED;
   }
+  g_ts_last_local_us = local_us;
+  g_ts_last_offset_us = offset_us;
+}
+#endif // !TELEMETRY_TIME_MASTER
+
+/* ---------------- Time sync request stamping ----------------
+ *
+ * The client's own REQUEST is caught on its way to CAN (tx_send runs inside
+ * seds_router_log_ts) and its first fragment is queued with a TX event, so
+ * the request's start of frame is known on both ends. Without egress queues
+ * the request goes out unstamped and only the round trip is used.
+ */
+#define TIMESYNC_REQ_MAX_BYTES 64u
+
+typedef struct {
+  uint64_t seq;
+  uint64_t t1_us;            // local, when the request was logged
+  uint8_t  active;           // a response is expected
+  uint8_t  capture;          // inside seds_router_log_ts for the request
+  uint8_t  want_stamp;       // bytes captured, CAN send not started yet
+  uint8_t  stamped;          // tx carries a TX event marker
+  size_t   len;
+  uint8_t  bytes[TIMESYNC_REQ_MAX_BYTES];
+  can_bus_large_tx_t tx;
+} TimesyncRequest;
+
+static TimesyncRequest g_ts_req;
+
+static inline void timesync_capture_request(const uint8_t *bytes, size_t len) {
+#if !TELEMETRY_TIME_MASTER
+  if (!g_ts_req.capture || len > sizeof(g_ts_req.bytes)) return;
+  if (telemetry_peek_data_type(bytes, len) != (int32_t)SEDS_DT_TIME_SYNC_REQUEST) return;
+  memcpy(g_ts_req.bytes, bytes, len);
+  g_ts_req.len = len;
+  g_ts_req.want_stamp = 1;
+  g_ts_req.capture = 0;
+#else
+  (void)bytes;
+  (void)len;
+#endif
+}
 
-  g_master_offset_ms += step;
+#if TELEMETRY_EGRESS_QUEUES
+// Called right after can_bus_send_large_start() for every CAN egress packet.
+static inline void timesync_stamp_request(can_bus_large_tx_t *tx, const uint8_t *bytes,
+                                          size_t len) {
+  if (!g_ts_req.want_stamp || len != g_ts_req.len || memcmp(bytes, g_ts_req.bytes, len) != 0) {
+    return;
+  }
+  can_bus_send_large_stamp(tx);
+  g_ts_req.tx = *tx;
+  g_ts_req.stamped = 1;
+  g_ts_req.want_stamp = 0;
 }
+#endif
+
+// Set while the CAN side hands a received packet to the router, so the time
+// sync handler can use the frame's start-of-frame stamp and sender address.
+typedef struct {
+  uint8_t  valid;
+  uint8_t  addr;
+  uint64_t sof_us;
+} TimesyncRxContext;
+
+static TimesyncRxContext g_ts_rx;
 
 /* ---------------- Global router state ---------------- */
 RouterState g_router = {.r = NULL, .created = 0, .start_time = 0};
 
 /* ---------------- TX helpers ---------------- */
+// This node's CAN ID for a packet: the band of its data type, and the
+// address from can_node.c.
+static inline uint32_t can_packet_id(const uint8_t *bytes, size_t len) {
+  return can_node_id(telemetry_can_band_of(telemetry_peek_data_type(bytes, len)));
+}
+
+#if TELEMETRY_EGRESS_QUEUES
+// Router side callbacks only enqueue; telemetry_egress_poll() feeds the links
+// through the *_egress_send hooks below.
+static int32_t g_can_egress = -1;
+#if TELEMETRY_UART_SIDE
+static int32_t g_uart_egress = -1;
+#endif
+#ifdef TELEMETRY_USB_CDC
+static int32_t g_usb_egress = -1;
+#endif
+
+static TelemetryEgressResult egress_result(HAL_StatusTypeDef st) {
+  if (st == HAL_OK) return TELEMETRY_EGRESS_SENT;
+  return (st == HAL_BUSY) ? TELEMETRY_EGRESS_BUSY : TELEMETRY_EGRESS_FAILED;
+}
+
+// A long packet goes out over several polls as FIFO space frees up. One per
+// class: a HIGH packet may start while a BULK one is half sent, and the
+// receivers reassemble per CAN ID.
+static can_bus_large_tx_t g_can_large_tx[TELEMETRY_PRIO_CLASSES];
+
+static TelemetryEgressResult can_egress_send(const uint8_t *bytes, size_t len,
+                                             uint8_t first, TelemetryPriority prio,
+                                             void *user) {
+  (void)user;
+  // Hold the queue until the address claim settles rather than sending
+  // under an address we may have to give up.
+  if (first && can_node_state() == CAN_NODE_CLAIMING) return TELEMETRY_EGRESS_BUSY;
+  can_bus_large_tx_t *tx = &g_can_large_tx[prio];
+  if (first) {
+    if (can_bus_send_large_start(tx, bytes, len, can_packet_id(bytes, len)) != HAL_OK) {
+      return TELEMETRY_EGRESS_FAILED;
+    }
+    timesync_stamp_request(tx, bytes, len);
+  }
+  return egress_result(can_bus_send_large_continue(tx));
+}
+
+#if TELEMETRY_UART_SIDE
+static TelemetryEgressResult uart_egress_send(const uint8_t *bytes, size_t len,
+                                              uint8_t first, TelemetryPriority prio,
+                                              void *user) {
+  (void)first;
+  (void)prio;
+  (void)user;
+  return egress_result(uart_link_send(SERIAL_FRAME_TYPE_ROUTER, bytes, len));
+}
+#endif
+
+#ifdef TELEMETRY_USB_CDC
+static TelemetryEgressResult usb_egress_send(const uint8_t *bytes, size_t len,
+                                             uint8_t first, TelemetryPriority prio,
+                                             void *user) {
+  (void)first;
+  (void)prio;
+  (void)user;
+  return egress_result(usb_cdc_link_send(SERIAL_FRAME_TYPE_ROUTER, bytes, len));
+}
+#endif
+#endif // TELEMETRY_EGRESS_QUEUES
+
+uint8_t telemetry_can_band_of(int32_t data_type) {
+  switch (data_type) {
+#define TELEMETRY_CAN_BAND_CASE_(dt, count, band)                              \
+  case (int32_t)(dt):                                                          \
+    return TELEMETRY_CAN_BAND_##band;
+    TELEMETRY_SCHEMA(TELEMETRY_CAN_BAND_CASE_)
+#undef TELEMETRY_CAN_BAND_CASE_
+  default:
+    return TELEMETRY_CAN_BAND_BULK;
+  }
+}
+
+TelemetryPriority telemetry_priority_of(int32_t data_type) {
+  return (telemetry_can_band_of(data_type) <= TELEMETRY_CAN_BAND_HIGH_LAST) ? TELEMETRY_PRIO_HIGH
+                                                                            : TELEMETRY_PRIO_BULK;
+}
+
+static inline TelemetryPriority packet_priority(const uint8_t *bytes, size_t len) {
+  return telemetry_priority_of(telemetry_peek_data_type(bytes, len));
+}
+
+// Link outputs, after routing.
+static SedsResult can_out(const uint8_t *bytes, size_t len) {
+#if TELEMETRY_EGRESS_QUEUES
+  if (g_can_egress >= 0) {
+    return telemetry_egress_push(g_can_egress, packet_priority(bytes, len), bytes, len);
+  }
+#endif
+  return (can_bus_send_large(bytes, len, can_packet_id(bytes, len)) == HAL_OK) ? SEDS_OK
+                                                                                : SEDS_IO;
+}
+
+static SedsResult uart_out(const uint8_t *bytes, size_t len) {
+#if TELEMETRY_EGRESS_QUEUES && TELEMETRY_UART_SIDE
+  if (g_uart_egress >= 0) {
+    return telemetry_egress_push(g_uart_egress, packet_priority(bytes, len), bytes, len);
+  }
+#endif
+  return (uart_link_send(SERIAL_FRAME_TYPE_ROUTER, bytes, len) == HAL_OK) ? SEDS_OK : SEDS_IO;
+}
+
+#ifdef TELEMETRY_USB_CDC
+static SedsResult usb_out(const uint8_t *bytes, size_t len) {
+#if TELEMETRY_EGRESS_QUEUES
+  if (g_usb_egress >= 0) {
+    return telemetry_egress_push(g_usb_egress, packet_priority(bytes, len), bytes, len);
+  }
+#endif
+  return (usb_cdc_link_send(SERIAL_FRAME_TYPE_ROUTER, bytes, len) == HAL_OK) ? SEDS_OK : SEDS_IO;
+}
+#endif
+
+// Own packets are noted in the duplicate cache so that a copy relayed back
+// to us by another gateway is dropped on arrival.
+static inline void dedup_note_own(const uint8_t *bytes, size_t len) {
+#if TELEMETRY_DEDUP
+  telemetry_dedup_note(bytes, len);
+#else
+  (void)bytes;
+  (void)len;
+#endif
+}
+
+static inline int route_allows(TelemetryRouteSide src, TelemetryRouteSide dst,
+                               const uint8_t *bytes, size_t len) {
+#if TELEMETRY_ROUTE_TABLE
+  return telemetry_route_check(telemetry_peek_data_type(bytes, len), src, dst);
+#else
+  (void)src;
+  (void)dst;
+  (void)bytes;
+  (void)len;
+  return 1;
+#endif
+}
+
+// Router side callbacks. With the routing table on, the router is a sink and
+// only hands us packets logged on this node; a packet the table denies is
+// consumed, not an error.
 SedsResult tx_send(const uint8_t *bytes, size_t len, void *user) {
   (void)user;
   if (!bytes || len == 0) return SEDS_BAD_ARG;
-  return (can_bus_send_large(bytes, len, 0x03) == HAL_OK) ? SEDS_OK : SEDS_IO;
+  if (!route_allows(TELEMETRY_ROUTE_LOCAL, TELEMETRY_ROUTE_CAN, bytes, len)) return SEDS_OK;
+  dedup_note_own(bytes, len);
+  timesync_capture_request(bytes, len);
+  return can_out(bytes, len);
+}
+
+SedsResult uart_tx_send(const uint8_t *bytes, size_t len, void *user) {
+  (void)user;
+  if (!bytes || len == 0) return SEDS_BAD_ARG;
+  if (!route_allows(TELEMETRY_ROUTE_LOCAL, TELEMETRY_ROUTE_UART, bytes, len)) return SEDS_OK;
+  dedup_note_own(bytes, len);
+  return uart_out(bytes, len);
 }
 
+#ifdef TELEMETRY_USB_CDC
+SedsResult usb_tx_send(const uint8_t *bytes, size_t len, void *user) {
+  (void)user;
+  if (!bytes || len == 0) return SEDS_BAD_ARG;
+  if (!route_allows(TELEMETRY_ROUTE_LOCAL, TELEMETRY_ROUTE_USB, bytes, len)) return SEDS_OK;
+  dedup_note_own(bytes, len);
+  return usb_out(bytes, len);
+}
+#endif
+
 /* ---------------- Local endpoint handler(s) ---------------- */
 SedsResult on_sd_packet(const SedsPacketView *pkt, void *user) {
   (void)user;
@@ -167,36 +524,76 @@ SedsResult on_sd_packet(const SedsPacketView *pkt, void *user) {
 /* ---------------- Time sync endpoint ----------------
  *
  * Handles:
- *  - TIME_SYNC_RESPONSE (clients): compute offset and update g_master_offset_ms
- *  - TIME_SYNC_REQUEST  (master): reply with [seq, t1, t2, t3]
+ *  - TIME_SYNC_RESPONSE (clients): compute offset and steer the clock model
+ *  - TIME_SYNC_REQUEST  (master): reply with [seq | flags, t1, t2, t3]
  *  - TIME_SYNC_ANNOUNCE (clients): learn unix_ms base
  *
+ * Times are microseconds. The seq word carries the client's CAN address
+ * above the counter: boards that boot together send equal counters and,
+ * waking on tick boundaries, often equal t1s. A request received from CAN
+ * gets t2 from the FDCAN start-of-frame stamp of its first fragment; the
+ * response says so in the top bit of seq, next to the CAN address the frame
+ * came from. If that is the client itself, it has the TX event stamp of the
+ * same instant, so t2 - t1(hw) is the offset with no path delay in it. t3
+ * is software: the response's own TX stamp would need a follow-up packet the
+ * schema does not have, and the request leg alone gives the offset.
+ *
  * NOTE:
  * This endpoint only updates *software* time. It does NOT affect ThreadX scheduling.
  */
+#define TIMESYNC_SEQ_COUNT_MASK  ((1ULL << 48) - 1ULL)
+#define TIMESYNC_SEQ_ADDR_SHIFT  48           // client's CAN address
+#define TIMESYNC_SEQ_MASK        ((1ULL << 56) - 1ULL)
+#define TIMESYNC_RESP_FROM_SHIFT 56           // CAN address the request frame came from
+#define TIMESYNC_RESP_SOF        (1ULL << 63) // t2 is that frame's start of frame
+
+#ifndef NET_TIMESYNC_CAUSAL_SLACK_US
+#define NET_TIMESYNC_CAUSAL_SLACK_US 50
+#endif
+
 static SedsResult on_timesync(const SedsPacketView *pkt, void *user) {
   (void)user;
   if (!pkt || !pkt->payload) return SEDS_ERR;
 
   // ---------- Client: handle response ----------
   if (pkt->ty == SEDS_DT_TIME_SYNC_RESPONSE && pkt->payload_len >= 32) {
+#if !TELEMETRY_TIME_MASTER
     uint64_t seq = 0, t1 = 0, t2 = 0, t3 = 0;
     memcpy(&seq, pkt->payload + 0, 8);
     memcpy(&t1,  pkt->payload + 8, 8);
     memcpy(&t2,  pkt->payload + 16, 8);
     memcpy(&t3,  pkt->payload + 24, 8);
 
-    const uint64_t t4 = tx_raw_now_ms(NULL);
-
-    int64_t offset_ms = 0;
-    uint64_t delay_ms = 0;
-    compute_offset_delay(t1, t2, t3, t4, &offset_ms, &delay_ms);
+    // t4: start of frame of the response if it came from CAN
+    const uint64_t t4 = g_ts_rx.valid ? g_ts_rx.sof_us : timebase_now_us();
 
-#if !TELEMETRY_TIME_MASTER
-    client_apply_offset_ms(offset_ms);
+    // Responses to other clients' requests, or to an old one of ours, are
+    // not ours to apply.
+    if (!g_ts_req.active || (seq & TIMESYNC_SEQ_MASK) != g_ts_req.seq || t1 != g_ts_req.t1_us) {
+      return SEDS_OK;
+    }
+    g_ts_req.active = 0;
+
+    int64_t offset_us = 0;
+    uint64_t delay_us = 0;
+    compute_offset_delay(t1, t2, t3, t4, &offset_us, &delay_us);
+    telemetry_last_delay_us_set(delay_us);
+
+    uint64_t t1_hw = 0;
+    const uint8_t from = (uint8_t)((seq >> TIMESYNC_RESP_FROM_SHIFT) & CAN_NODE_ADDR_MASK);
+    if ((seq & TIMESYNC_RESP_SOF) && from == can_node_addr() && g_ts_req.stamped &&
+        can_bus_large_tx_sof_us(&g_ts_req.tx, &t1_hw) == HAL_OK) {
+      // Causality: the stamp lies inside the exchange, and the response
+      // cannot arrive before it left.
+      const int64_t hw_offset = (int64_t)(t2 - t1_hw);
+      if (t1_hw >= t1 && t1_hw <= t4 &&
+          hw_offset >= (int64_t)(t3 - t4) - NET_TIMESYNC_CAUSAL_SLACK_US) {
+        client_apply_sample(t1_hw, hw_offset, 1);
+        return SEDS_OK;
+      }
+    }
+    client_apply_sample(t1 + (t4 - t1) / 2u, offset_us, 0);
 #endif
-    telemetry_last_delay_ms_set(delay_ms);
-    (void)seq;
     return SEDS_OK;
   }
 
@@ -207,17 +604,23 @@ static SedsResult on_timesync(const SedsPacketView *pkt, void *user) {
     memcpy(&seq, pkt->payload + 0, 8);
     memcpy(&t1,  pkt->payload + 8, 8);
 
-    // t2: time at receive (master local base)
-    const uint64_t t2 = tx_raw_now_ms(NULL);
+    // t2: time at receive (master local base), from the controller if the
+    // request came from CAN
+    uint64_t t2 = timebase_now_us();
+    seq &= TIMESYNC_SEQ_MASK;
+    if (g_ts_rx.valid) {
+      t2 = g_ts_rx.sof_us;
+      seq |= TIMESYNC_RESP_SOF | ((uint64_t)g_ts_rx.addr << TIMESYNC_RESP_FROM_SHIFT);
+    }
 
     // Optional: if you do real work here, set t3 right before sending.
-    const uint64_t t3 = tx_raw_now_ms(NULL);
+    const uint64_t t3 = timebase_now_us();
 
     const uint64_t resp[4] = {seq, t1, t2, t3};
 
     // Timestamp the packet at t3 (master local base)
     // Router will relay/broadcast it; clients match seq and compute offset.
-    return seds_router_log_ts(g_router.r, SEDS_DT_TIME_SYNC_RESPONSE, t3, resp, 4);
+    return seds_router_log_ts(g_router.r, SEDS_DT_TIME_SYNC_RESPONSE, t3 / 1000ULL, resp, 4);
 #else
     return SEDS_OK;
 #endif
@@ -234,7 +637,7 @@ static SedsResult on_timesync(const SedsPacketView *pkt, void *user) {
     memcpy(&unix_ms,  pkt->payload + 8, 8);
 
     // Half-RTT correction from last response (best-effort)
-    const uint64_t half_delay = telemetry_last_delay_ms_get() / 2ULL;
+    const uint64_t half_delay = telemetry_last_delay_us_get() / 2000ULL;
 
     // Set base so telemetry_unix_ms() matches
     const int64_t now = (int64_t)telemetry_now_ms();
@@ -258,10 +661,125 @@ static uint64_t node_now_since_ms(void *user) {
 }
 
 /* ---------------- RX helpers ---------------- */
-static void telemetry_can_rx(const uint8_t *data, size_t len, void *user) {
+// Relay a received packet to the other sides the routing table allows,
+// without decoding it.
+static void relay(TelemetryRouteSide from, const uint8_t *bytes, size_t len) {
+  if (from != TELEMETRY_ROUTE_CAN && g_can_side_id >= 0 &&
+      route_allows(from, TELEMETRY_ROUTE_CAN, bytes, len)) {
+    (void)can_out(bytes, len);
+  }
+#if TELEMETRY_UART_SIDE
+  if (from != TELEMETRY_ROUTE_UART && g_uart_side_id >= 0 &&
+      route_allows(from, TELEMETRY_ROUTE_UART, bytes, len)) {
+    (void)uart_out(bytes, len);
+  }
+#endif
+#ifdef TELEMETRY_USB_CDC
+  if (from != TELEMETRY_ROUTE_USB && g_usb_side_id >= 0 &&
+      route_allows(from, TELEMETRY_ROUTE_USB, bytes, len)) {
+    (void)usb_out(bytes, len);
+  }
+#endif
+}
+
+// HIGH packets are handed to the router at once instead of queueing behind
+// whatever bulk backlog process_all_queues has not reached yet.
+static void router_rx(int32_t side_id, const uint8_t *bytes, size_t len) {
+  const int high = packet_priority(bytes, len) == TELEMETRY_PRIO_HIGH;
+  if (side_id >= 0) {
+    if (high) {
+      (void)seds_router_receive_serialized_from_side(g_router.r, (uint32_t)side_id, bytes, len);
+    } else {
+      (void)seds_router_rx_serialized_packet_to_queue_from_side(
+          g_router.r, (uint32_t)side_id, bytes, len);
+    }
+  } else if (high) {
+    (void)seds_router_receive_serialized(g_router.r, bytes, len);
+  } else {
+    (void)seds_router_rx_serialized_packet_to_queue(g_router.r, bytes, len);
+  }
+}
+
+// Duplicate check, ingress filter and relaying. Returns 1 if the packet goes
+// on to the router.
+static int ingress_admit(TelemetryRouteSide from, const uint8_t *bytes, size_t len) {
+#if TELEMETRY_DEDUP
+  if (telemetry_dedup_check(bytes, len)) return 0;
+#endif
+#if TELEMETRY_INGRESS_FILTER
+  const TelemetryIngressVerdict v = telemetry_ingress_classify(bytes, len);
+#else
+  const TelemetryIngressVerdict v = TELEMETRY_INGRESS_ROUTE;
+#endif
+  if (v == TELEMETRY_INGRESS_DROP) return 0;
+  // Without the table the router (relay mode) forwards ROUTE packets itself.
+  if (v == TELEMETRY_INGRESS_FORWARD || TELEMETRY_ROUTE_TABLE) relay(from, bytes, len);
+  return v == TELEMETRY_INGRESS_ROUTE;
+}
+
+static void telemetry_can_rx(uint32_t id, uint8_t flags, const uint8_t *data, size_t len,
+                             void *user) {
   (void)user;
+  if (flags & CAN_BUS_FRAME_F_EXT) return;
+  if (TELEMETRY_CAN_ACCEPT_LEGACY_ID && id == TELEMETRY_CAN_LEGACY_ID) {
+    // No sender address to put in a time sync response: software stamps.
+    rx_asynchronous(data, len);
+    return;
+  }
+  const uint32_t band = CAN_NODE_ID_BAND(id);
+  if (band < TELEMETRY_CAN_BAND_TIME || band > TELEMETRY_CAN_BAND_BULK) return;
+  g_ts_rx.sof_us = can_bus_msg_sof_us();
+  g_ts_rx.addr = (uint8_t)CAN_NODE_ID_ADDR(id);
+  g_ts_rx.valid = 1;
   rx_asynchronous(data, len);
+  g_ts_rx.valid = 0;
+}
+
+#if TELEMETRY_UART_SIDE
+static void telemetry_uart_rx(uint8_t type, const uint8_t *payload, size_t len, void *user) {
+  (void)user;
+  if (type != SERIAL_FRAME_TYPE_ROUTER || len == 0) return;
+  if (!g_router.r || g_uart_side_id < 0) return;
+  if (!ingress_admit(TELEMETRY_ROUTE_UART, payload, len)) return;
+  router_rx(g_uart_side_id, payload, len);
+}
+#endif
+
+#if TELEMETRY_CAN_TAP
+// Called from can_bus_process_rx() for every frame on the bus.
+static void telemetry_can_tap(const can_bus_frame_t *frame, void *user) {
+  (void)user;
+  uint8_t buf[SERIAL_FRAME_CAN_HDR_LEN + 64];
+  uint64_t ts = frame->timestamp_us;
+  uint32_t id = frame->id;
+
+  for (unsigned i = 0; i < 8; i++) buf[i] = (uint8_t)(ts >> (8u * i));
+  for (unsigned i = 0; i < 4; i++) buf[8 + i] = (uint8_t)(id >> (8u * i));
+  buf[12] = frame->flags;
+  buf[13] = frame->len;
+  memcpy(&buf[SERIAL_FRAME_CAN_HDR_LEN], frame->data, frame->len);
+
+  const size_t n = SERIAL_FRAME_CAN_HDR_LEN + frame->len;
+#if TELEMETRY_UART_SIDE
+  (void)uart_link_send(SERIAL_FRAME_TYPE_CAN, buf, n);
+#endif
+#ifdef TELEMETRY_USB_CDC
+  (void)usb_cdc_link_send(SERIAL_FRAME_TYPE_CAN, buf, n);
+#endif
+  (void)n;
+}
+#endif
+
+#ifdef TELEMETRY_USB_CDC
+// Called from the USB CDC RX thread.
+static void telemetry_usb_rx(uint8_t type, const uint8_t *payload, size_t len, void *user) {
+  (void)user;
+  if (type != SERIAL_FRAME_TYPE_ROUTER || len == 0) return;
+  if (!g_router.r || g_usb_side_id < 0) return;
+  if (!ingress_admit(TELEMETRY_ROUTE_USB, payload, len)) return;
+  router_rx(g_usb_side_id, payload, len);
 }
+#endif
 
 void rx_asynchronous(const uint8_t *bytes, size_t len) {
 #ifndef TELEMETRY_ENABLED
@@ -274,13 +792,8 @@ void rx_asynchronous(const uint8_t *bytes, size_t len) {
   if (!g_router.r) {
     if (init_telemetry_router() != SEDS_OK) return;
   }
-
-  if (g_can_side_id >= 0) {
-    (void)seds_router_rx_serialized_packet_to_queue_from_side(
-        g_router.r, (uint32_t)g_can_side_id, bytes, len);
-  } else {
-    (void)seds_router_rx_serialized_packet_to_queue(g_router.r, bytes, len);
-  }
+  if (!ingress_admit(TELEMETRY_ROUTE_CAN, bytes, len)) return;
+  router_rx(g_can_side_id, bytes, len);
 #endif
 }
 
@@ -320,10 +833,23 @@ SedsResult telemetry_timesync_request(void) {
     if (init_telemetry_router() != SEDS_OK) return SEDS_ERR;
   }
 
-  const uint64_t t1 = tx_raw_now_ms(NULL);
-  const uint64_t req[2] = { g_timesync_seq++, t1 };
-
-  return seds_router_log_ts(g_router.r, SEDS_DT_TIME_SYNC_REQUEST, t1, req, 2);
+  const uint64_t t1 = timebase_now_us();
+  const uint64_t req[2] = {
+      (g_timesync_seq & TIMESYNC_SEQ_COUNT_MASK) |
+          ((uint64_t)can_node_addr() << TIMESYNC_SEQ_ADDR_SHIFT),
+      t1};
+  g_timesync_seq++;
+
+  g_ts_req.seq = req[0];
+  g_ts_req.t1_us = t1;
+  g_ts_req.active = 1;
+  g_ts_req.stamped = 0;
+  g_ts_req.want_stamp = 0;
+  g_ts_req.capture = 1; // tx_send picks the serialized request up
+  const SedsResult r = seds_router_log_ts(g_router.r, SEDS_DT_TIME_SYNC_REQUEST, t1 / 1000ULL,
+                                          req, 2);
+  g_ts_req.capture = 0;
+  return r;
 #endif
 #endif
 }
@@ -344,7 +870,7 @@ SedsResult telemetry_timesync_announce(uint64_t priority, uint64_t unix_ms) {
   }
 
   // Announce unix_ms from master (and priority for master election if you want it)
-  const uint64_t t = tx_raw_now_ms(NULL);
+  const uint64_t t = timebase_now_us() / 1000ULL;
   const uint64_t announce[2] = {priority, unix_ms};
 
   return seds_router_log_ts(g_router.r, SEDS_DT_TIME_SYNC_ANNOUNCE, t, announce, 2);
@@ -352,6 +878,39 @@ SedsResult telemetry_timesync_announce(uint64_t priority, uint64_t unix_ms) {
 #endif
 }
 
+/* ---------------- CAN bus health ---------------- */
+SedsResult telemetry_log_can_status(void) {
+#if !defined(TELEMETRY_ENABLED) || !defined(TELEMETRY_CAN_STATUS_DATA_TYPE)
+  return SEDS_OK;
+#else
+  can_bus_stats_t st;
+  can_bus_get_stats(&st);
+
+  uint32_t lec = 0;
+  const uint8_t nlec = st.lec_history_len < 8 ? st.lec_history_len : 8;
+  for (uint8_t i = nlec; i > 0; i--) {
+    lec = (lec << 4) | (st.lec_history[i - 1] & 0x0Fu);
+  }
+
+  const uint32_t rec[TELEMETRY_CAN_STATUS_WORDS] = {
+      [TELEMETRY_CAN_STATUS_STATE] = (uint32_t)st.state,
+      [TELEMETRY_CAN_STATUS_TEC] = st.tec,
+      [TELEMETRY_CAN_STATUS_REC] = st.rec,
+      [TELEMETRY_CAN_STATUS_WARNING_COUNT] = st.warning_count,
+      [TELEMETRY_CAN_STATUS_ERROR_PASSIVE_COUNT] = st.error_passive_count,
+      [TELEMETRY_CAN_STATUS_BUS_OFF_COUNT] = st.bus_off_count,
+      [TELEMETRY_CAN_STATUS_RECOVERY_COUNT] = st.recovery_count,
+      [TELEMETRY_CAN_STATUS_LAST_RECOVERY_MS] = st.last_recovery_ms,
+      [TELEMETRY_CAN_STATUS_MAX_RECOVERY_MS] = st.max_recovery_ms,
+      [TELEMETRY_CAN_STATUS_TX_DROPPED] = st.tx_dropped,
+      [TELEMETRY_CAN_STATUS_TX_ABORTED] = st.tx_aborted,
+      [TELEMETRY_CAN_STATUS_RX_OVERFLOW] = st.rx_overflow,
+      [TELEMETRY_CAN_STATUS_LEC_HISTORY] = lec,
+  };
+  return log_telemetry_array_async(TELEMETRY_CAN_STATUS_DATA_TYPE, rec);
+#endif
+}
+
 /* ---------------- Router init (idempotent) ---------------- */
 SedsResult init_telemetry_router(void) {
 #ifndef TELEMETRY_ENABLED
@@ -360,12 +919,39 @@ SedsResult init_telemetry_router(void) {
   if (g_router.created && g_router.r) return SEDS_OK;
 
   if (!g_can_rx_subscribed) {
-    if (can_bus_subscribe_rx(telemetry_can_rx, NULL) == HAL_OK) {
+    if (can_bus_subscribe_msgs(telemetry_can_rx, NULL) == HAL_OK) {
       g_can_rx_subscribed = 1;
     } else {
-      printf("Error: can_bus_subscribe_rx failed\r\n");
+      printf("Error: can_bus_subscribe_msgs failed\r\n");
+    }
+  }
+#if TELEMETRY_CAN_TAP
+  if (!g_can_tap_subscribed) {
+    if (can_bus_subscribe_frames(telemetry_can_tap, NULL) == HAL_OK) {
+      g_can_tap_subscribed = 1;
+    } else {
+      printf("Error: can_bus_subscribe_frames failed\r\n");
     }
   }
+#endif
+#if TELEMETRY_UART_SIDE
+  if (!g_uart_rx_subscribed) {
+    if (uart_link_subscribe_rx(telemetry_uart_rx, NULL) == HAL_OK) {
+      g_uart_rx_subscribed = 1;
+    } else {
+      printf("Error: uart_link_subscribe_rx failed\r\n");
+    }
+  }
+#endif
+#ifdef TELEMETRY_USB_CDC
+  if (!g_usb_rx_subscribed) {
+    if (usb_cdc_link_subscribe_rx(telemetry_usb_rx, NULL) == HAL_OK) {
+      g_usb_rx_subscribed = 1;
+    } else {
+      printf("Error: usb_cdc_link_subscribe_rx failed\r\n");
+    }
+  }
+#endif
 
   const SedsLocalEndpointDesc locals[] = {
       {
@@ -382,10 +968,27 @@ SedsResult init_telemetry_router(void) {
       },
   };
 
+#if TELEMETRY_ROUTE_TABLE
+  // The gateway relays received packets itself (see relay()), so the router
+  // only delivers to local endpoints and sends what this node logs.
+  static const TelemetryRouteRule routes[] = {TELEMETRY_ROUTES(TELEMETRY_ROUTE_RULE_)};
+  if (telemetry_route_load(routes, sizeof(routes) / sizeof(routes[0])) != SEDS_OK) {
+    printf("Error: invalid routing table, relaying everything\r\n");
+  }
+#endif
+
+  // Batched streams (telemetry_batches.h). Reconfiguring an existing stream
+  // is harmless, so a retried init can run this again.
+  TELEMETRY_BATCHES(TELEMETRY_BATCH_STREAM_)
+
   SedsRouter *r = seds_router_new(
+#if TELEMETRY_ROUTE_TABLE
+      Seds_RM_Sink,
+#else
       // Master should be relay too (so it forwards non-local packets),
       // unless you truly want it to sink everything.
       Seds_RM_Relay,
+#endif
       node_now_since_ms,
       NULL,
       locals,
@@ -399,6 +1002,26 @@ SedsResult init_telemetry_router(void) {
     return SEDS_ERR;
   }
 
+#if TELEMETRY_EGRESS_QUEUES
+  // Queues are registered once; init may run again after a failure.
+  if (g_can_egress < 0) {
+    g_can_egress = telemetry_egress_add("can", can_egress_send, NULL,
+                                        TELEMETRY_EGRESS_DROP_OLDEST);
+  }
+#if TELEMETRY_UART_SIDE
+  if (g_uart_egress < 0) {
+    g_uart_egress = telemetry_egress_add("uart", uart_egress_send, NULL,
+                                         TELEMETRY_EGRESS_DROP_OLDEST);
+  }
+#endif
+#ifdef TELEMETRY_USB_CDC
+  if (g_usb_egress < 0) {
+    g_usb_egress = telemetry_egress_add("usb", usb_egress_send, NULL,
+                                        TELEMETRY_EGRESS_DROP_OLDEST);
+  }
+#endif
+#endif
+
   g_can_side_id = seds_router_add_side_serialized(
       r, "can", 3, tx_send, NULL, false);
 
@@ -407,13 +1030,33 @@ SedsResult init_telemetry_router(void) {
     g_can_side_id = -1;
   }
 
+#if TELEMETRY_UART_SIDE
+  g_uart_side_id = seds_router_add_side_serialized(
+      r, "uart", 4, uart_tx_send, NULL, false);
+
+  if (g_uart_side_id < 0) {
+    printf("Error: failed to add UART side: %ld\r\n", (long)g_uart_side_id);
+    g_uart_side_id = -1;
+  }
+#endif
+
+#ifdef TELEMETRY_USB_CDC
+  g_usb_side_id = seds_router_add_side_serialized(
+      r, "usb", 3, usb_tx_send, NULL, false);
+
+  if (g_usb_side_id < 0) {
+    printf("Error: failed to add USB side: %ld\r\n", (long)g_usb_side_id);
+    g_usb_side_id = -1;
+  }
+#endif
+
   g_router.r = r;
   g_router.created = 1;
   g_router.start_time = telemetry_now_ms();
 
 #if TELEMETRY_TIME_MASTER
-  // master offset stays 0
-  g_master_offset_ms = 0;
+  // master model stays at zero offset and rate
+  model_set(0, 0, 0);
 #endif
 
   return SEDS_OK;
@@ -421,42 +1064,66 @@ SedsResult init_telemetry_router(void) {
 }
 
 /* ---------------- Logging APIs ---------------- */
+// Legacy size-based guess for the untyped entry points. Prefer the typed
+// macros in telemetry.h, which pick the exact kind at compile time.
 static inline SedsElemKind guess_kind_from_elem_size(size_t elem_size) {
   if (elem_size == 4 || elem_size == 8) return SEDS_EK_FLOAT;
   return SEDS_EK_UNSIGNED;
 }
 
-SedsResult log_telemetry_synchronous(SedsDataType data_type, const void *data,
-                                     size_t element_count, size_t element_size) {
+static inline int in_isr(void) { return __get_IPSR() != 0u; }
+
+SedsResult log_telemetry_typed(SedsDataType data_type, const void *data,
+                               size_t element_count, size_t element_size,
+                               SedsElemKind kind, uint8_t queue) {
 #ifdef TELEMETRY_ENABLED
+  if (!data || element_count == 0 || element_size == 0) return SEDS_BAD_ARG;
+
+#if TELEMETRY_CHECK_ELEMENT_COUNT
+  const size_t expected = telemetry_expected_count(data_type);
+  if (expected != 0 && expected != element_count) return SEDS_BAD_ARG;
+#endif
+
+  if (queue) {
+    if (element_count * element_size <= TELEMETRY_STAGE_MAX_BYTES) {
+      return telemetry_stage_push(data_type, data, element_count, element_size, kind);
+    }
+    if (in_isr()) return SEDS_BAD_ARG; // too large to stage, router is thread-only
+  }
+
   if (!g_router.r) {
     if (init_telemetry_router() != SEDS_OK) return SEDS_ERR;
   }
-  if (!data || element_count == 0 || element_size == 0) return SEDS_BAD_ARG;
-
-  const SedsElemKind kind = guess_kind_from_elem_size(element_size);
 
   return seds_router_log_typed_ex(g_router.r, data_type, data, element_count,
-                                 element_size, kind, NULL, 0);
+                                 element_size, kind, NULL, queue ? 1 : 0);
 #else
   (void)data_type;
+  (void)kind;
+  (void)queue;
   print_data_no_telem((void *)data, element_count * element_size);
   return SEDS_OK;
 #endif
 }
 
+SedsResult log_telemetry_synchronous(SedsDataType data_type, const void *data,
+                                     size_t element_count, size_t element_size) {
+  return log_telemetry_typed(data_type, data, element_count, element_size,
+                             guess_kind_from_elem_size(element_size), 0);
+}
+
 SedsResult log_telemetry_asynchronous(SedsDataType data_type, const void *data,
                                       size_t element_count, size_t element_size) {
+  return log_telemetry_typed(data_type, data, element_count, element_size,
+                             guess_kind_from_elem_size(element_size), 1);
+}
+
+SedsResult log_telemetry_from_isr(SedsDataType data_type, const void *data,
+                                  size_t element_count, size_t element_size) {
 #ifdef TELEMETRY_ENABLED
-  if (!g_router.r) {
-    if (init_telemetry_router() != SEDS_OK) return SEDS_ERR;
-  }
   if (!data || element_count == 0 || element_size == 0) return SEDS_BAD_ARG;
-
-  const SedsElemKind kind = guess_kind_from_elem_size(element_size);
-
-  return seds_router_log_typed_ex(g_router.r, data_type, data, element_count,
-                                 element_size, kind, NULL, 1);
+  return telemetry_stage_push(data_type, data, element_count, element_size,
+                              guess_kind_from_elem_size(element_size));
 #else
   (void)data_type;
   print_data_no_telem((void *)data, element_count * element_size);
@@ -520,8 +1187,11 @@ SedsResult process_all_queues_timeout(uint32_t timeout_ms) {
 #endif
 }
 
-/* ---------------- Error logging ---------------- */
-SedsResult log_error_asyncronous(const char *fmt, ...) {
+/* ---------------- Error logging ----------------
+ * Names are parenthesized so the TELEMETRY_DEFERRED_ERRORS macros in
+ * telemetry.h don't expand here.
+ */
+SedsResult (log_error_asyncronous)(const char *fmt, ...) {
 #ifndef TELEMETRY_ENABLED
   (void)fmt;
   return SEDS_OK;
@@ -559,7 +1229,7 @@ SedsResult log_error_asyncronous(const char *fmt, ...) {
 #endif
 }
 
-SedsResult log_error_syncronous(const char *fmt, ...) {
+SedsResult (log_error_syncronous)(const char *fmt, ...) {
 #ifndef TELEMETRY_ENABLED
   (void)fmt;
   return SEDS_OK;
@@ -597,6 +1267,48 @@ SedsResult log_error_syncronous(const char *fmt, ...) {
 #endif
 }
 
+SedsResult log_error_deferred(uint32_t fmt_id, const uint32_t *words,
+                              size_t nwords, uint8_t queue) {
+#ifndef TELEMETRY_ENABLED
+  (void)fmt_id;
+  (void)words;
+  (void)nwords;
+  (void)queue;
+  return SEDS_OK;
+#elif !defined(TELEMETRY_DEFERRED_DATA_TYPE)
+  // No data type for the records in this build (telemetry_schema.h).
+  (void)fmt_id;
+  (void)words;
+  (void)nwords;
+  (void)queue;
+  return SEDS_ERR;
+#else
+  // The macros reject this at compile time; direct callers get an error
+  // rather than a record with arguments missing.
+  if (nwords > TELEMETRY_DEFERRED_MAX_WORDS) return SEDS_BAD_ARG;
+  if (nwords && !words) return SEDS_BAD_ARG;
+
+  uint8_t buf[8 + 4 * TELEMETRY_DEFERRED_MAX_WORDS];
+  buf[0] = TELEMETRY_DEFERRED_MAGIC0;
+  buf[1] = TELEMETRY_DEFERRED_MAGIC1;
+  buf[2] = (uint8_t)nwords;
+  buf[3] = 0;
+  memcpy(&buf[4], &fmt_id, 4); // Cortex-M is little-endian
+  if (nwords) memcpy(&buf[8], words, 4 * nwords);
+  const size_t len = 8 + 4 * nwords;
+
+  if (queue && len <= TELEMETRY_STAGE_MAX_BYTES) {
+    return telemetry_stage_push(TELEMETRY_DEFERRED_DATA_TYPE, buf, len, 1, SEDS_EK_UNSIGNED);
+  }
+
+  if (!g_router.r) {
+    if (init_telemetry_router() != SEDS_OK) return SEDS_ERR;
+  }
+  return seds_router_log_typed_ex(g_router.r, TELEMETRY_DEFERRED_DATA_TYPE, buf, len, 1,
+                                 SEDS_EK_UNSIGNED, NULL, queue ? 1 : 0);
+#endif
+}
+
 SedsResult print_telemetry_error(const int32_t error_code) {
 #ifndef TELEMETRY_ENABLED
   (void)error_code;
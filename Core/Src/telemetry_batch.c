@@ -0,0 +1,290 @@
+// telemetry_batch.c
+//
+// Per-data-type batching / decimation stage. See telemetry_batch.h.
+//
+// Threading: the batch buffers and the active configuration are owned by the
+// telemetry thread (telemetry_stage_drain() -> telemetry_batch_submit(),
+// telemetry_batch_poll()). telemetry_batch_configure()/remove() may be called
+// from any thread: they only write a pending copy under a short IRQ mask and
+// set a flag; the telemetry thread flushes and applies it at the next call.
+
+#include "telemetry_batch.h"
+#include "telemetry.h"
+#include "telemetry_gorilla.h"
+
+#include "stm32g4xx_hal.h"
+
+#include <float.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef struct {
+  volatile uint8_t in_use;
+  volatile uint8_t dirty;    // pending config waiting to be applied
+  volatile uint8_t removing; // remove requested
+  SedsDataType data_type;    // key; set before in_use
+  TelemetryBatchConfig pending;
+
+  // ---- telemetry-thread owned ----
+  uint8_t active; // cfg valid
+  TelemetryBatchConfig cfg;
+  TelemetryBatchStats stats;
+  uint16_t decim_ctr;
+  uint16_t n; // samples in the current batch
+  uint8_t kind;
+  uint8_t elem_size;
+  uint8_t elem_count;
+  uint64_t first_us;
+  uint32_t ts_off[TELEMETRY_BATCH_MAX_SAMPLES]; // us, relative to first_us
+  uint8_t buf[TELEMETRY_BATCH_MAX_BYTES];
+} batch_slot_t;
+
+static batch_slot_t g_batch[TELEMETRY_BATCH_STREAMS];
+
+// Summary scratch: [min..][max..][mean..] for up to STAGE_MAX_BYTES elements.
+static float g_summary[3u * TELEMETRY_STAGE_MAX_BYTES];
+
+// Gorilla output scratch (worst case: every value and timestamp expands).
+static uint8_t g_encoded[TELEMETRY_GORILLA_HEADER_BYTES +
+                         TELEMETRY_BATCH_MAX_SAMPLES * 5u +
+                         TELEMETRY_BATCH_MAX_BYTES * 2u];
+
+static inline uint32_t batch_irq_save(void) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  return primask;
+}
+
+static inline void batch_irq_restore(uint32_t primask) { __set_PRIMASK(primask); }
+
+static batch_slot_t *batch_find(SedsDataType data_type) {
+  for (unsigned i = 0; i < TELEMETRY_BATCH_STREAMS; i++) {
+    if (g_batch[i].in_use && g_batch[i].data_type == data_type) return &g_batch[i];
+  }
+  return NULL;
+}
+
+static float elem_to_float(const uint8_t *p, uint8_t size, uint8_t kind) {
+  switch (kind) {
+  case SEDS_EK_FLOAT:
+    if (size == 4) { float v; memcpy(&v, p, 4); return v; }
+    if (size == 8) { double v; memcpy(&v, p, 8); return (float)v; }
+    break;
+  case SEDS_EK_SIGNED:
+    if (size == 1) return (float)(int8_t)p[0];
+    if (size == 2) { int16_t v; memcpy(&v, p, 2); return (float)v; }
+    if (size == 4) { int32_t v; memcpy(&v, p, 4); return (float)v; }
+    if (size == 8) { int64_t v; memcpy(&v, p, 8); return (float)v; }
+    break;
+  default:
+    if (size == 1) return (float)p[0];
+    if (size == 2) { uint16_t v; memcpy(&v, p, 2); return (float)v; }
+    if (size == 4) { uint32_t v; memcpy(&v, p, 4); return (float)v; }
+    if (size == 8) { uint64_t v; memcpy(&v, p, 8); return (float)v; }
+    break;
+  }
+  return 0.0f;
+}
+
+static uint16_t batch_capacity(const batch_slot_t *s) {
+  const size_t sample_bytes = (size_t)s->elem_size * s->elem_count;
+  size_t cap = sample_bytes ? TELEMETRY_BATCH_MAX_BYTES / sample_bytes : 0;
+  if (cap > TELEMETRY_BATCH_MAX_SAMPLES) cap = TELEMETRY_BATCH_MAX_SAMPLES;
+  if (s->cfg.max_samples && s->cfg.max_samples < cap) cap = s->cfg.max_samples;
+  return (uint16_t)cap;
+}
+
+static void batch_flush(batch_slot_t *s) {
+  if (s->n == 0) return;
+
+  const uint16_t n = s->n;
+  s->n = 0;
+
+#ifdef TELEMETRY_ENABLED
+  if (!g_router.r) return;
+
+  // Router timestamps are ms since router start; the Gorilla blob keeps the
+  // same origin in us.
+  const uint64_t start_us = g_router.start_time * 1000ULL;
+  const uint64_t t0_us = (s->first_us > start_us) ? s->first_us - start_us : 0;
+  const uint64_t ts = t0_us / 1000ULL;
+  const size_t sample_bytes = (size_t)s->elem_size * s->elem_count;
+  s->stats.raw_bytes += (uint32_t)(n * (sample_bytes + sizeof(uint64_t)));
+
+  if (s->cfg.mode == TELEMETRY_BATCH_SUMMARY) {
+    const size_t ec = s->elem_count;
+    float *mn = &g_summary[0];
+    float *mx = &g_summary[ec];
+    float *mean = &g_summary[2 * ec];
+    for (size_t e = 0; e < ec; e++) {
+      mn[e] = FLT_MAX;
+      mx[e] = -FLT_MAX;
+      mean[e] = 0.0f;
+    }
+    for (uint16_t i = 0; i < n; i++) {
+      const uint8_t *sample = &s->buf[i * sample_bytes];
+      for (size_t e = 0; e < ec; e++) {
+        const float v = elem_to_float(&sample[e * s->elem_size], s->elem_size, s->kind);
+        if (v < mn[e]) mn[e] = v;
+        if (v > mx[e]) mx[e] = v;
+        mean[e] += v;
+      }
+    }
+    for (size_t e = 0; e < ec; e++) mean[e] /= (float)n;
+
+    if (seds_router_log_typed_ex(g_router.r, s->cfg.out_type, g_summary, 3 * ec,
+                                 sizeof(float), SEDS_EK_FLOAT, &ts, 1) == SEDS_OK) {
+      s->stats.batches_out++;
+      s->stats.bytes_out += (uint32_t)(3 * ec * sizeof(float));
+    }
+    return;
+  }
+
+  if (s->cfg.codec == TELEMETRY_BATCH_CODEC_GORILLA) {
+    const size_t len = telemetry_gorilla_encode(
+        g_encoded, sizeof(g_encoded), s->buf, s->ts_off, n, s->elem_size,
+        s->elem_count, s->kind, t0_us);
+    if (len && seds_router_log_typed_ex(g_router.r, s->cfg.out_type, g_encoded,
+                                        len, 1, SEDS_EK_UNSIGNED, &ts,
+                                        1) == SEDS_OK) {
+      s->stats.batches_out++;
+      s->stats.bytes_out += (uint32_t)len;
+    }
+    return;
+  }
+
+  if (seds_router_log_typed_ex(g_router.r, s->cfg.out_type, s->buf,
+                               (size_t)n * s->elem_count, s->elem_size,
+                               (SedsElemKind)s->kind, &ts, 1) == SEDS_OK) {
+    s->stats.batches_out++;
+    s->stats.bytes_out += (uint32_t)(n * sample_bytes);
+  }
+#endif
+}
+
+// Apply pending configuration / removal. Telemetry thread only.
+static void batch_sync_config(batch_slot_t *s) {
+  if (s->removing) {
+    batch_flush(s);
+    uint32_t pm = batch_irq_save();
+    s->removing = 0;
+    s->dirty = 0;
+    s->active = 0;
+    s->in_use = 0;
+    batch_irq_restore(pm);
+    return;
+  }
+  if (s->dirty) {
+    batch_flush(s);
+    uint32_t pm = batch_irq_save();
+    s->cfg = s->pending;
+    s->dirty = 0;
+    batch_irq_restore(pm);
+    if (!s->active) memset(&s->stats, 0, sizeof(s->stats));
+    s->active = 1;
+    s->decim_ctr = 0;
+  }
+}
+
+SedsResult telemetry_batch_configure(const TelemetryBatchConfig *cfg) {
+  if (!cfg) return SEDS_BAD_ARG;
+  if (cfg->mode != TELEMETRY_BATCH_RAW && cfg->mode != TELEMETRY_BATCH_SUMMARY)
+    return SEDS_BAD_ARG;
+  if (cfg->codec == TELEMETRY_BATCH_CODEC_GORILLA && cfg->mode != TELEMETRY_BATCH_RAW)
+    return SEDS_BAD_ARG;
+  if (cfg->codec > TELEMETRY_BATCH_CODEC_GORILLA) return SEDS_BAD_ARG;
+
+  SedsResult res = SEDS_ERR;
+  uint32_t pm = batch_irq_save();
+  batch_slot_t *s = batch_find(cfg->data_type);
+  if (!s) {
+    for (unsigned i = 0; i < TELEMETRY_BATCH_STREAMS; i++) {
+      if (!g_batch[i].in_use) {
+        s = &g_batch[i];
+        s->data_type = cfg->data_type;
+        s->active = 0;
+        s->n = 0;
+        s->in_use = 1;
+        break;
+      }
+    }
+  }
+  if (s) {
+    s->pending = *cfg;
+    s->removing = 0;
+    s->dirty = 1;
+    res = SEDS_OK;
+  }
+  batch_irq_restore(pm);
+  return res;
+}
+
+SedsResult telemetry_batch_remove(SedsDataType data_type) {
+  uint32_t pm = batch_irq_save();
+  batch_slot_t *s = batch_find(data_type);
+  if (s) s->removing = 1;
+  batch_irq_restore(pm);
+  return s ? SEDS_OK : SEDS_ERR;
+}
+
+SedsResult telemetry_batch_get_stats(SedsDataType data_type,
+                                     TelemetryBatchStats *out) {
+  if (!out) return SEDS_BAD_ARG;
+  batch_slot_t *s = batch_find(data_type);
+  if (!s) return SEDS_ERR;
+  *out = s->stats;
+  return SEDS_OK;
+}
+
+int telemetry_batch_submit(SedsDataType data_type, const void *data,
+                           size_t element_count, size_t element_size,
+                           SedsElemKind kind, uint64_t ts_us) {
+  batch_slot_t *s = batch_find(data_type);
+  if (!s) return 0;
+  batch_sync_config(s);
+  if (!s->active || s->removing) return 0;
+
+  s->stats.samples_in++;
+
+  const uint16_t decim = s->cfg.decimate ? s->cfg.decimate : 1u;
+  const uint16_t ctr = s->decim_ctr;
+  s->decim_ctr = (uint16_t)((ctr + 1u) % decim);
+  if (ctr != 0) return 1; // decimated away
+
+  // A change of sample layout closes the current batch.
+  if (s->n && (s->elem_size != element_size || s->elem_count != element_count ||
+               s->kind != (uint8_t)kind)) {
+    batch_flush(s);
+  }
+  if (s->n == 0) {
+    s->elem_size = (uint8_t)element_size;
+    s->elem_count = (uint8_t)element_count;
+    s->kind = (uint8_t)kind;
+    s->first_us = ts_us;
+  }
+
+  const uint16_t cap = batch_capacity(s);
+  if (cap == 0) return 0; // sample larger than a batch; log it unbatched
+
+  const size_t sample_bytes = element_count * element_size;
+  const uint64_t off = (ts_us > s->first_us) ? ts_us - s->first_us : 0;
+  s->ts_off[s->n] = (off > UINT32_MAX) ? UINT32_MAX : (uint32_t)off;
+  memcpy(&s->buf[s->n * sample_bytes], data, sample_bytes);
+  s->n++;
+  s->stats.samples_kept++;
+
+  if (s->n >= cap) batch_flush(s);
+  return 1;
+}
+
+void telemetry_batch_poll(uint64_t now_us) {
+  for (unsigned i = 0; i < TELEMETRY_BATCH_STREAMS; i++) {
+    batch_slot_t *s = &g_batch[i];
+    if (!s->in_use) continue;
+    batch_sync_config(s);
+    if (!s->active || s->n == 0 || s->cfg.max_age_ms == 0) continue;
+    if (now_us >= s->first_us &&
+        now_us - s->first_us >= (uint64_t)s->cfg.max_age_ms * 1000ULL)
+      batch_flush(s);
+  }
+}
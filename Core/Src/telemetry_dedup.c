@@ -0,0 +1,117 @@
+// telemetry_dedup.c
+//
+// Recently-seen packet cache for relay loop suppression. See telemetry_dedup.h.
+//
+//  - Key: FNV-1a over the whole serialized packet. The bytes carry the
+//    sender, data type and timestamp, so two packets with the same key are
+//    the same packet coming round again (a relayed copy, or our own packet
+//    echoed back by another gateway).
+//  - Storage: TELEMETRY_DEDUP_ENTRIES slots in sets of DEDUP_WAYS, entry =
+//    {hash, last seen ms}, most recently seen first. A hit refreshes the
+//    time, so a packet circulating between gateways stays suppressed while it
+//    keeps arriving. A miss replaces the least recently seen way.
+//  - Used from the telemetry thread, the USB CDC RX thread and any thread
+//    that logs synchronously, so lookups run under a short IRQ-masked section.
+
+#include "telemetry_dedup.h"
+#include "timebase.h"
+
+#include "stm32g4xx_hal.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if TELEMETRY_DEDUP
+
+#define DEDUP_WAYS 4u
+#define DEDUP_SETS (TELEMETRY_DEDUP_ENTRIES / DEDUP_WAYS)
+
+#if (DEDUP_SETS == 0) || ((DEDUP_SETS & (DEDUP_SETS - 1u)) != 0)
+#error "TELEMETRY_DEDUP_ENTRIES must be 4 times a power of two"
+#endif
+
+typedef struct {
+  uint32_t hash; // 0 = empty
+  uint32_t t_ms;
+} dedup_entry_t;
+
+static dedup_entry_t g_cache[DEDUP_SETS][DEDUP_WAYS];
+static TelemetryDedupStats g_stats;
+
+static inline uint32_t dedup_lock(void) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  return primask;
+}
+
+static inline void dedup_unlock(uint32_t primask) { __set_PRIMASK(primask); }
+
+static uint32_t packet_hash(const uint8_t *bytes, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h ^= bytes[i];
+    h *= 16777619u;
+  }
+  return h ? h : 1u;
+}
+
+// Ways are kept most recently used first, so the last way is the victim.
+static void set_move_front(dedup_entry_t *set, uint32_t w, uint32_t h,
+                           uint32_t now) {
+  for (; w > 0; w--) set[w] = set[w - 1u];
+  set[0].hash = h;
+  set[0].t_ms = now;
+}
+
+// Returns 1 if the packet was seen within the window. Records it either way.
+static int dedup_lookup(uint32_t h, uint32_t now) {
+  dedup_entry_t *set = g_cache[(h ^ (h >> 16)) & (DEDUP_SETS - 1u)];
+
+  for (uint32_t w = 0; w < DEDUP_WAYS; w++) {
+    if (set[w].hash == h &&
+        (uint32_t)(now - set[w].t_ms) <= TELEMETRY_DEDUP_WINDOW_MS) {
+      set_move_front(set, w, h, now);
+      return 1;
+    }
+  }
+
+  const dedup_entry_t *last = &set[DEDUP_WAYS - 1u];
+  if (last->hash != 0 && (uint32_t)(now - last->t_ms) <= TELEMETRY_DEDUP_WINDOW_MS) {
+    g_stats.evicted++;
+  }
+  set_move_front(set, DEDUP_WAYS - 1u, h, now);
+  return 0;
+}
+
+int telemetry_dedup_check(const uint8_t *bytes, size_t len) {
+  if (!bytes || len == 0) return 0;
+  const uint32_t h = packet_hash(bytes, len);
+  const uint32_t now = (uint32_t)timebase_now_ms();
+
+  uint32_t pm = dedup_lock();
+  const int dup = dedup_lookup(h, now);
+  g_stats.checked++;
+  if (dup) g_stats.duplicates++;
+  dedup_unlock(pm);
+  return dup;
+}
+
+void telemetry_dedup_note(const uint8_t *bytes, size_t len) {
+  if (!bytes || len == 0) return;
+  const uint32_t h = packet_hash(bytes, len);
+  const uint32_t now = (uint32_t)timebase_now_ms();
+
+  uint32_t pm = dedup_lock();
+  (void)dedup_lookup(h, now);
+  g_stats.noted++;
+  dedup_unlock(pm);
+}
+
+void telemetry_dedup_get_stats(TelemetryDedupStats *out) {
+  if (!out) return;
+  uint32_t pm = dedup_lock();
+  *out = g_stats;
+  dedup_unlock(pm);
+}
+
+#endif // TELEMETRY_DEDUP
@@ -0,0 +1,305 @@
+// telemetry_egress.c
+//
+// Per-side output queues between the router and the links. See
+// telemetry_egress.h.
+//
+//  - Producers are the router's side TX callbacks. They run in whatever
+//    thread called into the router (the telemetry thread for queued traffic,
+//    the caller for synchronous logs), so a push copies the packet into the
+//    side's ring under a short IRQ-masked section.
+//  - Each side has one queue per priority class. The telemetry thread is the
+//    only consumer; it serves a side's high queue before its bulk queue.
+//  - Every queue has its own in-flight buffer: the consumer moves the oldest
+//    packet there and offers it to the link until the link takes it.
+//    Producers never touch in-flight packets, so DROP_OLDEST can evict queued
+//    packets while a retry is pending, and a high packet can go out while a
+//    long bulk packet is only partly sent (CAN sends them on different IDs).
+//  - Each ring holds variable-length records [len u16][rsvd u16][t_ms u32]
+//    [bytes], 4-byte aligned and never split; a record that does not fit at
+//    the end leaves a wrap marker and starts at offset 0.
+
+#include "telemetry_egress.h"
+#include "timebase.h"
+
+#include "stm32g4xx_hal.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if TELEMETRY_EGRESS_QUEUES
+
+#define EGRESS_HDR_LEN 8u
+#define EGRESS_WRAP 0xFFFFu
+#define EGRESS_ALIGN(n) (((n) + 3u) & ~3u)
+
+// A high packet that does not fit the small high queue goes to bulk.
+#define EGRESS_HIGH_MAX_PACKET                                                 \
+  ((TELEMETRY_EGRESS_HIGH_QUEUE_BYTES - EGRESS_HDR_LEN) <                      \
+           TELEMETRY_EGRESS_MAX_PACKET                                         \
+       ? (TELEMETRY_EGRESS_HIGH_QUEUE_BYTES - EGRESS_HDR_LEN)                  \
+       : TELEMETRY_EGRESS_MAX_PACKET)
+
+#if TELEMETRY_EGRESS_QUEUE_BYTES >= 0xFFFFu
+#error "TELEMETRY_EGRESS_QUEUE_BYTES must fit the 16-bit ring offsets"
+#endif
+#if TELEMETRY_EGRESS_HIGH_QUEUE_BYTES <= EGRESS_HDR_LEN ||                     \
+    TELEMETRY_EGRESS_HIGH_QUEUE_BYTES > TELEMETRY_EGRESS_QUEUE_BYTES
+#error "TELEMETRY_EGRESS_HIGH_QUEUE_BYTES must be in (8, TELEMETRY_EGRESS_QUEUE_BYTES]"
+#endif
+
+typedef struct {
+  // Ring (producers and consumer, under egress_lock()).
+  uint8_t *ring;
+  uint16_t size;
+  uint16_t head; // oldest record
+  uint16_t tail; // next write
+  uint16_t used; // bytes, wrap padding included
+  uint16_t packets;
+
+  // In-flight packet (consumer only).
+  uint8_t *cur;
+  uint16_t cur_len;
+  uint8_t cur_started;
+} egress_queue_t;
+
+typedef struct {
+  const char *name;
+  TelemetryEgressSendFn send;
+  void *user;
+  uint8_t policy;
+  egress_queue_t q[TELEMETRY_PRIO_CLASSES];
+  TelemetryEgressStats st;
+} egress_side_t;
+
+static egress_side_t g_sides[TELEMETRY_EGRESS_MAX_SIDES];
+static uint32_t g_side_count = 0;
+
+static uint8_t g_bulk_ring[TELEMETRY_EGRESS_MAX_SIDES][TELEMETRY_EGRESS_QUEUE_BYTES]
+    __attribute__((aligned(4)));
+static uint8_t g_bulk_cur[TELEMETRY_EGRESS_MAX_SIDES][TELEMETRY_EGRESS_MAX_PACKET];
+static uint8_t g_high_ring[TELEMETRY_EGRESS_MAX_SIDES][TELEMETRY_EGRESS_HIGH_QUEUE_BYTES]
+    __attribute__((aligned(4)));
+static uint8_t g_high_cur[TELEMETRY_EGRESS_MAX_SIDES][EGRESS_HIGH_MAX_PACKET];
+
+static inline uint32_t egress_lock(void) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  return primask;
+}
+
+static inline void egress_unlock(uint32_t primask) { __set_PRIMASK(primask); }
+
+static egress_side_t *side_get(int32_t side) {
+  if (side < 0 || (uint32_t)side >= g_side_count) return NULL;
+  return &g_sides[side];
+}
+
+int32_t telemetry_egress_add(const char *name, TelemetryEgressSendFn send,
+                             void *user, TelemetryEgressPolicy policy) {
+  if (!send || g_side_count >= TELEMETRY_EGRESS_MAX_SIDES) return -1;
+
+  const uint32_t i = g_side_count;
+  egress_side_t *s = &g_sides[i];
+  memset(s, 0, sizeof(*s));
+  s->name = name;
+  s->send = send;
+  s->user = user;
+  s->policy = (uint8_t)policy;
+  s->q[TELEMETRY_PRIO_BULK].ring = g_bulk_ring[i];
+  s->q[TELEMETRY_PRIO_BULK].size = TELEMETRY_EGRESS_QUEUE_BYTES;
+  s->q[TELEMETRY_PRIO_BULK].cur = g_bulk_cur[i];
+  s->q[TELEMETRY_PRIO_HIGH].ring = g_high_ring[i];
+  s->q[TELEMETRY_PRIO_HIGH].size = TELEMETRY_EGRESS_HIGH_QUEUE_BYTES;
+  s->q[TELEMETRY_PRIO_HIGH].cur = g_high_cur[i];
+  return (int32_t)g_side_count++;
+}
+
+// Ring helpers; caller holds egress_lock().
+
+static void ring_drop_head(egress_queue_t *q) {
+  uint16_t len;
+  memcpy(&len, &q->ring[q->head], sizeof(len));
+  if (len == EGRESS_WRAP) {
+    q->used = (uint16_t)(q->used - (q->size - q->head));
+    q->head = 0;
+    memcpy(&len, &q->ring[0], sizeof(len));
+  }
+  const uint16_t rec = (uint16_t)EGRESS_ALIGN(EGRESS_HDR_LEN + len);
+  q->used = (uint16_t)(q->used - rec);
+  q->head = (uint16_t)(q->head + rec);
+  if (q->head >= q->size) q->head = 0;
+  q->packets--;
+  if (q->packets == 0) q->head = q->tail = q->used = 0;
+}
+
+// Returns the write offset for a record of `rec` bytes, or -1 if it does not
+// fit right now.
+static int32_t ring_reserve(egress_queue_t *q, uint16_t rec) {
+  if (q->packets == 0) {
+    q->head = q->tail = q->used = 0;
+    return (rec <= q->size) ? 0 : -1;
+  }
+  if (q->tail > q->head) {
+    if ((uint32_t)q->size - q->tail >= rec) return q->tail;
+    if (q->head >= rec) {
+      const uint16_t wrap = EGRESS_WRAP;
+      memcpy(&q->ring[q->tail], &wrap, sizeof(wrap));
+      q->used = (uint16_t)(q->used + (q->size - q->tail));
+      q->tail = 0;
+      return 0;
+    }
+    return -1;
+  }
+  // tail <= head with packets queued: free space is [tail, head).
+  return ((uint32_t)(q->head - q->tail) >= rec) ? q->tail : -1;
+}
+
+SedsResult telemetry_egress_push(int32_t side, TelemetryPriority prio,
+                                 const uint8_t *bytes, size_t len) {
+  egress_side_t *s = side_get(side);
+  if (!s || !bytes || len == 0 || (uint32_t)prio >= TELEMETRY_PRIO_CLASSES) {
+    return SEDS_BAD_ARG;
+  }
+
+  if (len > TELEMETRY_EGRESS_MAX_PACKET) {
+    // Too big to queue: one direct attempt, as without the queues.
+    s->st.oversize++;
+    return (s->send(bytes, len, 1, prio, s->user) == TELEMETRY_EGRESS_SENT)
+               ? SEDS_OK
+               : SEDS_IO;
+  }
+  if (prio == TELEMETRY_PRIO_HIGH && len > EGRESS_HIGH_MAX_PACKET) {
+    prio = TELEMETRY_PRIO_BULK;
+  }
+
+  egress_queue_t *q = &s->q[prio];
+  const uint16_t rec = (uint16_t)EGRESS_ALIGN(EGRESS_HDR_LEN + len);
+  const uint32_t now = (uint32_t)timebase_now_ms();
+
+  uint32_t pm = egress_lock();
+  int32_t off = ring_reserve(q, rec);
+  while (off < 0 && s->policy == TELEMETRY_EGRESS_DROP_OLDEST &&
+         q->packets > 0) {
+    ring_drop_head(q);
+    s->st.dropped_oldest++;
+    off = ring_reserve(q, rec);
+  }
+  if (off < 0) {
+    s->st.dropped_newest++;
+    egress_unlock(pm);
+    return SEDS_IO;
+  }
+
+  const uint16_t len16 = (uint16_t)len;
+  const uint16_t rsvd = 0;
+  uint8_t *p = &q->ring[off];
+  memcpy(p, &len16, 2);
+  memcpy(p + 2, &rsvd, 2);
+  memcpy(p + 4, &now, 4);
+  memcpy(p + EGRESS_HDR_LEN, bytes, len);
+
+  q->tail = (uint16_t)(off + rec);
+  if (q->tail >= q->size) q->tail = 0;
+  q->used = (uint16_t)(q->used + rec);
+  q->packets++;
+  s->st.enqueued++;
+  if (prio == TELEMETRY_PRIO_BULK && q->used > s->st.high_water_bytes) {
+    s->st.high_water_bytes = q->used;
+  }
+  egress_unlock(pm);
+  return SEDS_OK;
+}
+
+// Moves the oldest queued packet that is still fresh into cur[]. Returns 0
+// when the queue is empty.
+static int egress_take(egress_side_t *s, egress_queue_t *q, uint32_t now) {
+  for (;;) {
+    uint32_t pm = egress_lock();
+    if (q->packets == 0) {
+      egress_unlock(pm);
+      return 0;
+    }
+
+    uint16_t len;
+    memcpy(&len, &q->ring[q->head], sizeof(len));
+    uint16_t at = q->head;
+    if (len == EGRESS_WRAP) {
+      at = 0;
+      memcpy(&len, &q->ring[0], sizeof(len));
+    }
+    uint32_t t_ms;
+    memcpy(&t_ms, &q->ring[at + 4u], sizeof(t_ms));
+
+    const int fresh = (TELEMETRY_EGRESS_MAX_AGE_MS == 0u) ||
+                      ((uint32_t)(now - t_ms) <= TELEMETRY_EGRESS_MAX_AGE_MS);
+    if (fresh) memcpy(q->cur, &q->ring[at + EGRESS_HDR_LEN], len);
+    ring_drop_head(q);
+    egress_unlock(pm);
+
+    if (fresh) {
+      q->cur_len = len;
+      q->cur_started = 0;
+      return 1;
+    }
+    s->st.expired++;
+  }
+}
+
+void telemetry_egress_poll(void) {
+  const uint32_t now = (uint32_t)timebase_now_ms();
+
+  for (uint32_t i = 0; i < g_side_count; i++) {
+    egress_side_t *s = &g_sides[i];
+    uint32_t budget = TELEMETRY_EGRESS_POLL_BUDGET;
+
+    // High class first; the budget is shared so one side's poll stays short.
+    for (int32_t c = TELEMETRY_PRIO_CLASSES - 1; c >= 0 && budget > 0; c--) {
+      egress_queue_t *q = &s->q[c];
+      int busy = 0;
+
+      for (; budget > 0; budget--) {
+        if (q->cur_len == 0 && !egress_take(s, q, now)) break;
+
+        const TelemetryEgressResult r =
+            s->send(q->cur, q->cur_len, (uint8_t)!q->cur_started,
+                    (TelemetryPriority)c, s->user);
+        q->cur_started = 1;
+        if (r == TELEMETRY_EGRESS_BUSY) {
+          s->st.busy++;
+          busy = 1;
+          break;
+        }
+        if (r == TELEMETRY_EGRESS_SENT) {
+          s->st.sent++;
+          if (c == TELEMETRY_PRIO_HIGH) s->st.sent_high++;
+        } else {
+          s->st.failed++;
+        }
+        q->cur_len = 0;
+      }
+      if (busy) break; // this link is full; the next side still gets its turn
+    }
+  }
+}
+
+void telemetry_egress_set_policy(int32_t side, TelemetryEgressPolicy policy) {
+  egress_side_t *s = side_get(side);
+  if (s) s->policy = (uint8_t)policy;
+}
+
+void telemetry_egress_get_stats(int32_t side, TelemetryEgressStats *out) {
+  if (!out) return;
+  egress_side_t *s = side_get(side);
+  if (!s) {
+    memset(out, 0, sizeof(*out));
+    return;
+  }
+  uint32_t pm = egress_lock();
+  *out = s->st;
+  out->depth_bytes = s->q[TELEMETRY_PRIO_BULK].used;
+  out->depth_packets = s->q[TELEMETRY_PRIO_BULK].packets;
+  out->depth_high_packets = s->q[TELEMETRY_PRIO_HIGH].packets;
+  egress_unlock(pm);
+}
+
+#endif // TELEMETRY_EGRESS_QUEUES
@@ -0,0 +1,310 @@
+// telemetry_gorilla.c
+//
+// Gorilla-style batch codec. See telemetry_gorilla.h for the packet layout.
+//
+// Timestamp codes (dod = delta-of-delta, two's complement):
+//   '0'                 dod == 0
+//   '10'   + 7 bits     -64 .. 63
+//   '110'  + 9 bits     -256 .. 255
+//   '1110' + 12 bits    -2048 .. 2047
+//   '1111' + 36 bits    anything else (offsets are u32)
+//
+// Value codes, per element column, width W = 32 or 64:
+//   first value         W raw bits
+//   '0'                 same as previous
+//   '10' + bits         XOR fits the previous (leading, trailing) window
+//   '11' + lead + (len - 1) + len bits
+// lead and len-1 use 5 bits for W = 32 and 6 bits for W = 64.
+//
+// Values are loaded as little-endian words; both the MCU and the hosts we
+// decode on are little-endian.
+
+#include "telemetry_gorilla.h"
+
+#include <string.h>
+
+/* ---------------- Bit stream ---------------- */
+typedef struct {
+  uint8_t *buf;
+  size_t cap;  // bytes
+  size_t bit;  // write position
+  int err;
+} bit_writer_t;
+
+typedef struct {
+  const uint8_t *buf;
+  size_t len;  // bytes
+  size_t bit;  // read position
+  int err;
+} bit_reader_t;
+
+static void bw_put(bit_writer_t *w, uint64_t v, unsigned nbits) {
+  if (w->err) return;
+  if (w->bit + nbits > w->cap * 8u) { w->err = 1; return; }
+  while (nbits) {
+    const size_t byte = w->bit >> 3;
+    const unsigned used = (unsigned)(w->bit & 7u);
+    const unsigned room = 8u - used;
+    const unsigned take = (nbits < room) ? nbits : room;
+    const uint8_t chunk = (uint8_t)((v >> (nbits - take)) & ((1u << take) - 1u));
+    if (used == 0) w->buf[byte] = 0;
+    w->buf[byte] |= (uint8_t)(chunk << (room - take));
+    w->bit += take;
+    nbits -= take;
+  }
+}
+
+static uint64_t br_get(bit_reader_t *r, unsigned nbits) {
+  if (r->err) return 0;
+  if (r->bit + nbits > r->len * 8u) { r->err = 1; return 0; }
+  uint64_t v = 0;
+  while (nbits) {
+    const size_t byte = r->bit >> 3;
+    const unsigned used = (unsigned)(r->bit & 7u);
+    const unsigned room = 8u - used;
+    const unsigned take = (nbits < room) ? nbits : room;
+    const uint8_t chunk =
+        (uint8_t)((r->buf[byte] >> (room - take)) & ((1u << take) - 1u));
+    v = (v << take) | chunk;
+    r->bit += take;
+    nbits -= take;
+  }
+  return v;
+}
+
+static inline int64_t sign_extend(uint64_t v, unsigned nbits) {
+  const uint64_t m = 1ull << (nbits - 1u);
+  return (int64_t)((v ^ m) - m);
+}
+
+static inline unsigned clz64(uint64_t v) { return v ? (unsigned)__builtin_clzll(v) : 64u; }
+static inline unsigned ctz64(uint64_t v) { return v ? (unsigned)__builtin_ctzll(v) : 64u; }
+
+/* ---------------- Timestamps ---------------- */
+static void put_dod(bit_writer_t *w, int64_t dod) {
+  if (dod == 0) {
+    bw_put(w, 0x0, 1);
+  } else if (dod >= -64 && dod <= 63) {
+    bw_put(w, 0x2, 2);
+    bw_put(w, (uint64_t)dod & 0x7Fu, 7);
+  } else if (dod >= -256 && dod <= 255) {
+    bw_put(w, 0x6, 3);
+    bw_put(w, (uint64_t)dod & 0x1FFu, 9);
+  } else if (dod >= -2048 && dod <= 2047) {
+    bw_put(w, 0xE, 4);
+    bw_put(w, (uint64_t)dod & 0xFFFu, 12);
+  } else {
+    bw_put(w, 0xF, 4);
+    bw_put(w, (uint64_t)dod & 0xFFFFFFFFFull, 36);
+  }
+}
+
+static int64_t get_dod(bit_reader_t *r) {
+  if (br_get(r, 1) == 0) return 0;
+  if (br_get(r, 1) == 0) return sign_extend(br_get(r, 7), 7);
+  if (br_get(r, 1) == 0) return sign_extend(br_get(r, 9), 9);
+  if (br_get(r, 1) == 0) return sign_extend(br_get(r, 12), 12);
+  return sign_extend(br_get(r, 36), 36);
+}
+
+/* ---------------- Values ---------------- */
+static uint64_t load_word(const uint8_t *p, unsigned bytes) {
+  if (bytes == 4) { uint32_t v; memcpy(&v, p, 4); return v; }
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+static void store_word(uint8_t *p, uint64_t v, unsigned bytes) {
+  if (bytes == 4) { const uint32_t w = (uint32_t)v; memcpy(p, &w, 4); return; }
+  memcpy(p, &v, 8);
+}
+
+static void put_values(bit_writer_t *w, const uint8_t *samples, uint16_t n,
+                       unsigned bytes, unsigned elem_count) {
+  const unsigned width = bytes * 8u;
+  const unsigned field = (width == 32u) ? 5u : 6u;
+  const unsigned lead_max = (1u << field) - 1u;
+  const size_t stride = (size_t)bytes * elem_count;
+
+  for (unsigned e = 0; e < elem_count; e++) {
+    const uint8_t *p = samples + (size_t)e * bytes;
+    uint64_t prev = load_word(p, bytes);
+    unsigned win_lead = 0, win_trail = 0;
+    int have_win = 0;
+    bw_put(w, prev, width);
+
+    for (uint16_t i = 1; i < n; i++) {
+      const uint64_t cur = load_word(p + (size_t)i * stride, bytes);
+      const uint64_t x = cur ^ prev;
+      prev = cur;
+      if (x == 0) {
+        bw_put(w, 0x0, 1);
+        continue;
+      }
+      unsigned lead = clz64(x) - (64u - width);
+      const unsigned trail = ctz64(x);
+      if (lead > lead_max) lead = lead_max;
+
+      if (have_win && lead >= win_lead && trail >= win_trail) {
+        bw_put(w, 0x2, 2);
+        bw_put(w, x >> win_trail, width - win_lead - win_trail);
+      } else {
+        const unsigned len = width - lead - trail;
+        bw_put(w, 0x3, 2);
+        bw_put(w, lead, field);
+        bw_put(w, len - 1u, field);
+        bw_put(w, x >> trail, len);
+        win_lead = lead;
+        win_trail = trail;
+        have_win = 1;
+      }
+    }
+  }
+}
+
+static void get_values(bit_reader_t *r, uint8_t *samples, uint16_t n,
+                       unsigned bytes, unsigned elem_count) {
+  const unsigned width = bytes * 8u;
+  const unsigned field = (width == 32u) ? 5u : 6u;
+  const size_t stride = (size_t)bytes * elem_count;
+
+  for (unsigned e = 0; e < elem_count && !r->err; e++) {
+    uint8_t *p = samples + (size_t)e * bytes;
+    uint64_t prev = br_get(r, width);
+    unsigned win_lead = 0, win_trail = 0;
+    store_word(p, prev, bytes);
+
+    for (uint16_t i = 1; i < n && !r->err; i++) {
+      if (br_get(r, 1) != 0) {
+        if (br_get(r, 1) != 0) {
+          win_lead = (unsigned)br_get(r, field);
+          const unsigned len = (unsigned)br_get(r, field) + 1u;
+          if (win_lead + len > width) { r->err = 1; return; }
+          win_trail = width - win_lead - len;
+        }
+        const unsigned len = width - win_lead - win_trail;
+        if (len == 0) { r->err = 1; return; }
+        prev ^= br_get(r, len) << win_trail;
+      }
+      store_word(p + (size_t)i * stride, prev, bytes);
+    }
+  }
+}
+
+/* ---------------- Header ---------------- */
+static void put_header(uint8_t *out, const TelemetryGorillaHeader *h) {
+  out[0] = TELEMETRY_GORILLA_MAGIC0;
+  out[1] = TELEMETRY_GORILLA_MAGIC1;
+  out[2] = (uint8_t)((h->kind & TELEMETRY_GORILLA_KIND_MASK) |
+                     (h->stored ? TELEMETRY_GORILLA_FLAG_STORED : 0u));
+  out[3] = h->elem_size;
+  out[4] = h->elem_count;
+  out[5] = (uint8_t)(h->n & 0xFFu);
+  out[6] = (uint8_t)(h->n >> 8);
+  for (unsigned i = 0; i < 8; i++) out[7 + i] = (uint8_t)(h->t0 >> (8u * i));
+}
+
+int telemetry_gorilla_is_packet(const uint8_t *data, size_t len) {
+  return data && len >= TELEMETRY_GORILLA_HEADER_BYTES &&
+         data[0] == TELEMETRY_GORILLA_MAGIC0 && data[1] == TELEMETRY_GORILLA_MAGIC1;
+}
+
+int telemetry_gorilla_header(const uint8_t *data, size_t len,
+                             TelemetryGorillaHeader *hdr) {
+  if (!hdr || !telemetry_gorilla_is_packet(data, len)) return -1;
+  hdr->kind = data[2] & TELEMETRY_GORILLA_KIND_MASK;
+  hdr->stored = (data[2] & TELEMETRY_GORILLA_FLAG_STORED) ? 1u : 0u;
+  hdr->elem_size = data[3];
+  hdr->elem_count = data[4];
+  hdr->n = (uint16_t)(data[5] | (data[6] << 8));
+  hdr->t0 = 0;
+  for (unsigned i = 0; i < 8; i++) hdr->t0 |= (uint64_t)data[7 + i] << (8u * i);
+  if (hdr->elem_size == 0 || hdr->elem_count == 0 || hdr->n == 0) return -1;
+  if (!hdr->stored && hdr->elem_size != 4 && hdr->elem_size != 8) return -1;
+  return 0;
+}
+
+/* ---------------- Public API ---------------- */
+size_t telemetry_gorilla_encode(uint8_t *out, size_t out_cap,
+                                const void *samples, const uint32_t *ts_off,
+                                uint16_t n, uint8_t elem_size,
+                                uint8_t elem_count, uint8_t kind, uint64_t t0) {
+  if (!out || !samples || !ts_off || n == 0 || elem_size == 0 || elem_count == 0)
+    return 0;
+  if (out_cap < TELEMETRY_GORILLA_HEADER_BYTES) return 0;
+
+  TelemetryGorillaHeader h = {
+      .kind = kind,
+      .elem_size = elem_size,
+      .elem_count = elem_count,
+      .stored = 0,
+      .n = n,
+      .t0 = t0,
+  };
+
+  bit_writer_t w = {.buf = out, .cap = out_cap, .bit = TELEMETRY_GORILLA_HEADER_BYTES * 8u};
+
+  int64_t prev_delta = 0;
+  for (uint16_t i = 1; i < n; i++) {
+    const int64_t delta = (int64_t)ts_off[i] - (int64_t)ts_off[i - 1];
+    put_dod(&w, delta - prev_delta);
+    prev_delta = delta;
+  }
+  if (w.err) return 0;
+
+  const size_t ts_end = w.bit;
+  const size_t raw_bytes = (size_t)n * elem_size * elem_count;
+  const size_t stored_bytes = ((ts_end + 7u) >> 3) + raw_bytes;
+
+  if (elem_size == 4 || elem_size == 8) {
+    put_values(&w, (const uint8_t *)samples, n, elem_size, elem_count);
+    const size_t xor_bytes = (w.bit + 7u) >> 3;
+    if (!w.err && xor_bytes <= stored_bytes) {
+      put_header(out, &h);
+      return xor_bytes;
+    }
+  }
+
+  // Verbatim values: not a 4/8-byte type, or XOR coding did not pay off.
+  if (stored_bytes > out_cap) return 0;
+  if (ts_end & 7u) out[ts_end >> 3] &= (uint8_t)(0xFFu << (8u - (ts_end & 7u)));
+  memcpy(&out[(ts_end + 7u) >> 3], samples, raw_bytes);
+  h.stored = 1;
+  put_header(out, &h);
+  return stored_bytes;
+}
+
+int telemetry_gorilla_decode(const uint8_t *data, size_t len,
+                             TelemetryGorillaHeader *hdr, void *samples_out,
+                             size_t samples_cap, uint64_t *ts_out,
+                             size_t ts_cap) {
+  TelemetryGorillaHeader h;
+  if (telemetry_gorilla_header(data, len, &h) != 0) return -1;
+  if (hdr) *hdr = h;
+
+  const size_t raw_bytes = (size_t)h.n * h.elem_size * h.elem_count;
+  if (!samples_out || samples_cap < raw_bytes) return -1;
+  if (ts_out && ts_cap < h.n) return -1;
+
+  bit_reader_t r = {.buf = data, .len = len, .bit = TELEMETRY_GORILLA_HEADER_BYTES * 8u};
+
+  int64_t off = 0, delta = 0;
+  if (ts_out) ts_out[0] = h.t0;
+  for (uint16_t i = 1; i < h.n; i++) {
+    delta += get_dod(&r);
+    off += delta;
+    if (ts_out) ts_out[i] = h.t0 + (uint64_t)off;
+  }
+  if (r.err) return -1;
+
+  if (h.stored) {
+    const size_t start = (r.bit + 7u) >> 3;
+    if (start + raw_bytes > len) return -1;
+    memcpy(samples_out, &data[start], raw_bytes);
+    return h.n;
+  }
+
+  get_values(&r, (uint8_t *)samples_out, h.n, h.elem_size, h.elem_count);
+  return r.err ? -1 : h.n;
+}
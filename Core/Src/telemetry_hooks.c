@@ -1,7 +1,11 @@
 // Core/Src/telemetry_alloc.c
 #include "tx_api.h"
+#include "telemetry.h"
+#include "telemetry_heap.h"
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 /*
  * Rust expects these functions to exist for heap allocations:
@@ -10,11 +14,38 @@
  *   void telemetryFree(void *);
  *   void seds_error_msg(const char *str, size_t len);
  *
+ * Allocation is segregated by size: the router's packets, queue nodes and
+ * small vectors come in a handful of sizes, so those are served from
+ * TX_BLOCK_POOLs (constant time, never fragments). Everything else, and any
+ * class that runs dry, goes to a TX_BYTE_POOL (first fit, can fragment).
+ * telemetryFree() finds the owner by address range.
  */
 
 #define RUST_HEAP_SIZE  (32 * 1024u)  // this will need to be tuned
+
+/* Size classes: block payload size and count. Sizes must be ascending. */
+#ifndef RUST_HEAP_CLASS_BLOCKS
+#define RUST_HEAP_CLASS_BLOCKS  { 96u, 64u, 48u, 24u, 12u }
+#endif
+#define RUST_HEAP_CLASS_SIZES   { 16u, 32u, 64u, 128u, 256u }
+
+/* ThreadX puts one pointer in front of every block. */
+#define RUST_HEAP_BLOCK_OVERHEAD (sizeof(void *))
+
+static const UINT class_size[TELEMETRY_HEAP_CLASSES]   = RUST_HEAP_CLASS_SIZES;
+static const UINT class_blocks[TELEMETRY_HEAP_CLASSES] = RUST_HEAP_CLASS_BLOCKS;
+
+typedef struct
+{
+    TX_BLOCK_POOL pool;
+    UCHAR *start;
+    UCHAR *end;
+} rust_heap_class_t;
+
+static UCHAR rust_heap[RUST_HEAP_SIZE] __attribute__((aligned(8)));
 static TX_BYTE_POOL rust_byte_pool;
-static UCHAR rust_heap[RUST_HEAP_SIZE];
+static rust_heap_class_t rust_classes[TELEMETRY_HEAP_CLASSES];
+static TelemetryHeapStats rust_stats;
 
 void rust_heap_init(void)
 {
@@ -23,46 +54,392 @@ void rust_heap_init(void)
         return;
     }
 
+    /* Carve the block pools off the front of the heap; the rest is the
+       byte pool. */
+    UCHAR *cursor = rust_heap;
+    for (UINT i = 0; i < TELEMETRY_HEAP_CLASSES; i++)
+    {
+        const ULONG bytes = (ULONG)(class_size[i] + RUST_HEAP_BLOCK_OVERHEAD) * class_blocks[i];
+        rust_heap_class_t *c = &rust_classes[i];
+
+        if (tx_block_pool_create(&c->pool, "rust_heap_class", class_size[i],
+                                 cursor, bytes) != TX_SUCCESS)
+        {
+            while (1) { }
+        }
+        c->start = cursor;
+        c->end = cursor + bytes;
+        cursor += bytes;
+
+        rust_stats.cls[i].block_size = (uint16_t)class_size[i];
+        rust_stats.cls[i].blocks = (uint16_t)class_blocks[i];
+    }
+
+    const ULONG pool_bytes = (ULONG)(&rust_heap[RUST_HEAP_SIZE] - cursor);
     UINT status = tx_byte_pool_create(&rust_byte_pool,
                                       "rust_heap",
-                                      rust_heap,
-                                      sizeof(rust_heap));
+                                      cursor,
+                                      pool_bytes);
     if (status != TX_SUCCESS) {
         /* If this fails, you're in deep trouble – spin or assert */
         while (1) { }
     }
 
+    rust_stats.pool_bytes = pool_bytes;
+    rust_stats.pool_available = rust_byte_pool.tx_byte_pool_available;
+    rust_stats.pool_min_available = rust_stats.pool_available;
+
     initialized = 1;
 }
 
-void *telemetryMalloc(size_t xSize)
+#ifdef TELEMETRY_HEAP_PROFILE
+/*
+ * Allocation profiler. Every live allocation is kept in a fixed table
+ * (pointer, requested size, time) so telemetryFree() can account for it.
+ * Lookups are linear scans with interrupts off: fine for a profiling build,
+ * not for flight.
+ *
+ * Statistics are per power-of-two request size. They are not per call
+ * site: every allocation reaches telemetryMalloc() through the Rust
+ * allocator shim, so its return address is the same for all of them, and
+ * the Rust frames above it cannot be walked without frame pointers.
+ */
+#ifndef TELEMETRY_HEAP_PROFILE_TRACK
+#define TELEMETRY_HEAP_PROFILE_TRACK 256u  // live allocations tracked
+#endif
+#define TELEMETRY_HEAP_PROFILE_BUCKETS 10u // <=8, <=16, ... <=2048, larger
+
+typedef struct
+{
+    void *ptr;
+    uint32_t size;
+    uint32_t t_ms;
+    uint8_t bucket;
+} prof_live_t;
+
+typedef struct
+{
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t live;
+    uint32_t live_bytes;
+    uint32_t peak_bytes;
+    uint32_t max_life_ms;
+    uint64_t sum_life_ms;
+} prof_bucket_t;
+
+static prof_live_t prof_live[TELEMETRY_HEAP_PROFILE_TRACK];
+static prof_bucket_t prof_buckets[TELEMETRY_HEAP_PROFILE_BUCKETS];
+static uint32_t prof_live_bytes;
+static uint32_t prof_peak_bytes;
+static uint32_t prof_live_count;
+static uint32_t prof_peak_count;
+static uint32_t prof_untracked; // live table full
+
+static UINT prof_bucket(size_t size)
+{
+    UINT b = 0;
+    size_t limit = 8u;
+    while (b < TELEMETRY_HEAP_PROFILE_BUCKETS - 1u && size > limit) {
+        limit <<= 1;
+        b++;
+    }
+    return b;
+}
+
+/* Called with interrupts disabled. */
+static void prof_on_alloc(void *ptr, size_t size, uint32_t now)
 {
+    const UINT bucket = prof_bucket(size);
+    prof_bucket_t *b = &prof_buckets[bucket];
+    b->allocs++;
+
+    prof_live_t *slot = NULL;
+    for (UINT i = 0; i < TELEMETRY_HEAP_PROFILE_TRACK; i++)
+    {
+        if (prof_live[i].ptr == NULL) {
+            slot = &prof_live[i];
+            break;
+        }
+    }
+    if (slot == NULL) {
+        prof_untracked++;
+        return;
+    }
+
+    slot->ptr = ptr;
+    slot->size = (uint32_t)size;
+    slot->t_ms = now;
+    slot->bucket = (uint8_t)bucket;
+
+    b->live++;
+    b->live_bytes += (uint32_t)size;
+    if (b->live_bytes > b->peak_bytes) {
+        b->peak_bytes = b->live_bytes;
+    }
+
+    prof_live_count++;
+    prof_live_bytes += (uint32_t)size;
+    if (prof_live_bytes > prof_peak_bytes) {
+        prof_peak_bytes = prof_live_bytes;
+    }
+    if (prof_live_count > prof_peak_count) {
+        prof_peak_count = prof_live_count;
+    }
+}
+
+/* Called with interrupts disabled. */
+static void prof_on_free(const void *ptr, uint32_t now)
+{
+    for (UINT i = 0; i < TELEMETRY_HEAP_PROFILE_TRACK; i++)
+    {
+        prof_live_t *slot = &prof_live[i];
+        if (slot->ptr != ptr) {
+            continue;
+        }
+
+        prof_bucket_t *b = &prof_buckets[slot->bucket];
+        const uint32_t life = now - slot->t_ms;
+        b->frees++;
+        b->live--;
+        b->live_bytes -= slot->size;
+        b->sum_life_ms += life;
+        if (life > b->max_life_ms) {
+            b->max_life_ms = life;
+        }
+
+        prof_live_count--;
+        prof_live_bytes -= slot->size;
+        slot->ptr = NULL;
+        return;
+    }
+}
+
+static void prof_emit(uint8_t outputs, const char *line, int n)
+{
+    if (n <= 0) {
+        return;
+    }
+    if (outputs & TELEMETRY_HEAP_PROFILE_OUT_CONSOLE) {
+        printf("%s\r\n", line);
+    }
+#ifdef TELEMETRY_ENABLED
+    if (outputs & TELEMETRY_HEAP_PROFILE_OUT_TELEMETRY) {
+        (void)log_telemetry_asynchronous(SEDS_DT_MESSAGE_DATA, line, (size_t)n, 1);
+    }
+#endif
+}
+
+void telemetry_heap_profile_dump(uint8_t outputs)
+{
+    TX_INTERRUPT_SAVE_AREA
+    char line[128];
+    int n;
+
+    TX_DISABLE
+    const uint32_t live = prof_live_bytes, peak = prof_peak_bytes;
+    const uint32_t live_n = prof_live_count, peak_n = prof_peak_count;
+    const uint32_t untracked = prof_untracked;
+    TX_RESTORE
+
+    n = snprintf(line, sizeof(line),
+                 "heap live=%luB/%lu peak=%luB/%lu untracked=%lu heap=%luB",
+                 (unsigned long)live, (unsigned long)live_n,
+                 (unsigned long)peak, (unsigned long)peak_n,
+                 (unsigned long)untracked, (unsigned long)RUST_HEAP_SIZE);
+    prof_emit(outputs, line, n);
+
+    /* One line per size bucket that saw traffic. live > 0 with an old
+       oldest= is a leak candidate. */
+    const uint32_t now = (uint32_t)telemetry_now_ms();
+    for (UINT i = 0; i < TELEMETRY_HEAP_PROFILE_BUCKETS; i++)
+    {
+        TX_DISABLE
+        const prof_bucket_t b = prof_buckets[i];
+        uint32_t oldest = 0;
+        for (UINT k = 0; k < TELEMETRY_HEAP_PROFILE_TRACK; k++)
+        {
+            if (prof_live[k].ptr != NULL && prof_live[k].bucket == i &&
+                now - prof_live[k].t_ms > oldest) {
+                oldest = now - prof_live[k].t_ms;
+            }
+        }
+        TX_RESTORE
+
+        if (b.allocs == 0) {
+            continue;
+        }
+        const int last = (i + 1u == TELEMETRY_HEAP_PROFILE_BUCKETS);
+        n = snprintf(line, sizeof(line),
+                     "heap size%s%lu n=%lu free=%lu live=%luB/%lu peak=%luB "
+                     "life_avg=%lums max=%lums oldest=%lums",
+                     last ? ">" : "<=",
+                     (unsigned long)(8u << (last ? i - 1u : i)),
+                     (unsigned long)b.allocs, (unsigned long)b.frees,
+                     (unsigned long)b.live_bytes, (unsigned long)b.live,
+                     (unsigned long)b.peak_bytes,
+                     (unsigned long)(b.frees ? b.sum_life_ms / b.frees : 0u),
+                     (unsigned long)b.max_life_ms, (unsigned long)oldest);
+        if ((size_t)n >= sizeof(line)) {
+            n = (int)sizeof(line) - 1;
+        }
+        prof_emit(outputs, line, n);
+    }
+}
+
+void telemetry_heap_profile_reset_peak(void)
+{
+    TX_INTERRUPT_SAVE_AREA
+
+    TX_DISABLE
+    prof_peak_bytes = prof_live_bytes;
+    prof_peak_count = prof_live_count;
+    for (UINT i = 0; i < TELEMETRY_HEAP_PROFILE_BUCKETS; i++) {
+        prof_buckets[i].peak_bytes = prof_buckets[i].live_bytes;
+    }
+    TX_RESTORE
+}
+#endif /* TELEMETRY_HEAP_PROFILE */
+
+static int rust_heap_class_of_size(size_t size)
+{
+    for (UINT i = 0; i < TELEMETRY_HEAP_CLASSES; i++)
+    {
+        if (size <= class_size[i]) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static int rust_heap_class_of_ptr(const void *p)
+{
+    const UCHAR *b = (const UCHAR *)p;
+    for (UINT i = 0; i < TELEMETRY_HEAP_CLASSES; i++)
+    {
+        if (b >= rust_classes[i].start && b < rust_classes[i].end) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static void *rust_heap_alloc(size_t xSize)
+{
+    TX_INTERRUPT_SAVE_AREA
     void *ptr = NULL;
 
-    /* Make sure pool is ready – safe to call multiple times */
+    /* Make sure pools are ready – safe to call multiple times */
     rust_heap_init();
 
-    /* TX_NO_WAIT: allocator is fast and non-blocking */
+    /* TX_NO_WAIT everywhere: allocator is fast and non-blocking */
+    const int cls = rust_heap_class_of_size(xSize);
+    if (cls >= 0)
+    {
+        if (tx_block_allocate(&rust_classes[cls].pool, &ptr, TX_NO_WAIT) == TX_SUCCESS)
+        {
+            TelemetryHeapClassStats *st = &rust_stats.cls[cls];
+            TX_DISABLE
+            st->allocs++;
+            st->in_use++;
+            if (st->in_use > st->high_water) {
+                st->high_water = st->in_use;
+            }
+            TX_RESTORE
+            return ptr;
+        }
+
+        TX_DISABLE
+        rust_stats.cls[cls].spills++;
+        TX_RESTORE
+    }
+
     UINT status = tx_byte_allocate(&rust_byte_pool, &ptr, xSize, TX_NO_WAIT);
+
+    TX_DISABLE
     if (status != TX_SUCCESS) {
-        return NULL;
+        rust_stats.failures++;
+        ptr = NULL;
+    } else {
+        rust_stats.pool_allocs++;
+        const ULONG avail = rust_byte_pool.tx_byte_pool_available;
+        if (avail < rust_stats.pool_min_available) {
+            rust_stats.pool_min_available = avail;
+        }
+    }
+    TX_RESTORE
+
+    return ptr;
+}
+
+void *telemetryMalloc(size_t xSize)
+{
+#ifdef TELEMETRY_HEAP_PROFILE
+    TX_INTERRUPT_SAVE_AREA
+    void *ptr = rust_heap_alloc(xSize);
+    if (ptr != NULL) {
+        const uint32_t now = (uint32_t)telemetry_now_ms();
+        TX_DISABLE
+        prof_on_alloc(ptr, xSize, now);
+        TX_RESTORE
     }
     return ptr;
+#else
+    return rust_heap_alloc(xSize);
+#endif
 }
 
 void telemetryFree(void *pv)
 {
+    TX_INTERRUPT_SAVE_AREA
+
     if (pv == NULL) {
         return;
     }
 
+#ifdef TELEMETRY_HEAP_PROFILE
+    const uint32_t now = (uint32_t)telemetry_now_ms();
+    TX_DISABLE
+    prof_on_free(pv, now);
+    TX_RESTORE
+#endif
+
+    const int cls = rust_heap_class_of_ptr(pv);
+    if (cls >= 0)
+    {
+        if (tx_block_release(pv) == TX_SUCCESS)
+        {
+            TX_DISABLE
+            rust_stats.cls[cls].in_use--;
+            TX_RESTORE
+        }
+        return;
+    }
+
     /* If the pool wasn’t created yet, something is badly wrong,
        but tx_byte_release() will fail and we just ignore it. */
     (void)tx_byte_release(pv);
 }
 
+void telemetry_heap_get_stats(TelemetryHeapStats *out)
+{
+    TX_INTERRUPT_SAVE_AREA
+
+    if (out == NULL) {
+        return;
+    }
+
+    rust_heap_init();
+
+    TX_DISABLE
+    *out = rust_stats;
+    out->pool_available = rust_byte_pool.tx_byte_pool_available;
+    out->pool_fragments = rust_byte_pool.tx_byte_pool_fragments;
+    TX_RESTORE
+}
+
 void seds_error_msg(const char *str, size_t len)
 {
     (void)len;
     printf("%s\n", str);
-}
\ No newline at end of file
+}
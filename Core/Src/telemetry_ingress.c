@@ -0,0 +1,86 @@
+// telemetry_ingress.c
+//
+// Header-peek classifier run on every serialized packet a link hands us,
+// before it is queued into the router. See telemetry_ingress.h.
+//
+//  - The data type is read straight from the serialized bytes: a ULEB128
+//    varint at TELEMETRY_INGRESS_TYPE_OFFSET (a single byte for type ids
+//    below 128, telemetry_peek.c). Nothing else of the packet is parsed. The
+//    routing table (telemetry_route.c) uses the same peek.
+//  - Two bitmaps indexed by type hold the verdict: the forward bit sends the
+//    bytes to the other sides untouched, the drop bit discards them, neither
+//    hands them to the router as before.
+//  - Called from the telemetry thread (CAN, UART) and from the USB CDC RX
+//    thread, so counters are atomic; the bitmaps are only written at setup
+//    and word-sized, so readers see either the old or the new verdict.
+
+#include "telemetry_ingress.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#if TELEMETRY_INGRESS_FILTER
+
+#define INGRESS_WORDS ((TELEMETRY_INGRESS_MAX_TYPES + 31u) / 32u)
+
+static uint32_t g_fwd_bits[INGRESS_WORDS];
+static uint32_t g_drop_bits[INGRESS_WORDS];
+
+static _Atomic uint32_t g_count[TELEMETRY_INGRESS_VERDICTS];
+static _Atomic uint32_t g_runt = 0;
+static _Atomic uint32_t g_unknown = 0;
+
+void telemetry_ingress_set(SedsDataType data_type,
+                           TelemetryIngressVerdict verdict) {
+  const uint32_t t = (uint32_t)data_type;
+  if (t >= TELEMETRY_INGRESS_MAX_TYPES) return;
+
+  const uint32_t bit = 1u << (t & 31u);
+  uint32_t *fwd = &g_fwd_bits[t >> 5];
+  uint32_t *drop = &g_drop_bits[t >> 5];
+  *fwd = (verdict == TELEMETRY_INGRESS_FORWARD) ? (*fwd | bit) : (*fwd & ~bit);
+  *drop = (verdict == TELEMETRY_INGRESS_DROP) ? (*drop | bit) : (*drop & ~bit);
+}
+
+static TelemetryIngressVerdict classify(const uint8_t *bytes, size_t len) {
+  if (len < TELEMETRY_INGRESS_MIN_LEN) {
+    atomic_fetch_add_explicit(&g_runt, 1u, memory_order_relaxed);
+    return TELEMETRY_INGRESS_DROP;
+  }
+  const int32_t t = telemetry_peek_data_type(bytes, len);
+  if (t < 0) {
+    atomic_fetch_add_explicit(&g_runt, 1u, memory_order_relaxed);
+    return TELEMETRY_INGRESS_DROP;
+  }
+  if ((uint32_t)t >= TELEMETRY_INGRESS_MAX_TYPES) {
+    atomic_fetch_add_explicit(&g_unknown, 1u, memory_order_relaxed);
+    return TELEMETRY_INGRESS_UNKNOWN_VERDICT;
+  }
+
+  const uint32_t bit = 1u << ((uint32_t)t & 31u);
+  if (g_drop_bits[(uint32_t)t >> 5] & bit) return TELEMETRY_INGRESS_DROP;
+  if (g_fwd_bits[(uint32_t)t >> 5] & bit) return TELEMETRY_INGRESS_FORWARD;
+  return TELEMETRY_INGRESS_ROUTE;
+}
+
+TelemetryIngressVerdict telemetry_ingress_classify(const uint8_t *bytes,
+                                                   size_t len) {
+  const TelemetryIngressVerdict v = classify(bytes, len);
+  atomic_fetch_add_explicit(&g_count[v], 1u, memory_order_relaxed);
+  return v;
+}
+
+void telemetry_ingress_get_stats(TelemetryIngressStats *out) {
+  if (!out) return;
+  out->routed = atomic_load_explicit(&g_count[TELEMETRY_INGRESS_ROUTE],
+                                     memory_order_relaxed);
+  out->forwarded = atomic_load_explicit(&g_count[TELEMETRY_INGRESS_FORWARD],
+                                        memory_order_relaxed);
+  out->dropped = atomic_load_explicit(&g_count[TELEMETRY_INGRESS_DROP],
+                                      memory_order_relaxed);
+  out->runt = atomic_load_explicit(&g_runt, memory_order_relaxed);
+  out->unknown = atomic_load_explicit(&g_unknown, memory_order_relaxed);
+}
+
+#endif // TELEMETRY_INGRESS_FILTER
@@ -0,0 +1,15 @@
+// telemetry_peek.c
+//
+// Data type peek on serialized router packets. See telemetry_peek.h.
+
+#include "telemetry_peek.h"
+
+int32_t telemetry_peek_data_type(const uint8_t *bytes, size_t len) {
+  uint32_t v = 0;
+  for (size_t i = TELEMETRY_INGRESS_TYPE_OFFSET, shift = 0;
+       i < len && shift < 32u; i++, shift += 7u) {
+    v |= (uint32_t)(bytes[i] & 0x7Fu) << shift;
+    if ((bytes[i] & 0x80u) == 0) return (v > INT32_MAX) ? -1 : (int32_t)v;
+  }
+  return -1;
+}
@@ -0,0 +1,204 @@
+// telemetry_route.c
+//
+// Compiled routing table. See telemetry_route.h.
+//
+//  - A rule set compiles into one byte per (type, src, dst) cell:
+//      0 deny, 1 allow, 2 + k rate limited by limiter k.
+//    Types at or above TELEMETRY_ROUTE_MAX_TYPES share the last row. The
+//    per-packet check is one index computation and one byte load.
+//  - Two tables: load() compiles into the inactive one and publishes it with
+//    a release store. check() reads the active pointer, the cell and the
+//    limiter inside one short IRQ-masked section, so on this single core no
+//    reader can still be holding the inactive table when the next load
+//    rewrites it, however closely two loads follow each other. Loads are
+//    expected from one thread at a time.
+//  - Limiters are token buckets in milli-tokens, refilled from
+//    timebase_now_ms(). They belong to the table, so a reload starts every
+//    bucket full. CAN/UART relaying runs in the telemetry thread and USB in
+//    its RX thread; the same masked section serializes bucket updates.
+
+#include "telemetry_route.h"
+#include "timebase.h"
+
+#include "stm32g4xx_hal.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#if TELEMETRY_ROUTE_TABLE
+
+#define ROUTE_ROWS (TELEMETRY_ROUTE_MAX_TYPES + 1u)
+#define ROUTE_DSTS (TELEMETRY_ROUTE_SIDES - 1u) // LOCAL is never a destination
+#define ROUTE_CELL_DENY 0u
+#define ROUTE_CELL_ALLOW 1u
+#define ROUTE_CELL_LIMITER 2u
+
+#if TELEMETRY_ROUTE_MAX_LIMITERS > 253u
+#error "TELEMETRY_ROUTE_MAX_LIMITERS must fit a cell byte"
+#endif
+
+typedef struct {
+  uint32_t rate_per_s;
+  uint32_t cap_milli;
+  uint32_t tokens_milli;
+  uint32_t last_ms;
+} route_limiter_t;
+
+typedef struct {
+  uint8_t cell[ROUTE_ROWS][TELEMETRY_ROUTE_SIDES][ROUTE_DSTS];
+  route_limiter_t lim[TELEMETRY_ROUTE_MAX_LIMITERS];
+} route_table_t;
+
+static route_table_t g_tables[2];
+static _Atomic(route_table_t *) g_active = NULL;
+
+static _Atomic uint32_t g_allowed = 0;
+static _Atomic uint32_t g_denied = 0;
+static _Atomic uint32_t g_rate_limited = 0;
+static _Atomic uint32_t g_loads = 0;
+
+static inline uint32_t route_lock(void) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  return primask;
+}
+
+static inline void route_unlock(uint32_t primask) { __set_PRIMASK(primask); }
+
+SedsResult telemetry_route_load(const TelemetryRouteRule *rules, size_t count) {
+  if (!rules && count) return SEDS_BAD_ARG;
+
+  route_table_t *cur = atomic_load_explicit(&g_active, memory_order_acquire);
+  route_table_t *t = (cur == &g_tables[0]) ? &g_tables[1] : &g_tables[0];
+  memset(t->cell, ROUTE_CELL_ALLOW, sizeof(t->cell));
+  memset(t->lim, 0, sizeof(t->lim));
+
+  const uint32_t now = (uint32_t)timebase_now_ms();
+  uint32_t limiters = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    const TelemetryRouteRule *r = &rules[i];
+    const int any_src = (r->src == TELEMETRY_ROUTE_ANY_SIDE);
+    const int any_dst = (r->dst == TELEMETRY_ROUTE_ANY_SIDE);
+    if ((!any_src && r->src >= TELEMETRY_ROUTE_SIDES) ||
+        (!any_dst &&
+         (r->dst == TELEMETRY_ROUTE_LOCAL || r->dst >= TELEMETRY_ROUTE_SIDES))) {
+      return SEDS_BAD_ARG;
+    }
+
+    uint8_t cell;
+    switch (r->action) {
+    case TELEMETRY_ROUTE_DENY:
+      cell = ROUTE_CELL_DENY;
+      break;
+    case TELEMETRY_ROUTE_ALLOW:
+      cell = ROUTE_CELL_ALLOW;
+      break;
+    case TELEMETRY_ROUTE_RATE: {
+      if (limiters >= TELEMETRY_ROUTE_MAX_LIMITERS) return SEDS_BAD_ARG;
+      route_limiter_t *l = &t->lim[limiters];
+      const uint32_t burst = r->burst ? r->burst : 1u;
+      l->rate_per_s = r->rate_per_s;
+      l->cap_milli = burst * 1000u;
+      l->tokens_milli = l->cap_milli;
+      l->last_ms = now;
+      cell = (uint8_t)(ROUTE_CELL_LIMITER + limiters++);
+      break;
+    }
+    default:
+      return SEDS_BAD_ARG;
+    }
+
+    uint32_t row0 = 0, row1 = ROUTE_ROWS;
+    if (r->data_type != TELEMETRY_ROUTE_ANY_TYPE) {
+      row0 = (r->data_type < TELEMETRY_ROUTE_MAX_TYPES) ? r->data_type
+                                                        : TELEMETRY_ROUTE_MAX_TYPES;
+      row1 = row0 + 1u;
+      // Types past the table share a row; only ANY_TYPE rules may set it.
+      if (row0 == TELEMETRY_ROUTE_MAX_TYPES) continue;
+    }
+    const uint32_t s0 = any_src ? 0u : r->src;
+    const uint32_t s1 = any_src ? TELEMETRY_ROUTE_SIDES : r->src + 1u;
+    const uint32_t d0 = any_dst ? 0u : r->dst - 1u;
+    const uint32_t d1 = any_dst ? ROUTE_DSTS : r->dst;
+
+    for (uint32_t row = row0; row < row1; row++)
+      for (uint32_t s = s0; s < s1; s++)
+        for (uint32_t d = d0; d < d1; d++) t->cell[row][s][d] = cell;
+  }
+
+  // No reflection: a side never gets its own packets back, whatever the
+  // rules say.
+  for (uint32_t row = 0; row < ROUTE_ROWS; row++)
+    for (uint32_t side = TELEMETRY_ROUTE_CAN; side < TELEMETRY_ROUTE_SIDES; side++)
+      t->cell[row][side][side - 1u] = ROUTE_CELL_DENY;
+
+  uint32_t pm = route_lock();
+  atomic_store_explicit(&g_active, t, memory_order_release);
+  route_unlock(pm);
+  atomic_fetch_add_explicit(&g_loads, 1u, memory_order_relaxed);
+  return SEDS_OK;
+}
+
+// Caller holds route_lock().
+static int limiter_take(route_limiter_t *l) {
+  const uint32_t now = (uint32_t)timebase_now_ms();
+  const uint32_t dt = now - l->last_ms;
+  l->last_ms = now;
+
+  // rate_per_s tokens per 1000 ms is rate_per_s milli-tokens per ms.
+  uint64_t tokens = (uint64_t)l->tokens_milli + (uint64_t)dt * l->rate_per_s;
+  if (tokens > l->cap_milli) tokens = l->cap_milli;
+
+  int ok = 0;
+  if (tokens >= 1000u) {
+    tokens -= 1000u;
+    ok = 1;
+  }
+  l->tokens_milli = (uint32_t)tokens;
+  return ok;
+}
+
+int telemetry_route_check(int32_t data_type, TelemetryRouteSide src,
+                          TelemetryRouteSide dst) {
+  if ((uint32_t)src >= TELEMETRY_ROUTE_SIDES || dst == TELEMETRY_ROUTE_LOCAL ||
+      (uint32_t)dst >= TELEMETRY_ROUTE_SIDES || src == dst) {
+    return 0;
+  }
+  const uint32_t row = (data_type >= 0 && (uint32_t)data_type < TELEMETRY_ROUTE_MAX_TYPES)
+                           ? (uint32_t)data_type
+                           : TELEMETRY_ROUTE_MAX_TYPES;
+
+  // The table is only touched inside the mask; see the top of the file.
+  uint32_t pm = route_lock();
+  route_table_t *t = atomic_load_explicit(&g_active, memory_order_acquire);
+  if (!t) {
+    route_unlock(pm);
+    return 1; // nothing loaded: relay everything, as the router did
+  }
+  const uint8_t cell = t->cell[row][src][dst - 1u];
+  const int ok = (cell == ROUTE_CELL_ALLOW) ||
+                 (cell != ROUTE_CELL_DENY &&
+                  limiter_take(&t->lim[cell - ROUTE_CELL_LIMITER]));
+  route_unlock(pm);
+
+  if (ok) {
+    atomic_fetch_add_explicit(&g_allowed, 1u, memory_order_relaxed);
+  } else if (cell == ROUTE_CELL_DENY) {
+    atomic_fetch_add_explicit(&g_denied, 1u, memory_order_relaxed);
+  } else {
+    atomic_fetch_add_explicit(&g_rate_limited, 1u, memory_order_relaxed);
+  }
+  return ok;
+}
+
+void telemetry_route_get_stats(TelemetryRouteStats *out) {
+  if (!out) return;
+  out->allowed = atomic_load_explicit(&g_allowed, memory_order_relaxed);
+  out->denied = atomic_load_explicit(&g_denied, memory_order_relaxed);
+  out->rate_limited = atomic_load_explicit(&g_rate_limited, memory_order_relaxed);
+  out->loads = atomic_load_explicit(&g_loads, memory_order_relaxed);
+}
+
+#endif // TELEMETRY_ROUTE_TABLE
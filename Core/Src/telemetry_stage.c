@@ -0,0 +1,181 @@
+// telemetry_stage.c
+//
+// Multi-producer / single-consumer staging ring in front of the router. See
+// telemetry_stage.h.
+//
+//  - Producers (any thread, any ISR) claim a slot with one CAS on the enqueue
+//    index, copy a compact record in, and publish it with a release store of
+//    the slot sequence number. No mutex, no router call, no Rust heap.
+//  - The telemetry thread is the only consumer. telemetry_stage_drain() pops
+//    published records in order, offers them to the batching stage
+//    (telemetry_batch.c) and hands the rest to seds_router_log_typed_ex().
+//  - Records are stamped with the raw timebase (timebase.h), which is
+//    lock-free from any context; the consumer converts the stamp to
+//    synchronized time when it drains the record.
+//  - The ring is bounded. When it is full the new record is dropped and
+//    counted (newest-drop: the records already queued are older and still
+//    valid, and a producer in an ISR cannot wait).
+//
+// Per-slot sequence numbers follow the classic bounded-queue scheme:
+//   seq == pos            -> slot free for the producer that claims `pos`
+//   seq == pos + 1        -> slot published, consumer may read it
+//   seq == pos + DEPTH    -> consumer released it for the next lap
+//
+// A producer that is preempted between claim and publish stalls the consumer
+// at that slot until it resumes; records behind it are not lost.
+
+#include "telemetry_stage.h"
+#include "telemetry.h"
+#include "telemetry_batch.h"
+#include "timebase.h"
+
+#include "stm32g4xx_hal.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef TELEMETRY_STAGE_DEPTH
+#define TELEMETRY_STAGE_DEPTH 32u // must be a power of two
+#endif
+
+#if (TELEMETRY_STAGE_DEPTH & (TELEMETRY_STAGE_DEPTH - 1u)) != 0
+#error "TELEMETRY_STAGE_DEPTH must be a power of two"
+#endif
+
+#define STAGE_MASK (TELEMETRY_STAGE_DEPTH - 1u)
+
+typedef struct {
+  _Atomic uint32_t seq;
+  uint16_t data_type;
+  uint8_t kind;
+  uint8_t elem_size;
+  uint8_t count;
+  uint8_t len;
+  uint64_t local_us; // timebase_now_us() at capture
+  uint8_t data[TELEMETRY_STAGE_MAX_BYTES];
+} stage_slot_t;
+
+static stage_slot_t g_stage[TELEMETRY_STAGE_DEPTH];
+static _Atomic uint32_t g_enq = 0;
+static uint32_t g_deq = 0; // consumer-owned
+static _Atomic uint8_t g_stage_ready = 0;
+
+static _Atomic uint32_t g_pushed = 0;
+static _Atomic uint32_t g_dropped = 0;
+static uint32_t g_high_water = 0; // consumer-owned
+
+static void stage_init_once(void) {
+  if (atomic_load_explicit(&g_stage_ready, memory_order_acquire))
+    return;
+
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if (!atomic_load_explicit(&g_stage_ready, memory_order_relaxed)) {
+    for (uint32_t i = 0; i < TELEMETRY_STAGE_DEPTH; i++) {
+      atomic_store_explicit(&g_stage[i].seq, i, memory_order_relaxed);
+    }
+    atomic_store_explicit(&g_stage_ready, 1, memory_order_release);
+  }
+  __set_PRIMASK(primask);
+}
+
+SedsResult telemetry_stage_push(SedsDataType data_type, const void *data,
+                                size_t element_count, size_t element_size,
+                                SedsElemKind kind) {
+  if (!data || element_count == 0 || element_size == 0) return SEDS_BAD_ARG;
+  if (element_count > 0xFFu || element_size > 0xFFu) return SEDS_BAD_ARG;
+
+  const size_t len = element_count * element_size;
+  if (len > TELEMETRY_STAGE_MAX_BYTES) return SEDS_BAD_ARG;
+
+  stage_init_once();
+
+  const uint64_t ts = timebase_now_us();
+
+  uint32_t pos = atomic_load_explicit(&g_enq, memory_order_relaxed);
+  stage_slot_t *slot;
+  for (;;) {
+    slot = &g_stage[pos & STAGE_MASK];
+    const uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    const int32_t dif = (int32_t)(seq - pos);
+    if (dif == 0) {
+      if (atomic_compare_exchange_weak_explicit(&g_enq, &pos, pos + 1u,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        break;
+      }
+      // CAS failure reloaded `pos`; retry
+    } else if (dif < 0) {
+      atomic_fetch_add_explicit(&g_dropped, 1u, memory_order_relaxed);
+      return SEDS_ERR; // full
+    } else {
+      pos = atomic_load_explicit(&g_enq, memory_order_relaxed);
+    }
+  }
+
+  slot->data_type = (uint16_t)data_type;
+  slot->kind = (uint8_t)kind;
+  slot->elem_size = (uint8_t)element_size;
+  slot->count = (uint8_t)element_count;
+  slot->len = (uint8_t)len;
+  slot->local_us = ts;
+  memcpy(slot->data, data, len);
+
+  atomic_store_explicit(&slot->seq, pos + 1u, memory_order_release);
+  atomic_fetch_add_explicit(&g_pushed, 1u, memory_order_relaxed);
+  return SEDS_OK;
+}
+
+size_t telemetry_stage_drain(size_t max_records) {
+#ifndef TELEMETRY_ENABLED
+  (void)max_records;
+  return 0;
+#else
+  if (!g_router.r) return 0;
+  stage_init_once();
+
+  // Depth seen by the consumer (cheap approximation of the high-water mark).
+  const uint32_t backlog =
+      atomic_load_explicit(&g_enq, memory_order_relaxed) - g_deq;
+  if (backlog > g_high_water) g_high_water = backlog;
+
+  size_t n = 0;
+  while (max_records == 0 || n < max_records) {
+    stage_slot_t *slot = &g_stage[g_deq & STAGE_MASK];
+    const uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if ((int32_t)(seq - (g_deq + 1u)) < 0) break; // empty or not yet published
+
+    const uint64_t ts_us = telemetry_time_us_at(slot->local_us);
+
+    // Batched streams are accumulated instead of logged one by one, and keep
+    // the full microsecond stamp.
+    if (!telemetry_batch_submit((SedsDataType)slot->data_type, slot->data,
+                                slot->count, slot->elem_size,
+                                (SedsElemKind)slot->kind, ts_us)) {
+      const uint64_t ts_ms = ts_us / 1000ULL;
+      // Router timestamps are relative to router start (see node_now_since_ms).
+      const uint64_t ts = (ts_ms > g_router.start_time)
+                              ? ts_ms - g_router.start_time
+                              : 0;
+      (void)seds_router_log_typed_ex(g_router.r, (SedsDataType)slot->data_type,
+                                     slot->data, slot->count, slot->elem_size,
+                                     (SedsElemKind)slot->kind, &ts, 1);
+    }
+
+    atomic_store_explicit(&slot->seq, g_deq + TELEMETRY_STAGE_DEPTH,
+                          memory_order_release);
+    g_deq++;
+    n++;
+  }
+  return n;
+#endif
+}
+
+void telemetry_stage_get_stats(TelemetryStageStats *out) {
+  if (!out) return;
+  out->pushed = atomic_load_explicit(&g_pushed, memory_order_relaxed);
+  out->dropped = atomic_load_explicit(&g_dropped, memory_order_relaxed);
+  out->high_water = g_high_water;
+  out->depth = TELEMETRY_STAGE_DEPTH;
+}
@@ -2,7 +2,11 @@
 #include "GB-Threads.h"
 #include "tx_api.h"
 #include "telemetry.h"
+#include "telemetry_batch.h"
 #include "can_bus.h"
+#include "can_node.h"
+#include "timebase.h"
+#include "uart_link.h"
 
 TX_THREAD telemetry_thread;
 #define TELEMETRY_THREAD_STACK_SIZE 1024u
@@ -11,19 +15,19 @@ ULONG telemetry_thread_stack[TELEMETRY_THREAD_STACK_SIZE / sizeof(ULONG)];
 // How often this node requests a resync from the master:
 #define TIMESYNC_REQUEST_PERIOD_MS 2000u   // e.g. every 2 seconds
 
-#ifndef TX_TIMER_TICKS_PER_SECOND
-#error "TX_TIMER_TICKS_PER_SECOND must be defined by ThreadX."
-#endif
+// Max staged records moved into the router per loop iteration.
+#define TELEMETRY_STAGE_DRAIN_BATCH 16u
 
-static uint64_t tx_now_ms(void) {
-    ULONG ticks = tx_time_get();
-    return ((uint64_t)(uint32_t)ticks * 1000ULL) / (uint64_t)TX_TIMER_TICKS_PER_SECOND;
-}
+// CAN health record period; state changes are reported immediately.
+#define CAN_STATUS_PERIOD_MS 1000u
 
 void telemetry_thread_entry(ULONG initial_input)
 {
     (void)initial_input;
 
+    // Claim our CAN address; telemetry on CAN waits for it to settle.
+    can_node_init();
+
     // Ensure router exists early (so we can send requests immediately)
     (void)init_telemetry_router();
 
@@ -34,18 +38,46 @@ void telemetry_thread_entry(ULONG initial_input)
                                     1);
 
     uint64_t last_req_ms = 0;
+    uint64_t last_can_status_ms = 0;
+    can_bus_state_t last_can_state = can_bus_get_state();
 
     for (;;) {
         can_bus_process_rx();
+        uart_link_process_rx();
+#if TELEMETRY_EGRESS_QUEUES
+        telemetry_egress_poll(); // time sync replies before the bulk work below
+#endif
+        (void)telemetry_stage_drain(TELEMETRY_STAGE_DRAIN_BATCH);
         (void)process_all_queues_timeout(5);
+#if TELEMETRY_EGRESS_QUEUES
+        telemetry_egress_poll();
+#endif
         can_bus_process_rx();
 
-        const uint64_t now_ms = tx_now_ms();
+        const uint64_t now_ms = timebase_now_ms();
+        can_node_poll((uint32_t)now_ms);
+        telemetry_batch_poll(telemetry_now_us());
         if ((uint64_t)(now_ms - last_req_ms) >= (uint64_t)TIMESYNC_REQUEST_PERIOD_MS) {
             (void)telemetry_timesync_request();
             last_req_ms = now_ms;
         }
 
+        const can_bus_state_t can_state = can_bus_get_state();
+        if (can_state != last_can_state) {
+            if (can_state == CAN_BUS_STATE_BUS_OFF) {
+                // Fixed text: no formatting on this stack.
+                static const char bus_off_txt[] = "CAN bus-off";
+                (void)log_telemetry_asynchronous(SEDS_DT_GENERIC_ERROR, bus_off_txt,
+                                                 sizeof(bus_off_txt) - 1, 1);
+            }
+            (void)telemetry_log_can_status();
+            last_can_state = can_state;
+            last_can_status_ms = now_ms;
+        } else if ((uint64_t)(now_ms - last_can_status_ms) >= (uint64_t)CAN_STATUS_PERIOD_MS) {
+            (void)telemetry_log_can_status();
+            last_can_status_ms = now_ms;
+        }
+
         tx_thread_sleep(1);
     }
 }
@@ -0,0 +1,101 @@
+// timebase.c
+//
+// 64-bit monotonic clock from TIM2. See timebase.h.
+//
+//  - TIM2 is one of the G4's 32-bit timers. Prescaled to TIMEBASE_HZ it
+//    wraps every 2^32 ticks (about 9 minutes at 8 MHz); the update
+//    interrupt adds one to g_epoch per wrap.
+//  - A reader takes g_epoch, CNT and SR and retries if g_epoch moved in
+//    between, so a reader preempted by the update interrupt sees either the
+//    old epoch with the old count or the new one with the new count.
+//  - If the update is still pending (the reader masks interrupts, or runs
+//    in an ISR above TIM2), UIF is set and the count has already wrapped:
+//    a small count with UIF set belongs to the next epoch. A large one was
+//    read before the wrap.
+//  - The update interrupt clears UIF and advances g_epoch with interrupts
+//    masked, so no reader can see one step without the other.
+
+#include "timebase.h"
+
+#include "main.h"
+#include "stm32g4xx_hal.h"
+
+#if (1000000000u % TIMEBASE_HZ) != 0u || (TIMEBASE_HZ % 1000000u) != 0u
+#error "TIMEBASE_HZ must divide 1 GHz and be a multiple of 1 MHz"
+#endif
+
+#define TIMEBASE_NS_PER_TICK (1000000000u / TIMEBASE_HZ)
+#define TIMEBASE_TICKS_PER_US (TIMEBASE_HZ / 1000000u)
+#define TIMEBASE_TICKS_PER_MS (TIMEBASE_HZ / 1000u)
+
+#define TIMEBASE_HALF_RANGE 0x80000000u
+
+static volatile uint32_t g_epoch; // TIM2 wraps counted by the update ISR
+
+// APB1 timers run at PCLK1, or twice that when APB1 is divided.
+static uint32_t timebase_tim_clk_hz(void) {
+  const uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+  if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_HCLK_DIV1)
+    return 2u * pclk1;
+  return pclk1;
+}
+
+void timebase_init(void) {
+  const uint32_t clk = timebase_tim_clk_hz();
+  const uint32_t psc = clk / TIMEBASE_HZ;
+
+  // The tick conversions below assume exactly TIMEBASE_HZ. A rate the
+  // prescaler cannot reach would skew every timestamp without a trace.
+  if (psc == 0u || psc > 0x10000u || clk % TIMEBASE_HZ != 0u)
+    Error_Handler();
+
+  __HAL_RCC_TIM2_CLK_ENABLE();
+  TIM2->CR1 = 0;
+  TIM2->DIER = 0;
+  TIM2->PSC = psc - 1u;
+  TIM2->ARR = 0xFFFFFFFFu;
+  TIM2->CNT = 0;
+  TIM2->EGR = TIM_EGR_UG; // load the prescaler
+  TIM2->SR = ~TIM_SR_UIF; // UG sets it; that was not a wrap
+  g_epoch = 0;
+
+  TIM2->DIER = TIM_DIER_UIE;
+  HAL_NVIC_SetPriority(TIM2_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(TIM2_IRQn);
+  TIM2->CR1 = TIM_CR1_CEN;
+}
+
+static uint64_t timebase_ticks(void) {
+  uint32_t hi, cnt, sr;
+  do {
+    hi = g_epoch;
+    cnt = TIM2->CNT;
+    sr = TIM2->SR;
+  } while (hi != g_epoch);
+
+  if ((sr & TIM_SR_UIF) && cnt < TIMEBASE_HALF_RANGE)
+    hi++; // wrapped, the update interrupt has not run yet
+  return ((uint64_t)hi << 32) | cnt;
+}
+
+uint64_t timebase_now_ns(void) {
+  return timebase_ticks() * TIMEBASE_NS_PER_TICK;
+}
+
+uint64_t timebase_now_us(void) {
+  return timebase_ticks() / TIMEBASE_TICKS_PER_US;
+}
+
+uint64_t timebase_now_ms(void) {
+  return timebase_ticks() / TIMEBASE_TICKS_PER_MS;
+}
+
+void timebase_irq_handler(void) {
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if (TIM2->SR & TIM_SR_UIF) {
+    TIM2->SR = ~TIM_SR_UIF;
+    g_epoch++;
+  }
+  __set_PRIMASK(primask);
+}
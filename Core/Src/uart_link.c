@@ -0,0 +1,282 @@
+// uart_link.c
+//
+// Framed serial link over a DMA-driven UART. See uart_link.h.
+//
+// TX ping-pong:
+//  - g_tx[g_tx_fill] is the buffer senders append encoded frames to.
+//  - The other buffer is owned by the DMA while g_tx_busy is set.
+//  - tx_kick() swaps the buffers and starts the next transfer; it runs from
+//    uart_link_send() and from the TX-complete interrupt.
+//  - A sender reserves the worst-case encoded size at the end of the fill
+//    buffer with interrupts masked, then encodes into it with interrupts on.
+//    The CRC and COBS pass over a 512 B payload takes hundreds of
+//    microseconds at 16 MHz, far too long to hold off the FDCAN ISRs.
+//  - While any reservation is open (g_tx_writers) the buffers are not
+//    swapped; the last sender to finish kicks the transfer. The unused tail
+//    of a reservation is filled with 0x00, which the receiver skips as idle
+//    fill between frames.
+//
+// RX circular DMA:
+//  - The DMA writes g_rx[] forever. HAL_UARTEx_RxEventCallback fires on
+//    half/full transfer and on line idle with the current write position.
+//  - The ISR only advances g_rx_head and accumulates g_rx_pending.
+//  - uart_link_process_rx() (thread) decodes [tail, head). If more than one
+//    buffer's worth arrived since the last call the reader was lapped: the
+//    partial frame is dropped and the reader resyncs at the next delimiter.
+
+#include "uart_link.h"
+#include "timebase.h"
+#include <string.h>
+
+typedef struct {
+  serial_frame_rx_cb_t cb;
+  void *user;
+} uart_link_sub_t;
+
+static UART_HandleTypeDef *g_huart = NULL;
+static uart_link_sub_t g_subs[UART_LINK_MAX_SUBSCRIBERS];
+
+static uint8_t g_tx[2][UART_LINK_TX_BUF_SIZE];
+static volatile uint8_t g_tx_fill = 0;
+static volatile size_t g_tx_len = 0;
+static volatile uint8_t g_tx_busy = 0;
+static volatile uint8_t g_tx_writers = 0; // open reservations in g_tx_fill
+
+static uint8_t g_rx[UART_LINK_RX_BUF_SIZE];
+static volatile size_t g_rx_head = 0;     // ISR: DMA write position
+static volatile size_t g_rx_pending = 0;  // ISR: bytes since last drain
+static volatile uint8_t g_rx_restart = 0; // ISR: reception restarted
+static size_t g_rx_tail = 0;              // thread-owned
+
+static serial_frame_decoder_t g_dec;
+static uart_link_stats_t g_stats;
+
+static inline uint32_t uart_link_irq_save(void) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  return primask;
+}
+
+static inline void uart_link_irq_restore(uint32_t primask) {
+  __set_PRIMASK(primask);
+}
+
+// =========================
+// TX
+// =========================
+
+// Interrupts must be masked.
+static void tx_kick(void) {
+  if (g_tx_busy || g_tx_writers || g_tx_len == 0 || !g_huart)
+    return;
+
+  const uint8_t active = g_tx_fill;
+  const size_t n = g_tx_len;
+  g_tx_fill ^= 1u;
+  g_tx_len = 0;
+  g_tx_busy = 1;
+
+  if (HAL_UART_Transmit_DMA(g_huart, g_tx[active], (uint16_t)n) != HAL_OK) {
+    g_tx_busy = 0;
+    g_stats.tx_dropped++;
+  }
+}
+
+HAL_StatusTypeDef uart_link_send(uint8_t type, const uint8_t *data,
+                                 size_t len) {
+  if (!g_huart || (len && !data))
+    return HAL_ERROR;
+  if (len > SERIAL_FRAME_MAX_PAYLOAD)
+    return HAL_ERROR;
+
+  const size_t need = SERIAL_FRAME_ENCODED_MAX(len);
+  uint32_t pm = uart_link_irq_save();
+
+  const size_t used = g_tx_len;
+  if (used + need > UART_LINK_TX_BUF_SIZE) {
+    g_stats.tx_dropped++;
+    uart_link_irq_restore(pm);
+    return HAL_BUSY;
+  }
+  uint8_t *out = &g_tx[g_tx_fill][used];
+  g_tx_len = used + need;
+  g_tx_writers++;
+  uart_link_irq_restore(pm);
+
+  const size_t n = serial_frame_encode(type, data, len, out, need);
+  memset(out + n, 0x00, need - n);
+
+  pm = uart_link_irq_save();
+  g_tx_writers--;
+  g_stats.tx_frames++;
+  g_stats.tx_bytes += (uint32_t)n;
+  tx_kick();
+  uart_link_irq_restore(pm);
+  return HAL_OK;
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
+  if (huart != g_huart)
+    return;
+  g_tx_busy = 0;
+  tx_kick();
+}
+
+// =========================
+// RX
+// =========================
+
+static HAL_StatusTypeDef rx_start(void) {
+  g_rx_head = 0;
+  g_rx_pending = 0;
+  g_rx_restart = 1;
+  return HAL_UARTEx_ReceiveToIdle_DMA(g_huart, g_rx, UART_LINK_RX_BUF_SIZE);
+}
+
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size) {
+  if (huart != g_huart)
+    return;
+
+  // Size is the DMA write position (1..BUF_SIZE); BUF_SIZE at transfer
+  // complete, where the circular DMA wraps to 0.
+  const size_t head = g_rx_head;
+  const size_t pos = (size_t)Size;
+  const size_t fresh = (pos >= head) ? pos - head
+                                     : pos + UART_LINK_RX_BUF_SIZE - head;
+  g_rx_pending += fresh;
+  g_rx_head = pos % UART_LINK_RX_BUF_SIZE;
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart) {
+  if (huart != g_huart)
+    return;
+  g_stats.uart_errors++;
+
+  // HAL stops a DMA reception on overrun/noise/framing errors.
+  if (huart->RxState == HAL_UART_STATE_READY)
+    (void)rx_start();
+}
+
+static void uart_link_dispatch(uint8_t type, const uint8_t *payload, size_t len,
+                               void *user) {
+  (void)user;
+  for (unsigned i = 0; i < UART_LINK_MAX_SUBSCRIBERS; i++) {
+    if (g_subs[i].cb)
+      g_subs[i].cb(type, payload, len, g_subs[i].user);
+  }
+}
+
+void uart_link_process_rx(void) {
+  if (!g_huart)
+    return;
+
+  uint32_t pm = uart_link_irq_save();
+  const uint8_t restart = g_rx_restart;
+  size_t pending = g_rx_pending;
+  const size_t head = g_rx_head;
+  g_rx_pending = 0;
+  g_rx_restart = 0;
+  uart_link_irq_restore(pm);
+
+  if (restart) {
+    // Reception restarted at offset 0; anything half-decoded is stale.
+    g_rx_tail = 0;
+    g_dec.len = 0;
+    g_dec.overflow = 0;
+    pending = head;
+  }
+
+  if (pending > UART_LINK_RX_BUF_SIZE) {
+    g_stats.rx_overruns++;
+    g_rx_tail = head;
+    g_dec.len = 0;
+    g_dec.overflow = 1; // skip the torn frame up to the next delimiter
+    return;
+  }
+
+  g_stats.rx_bytes += (uint32_t)pending;
+
+  while (pending) {
+    size_t chunk = UART_LINK_RX_BUF_SIZE - g_rx_tail;
+    if (chunk > pending)
+      chunk = pending;
+    serial_frame_decoder_feed(&g_dec, &g_rx[g_rx_tail], chunk);
+    g_rx_tail = (g_rx_tail + chunk) % UART_LINK_RX_BUF_SIZE;
+    pending -= chunk;
+  }
+}
+
+HAL_StatusTypeDef uart_link_subscribe_rx(serial_frame_rx_cb_t cb, void *user) {
+  if (!cb)
+    return HAL_ERROR;
+
+  for (unsigned i = 0; i < UART_LINK_MAX_SUBSCRIBERS; i++) {
+    if (g_subs[i].cb == cb && g_subs[i].user == user)
+      return HAL_ERROR;
+  }
+  for (unsigned i = 0; i < UART_LINK_MAX_SUBSCRIBERS; i++) {
+    if (g_subs[i].cb == NULL) {
+      g_subs[i].cb = cb;
+      g_subs[i].user = user;
+      return HAL_OK;
+    }
+  }
+  return HAL_ERROR;
+}
+
+// =========================
+// Setup
+// =========================
+
+static HAL_StatusTypeDef uart_link_apply_baud(uint32_t baud) {
+  if (baud == 0 || g_huart->Init.BaudRate == baud)
+    return HAL_OK;
+  g_huart->Init.BaudRate = baud;
+  // gState is READY, so this only rewrites BRR/CR* (no MSP re-init).
+  return HAL_UART_Init(g_huart);
+}
+
+HAL_StatusTypeDef uart_link_init(UART_HandleTypeDef *huart, uint32_t baud) {
+  if (!huart || !huart->hdmarx || !huart->hdmatx)
+    return HAL_ERROR;
+
+  g_huart = huart;
+  serial_frame_decoder_init(&g_dec, uart_link_dispatch, NULL);
+  g_tx_fill = 0;
+  g_tx_len = 0;
+  g_tx_busy = 0;
+  g_tx_writers = 0;
+  g_rx_tail = 0;
+
+  if (uart_link_apply_baud(baud) != HAL_OK)
+    return HAL_ERROR;
+  return rx_start();
+}
+
+HAL_StatusTypeDef uart_link_set_baud(uint32_t baud) {
+  if (!g_huart || baud == 0)
+    return HAL_ERROR;
+
+  // Let the in-flight DMA transfer finish so no frame is cut mid-byte.
+  const uint32_t t0 = (uint32_t)timebase_now_ms();
+  while (g_tx_busy) {
+    if (((uint32_t)timebase_now_ms() - t0) > 100u)
+      return HAL_TIMEOUT;
+  }
+
+  (void)HAL_UART_AbortReceive(g_huart);
+  if (uart_link_apply_baud(baud) != HAL_OK)
+    return HAL_ERROR;
+  return rx_start();
+}
+
+void uart_link_get_stats(uart_link_stats_t *out) {
+  if (!out)
+    return;
+  uint32_t pm = uart_link_irq_save();
+  *out = g_stats;
+  uart_link_irq_restore(pm);
+  out->rx_frames = g_dec.frames_ok;
+  out->rx_crc_errors = g_dec.crc_errors;
+  out->rx_framing_errors = g_dec.framing_errors;
+}
@@ -23,7 +23,18 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
-
+#if defined(TELEMETRY_USB_CDC) || defined(CAN_GS_USB)
+#include "main.h"
+#include "ux_dcd_stm32.h"
+#include "ux_device_descriptors.h"
+#endif
+#ifdef TELEMETRY_USB_CDC
+#include "ux_device_class_cdc_acm.h"
+#include "ux_device_cdc_acm.h"
+#endif
+#ifdef CAN_GS_USB
+#include "ux_device_gs_usb.h"
+#endif
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -33,7 +44,27 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
-
+/* USBX system memory: device stack, class instance and the bulk transfer
+   buffers (UX_SLAVE_REQUEST_DATA_MAX_LENGTH each). */
+#define UX_APP_SYSTEM_MEMORY_SIZE  (10U * 1024U)
+
+/* PMA layout (bytes). The buffer descriptor table takes 8 bytes per
+   endpoint for the 8 endpoints the PCD is configured with. Bulk endpoints
+   are double-buffered so the host can fill one bank while the DCD empties
+   the other. */
+#define PMA_EP0_OUT        0x040U
+#define PMA_EP0_IN         0x080U
+#define PMA_CDC_CMD_IN     0x0C0U
+#define PMA_CDC_OUT_BUF0   0x0D0U
+#define PMA_CDC_OUT_BUF1   0x110U
+#define PMA_CDC_IN_BUF0    0x150U
+#define PMA_CDC_IN_BUF1    0x190U
+
+/* gs_usb mode: the same EP0 layout, then the bulk pair. */
+#define PMA_GS_IN_BUF0     0x0C0U
+#define PMA_GS_IN_BUF1     0x100U
+#define PMA_GS_OUT_BUF0    0x140U
+#define PMA_GS_OUT_BUF1    0x180U
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -46,7 +77,12 @@
 static TX_THREAD ux_device_app_thread;
 
 /* USER CODE BEGIN PV */
-
+#if defined(TELEMETRY_USB_CDC) || defined(CAN_GS_USB)
+extern PCD_HandleTypeDef hpcd_USB_FS;
+#endif
+#ifdef TELEMETRY_USB_CDC
+static UX_SLAVE_CLASS_CDC_ACM_PARAMETER cdc_acm_parameter;
+#endif
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -67,7 +103,70 @@ UINT MX_USBX_Device_Init(VOID *memory_ptr)
   TX_BYTE_POOL *byte_pool = (TX_BYTE_POOL*)memory_ptr;
 
   /* USER CODE BEGIN MX_USBX_Device_Init0 */
+#if defined(TELEMETRY_USB_CDC) || defined(CAN_GS_USB)
+  UCHAR *framework;
+  ULONG framework_len;
+  UCHAR *strings;
+  ULONG strings_len;
+  UCHAR *languages;
+  ULONG languages_len;
+
+  if (tx_byte_allocate(byte_pool, (VOID **) &pointer, UX_APP_SYSTEM_MEMORY_SIZE,
+                       TX_NO_WAIT) != TX_SUCCESS)
+  {
+    return TX_POOL_ERROR;
+  }
+
+  if (ux_system_initialize(pointer, UX_APP_SYSTEM_MEMORY_SIZE, UX_NULL, 0) != UX_SUCCESS)
+  {
+    return UX_ERROR;
+  }
+
+  framework = USBD_Get_Device_Framework_Full_Speed(&framework_len);
+  strings = USBD_Get_String_Framework(&strings_len);
+  languages = USBD_Get_Language_Id_Framework(&languages_len);
+
+  /* Full-speed only: no high-speed framework. */
+  if (ux_device_stack_initialize(UX_NULL, 0U, framework, framework_len,
+                                 strings, strings_len, languages, languages_len,
+                                 UX_NULL) != UX_SUCCESS)
+  {
+    return UX_ERROR;
+  }
+#endif
+
+#ifdef TELEMETRY_USB_CDC
+  cdc_acm_parameter.ux_slave_class_cdc_acm_instance_activate = USBD_CDC_ACM_Activate;
+  cdc_acm_parameter.ux_slave_class_cdc_acm_instance_deactivate = USBD_CDC_ACM_Deactivate;
+  cdc_acm_parameter.ux_slave_class_cdc_acm_parameter_change = USBD_CDC_ACM_ParameterChange;
+
+  /* Configuration 1, interface 0 (the IAD pulls in the data interface). */
+  if (ux_device_stack_class_register(_ux_system_slave_class_cdc_acm_name,
+                                     ux_device_class_cdc_acm_entry, 1, 0,
+                                     (VOID *)&cdc_acm_parameter) != UX_SUCCESS)
+  {
+    return UX_ERROR;
+  }
 
+  if (usb_cdc_link_init(byte_pool) != UX_SUCCESS)
+  {
+    return UX_ERROR;
+  }
+#endif
+
+#ifdef CAN_GS_USB
+  /* Configuration 1, interface 0: the vendor-specific gs_usb interface. */
+  if (ux_device_stack_class_register(usb_gs_usb_class_name, usb_gs_usb_class_entry,
+                                     1, 0, UX_NULL) != UX_SUCCESS)
+  {
+    return UX_ERROR;
+  }
+
+  if (usb_gs_usb_init(byte_pool) != UX_SUCCESS)
+  {
+    return UX_ERROR;
+  }
+#endif
   /* USER CODE END MX_USBX_Device_Init0 */
 
   /* Allocate the stack for device application main thread */
@@ -106,6 +205,47 @@ static VOID app_ux_device_thread_entry(ULONG thread_input)
 {
   /* USER CODE BEGIN app_ux_device_thread_entry */
   TX_PARAMETER_NOT_USED(thread_input);
+#ifdef TELEMETRY_USB_CDC
+  HAL_PCDEx_PMAConfig(&hpcd_USB_FS, 0x00U, PCD_SNG_BUF, PMA_EP0_OUT);
+  HAL_PCDEx_PMAConfig(&hpcd_USB_FS, 0x80U, PCD_SNG_BUF, PMA_EP0_IN);
+  HAL_PCDEx_PMAConfig(&hpcd_USB_FS, USBD_CDCACM_EPINCMD_ADDR, PCD_SNG_BUF, PMA_CDC_CMD_IN);
+  HAL_PCDEx_PMAConfig(&hpcd_USB_FS, USBD_CDCACM_EPOUT_ADDR, PCD_DBL_BUF,
+                      PMA_CDC_OUT_BUF0 | (PMA_CDC_OUT_BUF1 << 16U));
+  HAL_PCDEx_PMAConfig(&hpcd_USB_FS, USBD_CDCACM_EPIN_ADDR, PCD_DBL_BUF,
+                      PMA_CDC_IN_BUF0 | (PMA_CDC_IN_BUF1 << 16U));
+
+  if (ux_dcd_stm32_initialize((ULONG)USB, (ULONG)&hpcd_USB_FS) != UX_SUCCESS)
+  {
+    return;
+  }
+  if (HAL_PCD_Start(&hpcd_USB_FS) != HAL_OK)
+  {
+    return;
+  }
+
+  /* This thread now owns the bulk IN endpoint. */
+  usb_cdc_link_tx_thread_entry(0);
+#endif
+#ifdef CAN_GS_USB
+  HAL_PCDEx_PMAConfig(&hpcd_USB_FS, 0x00U, PCD_SNG_BUF, PMA_EP0_OUT);
+  HAL_PCDEx_PMAConfig(&hpcd_USB_FS, 0x80U, PCD_SNG_BUF, PMA_EP0_IN);
+  HAL_PCDEx_PMAConfig(&hpcd_USB_FS, USBD_GS_USB_EPIN_ADDR, PCD_DBL_BUF,
+                      PMA_GS_IN_BUF0 | (PMA_GS_IN_BUF1 << 16U));
+  HAL_PCDEx_PMAConfig(&hpcd_USB_FS, USBD_GS_USB_EPOUT_ADDR, PCD_DBL_BUF,
+                      PMA_GS_OUT_BUF0 | (PMA_GS_OUT_BUF1 << 16U));
+
+  if (ux_dcd_stm32_initialize((ULONG)USB, (ULONG)&hpcd_USB_FS) != UX_SUCCESS)
+  {
+    return;
+  }
+  if (HAL_PCD_Start(&hpcd_USB_FS) != HAL_OK)
+  {
+    return;
+  }
+
+  /* This thread now owns the bulk IN endpoint and applies MODE requests. */
+  usb_gs_usb_tx_thread_entry(0);
+#endif
   /* USER CODE END app_ux_device_thread_entry */
 }
 
@@ -0,0 +1,261 @@
+/* ux_device_cdc_acm.c
+ *
+ * CDC-ACM telemetry link. See ux_device_cdc_acm.h.
+ */
+#include "ux_device_cdc_acm.h"
+#include "app_usbx_device.h"
+#include "ux_device_class_cdc_acm.h"
+
+#include <string.h>
+
+#define USB_CDC_LINK_TX_EVENT  0x1U
+
+typedef struct
+{
+  serial_frame_rx_cb_t cb;
+  void *user;
+} usb_cdc_link_sub_t;
+
+static UX_SLAVE_CLASS_CDC_ACM *volatile cdc_acm = UX_NULL;
+
+static TX_MUTEX tx_lock;
+static TX_EVENT_FLAGS_GROUP tx_events;
+static TX_THREAD rx_thread;
+static UINT link_ready = 0;
+
+static UCHAR tx_buf[2][USB_CDC_LINK_TX_BUF_SIZE];
+static UINT tx_fill = 0;
+static ULONG tx_len = 0;
+
+static UCHAR rx_buf[USB_CDC_LINK_RX_BUF_SIZE];
+static serial_frame_decoder_t rx_dec;
+static usb_cdc_link_sub_t subs[USB_CDC_LINK_MAX_SUBSCRIBERS];
+
+static usb_cdc_link_stats_t stats;
+
+static VOID usb_cdc_link_rx_thread_entry(ULONG thread_input);
+
+/* ----------------------------- Class callbacks ----------------------------- */
+
+VOID USBD_CDC_ACM_Activate(VOID *cdc_acm_instance)
+{
+  cdc_acm = (UX_SLAVE_CLASS_CDC_ACM *)cdc_acm_instance;
+  stats.connects++;
+}
+
+VOID USBD_CDC_ACM_Deactivate(VOID *cdc_acm_instance)
+{
+  UX_PARAMETER_NOT_USED(cdc_acm_instance);
+  cdc_acm = UX_NULL;
+}
+
+VOID USBD_CDC_ACM_ParameterChange(VOID *cdc_acm_instance)
+{
+  /* Line coding is meaningless for a virtual port; accept anything. */
+  UX_PARAMETER_NOT_USED(cdc_acm_instance);
+}
+
+/* ----------------------------------- TX ----------------------------------- */
+
+HAL_StatusTypeDef usb_cdc_link_send(uint8_t type, const uint8_t *data, size_t len)
+{
+  if (!link_ready || (len && !data) || len > SERIAL_FRAME_MAX_PAYLOAD)
+  {
+    return HAL_ERROR;
+  }
+
+  if (cdc_acm == UX_NULL)
+  {
+    stats.tx_no_host++;
+    return HAL_OK;
+  }
+
+  HAL_StatusTypeDef st = HAL_OK;
+  if (tx_mutex_get(&tx_lock, TX_WAIT_FOREVER) != TX_SUCCESS)
+  {
+    return HAL_ERROR;
+  }
+
+  const size_t n = serial_frame_encode(type, data, len, &tx_buf[tx_fill][tx_len],
+                                       USB_CDC_LINK_TX_BUF_SIZE - tx_len);
+  if (n == 0U)
+  {
+    stats.tx_dropped++;
+    st = HAL_BUSY;
+  }
+  else
+  {
+    tx_len += n;
+    stats.tx_frames++;
+    stats.tx_bytes += (uint32_t)n;
+  }
+
+  (void)tx_mutex_put(&tx_lock);
+
+  if (st == HAL_OK)
+  {
+    (void)tx_event_flags_set(&tx_events, USB_CDC_LINK_TX_EVENT, TX_OR);
+  }
+  return st;
+}
+
+/* Runs in the USBX device application thread. While one buffer is being
+   written, senders fill the other; a write therefore always carries every
+   frame queued since the previous one. */
+VOID usb_cdc_link_tx_thread_entry(ULONG thread_input)
+{
+  UX_PARAMETER_NOT_USED(thread_input);
+  ULONG flags;
+  ULONG actual;
+
+  for (;;)
+  {
+    (void)tx_event_flags_get(&tx_events, USB_CDC_LINK_TX_EVENT, TX_OR_CLEAR,
+                             &flags, TX_WAIT_FOREVER);
+
+    (void)tx_mutex_get(&tx_lock, TX_WAIT_FOREVER);
+    const UINT active = tx_fill;
+    const ULONG n = tx_len;
+    tx_fill ^= 1U;
+    tx_len = 0;
+    (void)tx_mutex_put(&tx_lock);
+
+    UX_SLAVE_CLASS_CDC_ACM *cdc = cdc_acm;
+    if (n == 0U)
+    {
+      continue;
+    }
+    if (cdc == UX_NULL)
+    {
+      stats.tx_no_host++;
+      continue;
+    }
+
+    stats.tx_transfers++;
+    if (ux_device_class_cdc_acm_write(cdc, tx_buf[active], n, &actual) != UX_SUCCESS)
+    {
+      stats.tx_errors++;
+    }
+  }
+}
+
+/* ----------------------------------- RX ----------------------------------- */
+
+static void usb_cdc_link_dispatch(uint8_t type, const uint8_t *payload, size_t len,
+                                  void *user)
+{
+  UX_PARAMETER_NOT_USED(user);
+  for (unsigned i = 0; i < USB_CDC_LINK_MAX_SUBSCRIBERS; i++)
+  {
+    if (subs[i].cb)
+    {
+      subs[i].cb(type, payload, len, subs[i].user);
+    }
+  }
+}
+
+static VOID usb_cdc_link_rx_thread_entry(ULONG thread_input)
+{
+  UX_PARAMETER_NOT_USED(thread_input);
+  UX_SLAVE_CLASS_CDC_ACM *last = UX_NULL;
+  ULONG actual;
+
+  for (;;)
+  {
+    UX_SLAVE_CLASS_CDC_ACM *cdc = cdc_acm;
+    if (cdc == UX_NULL)
+    {
+      last = UX_NULL;
+      tx_thread_sleep(10);
+      continue;
+    }
+    if (cdc != last)
+    {
+      /* New session: drop whatever half frame the last one left behind. */
+      rx_dec.len = 0;
+      rx_dec.overflow = 0;
+      last = cdc;
+    }
+
+    if (ux_device_class_cdc_acm_read(cdc, rx_buf, sizeof(rx_buf), &actual) != UX_SUCCESS)
+    {
+      tx_thread_sleep(1);
+      continue;
+    }
+    stats.rx_bytes += actual;
+    serial_frame_decoder_feed(&rx_dec, rx_buf, actual);
+  }
+}
+
+HAL_StatusTypeDef usb_cdc_link_subscribe_rx(serial_frame_rx_cb_t cb, void *user)
+{
+  if (!cb)
+  {
+    return HAL_ERROR;
+  }
+  for (unsigned i = 0; i < USB_CDC_LINK_MAX_SUBSCRIBERS; i++)
+  {
+    if (subs[i].cb == cb && subs[i].user == user)
+    {
+      return HAL_ERROR;
+    }
+  }
+  for (unsigned i = 0; i < USB_CDC_LINK_MAX_SUBSCRIBERS; i++)
+  {
+    if (subs[i].cb == NULL)
+    {
+      subs[i].cb = cb;
+      subs[i].user = user;
+      return HAL_OK;
+    }
+  }
+  return HAL_ERROR;
+}
+
+/* ---------------------------------- Setup --------------------------------- */
+
+UINT usb_cdc_link_init(TX_BYTE_POOL *byte_pool)
+{
+  VOID *stack;
+
+  serial_frame_decoder_init(&rx_dec, usb_cdc_link_dispatch, NULL);
+
+  if (tx_mutex_create(&tx_lock, "usb_cdc_tx", TX_INHERIT) != TX_SUCCESS)
+  {
+    return UX_ERROR;
+  }
+  if (tx_event_flags_create(&tx_events, "usb_cdc_tx") != TX_SUCCESS)
+  {
+    return UX_ERROR;
+  }
+  if (tx_byte_allocate(byte_pool, &stack, USB_CDC_LINK_RX_STACK_SIZE, TX_NO_WAIT) != TX_SUCCESS)
+  {
+    return TX_POOL_ERROR;
+  }
+  if (tx_thread_create(&rx_thread, "USB CDC RX", usb_cdc_link_rx_thread_entry, 0,
+                       stack, USB_CDC_LINK_RX_STACK_SIZE, UX_DEVICE_APP_THREAD_PRIO,
+                       UX_DEVICE_APP_THREAD_PRIO, TX_NO_TIME_SLICE, TX_AUTO_START) != TX_SUCCESS)
+  {
+    return TX_THREAD_ERROR;
+  }
+
+  link_ready = 1;
+  return UX_SUCCESS;
+}
+
+uint8_t usb_cdc_link_connected(void)
+{
+  return (cdc_acm != UX_NULL) ? 1U : 0U;
+}
+
+void usb_cdc_link_get_stats(usb_cdc_link_stats_t *out)
+{
+  if (!out)
+  {
+    return;
+  }
+  *out = stats;
+  out->rx_frames = rx_dec.frames_ok;
+  out->rx_crc_errors = rx_dec.crc_errors;
+  out->rx_framing_errors = rx_dec.framing_errors;
+}
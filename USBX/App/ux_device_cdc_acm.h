@@ -0,0 +1,84 @@
+/* ux_device_cdc_acm.h
+ *
+ * CDC-ACM telemetry link on the USB FS port.
+ *
+ * The virtual COM port carries the same COBS + CRC frames as the UART link
+ * (serial_frame.h), so a bench laptop sees every router packet that crosses
+ * the gateway with the same decoder.
+ *
+ *  - TX: senders append encoded frames to one of two buffers under a mutex
+ *    while the USBX thread writes the other one out in a single bulk
+ *    transfer. ZLPs after transfers that end on a packet boundary come from
+ *    UX_DEVICE_CLASS_CDC_ACM_WRITE_AUTO_ZLP.
+ *  - RX: a dedicated thread blocks in ux_device_class_cdc_acm_read() and
+ *    feeds the frame decoder; subscribers are called from that thread.
+ *  - While no host has the port configured, frames are discarded (counted in
+ *    tx_no_host) instead of queued, so a late connect never sees stale data.
+ */
+#ifndef __UX_DEVICE_CDC_ACM_H__
+#define __UX_DEVICE_CDC_ACM_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ux_api.h"
+#include "serial_frame.h"
+#include "stm32g4xx_hal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef USB_CDC_LINK_TX_BUF_SIZE
+#define USB_CDC_LINK_TX_BUF_SIZE      2048U /* per ping-pong half */
+#endif
+
+#ifndef USB_CDC_LINK_RX_BUF_SIZE
+#define USB_CDC_LINK_RX_BUF_SIZE      512U
+#endif
+
+#ifndef USB_CDC_LINK_RX_STACK_SIZE
+#define USB_CDC_LINK_RX_STACK_SIZE    1024U
+#endif
+
+#ifndef USB_CDC_LINK_MAX_SUBSCRIBERS
+#define USB_CDC_LINK_MAX_SUBSCRIBERS  4
+#endif
+
+typedef struct {
+  uint32_t tx_frames;
+  uint32_t tx_bytes;
+  uint32_t tx_dropped;   /* no room in the fill buffer */
+  uint32_t tx_no_host;   /* discarded while disconnected */
+  uint32_t tx_transfers; /* bulk writes issued */
+  uint32_t tx_errors;
+  uint32_t rx_bytes;
+  uint32_t rx_frames;
+  uint32_t rx_crc_errors;
+  uint32_t rx_framing_errors;
+  uint32_t connects;
+} usb_cdc_link_stats_t;
+
+/* Frame and queue one payload. HAL_BUSY if the TX buffer is full. */
+HAL_StatusTypeDef usb_cdc_link_send(uint8_t type, const uint8_t *data, size_t len);
+
+/* Subscribe to received frames (called from the USB RX thread). */
+HAL_StatusTypeDef usb_cdc_link_subscribe_rx(serial_frame_rx_cb_t cb, void *user);
+
+/* 1 while a host has the CDC-ACM function configured. */
+uint8_t usb_cdc_link_connected(void);
+
+void usb_cdc_link_get_stats(usb_cdc_link_stats_t *out);
+
+/* USBX glue, used by app_usbx_device.c */
+UINT usb_cdc_link_init(TX_BYTE_POOL *byte_pool);
+VOID usb_cdc_link_tx_thread_entry(ULONG thread_input);
+VOID USBD_CDC_ACM_Activate(VOID *cdc_acm_instance);
+VOID USBD_CDC_ACM_Deactivate(VOID *cdc_acm_instance);
+VOID USBD_CDC_ACM_ParameterChange(VOID *cdc_acm_instance);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UX_DEVICE_CDC_ACM_H__ */
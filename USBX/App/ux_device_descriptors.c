@@ -0,0 +1,124 @@
+/* ux_device_descriptors.c
+ *
+ * Full-speed descriptors for a single CDC-ACM function (IAD + communication
+ * interface with an interrupt notification endpoint + data interface with
+ * a pair of 64-byte bulk endpoints).
+ *
+ * With CAN_GS_USB the device is instead a gs_usb adapter: one vendor-specific
+ * interface with a bulk IN/OUT pair, everything else over vendor requests.
+ */
+#include "ux_device_descriptors.h"
+
+#define LOBYTE(x)  ((UCHAR)((x) & 0x00FFU))
+#define HIBYTE(x)  ((UCHAR)(((x) & 0xFF00U) >> 8U))
+
+#ifdef CAN_GS_USB
+
+#define USBD_CONFIG_DESC_LEN  32U
+
+static UCHAR device_framework_full_speed[] = {
+  /* Device descriptor */
+  0x12, 0x01, 0x00, 0x02,
+  0x00, 0x00, 0x00,                 /* class defined per interface */
+  0x40,                             /* EP0 max packet */
+  LOBYTE(USBD_VID), HIBYTE(USBD_VID),
+  LOBYTE(USBD_PID), HIBYTE(USBD_PID),
+  0x00, 0x02,                       /* bcdDevice 2.00 */
+  0x01, 0x02, 0x03,                 /* manufacturer, product, serial */
+  0x01,                             /* one configuration */
+
+  /* Configuration descriptor */
+  0x09, 0x02, LOBYTE(USBD_CONFIG_DESC_LEN), HIBYTE(USBD_CONFIG_DESC_LEN),
+  0x01, 0x01, 0x00,
+  0xC0,                             /* self powered */
+  0x32,                             /* 100 mA */
+
+  /* Interface 0: vendor specific (gs_usb) */
+  0x09, 0x04, 0x00, 0x00, 0x02, 0xFF, 0xFF, 0xFF, 0x00,
+  0x07, 0x05, USBD_GS_USB_EPIN_ADDR, 0x02,
+  LOBYTE(USBD_GS_USB_EP_FS_MPS), HIBYTE(USBD_GS_USB_EP_FS_MPS), 0x00,
+  0x07, 0x05, USBD_GS_USB_EPOUT_ADDR, 0x02,
+  LOBYTE(USBD_GS_USB_EP_FS_MPS), HIBYTE(USBD_GS_USB_EP_FS_MPS), 0x00,
+};
+
+#else
+
+#define USBD_CONFIG_DESC_LEN  75U
+
+static UCHAR device_framework_full_speed[] = {
+  /* Device descriptor */
+  0x12, 0x01, 0x00, 0x02,
+  0xEF, 0x02, 0x01,                 /* misc / common class / IAD */
+  0x40,                             /* EP0 max packet */
+  LOBYTE(USBD_VID), HIBYTE(USBD_VID),
+  LOBYTE(USBD_PID), HIBYTE(USBD_PID),
+  0x00, 0x02,                       /* bcdDevice 2.00 */
+  0x01, 0x02, 0x03,                 /* manufacturer, product, serial */
+  0x01,                             /* one configuration */
+
+  /* Configuration descriptor */
+  0x09, 0x02, LOBYTE(USBD_CONFIG_DESC_LEN), HIBYTE(USBD_CONFIG_DESC_LEN),
+  0x02, 0x01, 0x00,
+  0xC0,                             /* self powered */
+  0x32,                             /* 100 mA */
+
+  /* Interface association */
+  0x08, 0x0B, 0x00, 0x02, 0x02, 0x02, 0x00, 0x00,
+
+  /* Interface 0: communication class, ACM */
+  0x09, 0x04, 0x00, 0x00, 0x01, 0x02, 0x02, 0x01, 0x00,
+  0x05, 0x24, 0x00, 0x10, 0x01,     /* header, CDC 1.10 */
+  0x05, 0x24, 0x01, 0x00, 0x01,     /* call management */
+  0x04, 0x24, 0x02, 0x02,           /* ACM: line coding + serial state */
+  0x05, 0x24, 0x06, 0x00, 0x01,     /* union: master 0, slave 1 */
+  0x07, 0x05, USBD_CDCACM_EPINCMD_ADDR, 0x03,
+  LOBYTE(USBD_CDCACM_EPINCMD_FS_MPS), HIBYTE(USBD_CDCACM_EPINCMD_FS_MPS), 0x10,
+
+  /* Interface 1: data class */
+  0x09, 0x04, 0x01, 0x00, 0x02, 0x0A, 0x00, 0x00, 0x00,
+  0x07, 0x05, USBD_CDCACM_EPOUT_ADDR, 0x02,
+  LOBYTE(USBD_CDCACM_EP_FS_MPS), HIBYTE(USBD_CDCACM_EP_FS_MPS), 0x00,
+  0x07, 0x05, USBD_CDCACM_EPIN_ADDR, 0x02,
+  LOBYTE(USBD_CDCACM_EP_FS_MPS), HIBYTE(USBD_CDCACM_EP_FS_MPS), 0x00,
+};
+
+#endif /* CAN_GS_USB */
+
+/* USBX string framework: [langid LE] [index] [length] [ASCII] per string */
+static UCHAR string_framework[] = {
+  0x09, 0x04, 0x01, 18,
+  'S', 'T', 'M', 'i', 'c', 'r', 'o', 'e', 'l', 'e', 'c', 't', 'r', 'o', 'n', 'i', 'c', 's',
+
+#ifdef CAN_GS_USB
+  0x09, 0x04, 0x02, 19,
+  'G', 'a', 't', 'e', 'w', 'a', 'y', ' ', 'C', 'A', 'N', ' ', 'A', 'd', 'a', 'p', 't', 'e', 'r',
+#else
+  0x09, 0x04, 0x02, 17,
+  'G', 'a', 't', 'e', 'w', 'a', 'y', ' ', 'T', 'e', 'l', 'e', 'm', 'e', 't', 'r', 'y',
+#endif
+
+  0x09, 0x04, 0x03, 4,
+  '0', '0', '0', '1',
+};
+
+static UCHAR language_id_framework[] = {
+  0x09, 0x04, /* English (US) */
+};
+
+UCHAR *USBD_Get_Device_Framework_Full_Speed(ULONG *length)
+{
+  *length = sizeof(device_framework_full_speed);
+  return device_framework_full_speed;
+}
+
+UCHAR *USBD_Get_String_Framework(ULONG *length)
+{
+  *length = sizeof(string_framework);
+  return string_framework;
+}
+
+UCHAR *USBD_Get_Language_Id_Framework(ULONG *length)
+{
+  *length = sizeof(language_id_framework);
+  return language_id_framework;
+}
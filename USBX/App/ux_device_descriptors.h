@@ -0,0 +1,43 @@
+/* ux_device_descriptors.h
+ *
+ * Full-speed USB descriptors for the gateway's USB function (CDC-ACM
+ * telemetry port, or the gs_usb CAN adapter with CAN_GS_USB), in the
+ * framework layout ux_device_stack_initialize() expects.
+ */
+#ifndef __UX_DEVICE_DESCRIPTORS_H__
+#define __UX_DEVICE_DESCRIPTORS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ux_api.h"
+
+#ifdef CAN_GS_USB
+/* The IDs the Linux gs_usb driver binds to (candleLight). */
+#define USBD_VID                      0x1D50U
+#define USBD_PID                      0x606FU
+#else
+#define USBD_VID                      0x0483U /* STMicroelectronics */
+#define USBD_PID                      0x5740U /* Virtual COM port */
+#endif
+
+#define USBD_GS_USB_EPIN_ADDR         0x81U
+#define USBD_GS_USB_EPOUT_ADDR        0x02U
+#define USBD_GS_USB_EP_FS_MPS         64U
+
+#define USBD_CDCACM_EPINCMD_ADDR      0x82U
+#define USBD_CDCACM_EPINCMD_FS_MPS    8U
+#define USBD_CDCACM_EPOUT_ADDR        0x01U
+#define USBD_CDCACM_EPIN_ADDR         0x81U
+#define USBD_CDCACM_EP_FS_MPS         64U
+
+UCHAR *USBD_Get_Device_Framework_Full_Speed(ULONG *length);
+UCHAR *USBD_Get_String_Framework(ULONG *length);
+UCHAR *USBD_Get_Language_Id_Framework(ULONG *length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UX_DEVICE_DESCRIPTORS_H__ */
@@ -0,0 +1,525 @@
+/* ux_device_gs_usb.c
+ *
+ * gs_usb USB-CAN adapter class. See ux_device_gs_usb.h.
+ */
+#include "ux_device_gs_usb.h"
+#include "app_usbx_device.h"
+#include "can_bus.h"
+#include "gs_usb_proto.h"
+#include "ux_system.h"
+
+#define USB_GS_USB_EVENT_TX      0x1U
+#define USB_GS_USB_EVENT_CFG     0x2U
+
+/* The driver keeps at most this many frames in flight and needs an echo for
+   each; bus traffic never takes the last slots. */
+#define USB_GS_USB_ECHO_RESERVE  10U
+
+#define USB_GS_USB_FEATURES                                                  \
+  (GS_USB_FEATURE_LISTEN_ONLY | GS_USB_FEATURE_LOOP_BACK |                   \
+   GS_USB_FEATURE_ONE_SHOT | GS_USB_FEATURE_HW_TIMESTAMP | GS_USB_FEATURE_FD | \
+   GS_USB_FEATURE_BT_CONST_EXT | GS_USB_FEATURE_GET_STATE)
+
+typedef enum
+{
+  USB_GS_USB_CFG_NONE = 0,
+  USB_GS_USB_CFG_START,
+  USB_GS_USB_CFG_STOP,
+} usb_gs_usb_cfg_t;
+
+UCHAR usb_gs_usb_class_name[] = "gs_usb";
+
+static UX_SLAVE_ENDPOINT *volatile ep_in = UX_NULL;
+static UX_SLAVE_ENDPOINT *volatile ep_out = UX_NULL;
+
+static TX_EVENT_FLAGS_GROUP gs_events;
+static TX_THREAD rx_thread;
+static UINT link_ready = 0;
+
+static gs_usb_dev_t gs_dev;
+static gs_usb_caps_t gs_caps;
+
+/* MODE requests, recorded in the USB ISR and applied by the USBX thread. */
+static volatile usb_gs_usb_cfg_t cfg_cmd = USB_GS_USB_CFG_NONE;
+static can_bus_bit_timing_t cfg_nominal;
+static can_bus_bit_timing_t cfg_data;
+static uint32_t cfg_mode;
+
+/* Frames towards the host (bus traffic + echoes). */
+static gs_usb_frame_t queue[USB_GS_USB_QUEUE_DEPTH];
+static UINT q_head = 0;
+static UINT q_tail = 0;
+static UINT q_overflow = 0;
+
+static usb_gs_usb_stats_t stats;
+
+static VOID usb_gs_usb_rx_thread_entry(ULONG thread_input);
+
+/* ---------------------------------- Queue --------------------------------- */
+
+static UINT usb_gs_usb_queue_push(const gs_usb_frame_t *f, UINT is_echo)
+{
+  TX_INTERRUPT_SAVE_AREA
+  UINT ok = 0;
+
+  TX_DISABLE
+  const UINT used = (q_head + USB_GS_USB_QUEUE_DEPTH - q_tail) % USB_GS_USB_QUEUE_DEPTH;
+  const UINT room = USB_GS_USB_QUEUE_DEPTH - 1U - used;
+  if (room > (is_echo ? 0U : USB_GS_USB_ECHO_RESERVE))
+  {
+    queue[q_head] = *f;
+    if (!is_echo && q_overflow)
+    {
+      queue[q_head].flags |= GS_USB_FLAG_OVERFLOW;
+      q_overflow = 0;
+    }
+    q_head = (q_head + 1U) % USB_GS_USB_QUEUE_DEPTH;
+    ok = 1;
+  }
+  else if (!is_echo)
+  {
+    q_overflow = 1;
+  }
+  TX_RESTORE
+
+  if (ok)
+  {
+    (void)tx_event_flags_set(&gs_events, USB_GS_USB_EVENT_TX, TX_OR);
+  }
+  else
+  {
+    stats.to_host_dropped++;
+  }
+  return ok;
+}
+
+static UINT usb_gs_usb_queue_pop(gs_usb_frame_t *f)
+{
+  TX_INTERRUPT_SAVE_AREA
+  UINT ok = 0;
+
+  TX_DISABLE
+  if (q_tail != q_head)
+  {
+    *f = queue[q_tail];
+    q_tail = (q_tail + 1U) % USB_GS_USB_QUEUE_DEPTH;
+    ok = 1;
+  }
+  TX_RESTORE
+  return ok;
+}
+
+static VOID usb_gs_usb_queue_flush(VOID)
+{
+  TX_INTERRUPT_SAVE_AREA
+
+  TX_DISABLE
+  q_tail = q_head;
+  q_overflow = 0;
+  TX_RESTORE
+}
+
+/* ------------------------------ Protocol ops ------------------------------ */
+
+/* Called from the USB ISR: validate nothing more than gs_usb_proto already
+   did, just hand the request to the USBX thread. */
+static int usb_gs_usb_op_start(void *user, const gs_usb_bittiming_t *nominal,
+                               const gs_usb_bittiming_t *data, uint32_t flags)
+{
+  UX_PARAMETER_NOT_USED(user);
+
+  cfg_nominal.prescaler = (uint16_t)nominal->brp;
+  cfg_nominal.tseg1 = (uint16_t)(nominal->prop_seg + nominal->phase_seg1);
+  cfg_nominal.tseg2 = (uint8_t)nominal->phase_seg2;
+  cfg_nominal.sjw = (uint8_t)nominal->sjw;
+
+  cfg_mode = 0;
+  if (data != NULL)
+  {
+    cfg_data.prescaler = (uint16_t)data->brp;
+    cfg_data.tseg1 = (uint16_t)(data->prop_seg + data->phase_seg1);
+    cfg_data.tseg2 = (uint8_t)data->phase_seg2;
+    cfg_data.sjw = (uint8_t)data->sjw;
+    cfg_mode |= CAN_BUS_MODE_FD;
+  }
+  if (flags & GS_USB_FEATURE_LISTEN_ONLY)
+  {
+    cfg_mode |= CAN_BUS_MODE_LISTEN_ONLY;
+  }
+  if (flags & GS_USB_FEATURE_LOOP_BACK)
+  {
+    cfg_mode |= CAN_BUS_MODE_LOOPBACK;
+  }
+  if (flags & GS_USB_FEATURE_ONE_SHOT)
+  {
+    cfg_mode |= CAN_BUS_MODE_ONE_SHOT;
+  }
+
+  cfg_cmd = USB_GS_USB_CFG_START;
+  (void)tx_event_flags_set(&gs_events, USB_GS_USB_EVENT_CFG, TX_OR);
+  return 0;
+}
+
+static void usb_gs_usb_op_stop(void *user)
+{
+  UX_PARAMETER_NOT_USED(user);
+  cfg_cmd = USB_GS_USB_CFG_STOP;
+  (void)tx_event_flags_set(&gs_events, USB_GS_USB_EVENT_CFG, TX_OR);
+}
+
+static uint32_t usb_gs_usb_op_timestamp(void *user)
+{
+  UX_PARAMETER_NOT_USED(user);
+  return (uint32_t)can_bus_time_us();
+}
+
+static void usb_gs_usb_op_get_state(void *user, uint32_t *state, uint32_t *rxerr,
+                                    uint32_t *txerr)
+{
+  UX_PARAMETER_NOT_USED(user);
+  can_bus_stats_t st;
+
+  can_bus_get_stats(&st);
+  *state = (uint32_t)st.state; /* same numbering as SocketCAN can_state */
+  *rxerr = st.rec;
+  *txerr = st.tec;
+}
+
+static const gs_usb_ops_t gs_ops = {
+  .start = usb_gs_usb_op_start,
+  .stop = usb_gs_usb_op_stop,
+  .timestamp_us = usb_gs_usb_op_timestamp,
+  .identify = NULL,
+  .get_state = usb_gs_usb_op_get_state,
+};
+
+/* Thread context: apply the last MODE request, if any. */
+static VOID usb_gs_usb_apply_config(VOID)
+{
+  TX_INTERRUPT_SAVE_AREA
+  can_bus_bit_timing_t nominal;
+  can_bus_bit_timing_t data;
+  uint32_t mode;
+
+  TX_DISABLE
+  const usb_gs_usb_cfg_t cmd = cfg_cmd;
+  cfg_cmd = USB_GS_USB_CFG_NONE;
+  nominal = cfg_nominal;
+  data = cfg_data;
+  mode = cfg_mode;
+  TX_RESTORE
+
+  if (cmd == USB_GS_USB_CFG_START)
+  {
+    usb_gs_usb_queue_flush();
+    if (can_bus_configure(&nominal, (mode & CAN_BUS_MODE_FD) ? &data : NULL, mode) != HAL_OK)
+    {
+      stats.config_errors++;
+    }
+    else
+    {
+      stats.starts++;
+    }
+  }
+  else if (cmd == USB_GS_USB_CFG_STOP)
+  {
+    usb_gs_usb_queue_flush();
+    (void)can_bus_restore_defaults();
+  }
+}
+
+/* ------------------------------ Bus -> host ------------------------------- */
+
+static void usb_gs_usb_on_frame(const can_bus_frame_t *frame, void *user)
+{
+  UX_PARAMETER_NOT_USED(user);
+  gs_usb_frame_t f;
+
+  if (!gs_dev.started)
+  {
+    return;
+  }
+
+  gs_usb_frame_from_bus(frame, GS_USB_ECHO_ID_RX, &f);
+
+  (void)usb_gs_usb_queue_push(&f, 0);
+}
+
+/* Runs in the USBX device application thread, which owns the bulk IN
+   endpoint. One host frame per transfer: the driver treats every completed
+   URB as exactly one frame.
+
+   A write blocks until the host polls IN. The driver keeps IN URBs queued
+   from interface up until it goes down and always has them queued before it
+   sends MODE start, so a pending MODE request is never stuck behind a stale
+   frame for longer than it takes the host to open the interface again. */
+VOID usb_gs_usb_tx_thread_entry(ULONG thread_input)
+{
+  UX_PARAMETER_NOT_USED(thread_input);
+  ULONG flags;
+  gs_usb_frame_t f;
+
+  for (;;)
+  {
+    (void)tx_event_flags_get(&gs_events, USB_GS_USB_EVENT_TX | USB_GS_USB_EVENT_CFG,
+                             TX_OR_CLEAR, &flags, TX_WAIT_FOREVER);
+
+    usb_gs_usb_apply_config();
+
+    while (usb_gs_usb_queue_pop(&f))
+    {
+      UX_SLAVE_ENDPOINT *ep = ep_in;
+      if (ep == UX_NULL || !gs_dev.started)
+      {
+        continue;
+      }
+
+      UX_SLAVE_TRANSFER *req = &ep->ux_slave_endpoint_transfer_request;
+      const ULONG n = gs_usb_frame_pack(&gs_dev, &f, req->ux_slave_transfer_request_data_pointer,
+                                        UX_SLAVE_REQUEST_DATA_MAX_LENGTH);
+      if (n == 0U || ux_device_stack_transfer_request(req, n, n) != UX_SUCCESS)
+      {
+        stats.to_host_errors++;
+      }
+      else
+      {
+        stats.to_host_frames++;
+      }
+
+      if (cfg_cmd != USB_GS_USB_CFG_NONE)
+      {
+        usb_gs_usb_apply_config();
+      }
+    }
+  }
+}
+
+/* ------------------------------ Host -> bus ------------------------------- */
+
+static VOID usb_gs_usb_to_bus(gs_usb_frame_t *hf)
+{
+  can_bus_frame_t f;
+  HAL_StatusTypeDef st;
+
+  gs_usb_frame_to_bus(hf, &f);
+
+  /* HAL_BUSY: TX FIFO full or controller recovering; give it a moment. */
+  st = can_bus_send_frame(&f);
+  for (UINT i = 0; st == HAL_BUSY && i < USB_GS_USB_TX_RETRY_TICKS; i++)
+  {
+    tx_thread_sleep(1);
+    st = can_bus_send_frame(&f);
+  }
+
+  if (st == HAL_OK)
+  {
+    stats.to_bus_frames++;
+  }
+  else
+  {
+    stats.to_bus_dropped++;
+  }
+
+  /* Echo regardless: the driver only frees a TX slot on the echo, and a
+     frame the controller refused is not going to be sent later either. */
+  hf->timestamp_us = (uint32_t)can_bus_time_us();
+  (void)usb_gs_usb_queue_push(hf, 1);
+}
+
+static VOID usb_gs_usb_rx_thread_entry(ULONG thread_input)
+{
+  UX_PARAMETER_NOT_USED(thread_input);
+  gs_usb_frame_t hf;
+
+  for (;;)
+  {
+    UX_SLAVE_ENDPOINT *ep = ep_out;
+    if (ep == UX_NULL)
+    {
+      tx_thread_sleep(10);
+      continue;
+    }
+
+    /* Frames are shorter than the request, so the short packet at the end
+       of each one completes the transfer. */
+    UX_SLAVE_TRANSFER *req = &ep->ux_slave_endpoint_transfer_request;
+    if (ux_device_stack_transfer_request(req, GS_USB_FRAME_MAX_LEN, GS_USB_FRAME_MAX_LEN) != UX_SUCCESS)
+    {
+      tx_thread_sleep(1);
+      continue;
+    }
+
+    if (gs_usb_frame_unpack(req->ux_slave_transfer_request_data_pointer,
+                            req->ux_slave_transfer_request_actual_length, &hf) != 0 ||
+        hf.channel != 0U)
+    {
+      stats.bad_frames++;
+      continue;
+    }
+    if (!gs_dev.started)
+    {
+      continue;
+    }
+    usb_gs_usb_to_bus(&hf);
+  }
+}
+
+/* ------------------------------ Vendor class ------------------------------ */
+
+static UINT usb_gs_usb_activate(UX_SLAVE_CLASS_COMMAND *command)
+{
+  UX_SLAVE_INTERFACE *interface_ptr = (UX_SLAVE_INTERFACE *)command->ux_slave_class_command_interface;
+  UX_SLAVE_ENDPOINT *endpoint = interface_ptr->ux_slave_interface_first_endpoint;
+
+  while (endpoint != UX_NULL)
+  {
+    if ((endpoint->ux_slave_endpoint_descriptor.bmAttributes & UX_MASK_ENDPOINT_TYPE) == UX_BULK_ENDPOINT)
+    {
+      if ((endpoint->ux_slave_endpoint_descriptor.bEndpointAddress & UX_ENDPOINT_DIRECTION) == UX_ENDPOINT_IN)
+      {
+        ep_in = endpoint;
+      }
+      else
+      {
+        ep_out = endpoint;
+      }
+    }
+    endpoint = endpoint->ux_slave_endpoint_next_endpoint;
+  }
+
+  return (ep_in != UX_NULL && ep_out != UX_NULL) ? UX_SUCCESS : UX_DESCRIPTOR_CORRUPTED;
+}
+
+static VOID usb_gs_usb_deactivate(VOID)
+{
+  ep_in = UX_NULL;
+  ep_out = UX_NULL;
+
+  /* Unplugged while started: hand the bus back to the gateway. */
+  if (gs_dev.started)
+  {
+    gs_dev.started = 0;
+    gs_dev.mode_flags = 0;
+    usb_gs_usb_op_stop(NULL);
+  }
+}
+
+static UINT usb_gs_usb_control(VOID)
+{
+  UX_SLAVE_DEVICE *device = &_ux_system_slave->ux_system_slave_device;
+  UX_SLAVE_TRANSFER *req = &device->ux_slave_device_control_endpoint.ux_slave_endpoint_transfer_request;
+  const UCHAR *setup = req->ux_slave_transfer_request_setup;
+
+  if ((setup[UX_SETUP_REQUEST_TYPE] & UX_REQUEST_TYPE) != UX_REQUEST_TYPE_VENDOR)
+  {
+    return UX_ERROR;
+  }
+
+  const UCHAR request = setup[UX_SETUP_REQUEST];
+  const USHORT value = (USHORT)(setup[UX_SETUP_VALUE] | (setup[UX_SETUP_VALUE + 1U] << 8));
+  const ULONG length = (ULONG)(setup[UX_SETUP_LENGTH] | (setup[UX_SETUP_LENGTH + 1U] << 8));
+  int n;
+
+  if (setup[UX_SETUP_REQUEST_TYPE] & UX_REQUEST_IN)
+  {
+    n = gs_usb_control(&gs_dev, request, value, NULL, 0,
+                       req->ux_slave_transfer_request_data_pointer,
+                       UX_SLAVE_REQUEST_CONTROL_MAX_LENGTH);
+    if (n >= 0)
+    {
+      (void)ux_device_stack_transfer_request(req, ((ULONG)n < length) ? (ULONG)n : length, length);
+    }
+  }
+  else
+  {
+    /* The DCD has already collected the data stage. */
+    n = gs_usb_control(&gs_dev, request, value, req->ux_slave_transfer_request_data_pointer,
+                       req->ux_slave_transfer_request_actual_length, NULL, 0);
+  }
+
+  if (n < 0)
+  {
+    stats.control_stalls++;
+    (void)ux_device_stack_endpoint_stall(&device->ux_slave_device_control_endpoint);
+  }
+  return UX_SUCCESS;
+}
+
+UINT usb_gs_usb_class_entry(UX_SLAVE_CLASS_COMMAND *command)
+{
+  switch (command->ux_slave_class_command_request)
+  {
+    case UX_SLAVE_CLASS_COMMAND_INITIALIZE:
+    case UX_SLAVE_CLASS_COMMAND_UNINITIALIZE:
+    case UX_SLAVE_CLASS_COMMAND_CHANGE:
+      return UX_SUCCESS;
+
+    case UX_SLAVE_CLASS_COMMAND_QUERY:
+      return (command->ux_slave_class_command_class == 0xFFU) ? UX_SUCCESS : UX_NO_CLASS_MATCH;
+
+    case UX_SLAVE_CLASS_COMMAND_ACTIVATE:
+      return usb_gs_usb_activate(command);
+
+    case UX_SLAVE_CLASS_COMMAND_DEACTIVATE:
+      usb_gs_usb_deactivate();
+      return UX_SUCCESS;
+
+    case UX_SLAVE_CLASS_COMMAND_REQUEST:
+      return usb_gs_usb_control();
+
+    default:
+      return UX_FUNCTION_NOT_SUPPORTED;
+  }
+}
+
+/* ---------------------------------- Setup --------------------------------- */
+
+UINT usb_gs_usb_init(TX_BYTE_POOL *byte_pool)
+{
+  VOID *stack;
+
+  /* FDCAN limits (RM0440 NBTP/DBTP), in the units gs_usb reports them. */
+  gs_caps.features = USB_GS_USB_FEATURES;
+  gs_caps.fclk_can = can_bus_clock_hz();
+  gs_caps.nominal = (gs_usb_bt_const_t){ 1U, 256U, 1U, 128U, 128U, 1U, 512U, 1U };
+  gs_caps.data = (gs_usb_bt_const_t){ 1U, 32U, 1U, 16U, 16U, 1U, 32U, 1U };
+  gs_caps.sw_version = 2U;
+  gs_caps.hw_version = 1U;
+  gs_usb_init(&gs_dev, &gs_caps, &gs_ops, NULL);
+
+  if (tx_event_flags_create(&gs_events, "gs_usb") != TX_SUCCESS)
+  {
+    return UX_ERROR;
+  }
+  if (tx_byte_allocate(byte_pool, &stack, USB_GS_USB_RX_STACK_SIZE, TX_NO_WAIT) != TX_SUCCESS)
+  {
+    return TX_POOL_ERROR;
+  }
+  if (tx_thread_create(&rx_thread, "USB gs_usb OUT", usb_gs_usb_rx_thread_entry, 0,
+                       stack, USB_GS_USB_RX_STACK_SIZE, UX_DEVICE_APP_THREAD_PRIO,
+                       UX_DEVICE_APP_THREAD_PRIO, TX_NO_TIME_SLICE, TX_AUTO_START) != TX_SUCCESS)
+  {
+    return TX_THREAD_ERROR;
+  }
+  if (can_bus_subscribe_frames(usb_gs_usb_on_frame, NULL) != HAL_OK)
+  {
+    return UX_ERROR;
+  }
+
+  link_ready = 1;
+  return UX_SUCCESS;
+}
+
+uint8_t usb_gs_usb_started(void)
+{
+  return (link_ready && gs_dev.started) ? 1U : 0U;
+}
+
+void usb_gs_usb_get_stats(usb_gs_usb_stats_t *out)
+{
+  if (!out)
+  {
+    return;
+  }
+  *out = stats;
+}
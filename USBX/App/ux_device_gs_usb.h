@@ -0,0 +1,72 @@
+/* ux_device_gs_usb.h
+ *
+ * gs_usb (candleLight) USB-CAN adapter on the USB FS port.
+ *
+ * The gateway enumerates as a device the Linux gs_usb driver binds to, so
+ * candump/cansend/`ip link set canX type can bitrate ...` work against the
+ * bus the gateway sits on. Protocol details live in gs_usb_proto.c; this
+ * file is the USBX vendor class and the glue to can_bus.
+ *
+ *  - Bus -> host: a can_bus frame subscriber queues every frame (including
+ *    the gateway's own transmissions) with its ISR timestamp; the USBX
+ *    thread writes one host frame per bulk IN transfer.
+ *  - Host -> bus: a dedicated thread reads bulk OUT, sends through
+ *    can_bus_send_frame() and queues the echo the driver waits for.
+ *  - Control requests arrive in USB interrupt context. MODE start/reset only
+ *    record the request; the USBX thread applies it with can_bus_configure()
+ *    / can_bus_restore_defaults(). When the host stops or unplugs, the bus
+ *    goes back to the gateway's own configuration.
+ */
+#ifndef __UX_DEVICE_GS_USB_H__
+#define __UX_DEVICE_GS_USB_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ux_api.h"
+#include "stm32g4xx_hal.h"
+
+#include <stdint.h>
+
+#ifndef USB_GS_USB_QUEUE_DEPTH
+#define USB_GS_USB_QUEUE_DEPTH       32U /* frames towards the host */
+#endif
+
+#ifndef USB_GS_USB_RX_STACK_SIZE
+#define USB_GS_USB_RX_STACK_SIZE     1024U
+#endif
+
+/* How long a host frame may wait for room in the FDCAN TX FIFO. */
+#ifndef USB_GS_USB_TX_RETRY_TICKS
+#define USB_GS_USB_TX_RETRY_TICKS    10U
+#endif
+
+typedef struct {
+  uint32_t to_host_frames;
+  uint32_t to_host_dropped; /* queue full, reported as overflow */
+  uint32_t to_host_errors;  /* bulk IN transfer failed */
+  uint32_t to_bus_frames;
+  uint32_t to_bus_dropped;  /* FDCAN refused the frame (echoed anyway) */
+  uint32_t bad_frames;      /* malformed OUT transfers */
+  uint32_t control_stalls;
+  uint32_t starts;
+  uint32_t config_errors;   /* can_bus_configure() failed after MODE start */
+} usb_gs_usb_stats_t;
+
+/* 1 while the host has the channel started. */
+uint8_t usb_gs_usb_started(void);
+
+void usb_gs_usb_get_stats(usb_gs_usb_stats_t *out);
+
+/* USBX glue, used by app_usbx_device.c */
+extern UCHAR usb_gs_usb_class_name[];
+UINT usb_gs_usb_class_entry(UX_SLAVE_CLASS_COMMAND *command);
+UINT usb_gs_usb_init(TX_BYTE_POOL *byte_pool);
+VOID usb_gs_usb_tx_thread_entry(ULONG thread_input);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UX_DEVICE_GS_USB_H__ */
@@ -0,0 +1,105 @@
+// capture_export.cpp
+
+#include "capture_export.h"
+
+namespace gwcap {
+
+// =========================
+// candump
+// =========================
+
+bool candump_sink::write(uint64_t t_us, const can_frame &f) {
+  char line[256];
+  int n = std::snprintf(line, sizeof(line), "(%llu.%06llu) %s ",
+                        (unsigned long long)(t_us / 1000000u),
+                        (unsigned long long)(t_us % 1000000u), iface_.c_str());
+
+  if (f.flags & CAN_F_EXT)
+    n += std::snprintf(line + n, sizeof(line) - n, "%08X", f.id & 0x1FFFFFFFu);
+  else
+    n += std::snprintf(line + n, sizeof(line) - n, "%03X", f.id & 0x7FFu);
+
+  if (f.flags & CAN_F_RTR) {
+    n += std::snprintf(line + n, sizeof(line) - n, "#R");
+  } else {
+    if (f.flags & CAN_F_FD) {
+      const unsigned fd_flags =
+          ((f.flags & CAN_F_BRS) ? 1u : 0u) | ((f.flags & CAN_F_ESI) ? 2u : 0u);
+      n += std::snprintf(line + n, sizeof(line) - n, "##%X", fd_flags);
+    } else {
+      line[n++] = '#';
+    }
+    static const char hex[] = "0123456789ABCDEF";
+    for (uint8_t i = 0; i < f.len && i < 64; i++) {
+      line[n++] = hex[f.data[i] >> 4];
+      line[n++] = hex[f.data[i] & 0xF];
+    }
+  }
+  line[n++] = '\n';
+  return std::fwrite(line, 1, size_t(n), out_) == size_t(n);
+}
+
+// =========================
+// pcap
+// =========================
+
+static void put_le32(uint8_t *p, uint32_t v) {
+  p[0] = uint8_t(v);
+  p[1] = uint8_t(v >> 8);
+  p[2] = uint8_t(v >> 16);
+  p[3] = uint8_t(v >> 24);
+}
+
+static void put_be32(uint8_t *p, uint32_t v) {
+  p[0] = uint8_t(v >> 24);
+  p[1] = uint8_t(v >> 16);
+  p[2] = uint8_t(v >> 8);
+  p[3] = uint8_t(v);
+}
+
+constexpr uint32_t kLinktypeCanSocketcan = 227;
+
+pcap_sink::pcap_sink(std::FILE *out) : out_(out) {
+  uint8_t gh[24] = {};
+  put_le32(gh, 0xA1B2C3D4u); // microsecond timestamps
+  gh[4] = 2;                 // version 2.4
+  gh[6] = 4;
+  put_le32(gh + 16, 72); // snaplen: largest canfd_frame
+  put_le32(gh + 20, kLinktypeCanSocketcan);
+  ok_ = std::fwrite(gh, 1, sizeof(gh), out_) == sizeof(gh);
+}
+
+bool pcap_sink::write(uint64_t t_us, const can_frame &f) {
+  if (!ok_)
+    return false;
+
+  const bool fd = (f.flags & CAN_F_FD) != 0;
+  const uint32_t cap = fd ? 72u : 16u;
+  uint8_t rec[16 + 72] = {};
+
+  put_le32(rec, uint32_t(t_us / 1000000u));
+  put_le32(rec + 4, uint32_t(t_us % 1000000u));
+  put_le32(rec + 8, cap);
+  put_le32(rec + 12, cap);
+
+  uint8_t *frame = rec + 16;
+  uint32_t can_id = (f.flags & CAN_F_EXT) ? ((f.id & 0x1FFFFFFFu) | 0x80000000u)
+                                          : (f.id & 0x7FFu);
+  if (f.flags & CAN_F_RTR)
+    can_id |= 0x40000000u;
+  put_be32(frame, can_id);
+
+  const uint8_t len = f.len > (fd ? 64 : 8) ? (fd ? 64 : 8) : f.len;
+  frame[4] = len;
+  if (fd) {
+    // canfd_frame.flags: CANFD_BRS 0x01, CANFD_ESI 0x02, CANFD_FDF 0x04
+    frame[5] = uint8_t(0x04u | ((f.flags & CAN_F_BRS) ? 0x01u : 0u) |
+                       ((f.flags & CAN_F_ESI) ? 0x02u : 0u));
+  }
+  if (!(f.flags & CAN_F_RTR))
+    std::memcpy(frame + 8, f.data, len);
+
+  return std::fwrite(rec, 1, 16 + cap, out_) == 16 + cap;
+}
+
+} // namespace gwcap
@@ -0,0 +1,46 @@
+// capture_export.h
+//
+// CAN frame exporters: candump log format (can-utils canplayer/log2asc) and
+// pcap with LINKTYPE_CAN_SOCKETCAN (Wireshark).
+
+#pragma once
+
+#include "capture_writer.h"
+
+#include <cstdio>
+#include <string>
+
+namespace gwcap {
+
+class frame_sink {
+public:
+  virtual ~frame_sink() = default;
+  virtual bool write(uint64_t t_us, const can_frame &f) = 0;
+};
+
+// "(1700000000.123456) can0 123#DEADBEEF", FD frames as "123##<flags><data>",
+// remote frames as "123#R".
+class candump_sink : public frame_sink {
+public:
+  candump_sink(std::FILE *out, std::string iface)
+      : out_(out), iface_(std::move(iface)) {}
+  bool write(uint64_t t_us, const can_frame &f) override;
+
+private:
+  std::FILE *out_;
+  std::string iface_;
+};
+
+// Classic frames as 16-byte struct can_frame, FD frames as 72-byte struct
+// canfd_frame; can_id is big endian with the SocketCAN EFF/RTR bits.
+class pcap_sink : public frame_sink {
+public:
+  explicit pcap_sink(std::FILE *out);
+  bool write(uint64_t t_us, const can_frame &f) override;
+
+private:
+  std::FILE *out_;
+  bool ok_;
+};
+
+} // namespace gwcap
@@ -0,0 +1,138 @@
+// capture_format.h
+//
+// On-disk layout of a gateway capture (.gwcap). All integers little endian,
+// every record 8-byte aligned so a mapped file can be walked in place.
+//
+//   [file header, 64 B]
+//   [block] [checkpoint] [block] [checkpoint] ...
+//   [index table: index_entry * count] [trailer, 32 B]
+//
+// A block is a run of records. The writer closes it after
+// block_bytes of payload or block_span_us of host time, whichever comes
+// first, and appends a CHECKPOINT record describing it (time range, record
+// count, a 256-bit bloom of the CAN IDs inside). The checkpoint carries a
+// sync word and the offset of the previous one, so a capture that was never
+// closed (power cut, kill -9) can still be indexed by scanning backwards from
+// EOF for the last checkpoint and following the chain.
+//
+// On a clean close the checkpoints are also copied into a contiguous index
+// table found through the trailer, which is what readers use first.
+//
+// Record:
+//   [t_us u64: host receive time, unix µs] [type u16] [flags u16] [len u32]
+//   [payload: len bytes] [pad to 8]
+//
+// CAN payload:     [dev_ts_us u64] [id u32] [flags u8] [len u8] [pad u16]
+//                  [data: len bytes]            flags: CAN_BUS_FRAME_F_*
+// ROUTER payload:  serialized sedsprintf packet, as received.
+// CHECKPOINT:      index_entry.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace gwcap {
+
+constexpr char kFileMagic[8] = {'G', 'W', 'C', 'A', 'P', '0', '0', '1'};
+constexpr char kTrailerMagic[8] = {'G', 'W', 'C', 'A', 'P', 'E', 'N', 'D'};
+constexpr uint32_t kVersion = 1;
+
+// First word of every checkpoint payload; what crash recovery scans for.
+constexpr uint64_t kCheckpointSync = 0x4B504B4348435747ull; // "GWCHCKPK"
+
+enum record_type : uint16_t {
+  REC_CAN = 1,
+  REC_ROUTER = 2,
+  REC_CHECKPOINT = 3,
+};
+
+// CAN frame flags, same values as CAN_BUS_FRAME_F_* in can_bus.h.
+enum can_flag : uint8_t {
+  CAN_F_EXT = 0x01,
+  CAN_F_RTR = 0x02,
+  CAN_F_FD = 0x04,
+  CAN_F_BRS = 0x08,
+  CAN_F_ESI = 0x10,
+  CAN_F_TX = 0x20, // sent by the gateway itself
+};
+
+#pragma pack(push, 1)
+
+struct file_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_len;
+  uint64_t created_unix_us;
+  uint32_t block_bytes;
+  uint32_t block_span_us;
+  uint8_t reserved[32];
+};
+static_assert(sizeof(file_header) == 64, "file_header layout");
+
+struct record_header {
+  uint64_t t_us;
+  uint16_t type;
+  uint16_t flags;
+  uint32_t len;
+};
+static_assert(sizeof(record_header) == 16, "record_header layout");
+
+struct can_record {
+  uint64_t dev_ts_us;
+  uint32_t id;
+  uint8_t flags;
+  uint8_t len;
+  uint16_t pad;
+  // data[len] follows
+};
+static_assert(sizeof(can_record) == 16, "can_record layout");
+
+struct index_entry {
+  uint64_t sync;            // kCheckpointSync
+  uint64_t block_off;       // first record of the block
+  uint64_t block_end;       // offset of this checkpoint record
+  uint64_t prev_checkpoint; // previous checkpoint record, 0 for the first
+  uint64_t t_first_us;
+  uint64_t t_last_us;
+  uint32_t records;
+  uint32_t can_records;
+  uint8_t id_bloom[32];
+};
+static_assert(sizeof(index_entry) == 88, "index_entry layout");
+
+struct trailer {
+  char magic[8];
+  uint64_t index_off;
+  uint64_t index_count;
+  uint64_t file_len; // sanity check against truncation/appends
+};
+static_assert(sizeof(trailer) == 32, "trailer layout");
+
+#pragma pack(pop)
+
+constexpr size_t align8(size_t n) { return (n + 7u) & ~size_t(7); }
+
+// Two probes into a 256-bit bloom. Cheap, and at a few hundred distinct IDs
+// per block the false positive rate stays low enough to skip most blocks.
+inline void bloom_probes(uint32_t id, uint8_t &a, uint8_t &b) {
+  uint32_t h = id * 0x9E3779B1u;
+  a = uint8_t(h >> 24);
+  b = uint8_t((h ^ (h >> 15)) * 0x85EBCA6Bu >> 24);
+}
+
+inline void bloom_add(uint8_t bloom[32], uint32_t id) {
+  uint8_t a, b;
+  bloom_probes(id, a, b);
+  bloom[a >> 3] |= uint8_t(1u << (a & 7));
+  bloom[b >> 3] |= uint8_t(1u << (b & 7));
+}
+
+inline bool bloom_maybe(const uint8_t bloom[32], uint32_t id) {
+  uint8_t a, b;
+  bloom_probes(id, a, b);
+  return (bloom[a >> 3] & (1u << (a & 7))) && (bloom[b >> 3] & (1u << (b & 7)));
+}
+
+} // namespace gwcap
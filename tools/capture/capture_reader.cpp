@@ -0,0 +1,256 @@
+// capture_reader.cpp
+
+#include "capture_reader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace gwcap {
+
+template <typename T> static T load(const uint8_t *p) {
+  T v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+capture_reader::~capture_reader() { close(); }
+
+void capture_reader::close() {
+  if (base_)
+    munmap(const_cast<uint8_t *>(base_), size_);
+  if (fd_ >= 0)
+    ::close(fd_);
+  base_ = nullptr;
+  fd_ = -1;
+  size_ = 0;
+  blocks_.clear();
+  tail_ = index_entry{};
+  source_ = index_source::none;
+}
+
+bool capture_reader::open(const std::string &path) {
+  close();
+
+  fd_ = ::open(path.c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    error_ = path + ": " + std::strerror(errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd_, &st) != 0 || st.st_size < (off_t)sizeof(file_header)) {
+    error_ = path + ": not a capture (too short)";
+    close();
+    return false;
+  }
+  size_ = uint64_t(st.st_size);
+
+  void *m = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+  if (m == MAP_FAILED) {
+    error_ = path + ": mmap: " + std::strerror(errno);
+    size_ = 0;
+    close();
+    return false;
+  }
+  base_ = static_cast<const uint8_t *>(m);
+
+  hdr_ = load<file_header>(base_);
+  if (std::memcmp(hdr_.magic, kFileMagic, sizeof(kFileMagic)) != 0 ||
+      hdr_.version != kVersion || hdr_.header_len < sizeof(file_header) ||
+      hdr_.header_len > size_) {
+    error_ = path + ": not a capture (bad header)";
+    close();
+    return false;
+  }
+
+  if (load_footer()) {
+    source_ = index_source::footer;
+  } else {
+    recover_index();
+    source_ = blocks_.empty() ? index_source::none : index_source::recovered;
+  }
+  return true;
+}
+
+bool capture_reader::record_at(uint64_t off, uint64_t end,
+                               record_view &out) const {
+  if (off + sizeof(record_header) > end)
+    return false;
+  const record_header rh = load<record_header>(base_ + off);
+  const uint64_t next = off + sizeof(record_header) + align8(rh.len);
+  if (next > end || next <= off)
+    return false;
+  out.off = off;
+  out.t_us = rh.t_us;
+  out.type = rh.type;
+  out.payload = base_ + off + sizeof(record_header);
+  out.len = rh.len;
+  return true;
+}
+
+bool capture_reader::checkpoint_at(uint64_t off, index_entry &out) const {
+  record_view r;
+  if (off < hdr_.header_len || !record_at(off, size_, r))
+    return false;
+  if (r.type != REC_CHECKPOINT || r.len != sizeof(index_entry))
+    return false;
+  out = load<index_entry>(r.payload);
+  return out.sync == kCheckpointSync && out.block_end == off &&
+         out.block_off <= off && out.prev_checkpoint < off;
+}
+
+bool capture_reader::load_footer() {
+  if (size_ < hdr_.header_len + sizeof(trailer))
+    return false;
+  const trailer tr = load<trailer>(base_ + size_ - sizeof(trailer));
+  if (std::memcmp(tr.magic, kTrailerMagic, sizeof(kTrailerMagic)) != 0 ||
+      tr.file_len != size_ ||
+      tr.index_off + tr.index_count * sizeof(index_entry) + sizeof(trailer) !=
+          size_)
+    return false;
+
+  blocks_.resize(tr.index_count);
+  for (uint64_t i = 0; i < tr.index_count; i++) {
+    blocks_[i] =
+        load<index_entry>(base_ + tr.index_off + i * sizeof(index_entry));
+    if (blocks_[i].sync != kCheckpointSync) {
+      blocks_.clear();
+      return false;
+    }
+  }
+  tail_ = index_entry{};
+  tail_.block_off = tail_.block_end = tr.index_off;
+  return true;
+}
+
+void capture_reader::recover_index() {
+  blocks_.clear();
+
+  // Newest checkpoint: the last sync word that sits inside a well-formed
+  // checkpoint record pointing back at itself.
+  uint64_t last = 0;
+  index_entry e;
+  for (uint64_t o = (size_ & ~uint64_t(7)); o >= hdr_.header_len + 16 + 8;) {
+    o -= 8;
+    if (load<uint64_t>(base_ + o) == kCheckpointSync &&
+        checkpoint_at(o - sizeof(record_header), e)) {
+      last = o - sizeof(record_header);
+      break;
+    }
+  }
+
+  for (uint64_t at = last; at != 0; at = e.prev_checkpoint) {
+    if (!checkpoint_at(at, e))
+      break;
+    blocks_.push_back(e);
+  }
+  std::reverse(blocks_.begin(), blocks_.end());
+  // A broken chain leaves a gap before the oldest block we found; treat the
+  // whole file as tail rather than silently skipping records.
+  if (!blocks_.empty() && blocks_.front().prev_checkpoint != 0)
+    blocks_.clear();
+  if (!blocks_.empty() && blocks_.front().block_off != hdr_.header_len)
+    blocks_.clear();
+
+  // Whatever follows the last checkpoint, up to the last complete record.
+  // Stop at anything that is not a record we write: an index table whose
+  // trailer was cut off would otherwise parse as records.
+  tail_ = index_entry{};
+  tail_.block_off = blocks_.empty()
+                        ? hdr_.header_len
+                        : blocks_.back().block_end + sizeof(record_header) +
+                              sizeof(index_entry);
+  tail_.t_first_us = std::numeric_limits<uint64_t>::max();
+  uint64_t o = tail_.block_off;
+  record_view r;
+  while (record_at(o, size_, r) && r.type >= REC_CAN &&
+         r.type <= REC_CHECKPOINT) {
+    if (r.type != REC_CHECKPOINT) {
+      tail_.records++;
+      tail_.t_first_us = std::min(tail_.t_first_us, r.t_us);
+      tail_.t_last_us = std::max(tail_.t_last_us, r.t_us);
+      if (r.type == REC_CAN)
+        tail_.can_records++;
+    }
+    o += sizeof(record_header) + align8(r.len);
+  }
+  tail_.block_end = o;
+  if (tail_.records == 0)
+    tail_.t_first_us = 0;
+}
+
+bool capture_reader::decode_can(const record_view &r, can_frame &out) {
+  if (r.type != REC_CAN || r.len < sizeof(can_record))
+    return false;
+  const can_record cr = load<can_record>(r.payload);
+  if (cr.len > 64 || r.len < sizeof(can_record) + cr.len)
+    return false;
+  out.dev_ts_us = cr.dev_ts_us;
+  out.id = cr.id;
+  out.flags = cr.flags;
+  out.len = cr.len;
+  std::memcpy(out.data, r.payload + sizeof(can_record), cr.len);
+  return true;
+}
+
+uint64_t capture_reader::scan_range(
+    uint64_t off, uint64_t end, const query &q,
+    const std::function<bool(const record_view &)> &cb, bool &stop) const {
+  const bool can_only = q.can_only || !q.ids.empty();
+  uint64_t n = 0;
+  record_view r;
+  while (!stop && record_at(off, end, r)) {
+    off += sizeof(record_header) + align8(r.len);
+    if (r.type == REC_CHECKPOINT || r.t_us < q.from_us || r.t_us > q.to_us)
+      continue;
+    if (can_only && r.type != REC_CAN)
+      continue;
+    if (!q.ids.empty()) {
+      if (r.len < sizeof(can_record))
+        continue;
+      const uint32_t id = load<uint32_t>(r.payload + 8);
+      if (std::find(q.ids.begin(), q.ids.end(), id) == q.ids.end())
+        continue;
+    }
+    n++;
+    if (!cb(r))
+      stop = true;
+  }
+  return n;
+}
+
+uint64_t
+capture_reader::scan(const query &q,
+                     const std::function<bool(const record_view &)> &cb) const {
+  if (!base_)
+    return 0;
+
+  bool stop = false;
+  uint64_t n = 0;
+  for (const index_entry &b : blocks_) {
+    if (stop)
+      break;
+    if (b.records == 0 || b.t_last_us < q.from_us || b.t_first_us > q.to_us)
+      continue;
+    if (!q.ids.empty()) {
+      if (b.can_records == 0)
+        continue;
+      bool maybe = false;
+      for (uint32_t id : q.ids)
+        maybe = maybe || bloom_maybe(b.id_bloom, id);
+      if (!maybe)
+        continue;
+    }
+    madvise(const_cast<uint8_t *>(base_) + (b.block_off & ~uint64_t(4095)),
+            b.block_end - (b.block_off & ~uint64_t(4095)), MADV_SEQUENTIAL);
+    n += scan_range(b.block_off, b.block_end, q, cb, stop);
+  }
+  if (!stop && tail_.block_end > tail_.block_off)
+    n += scan_range(tail_.block_off, tail_.block_end, q, cb, stop);
+  return n;
+}
+
+} // namespace gwcap
@@ -0,0 +1,86 @@
+// capture_reader.h
+//
+// Memory-mapped access to a .gwcap file. Queries are answered from the block
+// index: blocks whose time range or CAN ID bloom cannot match are skipped
+// without touching their pages, the rest are walked record by record.
+
+#pragma once
+
+#include "capture_format.h"
+#include "capture_writer.h"
+
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace gwcap {
+
+struct record_view {
+  uint64_t off; // of the record header
+  uint64_t t_us;
+  uint16_t type;
+  const uint8_t *payload;
+  uint32_t len;
+};
+
+struct query {
+  uint64_t from_us = 0;
+  uint64_t to_us = std::numeric_limits<uint64_t>::max(); // inclusive
+  std::vector<uint32_t> ids; // empty: any; non-empty implies CAN only
+  bool can_only = false;
+};
+
+enum class index_source {
+  footer,    // clean close
+  recovered, // rebuilt from the checkpoint chain
+  none,      // no checkpoint at all; everything is tail
+};
+
+class capture_reader {
+public:
+  capture_reader() = default;
+  ~capture_reader();
+  capture_reader(const capture_reader &) = delete;
+  capture_reader &operator=(const capture_reader &) = delete;
+
+  bool open(const std::string &path);
+  void close();
+
+  const std::string &error() const { return error_; }
+  const file_header &header() const { return hdr_; }
+  uint64_t size() const { return size_; }
+
+  // Indexed blocks in file order. Records written after the last checkpoint
+  // of an unclosed capture are in tail(), which has no bloom.
+  const std::vector<index_entry> &blocks() const { return blocks_; }
+  const index_entry &tail() const { return tail_; }
+  index_source source() const { return source_; }
+
+  // Calls cb for every matching record in file order; stop early by
+  // returning false. Returns the number of records passed to cb.
+  uint64_t scan(const query &q,
+                const std::function<bool(const record_view &)> &cb) const;
+
+  static bool decode_can(const record_view &r, can_frame &out);
+
+private:
+  bool load_footer();
+  void recover_index();
+  bool checkpoint_at(uint64_t off, index_entry &out) const;
+  bool record_at(uint64_t off, uint64_t end, record_view &out) const;
+  uint64_t scan_range(uint64_t off, uint64_t end, const query &q,
+                      const std::function<bool(const record_view &)> &cb,
+                      bool &stop) const;
+
+  int fd_ = -1;
+  const uint8_t *base_ = nullptr;
+  uint64_t size_ = 0;
+  std::string error_;
+  file_header hdr_{};
+  std::vector<index_entry> blocks_;
+  index_entry tail_{};
+  index_source source_ = index_source::none;
+};
+
+} // namespace gwcap
@@ -0,0 +1,179 @@
+// capture_writer.cpp
+
+#include "capture_writer.h"
+
+#include <cerrno>
+#include <chrono>
+
+namespace gwcap {
+
+static uint64_t unix_now_us() {
+  using namespace std::chrono;
+  return uint64_t(
+      duration_cast<microseconds>(system_clock::now().time_since_epoch())
+          .count());
+}
+
+capture_writer::~capture_writer() {
+  if (fp_)
+    close();
+}
+
+bool capture_writer::open(const std::string &path, const writer_options &opt) {
+  if (fp_)
+    close();
+
+  fp_ = std::fopen(path.c_str(), "wb");
+  if (!fp_) {
+    error_ = path + ": " + std::strerror(errno);
+    return false;
+  }
+  buf_.resize(1u << 20);
+  std::setvbuf(fp_, buf_.data(), _IOFBF, buf_.size());
+
+  opt_ = opt;
+  off_ = 0;
+  records_ = 0;
+  cur_open_ = false;
+  last_checkpoint_ = 0;
+  index_.clear();
+
+  file_header h{};
+  std::memcpy(h.magic, kFileMagic, sizeof(h.magic));
+  h.version = kVersion;
+  h.header_len = sizeof(h);
+  h.created_unix_us = unix_now_us();
+  h.block_bytes = opt_.block_bytes;
+  h.block_span_us = opt_.block_span_us;
+  if (!put(&h, sizeof(h)))
+    return false;
+  flush();
+  return true;
+}
+
+bool capture_writer::put(const void *p, size_t n) {
+  if (n && std::fwrite(p, 1, n, fp_) != n) {
+    error_ = std::string("write failed: ") + std::strerror(errno);
+    return false;
+  }
+  off_ += n;
+  return true;
+}
+
+void capture_writer::flush() {
+  if (fp_)
+    std::fflush(fp_);
+}
+
+void capture_writer::note(uint64_t t_us, bool can, uint32_t id) {
+  if (!cur_open_) {
+    cur_ = index_entry{};
+    cur_.sync = kCheckpointSync;
+    cur_.block_off = off_;
+    cur_.prev_checkpoint = last_checkpoint_;
+    cur_.t_first_us = t_us;
+    cur_.t_last_us = t_us;
+    cur_open_ = true;
+  }
+  if (t_us > cur_.t_last_us)
+    cur_.t_last_us = t_us;
+  cur_.records++;
+  if (can) {
+    cur_.can_records++;
+    bloom_add(cur_.id_bloom, id);
+  }
+}
+
+bool capture_writer::write_record(uint64_t t_us, uint16_t type, const void *a,
+                                  size_t a_len, const void *b, size_t b_len) {
+  static const uint8_t zeros[8] = {};
+
+  record_header rh{};
+  rh.t_us = t_us;
+  rh.type = type;
+  rh.len = uint32_t(a_len + b_len);
+  const size_t pad = align8(rh.len) - rh.len;
+
+  if (!put(&rh, sizeof(rh)) || !put(a, a_len) || !put(b, b_len) ||
+      !put(zeros, pad))
+    return false;
+  records_++;
+  return true;
+}
+
+// Close the block before the record that would overflow it. A host clock
+// step backwards also starts a new block (the unsigned difference wraps).
+bool capture_writer::roll(uint64_t t_us) {
+  if (cur_open_ && (off_ - cur_.block_off >= opt_.block_bytes ||
+                    t_us - cur_.t_first_us >= opt_.block_span_us))
+    return checkpoint();
+  return true;
+}
+
+bool capture_writer::add_can(uint64_t t_us, const can_frame &f) {
+  if (!fp_)
+    return false;
+
+  if (!roll(t_us))
+    return false;
+  note(t_us, true, f.id);
+
+  can_record cr{};
+  cr.dev_ts_us = f.dev_ts_us;
+  cr.id = f.id;
+  cr.flags = f.flags;
+  cr.len = f.len > 64 ? 64 : f.len;
+  return write_record(t_us, REC_CAN, &cr, sizeof(cr), f.data, cr.len);
+}
+
+bool capture_writer::add_router(uint64_t t_us, const uint8_t *data,
+                                size_t len) {
+  if (!fp_)
+    return false;
+  if (!roll(t_us))
+    return false;
+  note(t_us, false, 0);
+  return write_record(t_us, REC_ROUTER, data, len, nullptr, 0);
+}
+
+bool capture_writer::checkpoint() {
+  if (!cur_open_)
+    return true;
+
+  cur_.block_end = off_;
+  const uint64_t at = off_;
+  if (!write_record(cur_.t_last_us, REC_CHECKPOINT, &cur_, sizeof(cur_),
+                    nullptr, 0))
+    return false;
+  records_--; // checkpoints are bookkeeping, not data
+
+  index_.push_back(cur_);
+  last_checkpoint_ = at;
+  cur_open_ = false;
+  flush();
+  return true;
+}
+
+bool capture_writer::close() {
+  if (!fp_)
+    return true;
+
+  bool ok = checkpoint();
+
+  trailer tr{};
+  std::memcpy(tr.magic, kTrailerMagic, sizeof(tr.magic));
+  tr.index_off = off_;
+  tr.index_count = index_.size();
+  ok = ok && put(index_.data(), index_.size() * sizeof(index_entry));
+  tr.file_len = off_ + sizeof(tr);
+  ok = ok && put(&tr, sizeof(tr));
+
+  if (std::fclose(fp_) != 0 && ok) {
+    error_ = std::string("close failed: ") + std::strerror(errno);
+    ok = false;
+  }
+  fp_ = nullptr;
+  return ok;
+}
+
+} // namespace gwcap
@@ -0,0 +1,75 @@
+// capture_writer.h
+//
+// Appends records to a .gwcap file and maintains the block index. See
+// capture_format.h for the layout.
+
+#pragma once
+
+#include "capture_format.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace gwcap {
+
+struct can_frame {
+  uint64_t dev_ts_us = 0;
+  uint32_t id = 0;
+  uint8_t flags = 0; // CAN_F_*
+  uint8_t len = 0;
+  uint8_t data[64] = {};
+};
+
+struct writer_options {
+  uint32_t block_bytes = 1u << 20;    // close a block after ~1 MiB
+  uint32_t block_span_us = 1000000u;  // ... or 1 s of host time
+};
+
+class capture_writer {
+public:
+  capture_writer() = default;
+  ~capture_writer();
+  capture_writer(const capture_writer &) = delete;
+  capture_writer &operator=(const capture_writer &) = delete;
+
+  // Creates (truncates) path. Returns false and sets error() on failure.
+  bool open(const std::string &path, const writer_options &opt = {});
+
+  bool add_can(uint64_t t_us, const can_frame &f);
+  bool add_router(uint64_t t_us, const uint8_t *data, size_t len);
+
+  // Closes the current block, writes the index table and trailer.
+  bool close();
+
+  // Pushes buffered records to the kernel. Called at each checkpoint; call
+  // it yourself when idle so a crash loses as little as possible.
+  void flush();
+
+  bool is_open() const { return fp_ != nullptr; }
+  const std::string &error() const { return error_; }
+  uint64_t records() const { return records_; }
+  uint64_t bytes() const { return off_; }
+
+private:
+  bool write_record(uint64_t t_us, uint16_t type, const void *a, size_t a_len,
+                    const void *b, size_t b_len);
+  bool put(const void *p, size_t n);
+  bool roll(uint64_t t_us);
+  bool checkpoint();
+  void note(uint64_t t_us, bool can, uint32_t id);
+
+  std::FILE *fp_ = nullptr;
+  std::vector<char> buf_;
+  writer_options opt_;
+  std::string error_;
+
+  uint64_t off_ = 0;
+  uint64_t records_ = 0;
+  index_entry cur_{};
+  bool cur_open_ = false;
+  uint64_t last_checkpoint_ = 0;
+  std::vector<index_entry> index_;
+};
+
+} // namespace gwcap
@@ -0,0 +1,424 @@
+// gwcap_main.cpp
+//
+// Capture the gateway's serial stream (UART or USB CDC, serial_frame.h
+// framing) into an indexed .gwcap file, and query/export captures.
+//
+// Usage examples
+//   gwcap record /dev/ttyACM0 flight.gwcap
+//   gwcap record --baud 1000000 /dev/ttyUSB0 bench.gwcap
+//   gwcap info flight.gwcap
+//   gwcap dump --from +120 --to +125 --id 0x123 flight.gwcap
+//   gwcap export --format candump flight.gwcap flight.log
+//   gwcap export --format pcap --from +60 flight.gwcap - | wireshark -k -i -
+//
+// --from/--to take unix seconds, or "+seconds" relative to the first record.
+// The gateway only sends raw CAN frames when built with TELEMETRY_CAN_TAP=1;
+// router packets are always recorded.
+
+#include "capture_export.h"
+#include "capture_reader.h"
+#include "capture_writer.h"
+#include "serial_frame.h"
+#include "serial_source.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace gwcap;
+
+namespace {
+
+volatile std::sig_atomic_t g_stop = 0;
+
+void on_signal(int) { g_stop = 1; }
+
+uint64_t unix_now_us() {
+  using namespace std::chrono;
+  return uint64_t(
+      duration_cast<microseconds>(system_clock::now().time_since_epoch())
+          .count());
+}
+
+int usage() {
+  std::fprintf(
+      stderr,
+      "usage:\n"
+      "  gwcap record [--baud N] [--block-kib N] [--block-ms N] <tty|file|-> "
+      "<out.gwcap>\n"
+      "  gwcap info <capture>\n"
+      "  gwcap dump [filters] <capture>\n"
+      "  gwcap export --format candump|pcap [--iface NAME] [--device-time]\n"
+      "               [filters] <capture> <out|->\n"
+      "filters: --from T --to T --id ID[,ID...] --can\n");
+  return 2;
+}
+
+struct args {
+  std::vector<std::string> pos;
+  uint32_t baud = 115200;
+  uint32_t block_kib = 1024;
+  uint32_t block_ms = 1000;
+  std::string from, to, ids, format, iface = "can0";
+  bool can_only = false;
+  bool device_time = false;
+};
+
+bool parse_args(int argc, char **argv, args &a) {
+  for (int i = 2; i < argc; i++) {
+    const std::string s = argv[i];
+    auto value = [&](std::string &out) {
+      if (i + 1 >= argc)
+        return false;
+      out = argv[++i];
+      return true;
+    };
+    std::string v;
+    if (s == "--baud" && value(v))
+      a.baud = uint32_t(std::strtoul(v.c_str(), nullptr, 0));
+    else if (s == "--block-kib" && value(v))
+      a.block_kib = uint32_t(std::strtoul(v.c_str(), nullptr, 0));
+    else if (s == "--block-ms" && value(v))
+      a.block_ms = uint32_t(std::strtoul(v.c_str(), nullptr, 0));
+    else if (s == "--from" && value(a.from))
+      ;
+    else if (s == "--to" && value(a.to))
+      ;
+    else if (s == "--id" && value(a.ids))
+      ;
+    else if (s == "--format" && value(a.format))
+      ;
+    else if (s == "--iface" && value(a.iface))
+      ;
+    else if (s == "--can")
+      a.can_only = true;
+    else if (s == "--device-time")
+      a.device_time = true;
+    else if (s.size() > 1 && s[0] == '-' && s != "-")
+      return false;
+    else
+      a.pos.push_back(s);
+  }
+  return true;
+}
+
+// =========================
+// record
+// =========================
+
+struct record_ctx {
+  capture_writer *w;
+  uint64_t t_us;
+  uint64_t can_frames;
+  uint64_t router_packets;
+  uint64_t bad_can;
+  bool failed;
+};
+
+uint32_t rd32(const uint8_t *p) {
+  return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) |
+         (uint32_t(p[3]) << 24);
+}
+
+void on_frame(uint8_t type, const uint8_t *payload, size_t len, void *user) {
+  auto *ctx = static_cast<record_ctx *>(user);
+  if (ctx->failed)
+    return;
+
+  if (type == SERIAL_FRAME_TYPE_ROUTER) {
+    ctx->router_packets++;
+    ctx->failed = !ctx->w->add_router(ctx->t_us, payload, len);
+    return;
+  }
+  if (type != SERIAL_FRAME_TYPE_CAN)
+    return;
+
+  if (len < SERIAL_FRAME_CAN_HDR_LEN ||
+      payload[13] > 64 || len < SERIAL_FRAME_CAN_HDR_LEN + payload[13]) {
+    ctx->bad_can++;
+    return;
+  }
+  can_frame f;
+  f.dev_ts_us = uint64_t(rd32(payload)) | (uint64_t(rd32(payload + 4)) << 32);
+  f.id = rd32(payload + 8);
+  f.flags = payload[12];
+  f.len = payload[13];
+  std::memcpy(f.data, payload + SERIAL_FRAME_CAN_HDR_LEN, f.len);
+  ctx->can_frames++;
+  ctx->failed = !ctx->w->add_can(ctx->t_us, f);
+}
+
+int cmd_record(const args &a) {
+  if (a.pos.size() != 2)
+    return usage();
+
+  serial_source src;
+  if (!src.open(a.pos[0], a.baud)) {
+    std::fprintf(stderr, "gwcap: %s\n", src.error().c_str());
+    return 1;
+  }
+
+  writer_options opt;
+  opt.block_bytes = a.block_kib * 1024u;
+  opt.block_span_us = a.block_ms * 1000u;
+  capture_writer w;
+  if (!w.open(a.pos[1], opt)) {
+    std::fprintf(stderr, "gwcap: %s\n", w.error().c_str());
+    return 1;
+  }
+
+  std::signal(SIGINT, on_signal);
+  std::signal(SIGTERM, on_signal);
+
+  record_ctx ctx{&w, 0, 0, 0, 0, false};
+  serial_frame_decoder_t dec;
+  serial_frame_decoder_init(&dec, on_frame, &ctx);
+
+  std::vector<uint8_t> buf(64 * 1024);
+  uint64_t last_status = unix_now_us();
+  int rc = 0;
+  while (!g_stop) {
+    const long n = src.read(buf.data(), buf.size(), 200);
+    if (n < 0) {
+      if (src.is_tty())
+        std::fprintf(stderr, "gwcap: %s\n", src.error().c_str());
+      break;
+    }
+    ctx.t_us = unix_now_us();
+    if (n == 0) {
+      w.flush();
+      continue;
+    }
+    serial_frame_decoder_feed(&dec, buf.data(), size_t(n));
+    if (ctx.failed) {
+      std::fprintf(stderr, "gwcap: %s\n", w.error().c_str());
+      rc = 1;
+      break;
+    }
+    if (src.is_tty() && ctx.t_us - last_status >= 5000000u) {
+      last_status = ctx.t_us;
+      std::fprintf(stderr,
+                   "\r%llu CAN, %llu router, %u crc err, %.1f MiB   ",
+                   (unsigned long long)ctx.can_frames,
+                   (unsigned long long)ctx.router_packets, dec.crc_errors,
+                   double(w.bytes()) / (1024.0 * 1024.0));
+    }
+  }
+
+  if (!w.close()) {
+    std::fprintf(stderr, "gwcap: %s\n", w.error().c_str());
+    rc = 1;
+  }
+  std::fprintf(stderr,
+               "\n%llu CAN frames, %llu router packets; %u crc errors, %u "
+               "framing errors, %llu bad CAN payloads\n",
+               (unsigned long long)ctx.can_frames,
+               (unsigned long long)ctx.router_packets, dec.crc_errors,
+               dec.framing_errors, (unsigned long long)ctx.bad_can);
+  return rc;
+}
+
+// =========================
+// queries
+// =========================
+
+bool open_capture(capture_reader &r, const std::string &path) {
+  if (!r.open(path)) {
+    std::fprintf(stderr, "gwcap: %s\n", r.error().c_str());
+    return false;
+  }
+  if (r.source() != index_source::footer)
+    std::fprintf(stderr,
+                 "gwcap: %s was not closed cleanly; %s, %llu tail records "
+                 "unindexed\n",
+                 path.c_str(),
+                 r.source() == index_source::recovered
+                     ? "index rebuilt from checkpoints"
+                     : "no checkpoints",
+                 (unsigned long long)r.tail().records);
+  return true;
+}
+
+uint64_t first_time(const capture_reader &r) {
+  if (!r.blocks().empty())
+    return r.blocks().front().t_first_us;
+  return r.tail().t_first_us;
+}
+
+bool parse_time(const std::string &s, uint64_t base, uint64_t &out) {
+  if (s.empty())
+    return true;
+  char *end = nullptr;
+  const bool rel = s[0] == '+';
+  const double v = std::strtod(s.c_str() + (rel ? 1 : 0), &end);
+  if (!end || *end != '\0' || v < 0)
+    return false;
+  out = (rel ? base : 0) + uint64_t(v * 1e6 + 0.5);
+  return true;
+}
+
+bool build_query(const args &a, const capture_reader &r, query &q) {
+  const uint64_t base = first_time(r);
+  if (!parse_time(a.from, base, q.from_us) || !parse_time(a.to, base, q.to_us)) {
+    std::fprintf(stderr, "gwcap: bad --from/--to\n");
+    return false;
+  }
+  q.can_only = a.can_only;
+  size_t pos = 0;
+  while (pos < a.ids.size()) {
+    size_t comma = a.ids.find(',', pos);
+    if (comma == std::string::npos)
+      comma = a.ids.size();
+    const std::string one = a.ids.substr(pos, comma - pos);
+    char *end = nullptr;
+    const unsigned long id = std::strtoul(one.c_str(), &end, 0);
+    if (one.empty() || *end != '\0') {
+      std::fprintf(stderr, "gwcap: bad --id '%s'\n", one.c_str());
+      return false;
+    }
+    q.ids.push_back(uint32_t(id));
+    pos = comma + 1;
+  }
+  return true;
+}
+
+int cmd_info(const args &a) {
+  if (a.pos.size() != 1)
+    return usage();
+  capture_reader r;
+  if (!open_capture(r, a.pos[0]))
+    return 1;
+
+  uint64_t records = r.tail().records, can = r.tail().can_records;
+  uint64_t t0 = UINT64_MAX, t1 = 0;
+  for (const index_entry &b : r.blocks()) {
+    records += b.records;
+    can += b.can_records;
+    t0 = std::min(t0, b.t_first_us);
+    t1 = std::max(t1, b.t_last_us);
+  }
+  if (r.tail().records) {
+    t0 = std::min(t0, r.tail().t_first_us);
+    t1 = std::max(t1, r.tail().t_last_us);
+  }
+
+  std::printf("file:     %s (%.1f MiB)\n", a.pos[0].c_str(),
+              double(r.size()) / (1024.0 * 1024.0));
+  std::printf("index:    %zu blocks (%s)\n", r.blocks().size(),
+              r.source() == index_source::footer      ? "footer"
+              : r.source() == index_source::recovered ? "recovered"
+                                                      : "none");
+  std::printf("records:  %llu (%llu CAN, %llu router)\n",
+              (unsigned long long)records, (unsigned long long)can,
+              (unsigned long long)(records - can));
+  if (records)
+    std::printf("time:     %llu.%06llu .. %llu.%06llu (%.3f s)\n",
+                (unsigned long long)(t0 / 1000000u),
+                (unsigned long long)(t0 % 1000000u),
+                (unsigned long long)(t1 / 1000000u),
+                (unsigned long long)(t1 % 1000000u), double(t1 - t0) / 1e6);
+  return 0;
+}
+
+int cmd_dump(const args &a) {
+  if (a.pos.size() != 1)
+    return usage();
+  capture_reader r;
+  query q;
+  if (!open_capture(r, a.pos[0]) || !build_query(a, r, q))
+    return 1;
+
+  r.scan(q, [](const record_view &v) {
+    std::printf("(%llu.%06llu) ", (unsigned long long)(v.t_us / 1000000u),
+                (unsigned long long)(v.t_us % 1000000u));
+    can_frame f;
+    if (capture_reader::decode_can(v, f)) {
+      std::printf("CAN %s%s%s%s %0*X [%u] dev=%llu ",
+                  (f.flags & CAN_F_TX) ? "tx" : "rx",
+                  (f.flags & CAN_F_FD) ? " fd" : "",
+                  (f.flags & CAN_F_BRS) ? " brs" : "",
+                  (f.flags & CAN_F_RTR) ? " rtr" : "",
+                  (f.flags & CAN_F_EXT) ? 8 : 3, f.id, f.len,
+                  (unsigned long long)f.dev_ts_us);
+      for (uint8_t i = 0; i < f.len && !(f.flags & CAN_F_RTR); i++)
+        std::printf("%02X", f.data[i]);
+    } else {
+      std::printf("ROUTER [%u] ", v.len);
+      for (uint32_t i = 0; i < v.len; i++)
+        std::printf("%02x", v.payload[i]);
+    }
+    std::printf("\n");
+    return true;
+  });
+  return 0;
+}
+
+int cmd_export(const args &a) {
+  if (a.pos.size() != 2 || (a.format != "candump" && a.format != "pcap"))
+    return usage();
+  capture_reader r;
+  query q;
+  if (!open_capture(r, a.pos[0]) || !build_query(a, r, q))
+    return 1;
+  q.can_only = true;
+
+  std::FILE *out = a.pos[1] == "-" ? stdout : std::fopen(a.pos[1].c_str(), "wb");
+  if (!out) {
+    std::fprintf(stderr, "gwcap: %s: %s\n", a.pos[1].c_str(),
+                 std::strerror(errno));
+    return 1;
+  }
+
+  std::unique_ptr<frame_sink> sink;
+  if (a.format == "pcap")
+    sink.reset(new pcap_sink(out));
+  else
+    sink.reset(new candump_sink(out, a.iface));
+
+  bool ok = true;
+  const uint64_t n = r.scan(q, [&](const record_view &v) {
+    can_frame f;
+    if (!capture_reader::decode_can(v, f))
+      return true;
+    ok = sink->write(a.device_time ? f.dev_ts_us : v.t_us, f);
+    return ok;
+  });
+
+  if (out != stdout)
+    ok = (std::fclose(out) == 0) && ok;
+  else
+    ok = (std::fflush(out) == 0) && ok;
+  if (!ok) {
+    std::fprintf(stderr, "gwcap: write to %s failed\n", a.pos[1].c_str());
+    return 1;
+  }
+  std::fprintf(stderr, "%llu frames\n", (unsigned long long)n);
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2)
+    return usage();
+  args a;
+  if (!parse_args(argc, argv, a))
+    return usage();
+
+  const std::string cmd = argv[1];
+  if (cmd == "record")
+    return cmd_record(a);
+  if (cmd == "info")
+    return cmd_info(a);
+  if (cmd == "dump")
+    return cmd_dump(a);
+  if (cmd == "export")
+    return cmd_export(a);
+  return usage();
+}
@@ -0,0 +1,131 @@
+// serial_source.cpp
+
+#include "serial_source.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace gwcap {
+
+static bool baud_constant(uint32_t baud, speed_t &out) {
+  switch (baud) {
+  case 9600: out = B9600; return true;
+  case 19200: out = B19200; return true;
+  case 38400: out = B38400; return true;
+  case 57600: out = B57600; return true;
+  case 115200: out = B115200; return true;
+  case 230400: out = B230400; return true;
+#ifdef B460800
+  case 460800: out = B460800; return true;
+#endif
+#ifdef B921600
+  case 921600: out = B921600; return true;
+#endif
+#ifdef B1000000
+  case 1000000: out = B1000000; return true;
+#endif
+#ifdef B2000000
+  case 2000000: out = B2000000; return true;
+#endif
+  default: return false;
+  }
+}
+
+serial_source::~serial_source() { close(); }
+
+void serial_source::close() {
+  if (fd_ >= 0 && owned_)
+    ::close(fd_);
+  fd_ = -1;
+  owned_ = false;
+  tty_ = false;
+}
+
+bool serial_source::open(const std::string &path, uint32_t baud) {
+  close();
+
+  if (path == "-") {
+    fd_ = STDIN_FILENO;
+    return true;
+  }
+
+  fd_ = ::open(path.c_str(), O_RDONLY | O_NOCTTY);
+  if (fd_ < 0) {
+    error_ = path + ": " + std::strerror(errno);
+    return false;
+  }
+  owned_ = true;
+
+  if (!isatty(fd_))
+    return true;
+  tty_ = true;
+
+  struct termios tio;
+  if (tcgetattr(fd_, &tio) != 0) {
+    error_ = path + ": tcgetattr: " + std::strerror(errno);
+    close();
+    return false;
+  }
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cc[VMIN] = 0;
+  tio.c_cc[VTIME] = 0;
+
+  // The USB CDC side ignores the line coding, so an unusual baud is only an
+  // error for real UARTs; leave the speed alone if there is no constant.
+  speed_t speed;
+  if (baud_constant(baud, speed)) {
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+  } else if (baud != 0) {
+    error_ = path + ": unsupported baud " + std::to_string(baud);
+    close();
+    return false;
+  }
+
+  if (tcsetattr(fd_, TCSANOW, &tio) != 0) {
+    error_ = path + ": tcsetattr: " + std::strerror(errno);
+    close();
+    return false;
+  }
+  tcflush(fd_, TCIFLUSH);
+  return true;
+}
+
+long serial_source::read(uint8_t *buf, size_t cap, int timeout_ms) {
+  if (fd_ < 0)
+    return -1;
+
+  struct pollfd p = {fd_, POLLIN, 0};
+  const int r = poll(&p, 1, timeout_ms);
+  if (r < 0) {
+    if (errno == EINTR)
+      return 0;
+    error_ = std::string("poll: ") + std::strerror(errno);
+    return -1;
+  }
+  if (r == 0)
+    return 0;
+
+  const ssize_t n = ::read(fd_, buf, cap);
+  if (n < 0) {
+    if (errno == EINTR || errno == EAGAIN)
+      return 0;
+    error_ = std::string("read: ") + std::strerror(errno);
+    return -1;
+  }
+  if (n == 0) {
+    // A tty returns 0 when it has nothing (VMIN 0) but also on hangup.
+    if (tty_ && !(p.revents & POLLHUP))
+      return 0;
+    error_ = "end of input";
+    return -1;
+  }
+  return long(n);
+}
+
+} // namespace gwcap
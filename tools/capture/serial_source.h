@@ -0,0 +1,39 @@
+// serial_source.h
+//
+// Byte source for `gwcap record`: a tty (UART adapter or the gateway's USB
+// CDC port, put into raw mode at the given baud), a file/FIFO with a raw
+// byte dump, or stdin ("-").
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace gwcap {
+
+class serial_source {
+public:
+  serial_source() = default;
+  ~serial_source();
+  serial_source(const serial_source &) = delete;
+  serial_source &operator=(const serial_source &) = delete;
+
+  bool open(const std::string &path, uint32_t baud);
+  void close();
+
+  // Waits up to timeout_ms for data. Returns bytes read, 0 on timeout, -1 on
+  // EOF or error (see error()).
+  long read(uint8_t *buf, size_t cap, int timeout_ms);
+
+  bool is_tty() const { return tty_; }
+  const std::string &error() const { return error_; }
+
+private:
+  int fd_ = -1;
+  bool owned_ = false;
+  bool tty_ = false;
+  std::string error_;
+};
+
+} // namespace gwcap
@@ -0,0 +1,361 @@
+// frag_decoder.cpp
+
+#include "frag_decoder.h"
+
+#include <chrono>
+#include <cstring>
+
+namespace gwdec {
+
+stats &stats::operator+=(const stats &o) {
+  frames += o.frames;
+  skipped += o.skipped;
+  whole += o.whole;
+  fragments += o.fragments;
+  packets += o.packets;
+  duplicates += o.duplicates;
+  bad_header += o.bad_header;
+  mismatched += o.mismatched;
+  superseded += o.superseded;
+  timed_out += o.timed_out;
+  no_stream += o.no_stream;
+  incomplete += o.incomplete;
+  return *this;
+}
+
+static size_t pow2_at_least(size_t n) {
+  size_t p = 1;
+  while (p < n)
+    p <<= 1;
+  return p;
+}
+
+// =========================
+// reassembler
+// =========================
+
+reassembler::reassembler(const options &opt) : opt_(opt) {
+  if (opt_.max_streams == 0)
+    opt_.max_streams = 1;
+  if (opt_.max_frags == 0)
+    opt_.max_frags = 255;
+
+  // Keep the load factor at or below 1/2 so probe chains stay short.
+  table_.assign(pow2_at_least(opt_.max_streams * 2), stream{});
+  mask_ = table_.size() - 1;
+
+  arena_.assign(opt_.max_streams * size_t(opt_.max_bytes), 0);
+  free_bufs_.reserve(opt_.max_streams);
+  for (size_t i = opt_.max_streams; i-- > 0;)
+    free_bufs_.push_back(uint32_t(i));
+}
+
+// Standard and extended identifiers, and our own transmissions, are
+// separate streams even when the numeric ID collides.
+uint32_t reassembler::key_of(const frame &f) {
+  return (f.id & 0x1FFFFFFFu) | ((f.flags & F_EXT) ? (1u << 29) : 0u) |
+         ((f.flags & F_TX) ? (1u << 30) : 0u);
+}
+
+size_t reassembler::home(uint32_t key) const {
+  return size_t((key * 0x9E3779B1u) >> 7) & mask_;
+}
+
+size_t reassembler::find(uint32_t key) const {
+  for (size_t i = home(key);; i = (i + 1) & mask_) {
+    if (!table_[i].used)
+      return table_.size();
+    if (table_[i].key == key)
+      return i;
+  }
+}
+
+reassembler::stream *reassembler::insert(uint32_t key, uint64_t t_us) {
+  if (free_bufs_.empty())
+    expire(t_us);
+  if (free_bufs_.empty())
+    return nullptr;
+
+  size_t i = home(key);
+  while (table_[i].used)
+    i = (i + 1) & mask_;
+
+  stream &s = table_[i];
+  std::memset(&s, 0, sizeof(s));
+  s.used = true;
+  s.key = key;
+  s.buf = free_bufs_.back();
+  free_bufs_.pop_back();
+  active_++;
+  return &s;
+}
+
+// Backward-shift deletion: pull later members of the probe chain into the
+// hole so lookups never need tombstones.
+void reassembler::erase(size_t pos) {
+  free_bufs_.push_back(table_[pos].buf);
+  table_[pos].used = false;
+  active_--;
+
+  size_t hole = pos;
+  for (size_t j = (pos + 1) & mask_; table_[j].used; j = (j + 1) & mask_) {
+    const size_t h = home(table_[j].key);
+    const bool stays = (hole <= j) ? (hole < h && h <= j) : (hole < h || h <= j);
+    if (stays)
+      continue;
+    table_[hole] = table_[j];
+    table_[j].used = false;
+    hole = j;
+  }
+}
+
+// Timestamps that go backwards (mixed sources, clock steps) never expire a
+// stream; only a gap forward longer than the timeout does.
+bool reassembler::stale(const stream &s, uint64_t now_us) const {
+  return now_us > s.t_last_us && now_us - s.t_last_us > opt_.timeout_us;
+}
+
+void reassembler::expire(uint64_t now_us) {
+  for (size_t i = 0; i < table_.size();) {
+    if (table_[i].used && stale(table_[i], now_us)) {
+      st_.timed_out++;
+      erase(i); // re-check i: erase may have shifted an entry into it
+    } else {
+      i++;
+    }
+  }
+}
+
+void reassembler::finish() {
+  for (size_t i = 0; i < table_.size();) {
+    if (table_[i].used) {
+      st_.incomplete++;
+      erase(i);
+    } else {
+      i++;
+    }
+  }
+}
+
+void reassembler::push(const frame &f, packet_fn cb, void *user) {
+  st_.frames++;
+  if ((f.flags & F_RTR) || (!opt_.include_tx && (f.flags & F_TX))) {
+    st_.skipped++;
+    return;
+  }
+
+  if (f.len >= sizeof(can_bus_frag_hdr_t) &&
+      uint16_t(f.data[0] | (f.data[1] << 8)) == CAN_BUS_FRAG_MAGIC) {
+    push_fragment(f, cb, user);
+    return;
+  }
+
+  st_.whole++;
+  packet p{};
+  p.id = f.id;
+  p.flags = uint8_t(f.flags & (F_EXT | F_TX));
+  p.frag_cnt = 1;
+  p.t_first_us = p.t_last_us = f.t_us;
+  p.data = f.data;
+  p.len = f.len;
+  cb(p, user);
+}
+
+void reassembler::push_fragment(const frame &f, packet_fn cb, void *user) {
+  st_.fragments++;
+
+  can_bus_frag_hdr_t hdr;
+  std::memcpy(&hdr, f.data, sizeof(hdr));
+  if (hdr.frag_cnt == 0 || hdr.frag_idx >= hdr.frag_cnt ||
+      hdr.frag_cnt > opt_.max_frags || hdr.total_len == 0 ||
+      hdr.total_len > opt_.max_bytes) {
+    st_.bad_header++;
+    return;
+  }
+
+  const uint8_t *payload = f.data + sizeof(hdr);
+  const uint8_t payload_len = uint8_t(f.len - sizeof(hdr));
+  const uint32_t key = key_of(f);
+
+  size_t pos = find(key);
+  if (pos != table_.size()) {
+    stream &s = table_[pos];
+    if (stale(s, f.t_us)) {
+      st_.timed_out++;
+      erase(pos);
+      pos = table_.size();
+    } else if (s.seq != hdr.seq) {
+      st_.superseded++;
+      erase(pos);
+      pos = table_.size();
+    } else if (s.frag_cnt != hdr.frag_cnt || s.total_len != hdr.total_len) {
+      st_.mismatched++;
+      erase(pos);
+      return;
+    }
+  }
+
+  stream *s;
+  if (pos == table_.size()) {
+    s = insert(key, f.t_us);
+    if (!s) {
+      st_.no_stream++;
+      return;
+    }
+    s->seq = hdr.seq;
+    s->frag_cnt = hdr.frag_cnt;
+    s->total_len = hdr.total_len;
+    s->data_cap = payload_len;
+    s->t_first_us = f.t_us;
+    s->t_last_us = f.t_us;
+    pos = size_t(s - table_.data());
+  } else {
+    s = &table_[pos];
+  }
+  if (f.t_us > s->t_last_us)
+    s->t_last_us = f.t_us;
+
+  const uint32_t off = uint32_t(hdr.frag_idx) * s->data_cap;
+  if (off >= s->total_len)
+    return;
+  uint32_t take = payload_len;
+  if (off + take > s->total_len)
+    take = s->total_len - off;
+
+  uint64_t &word = s->got[hdr.frag_idx >> 6];
+  const uint64_t bit = 1ull << (hdr.frag_idx & 63);
+  if (word & bit) {
+    st_.duplicates++;
+    return;
+  }
+  word |= bit;
+  s->got_count++;
+  uint8_t *buf = arena_.data() + size_t(s->buf) * opt_.max_bytes;
+  std::memcpy(buf + off, payload, take);
+
+  if (s->got_count != s->frag_cnt)
+    return;
+
+  st_.packets++;
+  packet p{};
+  p.id = f.id;
+  p.flags = uint8_t(f.flags & (F_EXT | F_TX));
+  p.fragmented = true;
+  p.seq = s->seq;
+  p.frag_cnt = s->frag_cnt;
+  p.t_first_us = s->t_first_us;
+  p.t_last_us = s->t_last_us;
+  p.data = buf;
+  p.len = s->total_len;
+  cb(p, user);
+  erase(pos);
+}
+
+// =========================
+// decoder (sharded by CAN ID)
+// =========================
+
+// Single-producer single-consumer frame queue. Head and tail live on their
+// own cache lines so the dispatcher and the worker do not false-share.
+struct decoder::worker {
+  explicit worker(const options &opt)
+      : ring(pow2_at_least(opt.queue_frames < 2 ? 2 : opt.queue_frames)),
+        mask(ring.size() - 1), reasm(opt) {}
+
+  std::vector<frame> ring;
+  const size_t mask;
+  alignas(64) std::atomic<size_t> head{0}; // written by the dispatcher
+  alignas(64) std::atomic<size_t> tail{0}; // written by the worker
+  alignas(64) std::atomic<bool> stop{false};
+  reassembler reasm;
+  std::thread thread;
+};
+
+decoder::decoder(const options &opt, packet_fn cb, void *user)
+    : opt_(opt), cb_(cb), user_(user) {
+  if (opt_.workers == 0) {
+    inline_.reset(new reassembler(opt_));
+    return;
+  }
+  for (unsigned i = 0; i < opt_.workers; i++)
+    workers_.emplace_back(new worker(opt_));
+  for (auto &w : workers_) {
+    worker *wp = w.get();
+    w->thread = std::thread([this, wp] { run(*wp); });
+  }
+}
+
+decoder::~decoder() { finish(); }
+
+void decoder::push(const frame &f) {
+  if (inline_) {
+    inline_->push(f, cb_, user_);
+    return;
+  }
+
+  // Fragments of one message must reach the same worker; so must the whole
+  // frames of that ID, to keep per-ID order.
+  const uint32_t h = ((f.id & 0x1FFFFFFFu) ^ (uint32_t(f.flags & F_TX) << 25)) *
+                     0x9E3779B1u;
+  worker &w = *workers_[(uint64_t(h) * workers_.size()) >> 32];
+
+  const size_t head = w.head.load(std::memory_order_relaxed);
+  while (head - w.tail.load(std::memory_order_acquire) > w.mask)
+    std::this_thread::yield();
+  w.ring[head & w.mask] = f;
+  w.head.store(head + 1, std::memory_order_release);
+}
+
+void decoder::run(worker &w) {
+  unsigned idle = 0;
+  for (;;) {
+    size_t tail = w.tail.load(std::memory_order_relaxed);
+    const size_t head = w.head.load(std::memory_order_acquire);
+    if (tail == head) {
+      if (w.stop.load(std::memory_order_acquire) &&
+          w.head.load(std::memory_order_acquire) == tail)
+        break;
+      // Spin briefly for bursts, then back off so a slow live source
+      // does not keep a core busy.
+      if (++idle < 64)
+        std::this_thread::yield();
+      else
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      continue;
+    }
+    idle = 0;
+    for (; tail != head; tail++) {
+      w.reasm.push(w.ring[tail & w.mask], cb_, user_);
+      // Free slots as we go so a full queue unblocks the dispatcher early.
+      if ((tail & 255) == 255)
+        w.tail.store(tail + 1, std::memory_order_release);
+    }
+    w.tail.store(tail, std::memory_order_release);
+  }
+  w.reasm.finish();
+}
+
+void decoder::finish() {
+  if (finished_)
+    return;
+  finished_ = true;
+  if (inline_) {
+    inline_->finish();
+    return;
+  }
+  for (auto &w : workers_)
+    w->stop.store(true, std::memory_order_release);
+  for (auto &w : workers_)
+    w->thread.join();
+}
+
+stats decoder::get_stats() const {
+  stats s;
+  if (inline_)
+    s += inline_->get_stats();
+  for (const auto &w : workers_)
+    s += w->reasm.get_stats();
+  return s;
+}
+
+} // namespace gwdec
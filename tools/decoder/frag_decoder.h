@@ -0,0 +1,176 @@
+// frag_decoder.h
+//
+// Host-side reassembly of the can_bus fragment framing (can_bus_frag.h) for
+// post-flight analysis of captured bus traffic.
+//
+// Semantics follow handle_rx_frame() in can_bus.c: frames that do not start
+// with CAN_BUS_FRAG_MAGIC are whole messages; fragments are reassembled per
+// CAN ID, a new seq on an ID drops the partial message, duplicates are
+// ignored and a partial message idle for longer than the timeout is
+// discarded. Unlike the firmware, the number of concurrent partial messages
+// is only bounded by options::max_streams (the firmware keeps 4), and frames
+// the gateway sent itself (CAN_BUS_FRAME_F_TX) are decoded as a separate
+// stream instead of being skipped.
+//
+// The result of reassembly is the serialized router packet exactly as the
+// router received it; packet callbacks get the bytes and hand them to the
+// sedsprintf decoder of their choice (gwdecode reads the data type from the
+// header with telemetry_peek_data_type()).
+//
+// Streaming and allocation-free after construction: all stream state and
+// reassembly buffers are preallocated, and packet data passed to the
+// callback points into them (valid for the duration of the call).
+//
+// decoder spreads work across threads by CAN ID. Each worker owns the
+// streams of the IDs hashed to it, so reassembly needs no locking and the
+// order of packets within one ID is preserved. Callbacks run on the worker
+// threads, concurrently for different IDs.
+
+#pragma once
+
+#include "can_bus_frag.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace gwdec {
+
+// Same values as CAN_BUS_FRAME_F_* in can_bus.h.
+enum frame_flag : uint8_t {
+  F_EXT = 0x01,
+  F_RTR = 0x02,
+  F_FD = 0x04,
+  F_BRS = 0x08,
+  F_ESI = 0x10,
+  F_TX = 0x20,
+};
+
+struct frame {
+  uint64_t t_us; // drives the reassembly timeout; use the device timestamp
+  uint32_t id;
+  uint8_t flags; // F_*
+  uint8_t len;
+  uint8_t data[64];
+};
+
+struct packet {
+  uint32_t id;
+  uint8_t flags;    // F_EXT / F_TX of the frames it came from
+  bool fragmented;  // false: a single non-fragment frame
+  uint8_t seq;      // fragment sequence (0 when not fragmented)
+  uint8_t frag_cnt; // 1 when not fragmented
+  uint64_t t_first_us;
+  uint64_t t_last_us;
+  const uint8_t *data;
+  size_t len;
+};
+
+using packet_fn = void (*)(const packet &p, void *user);
+
+struct options {
+  unsigned workers = 0;        // 0: decode on the thread calling push()
+  size_t queue_frames = 8192;  // per worker, rounded up to a power of two
+  size_t max_streams = 1024;   // concurrent partial messages per worker
+  uint64_t timeout_us = uint64_t(CAN_BUS_REASM_TIMEOUT_MS) * 1000u;
+  uint16_t max_bytes = CAN_BUS_REASM_MAX_BYTES;
+  uint8_t max_frags = CAN_BUS_REASM_MAX_FRAGS;
+  bool include_tx = true;      // decode the gateway's own frames as well
+};
+
+struct stats {
+  uint64_t frames = 0;
+  uint64_t skipped = 0;          // RTR, or TX with include_tx off
+  uint64_t whole = 0;            // non-fragment frames delivered as packets
+  uint64_t fragments = 0;
+  uint64_t packets = 0;          // reassembled messages
+  uint64_t duplicates = 0;
+  uint64_t bad_header = 0;       // fragment header fails validation
+  uint64_t mismatched = 0;       // frag_cnt/total_len changed mid-message
+  uint64_t superseded = 0;       // partial dropped by a new seq on the ID
+  uint64_t timed_out = 0;
+  uint64_t no_stream = 0;        // max_streams partial messages in flight
+  uint64_t incomplete = 0;       // still partial at finish()
+
+  stats &operator+=(const stats &o);
+};
+
+// Single-threaded reassembler; what each decoder worker runs.
+class reassembler {
+public:
+  explicit reassembler(const options &opt);
+
+  void push(const frame &f, packet_fn cb, void *user);
+
+  // Counts what is still partial as incomplete and drops it.
+  void finish();
+
+  const stats &get_stats() const { return st_; }
+
+private:
+  struct stream {
+    bool used;
+    uint32_t key;
+    uint32_t buf;
+    uint8_t seq;
+    uint8_t frag_cnt;
+    uint8_t data_cap;
+    uint16_t total_len;
+    uint16_t got_count;
+    uint64_t got[4];
+    uint64_t t_first_us;
+    uint64_t t_last_us;
+  };
+
+  static uint32_t key_of(const frame &f);
+  size_t home(uint32_t key) const;
+  size_t find(uint32_t key) const; // slot index, or table_.size()
+  stream *insert(uint32_t key, uint64_t t_us);
+  void erase(size_t pos);
+  bool stale(const stream &s, uint64_t now_us) const;
+  void expire(uint64_t now_us);
+  void push_fragment(const frame &f, packet_fn cb, void *user);
+
+  options opt_;
+  stats st_;
+  std::vector<stream> table_; // open addressing, linear probing
+  size_t mask_;
+  size_t active_ = 0;
+  std::vector<uint8_t> arena_; // max_streams buffers of max_bytes
+  std::vector<uint32_t> free_bufs_;
+};
+
+class decoder {
+public:
+  decoder(const options &opt, packet_fn cb, void *user);
+  ~decoder();
+  decoder(const decoder &) = delete;
+  decoder &operator=(const decoder &) = delete;
+
+  // Blocks while the target worker's queue is full.
+  void push(const frame &f);
+
+  // Drains the queues, stops the workers and finishes every reassembler.
+  // push() must not be called afterwards.
+  void finish();
+
+  // Totals over all workers; complete once finish() returned.
+  stats get_stats() const;
+
+private:
+  struct worker;
+
+  void run(worker &w);
+
+  options opt_;
+  packet_fn cb_;
+  void *user_;
+  std::unique_ptr<reassembler> inline_;
+  std::vector<std::unique_ptr<worker>> workers_;
+  bool finished_ = false;
+};
+
+} // namespace gwdec
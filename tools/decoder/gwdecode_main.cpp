@@ -0,0 +1,201 @@
+// gwdecode_main.cpp
+//
+// Reassemble the router packets carried on the bus from a .gwcap capture
+// (recorded with TELEMETRY_CAN_TAP=1).
+//
+// Usage examples
+//   gwdecode flight.gwcap                     # one line per packet
+//   gwdecode --hex flight.gwcap               # ... with the packet bytes
+//   gwdecode --stats --threads 8 flight.gwcap # throughput and drop counters
+//   gwdecode --expand flight.gwcap            # ... and batched samples
+//
+// Each packet is labelled with the data type from its router header
+// (telemetry_peek.h, "type=?" if the header is cut short); the rest of the
+// router's framing is opaque here. --expand looks for Gorilla-coded batches
+// (telemetry_gorilla.h) inside each packet, found by their magic and a
+// header that decodes. Each sample is printed on its own
+// line with its timestamp and elements as little-endian hex.
+//
+// Reassembly timeouts run on the gateway's own frame timestamps unless
+// --host-time is given. With more than one thread, packets of different CAN
+// IDs may be printed out of order; each ID stays in order.
+
+#include "capture_reader.h"
+#include "frag_decoder.h"
+#include "telemetry_gorilla.h"
+#include "telemetry_peek.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct print_ctx {
+  bool quiet;
+  bool hex;
+  bool expand;
+};
+
+void append(std::string &out, const char *fmt, unsigned long long v) {
+  char buf[32];
+  const int n = std::snprintf(buf, sizeof(buf), fmt, v);
+  out.append(buf, size_t(n));
+}
+
+// Decode every Gorilla batch in the packet onto `out`, one line per sample.
+void expand_batches(const gwdec::packet &p, std::string &out) {
+  for (size_t off = 0; off + TELEMETRY_GORILLA_HEADER_BYTES <= p.len; off++) {
+    TelemetryGorillaHeader h;
+    if (telemetry_gorilla_header(&p.data[off], p.len - off, &h) != 0)
+      continue;
+    const size_t sample = size_t(h.elem_size) * h.elem_count;
+    std::vector<uint8_t> values(size_t(h.n) * sample);
+    std::vector<uint64_t> ts(h.n);
+    if (telemetry_gorilla_decode(&p.data[off], p.len - off, &h, values.data(),
+                                 values.size(), ts.data(), ts.size()) < 0)
+      continue;
+
+    append(out, "  batch kind=%llu", h.kind);
+    append(out, " size=%llu", h.elem_size);
+    append(out, " count=%llu", h.elem_count);
+    append(out, " samples=%llu\n", h.n);
+    for (size_t i = 0; i < h.n; i++) {
+      append(out, "    t=%llu", (unsigned long long)(ts[i] / 1000000u));
+      append(out, ".%06llu", (unsigned long long)(ts[i] % 1000000u));
+      for (size_t e = 0; e < h.elem_count; e++) {
+        const uint8_t *v = &values[i * sample + e * h.elem_size];
+        out += ' ';
+        out += "0x";
+        for (size_t b = h.elem_size; b-- > 0;)
+          append(out, "%02llx", v[b]);
+      }
+      out += '\n';
+    }
+  }
+}
+
+void on_packet(const gwdec::packet &p, void *user) {
+  const auto *ctx = static_cast<const print_ctx *>(user);
+  if (ctx->quiet)
+    return;
+
+  // One fwrite per packet keeps lines whole when workers print concurrently.
+  std::string line(112 + (ctx->hex ? p.len * 2 : 0), '\0');
+  int n = std::snprintf(
+      &line[0], line.size(), "(%llu.%06llu) %s %0*X seq=%u frags=%u len=%zu",
+      (unsigned long long)(p.t_last_us / 1000000u),
+      (unsigned long long)(p.t_last_us % 1000000u),
+      (p.flags & gwdec::F_TX) ? "tx" : "rx", (p.flags & gwdec::F_EXT) ? 8 : 3,
+      p.id, p.seq, p.frag_cnt, p.len);
+  const int32_t type = telemetry_peek_data_type(p.data, p.len);
+  if (type >= 0)
+    n += std::snprintf(&line[size_t(n)], line.size() - size_t(n), " type=%ld",
+                       long(type));
+  else
+    n += std::snprintf(&line[size_t(n)], line.size() - size_t(n), " type=?");
+  if (ctx->hex) {
+    static const char digits[] = "0123456789abcdef";
+    line[size_t(n++)] = ' ';
+    for (size_t i = 0; i < p.len; i++) {
+      line[size_t(n++)] = digits[p.data[i] >> 4];
+      line[size_t(n++)] = digits[p.data[i] & 0xF];
+    }
+  }
+  line[size_t(n++)] = '\n';
+  line.resize(size_t(n));
+  if (ctx->expand)
+    expand_batches(p, line);
+  std::fwrite(line.data(), 1, line.size(), stdout);
+}
+
+int usage() {
+  std::fprintf(stderr, "usage: gwdecode [--threads N] [--host-time] [--hex] "
+                       "[--expand] [--stats] <capture>\n");
+  return 2;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  gwdec::options opt;
+  opt.workers = std::thread::hardware_concurrency();
+  if (opt.workers > 1)
+    opt.workers--; // leave a core for the capture scan
+  bool host_time = false;
+  print_ctx ctx{false, false, false};
+  std::string path;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string s = argv[i];
+    if (s == "--threads" && i + 1 < argc)
+      opt.workers = unsigned(std::strtoul(argv[++i], nullptr, 0));
+    else if (s == "--host-time")
+      host_time = true;
+    else if (s == "--hex")
+      ctx.hex = true;
+    else if (s == "--expand")
+      ctx.expand = true;
+    else if (s == "--stats")
+      ctx.quiet = true;
+    else if (!s.empty() && s[0] != '-' && path.empty())
+      path = s;
+    else
+      return usage();
+  }
+  if (path.empty())
+    return usage();
+
+  gwcap::capture_reader r;
+  if (!r.open(path)) {
+    std::fprintf(stderr, "gwdecode: %s\n", r.error().c_str());
+    return 1;
+  }
+
+  const auto t0 = std::chrono::steady_clock::now();
+  gwdec::decoder dec(opt, on_packet, &ctx);
+
+  gwcap::query q;
+  q.can_only = true;
+  r.scan(q, [&](const gwcap::record_view &v) {
+    gwcap::can_frame cf;
+    if (!gwcap::capture_reader::decode_can(v, cf))
+      return true;
+    gwdec::frame f;
+    f.t_us = host_time ? v.t_us : cf.dev_ts_us;
+    f.id = cf.id;
+    f.flags = cf.flags;
+    f.len = cf.len;
+    std::memcpy(f.data, cf.data, cf.len);
+    dec.push(f);
+    return true;
+  });
+  dec.finish();
+
+  const double secs =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - t0)
+          .count();
+  const gwdec::stats s = dec.get_stats();
+  std::fflush(stdout);
+  std::fprintf(stderr,
+               "%llu frames in %.3f s (%.1f M frames/s, %u threads)\n"
+               "  packets: %llu reassembled, %llu single-frame\n"
+               "  fragments: %llu, duplicates %llu, bad header %llu\n"
+               "  dropped: mismatched %llu, superseded %llu, timed out %llu, "
+               "no stream %llu, incomplete %llu\n",
+               (unsigned long long)s.frames, secs,
+               secs > 0 ? double(s.frames) / secs / 1e6 : 0.0, opt.workers,
+               (unsigned long long)s.packets, (unsigned long long)s.whole,
+               (unsigned long long)s.fragments,
+               (unsigned long long)s.duplicates,
+               (unsigned long long)s.bad_header,
+               (unsigned long long)s.mismatched,
+               (unsigned long long)s.superseded,
+               (unsigned long long)s.timed_out,
+               (unsigned long long)s.no_stream,
+               (unsigned long long)s.incomplete);
+  return 0;
+}
@@ -0,0 +1,581 @@
+// fdcan_socketcan.c
+//
+// The FDCAN HAL calls can_bus.c makes, served from a Linux raw CAN socket.
+//
+//  - TX: a 3-element software FIFO in front of the socket, the depth of the
+//    G4's TX FIFO. Frames leave it as fast as the kernel takes them; when the
+//    interface queue is full (ENOBUFS) they wait and the free level drops to
+//    zero, so can_bus.c sees "FIFO full" (HAL_BUSY) instead of losing a
+//    fragment mid-message.
+//  - RX: an epoll thread reads frames into a FIFO1 and runs
+//    HAL_FDCAN_RxFifo1Callback() under the port's interrupt lock, as the
+//    interrupt would; can_bus.c then pushes them into its RX ring.
+//  - Timestamps: RX frames are stamped with TIM3 when the thread reads
+//    them, which is late by the kernel's receive latency, not at start of
+//    frame. No TX events are stored, so a gwd time client always falls back
+//    to the round-trip estimate, and a gwd time master's receive stamps are
+//    only as good as the host's scheduling.
+//  - Errors: CAN error frames (controller state, protocol errors, counters)
+//    update an emulated PSR/ECR and run the error-status and protocol-error
+//    callbacks. Bus-off recovery is the kernel's (restart-ms on the
+//    interface); clearing CCCR.INIT here does nothing.
+//  - Bit timing and CAN FD mode belong to the interface ("ip link set can0
+//    type can bitrate 500000 dbitrate 2000000 fd on"). HAL_FDCAN_Init()
+//    keeps loopback and listen-only, and ignores the timing fields.
+
+#define _GNU_SOURCE
+
+#include "gwd_port.h"
+
+#include <errno.h>
+#include <linux/can.h>
+#include <linux/can/error.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define PORT_TX_FIFO_DEPTH 3u  // FDCAN TX FIFO elements on the G4
+#define PORT_RX_FIFO_DEPTH 32u // frames read per wakeup
+#define PORT_TX_RETRY_MS 1     // RX thread retries a stalled TX FIFO
+
+#ifndef CANFD_FDF
+#define CANFD_FDF 0x04 // Linux >= 5.14; harmless to older kernels
+#endif
+
+static FDCAN_GlobalTypeDef g_regs;
+static FDCAN_HandleTypeDef *g_hfdcan;
+static int g_fd = -1;
+static int g_epfd = -1;
+static int g_evfd = -1;
+static int g_fd_capable;
+static pthread_t g_rx_thread;
+static volatile int g_rx_running;
+static volatile int g_started;
+static volatile uint32_t g_active_its;
+static int g_listen_only;
+
+static const uint8_t k_dlc_len[16] = {0, 1,  2,  3,  4,  5,  6,  7,
+                                      8, 12, 16, 20, 24, 32, 48, 64};
+
+static uint32_t len_to_dlc(uint8_t len) {
+  for (uint32_t dlc = 0; dlc < 16u; dlc++) {
+    if (k_dlc_len[dlc] >= len)
+      return dlc;
+  }
+  return 15u;
+}
+
+// =========================
+// TX FIFO
+// =========================
+
+static pthread_mutex_t g_tx_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct canfd_frame g_tx_fifo[PORT_TX_FIFO_DEPTH];
+static size_t g_tx_size[PORT_TX_FIFO_DEPTH];
+static uint32_t g_tx_count;
+
+// Hand queued frames to the kernel until it pushes back. g_tx_lock held.
+static void tx_flush_locked(void) {
+  while (g_tx_count > 0) {
+    const ssize_t n = write(g_fd, &g_tx_fifo[0], g_tx_size[0]);
+    if (n < 0 && (errno == ENOBUFS || errno == EAGAIN || errno == EINTR))
+      return;
+    // Written, or refused for good (interface down, bad frame): either way
+    // it leaves the FIFO, as a frame the controller gave up on would.
+    memmove(&g_tx_fifo[0], &g_tx_fifo[1],
+            (g_tx_count - 1u) * sizeof(g_tx_fifo[0]));
+    memmove(&g_tx_size[0], &g_tx_size[1],
+            (g_tx_count - 1u) * sizeof(g_tx_size[0]));
+    g_tx_count--;
+  }
+}
+
+static void tx_sync_regs_locked(void) {
+  g_regs.TXBRP = (1u << g_tx_count) - 1u;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_AddMessageToTxFifoQ(FDCAN_HandleTypeDef *hfdcan,
+                                               const FDCAN_TxHeaderTypeDef *pTxHeader,
+                                               const uint8_t *pTxData) {
+  (void)hfdcan;
+  if (g_fd < 0 || !g_started || g_listen_only)
+    return HAL_ERROR;
+
+  struct canfd_frame f;
+  memset(&f, 0, sizeof(f));
+  const int fd = pTxHeader->FDFormat == FDCAN_FD_CAN;
+  if (fd && !g_fd_capable)
+    return HAL_ERROR;
+
+  if (pTxHeader->IdType == FDCAN_EXTENDED_ID)
+    f.can_id = (pTxHeader->Identifier & CAN_EFF_MASK) | CAN_EFF_FLAG;
+  else
+    f.can_id = pTxHeader->Identifier & CAN_SFF_MASK;
+  if (pTxHeader->TxFrameType == FDCAN_REMOTE_FRAME && !fd)
+    f.can_id |= CAN_RTR_FLAG;
+
+  f.len = k_dlc_len[pTxHeader->DataLength & 0xFu];
+  if (!fd && f.len > 8)
+    f.len = 8;
+  if (fd) {
+    f.flags = CANFD_FDF;
+    if (pTxHeader->BitRateSwitch == FDCAN_BRS_ON)
+      f.flags |= CANFD_BRS;
+  }
+  if (!(f.can_id & CAN_RTR_FLAG))
+    memcpy(f.data, pTxData, f.len);
+
+  pthread_mutex_lock(&g_tx_lock);
+  tx_flush_locked();
+  if (g_tx_count >= PORT_TX_FIFO_DEPTH) {
+    pthread_mutex_unlock(&g_tx_lock);
+    return HAL_ERROR; // FIFO full, as HAL reports it
+  }
+  g_tx_fifo[g_tx_count] = f;
+  g_tx_size[g_tx_count] = fd ? CANFD_MTU : CAN_MTU;
+  g_tx_count++;
+  tx_flush_locked();
+  tx_sync_regs_locked();
+  const uint32_t pending = g_tx_count;
+  pthread_mutex_unlock(&g_tx_lock);
+
+  if (pending) {
+    uint64_t one = 1;
+    (void)write(g_evfd, &one, sizeof(one)); // RX thread retries the rest
+  }
+  return HAL_OK;
+}
+
+uint32_t HAL_FDCAN_GetTxFifoFreeLevel(const FDCAN_HandleTypeDef *hfdcan) {
+  (void)hfdcan;
+  if (g_fd < 0 || !g_started)
+    return 0u;
+  pthread_mutex_lock(&g_tx_lock);
+  tx_flush_locked();
+  tx_sync_regs_locked();
+  const uint32_t free_level = PORT_TX_FIFO_DEPTH - g_tx_count;
+  pthread_mutex_unlock(&g_tx_lock);
+  return free_level;
+}
+
+// Frames already in the kernel's queue cannot be recalled; only the
+// software FIFO is flushed.
+HAL_StatusTypeDef HAL_FDCAN_AbortTxRequest(FDCAN_HandleTypeDef *hfdcan,
+                                          uint32_t BufferIndexes) {
+  (void)hfdcan;
+  (void)BufferIndexes;
+  pthread_mutex_lock(&g_tx_lock);
+  g_tx_count = 0;
+  tx_sync_regs_locked();
+  pthread_mutex_unlock(&g_tx_lock);
+  return HAL_OK;
+}
+
+// =========================
+// RX FIFO1 (RX thread only)
+// =========================
+
+static struct canfd_frame g_rx_fifo[PORT_RX_FIFO_DEPTH];
+static uint8_t g_rx_fd[PORT_RX_FIFO_DEPTH];
+static uint16_t g_rx_stamp[PORT_RX_FIFO_DEPTH];
+static uint32_t g_rx_head;
+static uint32_t g_rx_count;
+
+uint32_t HAL_FDCAN_GetRxFifoFillLevel(const FDCAN_HandleTypeDef *hfdcan,
+                                      uint32_t RxFifo) {
+  (void)hfdcan;
+  return (RxFifo == FDCAN_RX_FIFO1) ? g_rx_count : 0u;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_GetRxMessage(FDCAN_HandleTypeDef *hfdcan,
+                                        uint32_t RxLocation,
+                                        FDCAN_RxHeaderTypeDef *pRxHeader,
+                                        uint8_t *pRxData) {
+  (void)hfdcan;
+  if (RxLocation != FDCAN_RX_FIFO1 || g_rx_count == 0)
+    return HAL_ERROR;
+
+  const struct canfd_frame *f = &g_rx_fifo[g_rx_head];
+  const int fd = g_rx_fd[g_rx_head];
+  memset(pRxHeader, 0, sizeof(*pRxHeader));
+  if (f->can_id & CAN_EFF_FLAG) {
+    pRxHeader->Identifier = f->can_id & CAN_EFF_MASK;
+    pRxHeader->IdType = FDCAN_EXTENDED_ID;
+  } else {
+    pRxHeader->Identifier = f->can_id & CAN_SFF_MASK;
+    pRxHeader->IdType = FDCAN_STANDARD_ID;
+  }
+  pRxHeader->RxFrameType =
+      (f->can_id & CAN_RTR_FLAG) ? FDCAN_REMOTE_FRAME : FDCAN_DATA_FRAME;
+  pRxHeader->FDFormat = fd ? FDCAN_FD_CAN : FDCAN_CLASSIC_CAN;
+  pRxHeader->BitRateSwitch =
+      (fd && (f->flags & CANFD_BRS)) ? FDCAN_BRS_ON : FDCAN_BRS_OFF;
+  pRxHeader->ErrorStateIndicator =
+      (fd && (f->flags & CANFD_ESI)) ? FDCAN_ESI_PASSIVE : FDCAN_ESI_ACTIVE;
+  pRxHeader->DataLength = len_to_dlc(f->len);
+  pRxHeader->RxTimestamp = g_rx_stamp[g_rx_head];
+  memcpy(pRxData, f->data, f->len);
+
+  g_rx_head = (g_rx_head + 1u) % PORT_RX_FIFO_DEPTH;
+  g_rx_count--;
+  return HAL_OK;
+}
+
+// =========================
+// Error state
+// =========================
+//
+// PSR/ECR as the controller would report them. Reading the protocol status
+// resets the last error codes, as reading PSR does.
+
+static FDCAN_ProtocolStatusTypeDef g_psr = {
+    .LastErrorCode = FDCAN_PROTOCOL_ERROR_NO_CHANGE,
+    .DataLastErrorCode = FDCAN_PROTOCOL_ERROR_NO_CHANGE,
+};
+static FDCAN_ErrorCountersTypeDef g_ecr;
+
+// FDCAN LEC codes.
+#define LEC_STUFF 1u
+#define LEC_FORM 2u
+#define LEC_ACK 3u
+#define LEC_BIT1 4u
+#define LEC_BIT0 5u
+#define LEC_CRC 6u
+
+HAL_StatusTypeDef
+HAL_FDCAN_GetProtocolStatus(const FDCAN_HandleTypeDef *hfdcan,
+                            FDCAN_ProtocolStatusTypeDef *ProtocolStatus) {
+  (void)hfdcan;
+  *ProtocolStatus = g_psr;
+  g_psr.LastErrorCode = FDCAN_PROTOCOL_ERROR_NO_CHANGE;
+  g_psr.DataLastErrorCode = FDCAN_PROTOCOL_ERROR_NO_CHANGE;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_FDCAN_GetErrorCounters(const FDCAN_HandleTypeDef *hfdcan,
+                           FDCAN_ErrorCountersTypeDef *ErrorCounters) {
+  (void)hfdcan;
+  *ErrorCounters = g_ecr;
+  return HAL_OK;
+}
+
+// Fold one error frame into PSR/ECR. Returns the callbacks it calls for:
+// bit 0 status change, bit 1 protocol error. Interrupt lock held.
+static unsigned apply_error_frame(const struct can_frame *ef) {
+  unsigned events = 0;
+  const canid_t cls = ef->can_id & CAN_ERR_MASK;
+
+  if (cls & CAN_ERR_CRTL) {
+    const uint8_t c = ef->data[1];
+    if (c & (CAN_ERR_CRTL_RX_PASSIVE | CAN_ERR_CRTL_TX_PASSIVE)) {
+      g_psr.ErrorPassive = 1;
+      g_psr.Warning = 1;
+    } else if (c & (CAN_ERR_CRTL_RX_WARNING | CAN_ERR_CRTL_TX_WARNING)) {
+      g_psr.Warning = 1;
+    }
+#ifdef CAN_ERR_CRTL_ACTIVE
+    if (c & CAN_ERR_CRTL_ACTIVE) {
+      g_psr.ErrorPassive = 0;
+      g_psr.Warning = 0;
+    }
+#endif
+    events |= 1u;
+  }
+  if (cls & CAN_ERR_BUSOFF) {
+    g_psr.BusOff = 1;
+    SET_BIT(g_regs.CCCR, FDCAN_CCCR_INIT);
+    events |= 1u;
+  }
+  if (cls & CAN_ERR_RESTARTED) {
+    g_psr.BusOff = 0;
+    g_psr.ErrorPassive = 0;
+    g_psr.Warning = 0;
+    g_ecr.TxErrorCnt = 0;
+    g_ecr.RxErrorCnt = 0;
+    CLEAR_BIT(g_regs.CCCR, FDCAN_CCCR_INIT);
+    events |= 1u;
+  }
+
+  uint32_t lec = FDCAN_PROTOCOL_ERROR_NO_CHANGE;
+  if (cls & CAN_ERR_ACK)
+    lec = LEC_ACK;
+  if (cls & CAN_ERR_PROT) {
+    const uint8_t type = ef->data[2];
+    const uint8_t loc = ef->data[3];
+    if (type & CAN_ERR_PROT_STUFF)
+      lec = LEC_STUFF;
+    else if (type & CAN_ERR_PROT_FORM)
+      lec = LEC_FORM;
+    else if (type & CAN_ERR_PROT_BIT1)
+      lec = LEC_BIT1;
+    else if (type & (CAN_ERR_PROT_BIT0 | CAN_ERR_PROT_BIT))
+      lec = LEC_BIT0;
+    else if (loc == CAN_ERR_PROT_LOC_CRC_SEQ || loc == CAN_ERR_PROT_LOC_CRC_DEL)
+      lec = LEC_CRC;
+  }
+  if (lec != FDCAN_PROTOCOL_ERROR_NO_CHANGE) {
+    g_psr.LastErrorCode = lec;
+    events |= 2u;
+  }
+
+#ifdef CAN_ERR_CNT
+  if (cls & CAN_ERR_CNT) {
+    g_ecr.TxErrorCnt = ef->data[6];
+    g_ecr.RxErrorCnt = ef->data[7];
+  }
+#endif
+  return events;
+}
+
+// =========================
+// RX thread ("interrupts")
+// =========================
+
+static void rx_read_all(unsigned *events) {
+  while (g_rx_count < PORT_RX_FIFO_DEPTH) {
+    struct canfd_frame f;
+    const ssize_t n = read(g_fd, &f, sizeof(f));
+    if (n < 0)
+      return; // EAGAIN: drained
+    if (n != CAN_MTU && n != CANFD_MTU)
+      continue;
+
+    if (f.can_id & CAN_ERR_FLAG) {
+      *events |= apply_error_frame((const struct can_frame *)&f);
+      continue;
+    }
+    if (!g_started)
+      continue; // controller stopped: the frame is not received
+
+    const uint32_t slot = (g_rx_head + g_rx_count) % PORT_RX_FIFO_DEPTH;
+    g_rx_fifo[slot] = f;
+    g_rx_fd[slot] = (n == CANFD_MTU);
+    g_rx_stamp[slot] = (uint16_t)TIM3->CNT;
+    g_rx_count++;
+  }
+}
+
+static void *rx_thread_main(void *arg) {
+  (void)arg;
+  struct epoll_event ev[2];
+
+  while (g_rx_running) {
+    pthread_mutex_lock(&g_tx_lock);
+    tx_flush_locked();
+    tx_sync_regs_locked();
+    const int tx_waiting = g_tx_count > 0;
+    pthread_mutex_unlock(&g_tx_lock);
+
+    const int n = epoll_wait(g_epfd, ev, 2, tx_waiting ? PORT_TX_RETRY_MS : -1);
+    for (int i = 0; i < n; i++) {
+      if (ev[i].data.fd == g_evfd) {
+        uint64_t v;
+        (void)read(g_evfd, &v, sizeof(v));
+      }
+    }
+
+    // One "interrupt" per wakeup: the FIFO1 callback drains what was read,
+    // the error callbacks see the state after every error frame.
+    gwd_port_isr_enter();
+    unsigned events = 0;
+    rx_read_all(&events);
+    if (g_rx_count && (g_active_its & FDCAN_IT_RX_FIFO1_NEW_MESSAGE))
+      HAL_FDCAN_RxFifo1Callback(g_hfdcan, FDCAN_IT_RX_FIFO1_NEW_MESSAGE);
+    g_rx_count = 0; // what the callback left behind overruns
+    if ((events & 1u) && (g_active_its & (FDCAN_IT_BUS_OFF |
+                                          FDCAN_IT_ERROR_PASSIVE |
+                                          FDCAN_IT_ERROR_WARNING)))
+      HAL_FDCAN_ErrorStatusCallback(g_hfdcan, 0);
+    if ((events & 2u) && (g_active_its & (FDCAN_IT_ARB_PROTOCOL_ERROR |
+                                          FDCAN_IT_DATA_PROTOCOL_ERROR)))
+      HAL_FDCAN_ErrorCallback(g_hfdcan);
+    gwd_port_isr_exit();
+  }
+  return NULL;
+}
+
+// =========================
+// Controller control
+// =========================
+
+HAL_StatusTypeDef HAL_FDCAN_Init(FDCAN_HandleTypeDef *hfdcan) {
+  if (g_fd < 0)
+    return HAL_ERROR;
+
+  // External loopback: our own frames come back. Internal loopback and bus
+  // monitoring: never drive the bus. Both only approximate the controller
+  // modes, but keep a self-test or a passive tap usable.
+  const uint32_t mode = hfdcan->Init.Mode;
+  const int own = (mode == FDCAN_MODE_EXTERNAL_LOOPBACK ||
+                   mode == FDCAN_MODE_INTERNAL_LOOPBACK);
+  if (setsockopt(g_fd, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, &own,
+                 sizeof(own)) != 0)
+    return HAL_ERROR;
+  g_listen_only = (mode == FDCAN_MODE_BUS_MONITORING);
+
+  SET_BIT(g_regs.CCCR, FDCAN_CCCR_INIT);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_Start(FDCAN_HandleTypeDef *hfdcan) {
+  CLEAR_BIT(hfdcan->Instance->CCCR, FDCAN_CCCR_INIT);
+  g_started = 1;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_Stop(FDCAN_HandleTypeDef *hfdcan) {
+  g_started = 0;
+  SET_BIT(hfdcan->Instance->CCCR, FDCAN_CCCR_INIT);
+  (void)HAL_FDCAN_AbortTxRequest(hfdcan, 0);
+  return HAL_OK;
+}
+
+// Accept-all is the only filter can_bus.c sets, and the socket has no
+// filter installed.
+HAL_StatusTypeDef HAL_FDCAN_ConfigGlobalFilter(FDCAN_HandleTypeDef *hfdcan,
+                                              uint32_t NonMatchingStd,
+                                              uint32_t NonMatchingExt,
+                                              uint32_t RejectRemoteStd,
+                                              uint32_t RejectRemoteExt) {
+  (void)hfdcan;
+  (void)RejectRemoteStd;
+  (void)RejectRemoteExt;
+  if (NonMatchingStd != FDCAN_ACCEPT_IN_RX_FIFO1 ||
+      NonMatchingExt != FDCAN_ACCEPT_IN_RX_FIFO1)
+    return HAL_ERROR;
+  return HAL_OK;
+}
+
+// TIM3 is always the stamp source here; see the file comment.
+HAL_StatusTypeDef HAL_FDCAN_ConfigTimestampCounter(FDCAN_HandleTypeDef *hfdcan,
+                                                  uint32_t TimestampPrescaler) {
+  (void)hfdcan;
+  (void)TimestampPrescaler;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_EnableTimestampCounter(FDCAN_HandleTypeDef *hfdcan,
+                                                  uint32_t TimestampOperation) {
+  (void)hfdcan;
+  return (TimestampOperation == FDCAN_TIMESTAMP_EXTERNAL) ? HAL_OK : HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_GetTxEvent(FDCAN_HandleTypeDef *hfdcan,
+                                      FDCAN_TxEventFifoTypeDef *pTxEvent) {
+  (void)hfdcan;
+  (void)pTxEvent;
+  return HAL_ERROR; // TX event FIFO always empty
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ActivateNotification(FDCAN_HandleTypeDef *hfdcan,
+                                                uint32_t ActiveITs,
+                                                uint32_t BufferIndexes) {
+  (void)hfdcan;
+  (void)BufferIndexes;
+  g_active_its |= ActiveITs;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef gwd_fdcan_open(FDCAN_HandleTypeDef *hfdcan,
+                                 const char *ifname) {
+  if (!hfdcan || !ifname || g_fd >= 0)
+    return HAL_ERROR;
+
+  const int fd = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                        CAN_RAW);
+  if (fd < 0) {
+    perror("gwd: socket(PF_CAN)");
+    return HAL_ERROR;
+  }
+
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
+  if (ioctl(fd, SIOCGIFINDEX, &ifr) != 0) {
+    fprintf(stderr, "gwd: no CAN interface %s: %s\n", ifname, strerror(errno));
+    close(fd);
+    return HAL_ERROR;
+  }
+  const int ifindex = ifr.ifr_ifindex;
+  const int mtu = (ioctl(fd, SIOCGIFMTU, &ifr) == 0) ? ifr.ifr_mtu : (int)CAN_MTU;
+
+  const int on = 1;
+  g_fd_capable = (mtu == CANFD_MTU) &&
+                 setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &on,
+                            sizeof(on)) == 0;
+
+  can_err_mask_t err_mask = CAN_ERR_TX_TIMEOUT | CAN_ERR_CRTL | CAN_ERR_PROT |
+                            CAN_ERR_ACK | CAN_ERR_BUSOFF | CAN_ERR_RESTARTED;
+#ifdef CAN_ERR_CNT
+  err_mask |= CAN_ERR_CNT;
+#endif
+  (void)setsockopt(fd, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &err_mask,
+                   sizeof(err_mask));
+
+  struct sockaddr_can addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.can_family = AF_CAN;
+  addr.can_ifindex = ifindex;
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    fprintf(stderr, "gwd: bind %s: %s\n", ifname, strerror(errno));
+    close(fd);
+    return HAL_ERROR;
+  }
+
+  g_epfd = epoll_create1(EPOLL_CLOEXEC);
+  g_evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (g_epfd < 0 || g_evfd < 0) {
+    close(fd);
+    return HAL_ERROR;
+  }
+  struct epoll_event ev = {.events = EPOLLIN};
+  ev.data.fd = fd;
+  (void)epoll_ctl(g_epfd, EPOLL_CTL_ADD, fd, &ev);
+  ev.data.fd = g_evfd;
+  (void)epoll_ctl(g_epfd, EPOLL_CTL_ADD, g_evfd, &ev);
+
+  g_fd = fd;
+  g_hfdcan = hfdcan;
+  memset(&g_regs, 0, sizeof(g_regs));
+  SET_BIT(g_regs.CCCR, FDCAN_CCCR_INIT);
+  hfdcan->Instance = &g_regs;
+  memset(&hfdcan->Init, 0, sizeof(hfdcan->Init));
+  hfdcan->Init.FrameFormat =
+      g_fd_capable ? FDCAN_FRAME_FD_BRS : FDCAN_FRAME_CLASSIC;
+  hfdcan->Init.Mode = FDCAN_MODE_NORMAL;
+  hfdcan->Init.AutoRetransmission = ENABLE;
+  hfdcan->Init.NominalPrescaler = 1;
+  hfdcan->Init.NominalTimeSeg1 = 1;
+  hfdcan->Init.NominalTimeSeg2 = 1;
+  hfdcan->Init.NominalSyncJumpWidth = 1;
+
+  g_rx_running = 1;
+  if (pthread_create(&g_rx_thread, NULL, rx_thread_main, NULL) != 0) {
+    g_rx_running = 0;
+    return HAL_ERROR;
+  }
+  (void)pthread_setname_np(g_rx_thread, "fdcan-rx");
+  return HAL_OK;
+}
+
+void gwd_fdcan_close(void) {
+  if (g_fd < 0)
+    return;
+  g_rx_running = 0;
+  uint64_t one = 1;
+  (void)write(g_evfd, &one, sizeof(one));
+  pthread_join(g_rx_thread, NULL);
+  close(g_evfd);
+  close(g_epfd);
+  close(g_fd);
+  g_fd = g_epfd = g_evfd = -1;
+}
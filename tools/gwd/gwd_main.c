@@ -0,0 +1,132 @@
+// gwd_main.c
+//
+// The gateway's CAN and telemetry stack as a Linux daemon: can_bus.c,
+// can_node.c and telemetry.c run unmodified on a SocketCAN interface, with
+// an optional serial radio link.
+//
+// Usage examples
+//   gwd --can can0                                 # on the vehicle bus
+//   gwd --can can0 --uart /dev/ttyUSB0             # and relay to the radio
+//   gwd --can vcan0 --uid 1 & gwd --can vcan0 --uid 2   # two boards on vcan
+//
+// Bring the interface up first; bit timing and FD mode are set there:
+//   ip link set can0 type can bitrate 500000 dbitrate 2000000 fd on
+//   ip link set can0 type can restart-ms 100 && ip link set can0 up
+//   ip link add dev vcan0 type vcan && ip link set vcan0 mtu 72 up
+//
+// Without --uid the UID is derived from /etc/machine-id and the interface
+// name, so two daemons on one host and interface need distinct --uid values.
+
+#include "GB-Threads.h"
+#include "can_bus.h"
+#include "gwd_port.h"
+#include "uart_link.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static FDCAN_HandleTypeDef g_hfdcan;
+static UART_HandleTypeDef g_huart;
+
+static int usage(void) {
+  fprintf(stderr, "usage: gwd [--can IF] [--uart DEV] [--baud N] [--uid N]\n");
+  return 2;
+}
+
+// FNV-1a over the machine id and interface name, spread over the three
+// words the way the STM32 UID would be.
+static void default_uid(const char *ifname, uint32_t uid[3]) {
+  char id[64] = "";
+  FILE *f = fopen("/etc/machine-id", "r");
+  if (f) {
+    if (!fgets(id, sizeof(id), f))
+      id[0] = '\0';
+    fclose(f);
+  }
+
+  uint64_t h = 14695981039346656037ull;
+  const char *parts[2] = {id, ifname};
+  for (unsigned p = 0; p < 2; p++) {
+    for (const char *c = parts[p]; *c; c++) {
+      h ^= (uint8_t)*c;
+      h *= 1099511628211ull;
+    }
+  }
+  uid[0] = (uint32_t)h;
+  uid[1] = (uint32_t)(h >> 32);
+  uid[2] = (uint32_t)(h * 1099511628211ull >> 16);
+}
+
+int main(int argc, char **argv) {
+  const char *ifname = "can0";
+  const char *uart = NULL;
+  uint32_t baud = UART_LINK_BAUD;
+  uint32_t uid[3] = {0, 0, 0};
+  int have_uid = 0;
+
+  for (int i = 1; i < argc; i++) {
+    const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+    if (!v)
+      return usage();
+    if (strcmp(argv[i], "--can") == 0) {
+      ifname = v;
+    } else if (strcmp(argv[i], "--uart") == 0) {
+      uart = v;
+    } else if (strcmp(argv[i], "--baud") == 0) {
+      baud = (uint32_t)strtoul(v, NULL, 0);
+    } else if (strcmp(argv[i], "--uid") == 0) {
+      const unsigned long long n = strtoull(v, NULL, 0);
+      uid[0] = (uint32_t)n;
+      uid[1] = (uint32_t)(n >> 32);
+      uid[2] = 0x67776400u; // "gwd"
+      have_uid = 1;
+    } else {
+      return usage();
+    }
+    i++;
+  }
+  if (!have_uid)
+    default_uid(ifname, uid);
+
+  // Signals are taken with sigwait(); block them before any thread starts
+  // so none of the stack's threads is interrupted by one.
+  sigset_t sigs;
+  sigemptyset(&sigs);
+  sigaddset(&sigs, SIGINT);
+  sigaddset(&sigs, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+
+  gwd_port_init(uid);
+  if (gwd_fdcan_open(&g_hfdcan, ifname) != HAL_OK)
+    return 1;
+  can_bus_init(&g_hfdcan);
+
+  if (uart) {
+    g_huart.Instance = (void *)uart;
+    if (uart_link_init(&g_huart, baud) != HAL_OK)
+      return 1;
+  }
+
+  fprintf(stderr, "gwd: %s%s%s, uid %08x%08x%08x\n", ifname,
+          uart ? " <-> " : "", uart ? uart : "", (unsigned)uid[2],
+          (unsigned)uid[1], (unsigned)uid[0]);
+  create_telemetry_thread();
+
+  int sig = 0;
+  sigwait(&sigs, &sig);
+
+  can_bus_stats_t s;
+  can_bus_get_stats(&s);
+  fprintf(stderr,
+          "gwd: stopping; tec %u rec %u, bus-off %u, tx dropped %u, "
+          "aborted %u, rx overflow %u\n",
+          (unsigned)s.tec, (unsigned)s.rec, (unsigned)s.bus_off_count,
+          (unsigned)s.tx_dropped, (unsigned)s.tx_aborted,
+          (unsigned)s.rx_overflow);
+  // The telemetry thread never returns; exiting the process ends it.
+  gwd_fdcan_close();
+  return 0;
+}
@@ -0,0 +1,42 @@
+// gwd_port.h
+//
+// Linux implementation of the host HAL (tools/host_hal) that lets the
+// firmware's CAN and telemetry stack run as a process:
+//
+//  - linux_port.c: clocks (HAL tick, timebase, ThreadX ticks) from
+//    CLOCK_MONOTONIC, ThreadX threads on pthreads, the device UID, and
+//    "interrupts" as one process-wide lock: masking IRQs takes it, and the
+//    port's interrupt callbacks run holding it, so the firmware's
+//    PRIMASK-protected sections keep their meaning.
+//  - fdcan_socketcan.c: the FDCAN HAL calls can_bus.c makes, served from a
+//    raw CAN FD socket. An epoll thread plays the FIFO1 and error-status
+//    interrupts; frames reach can_bus.c through its usual RX ring.
+//  - uart_link_tty.c: uart_link.h on a serial device.
+
+#pragma once
+
+#include "stm32g4xx_hal.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Start the clocks and set the UID can_node.c derives its name from.
+void gwd_port_init(const uint32_t uid[3]);
+
+// Bracket an interrupt callback (the port's RX thread only).
+void gwd_port_isr_enter(void);
+void gwd_port_isr_exit(void);
+
+// Bind hfdcan to a SocketCAN interface (e.g. "can0", "vcan0") and start the
+// RX thread. Fills hfdcan->Init with the frame format the interface
+// supports; bit timing belongs to the interface ("ip link set ... bitrate").
+HAL_StatusTypeDef gwd_fdcan_open(FDCAN_HandleTypeDef *hfdcan,
+                                 const char *ifname);
+void gwd_fdcan_close(void);
+
+#ifdef __cplusplus
+}
+#endif
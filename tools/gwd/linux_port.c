@@ -0,0 +1,214 @@
+// linux_port.c
+//
+// Clocks, threads, UID and the interrupt lock for the Linux gateway (see
+// gwd_port.h).
+
+#define _GNU_SOURCE
+
+#include "gwd_port.h"
+
+#include "timebase.h"
+#include "tx_api.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define GWD_FDCAN_CLOCK_HZ 80000000u // the target's FDCAN kernel clock
+#define GWD_PCLK1_HZ 170000000u
+
+static struct timespec g_t0;
+static uint32_t g_uid[3];
+
+FDCAN_Config_TypeDef host_hal_fdcan_config;
+
+// =========================
+// Clocks
+// =========================
+
+static uint64_t port_now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  const int64_t us = (int64_t)(ts.tv_sec - g_t0.tv_sec) * 1000000 +
+                     ((int64_t)ts.tv_nsec - (int64_t)g_t0.tv_nsec) / 1000;
+  return us > 0 ? (uint64_t)us : 0u;
+}
+
+static void sleep_until_us(uint64_t t_us) {
+  struct timespec ts;
+  ts.tv_sec = g_t0.tv_sec + (time_t)(t_us / 1000000u);
+  ts.tv_nsec = g_t0.tv_nsec + (long)(t_us % 1000000u) * 1000;
+  if (ts.tv_nsec >= 1000000000L) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000L;
+  }
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+  }
+}
+
+uint32_t HAL_GetTick(void) { return (uint32_t)(port_now_us() / 1000u); }
+
+void HAL_Delay(uint32_t ms) {
+  sleep_until_us(port_now_us() + (uint64_t)ms * 1000u);
+}
+
+// timebase.h without TIM2: CLOCK_MONOTONIC is already 64-bit and safe from
+// any thread.
+void timebase_init(void) {}
+uint64_t timebase_now_ns(void) { return port_now_us() * 1000u; }
+uint64_t timebase_now_us(void) { return port_now_us(); }
+uint64_t timebase_now_ms(void) { return port_now_us() / 1000u; }
+void timebase_irq_handler(void) {}
+
+// The FDCAN timestamp counter: the same clock, 16 bits at 1 MHz.
+TIM_TypeDef *host_hal_tim3(void) {
+  static __thread TIM_TypeDef tim3;
+  tim3.CNT = (uint32_t)(port_now_us() & 0xFFFFu);
+  tim3.SR = 0;
+  return &tim3;
+}
+
+uint32_t HAL_RCCEx_GetPeriphCLKFreq(uint32_t clk) {
+  (void)clk;
+  return GWD_FDCAN_CLOCK_HZ;
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void) { return GWD_PCLK1_HZ; }
+
+uint32_t HAL_GetUIDw0(void) { return g_uid[0]; }
+uint32_t HAL_GetUIDw1(void) { return g_uid[1]; }
+uint32_t HAL_GetUIDw2(void) { return g_uid[2]; }
+
+void gwd_port_init(const uint32_t uid[3]) {
+  clock_gettime(CLOCK_MONOTONIC, &g_t0);
+  memcpy(g_uid, uid, sizeof(g_uid));
+}
+
+// =========================
+// Interrupt lock
+// =========================
+//
+// One lock stands for "interrupts masked". Thread code takes it through
+// __disable_irq() / __set_PRIMASK(); the RX thread holds it for the whole
+// of an interrupt callback, so callbacks and masked sections exclude each
+// other exactly as on the target. Inside a callback PRIMASK reads as set,
+// which keeps save/restore pairs there from touching the lock.
+
+static pthread_mutex_t g_irq_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread uint32_t t_primask;
+static __thread uint32_t t_in_isr;
+
+uint32_t __get_PRIMASK(void) { return t_primask; }
+
+void __disable_irq(void) {
+  if (!t_primask) {
+    pthread_mutex_lock(&g_irq_lock);
+    t_primask = 1u;
+  }
+}
+
+void __enable_irq(void) {
+  if (t_primask && !t_in_isr) {
+    t_primask = 0u;
+    pthread_mutex_unlock(&g_irq_lock);
+  }
+}
+
+void __set_PRIMASK(uint32_t primask) {
+  if (primask)
+    __disable_irq();
+  else
+    __enable_irq();
+}
+
+uint32_t __get_IPSR(void) { return t_in_isr ? 16u + 21u : 0u; } // FDCAN2_IT1
+
+void gwd_port_isr_enter(void) {
+  pthread_mutex_lock(&g_irq_lock);
+  t_primask = 1u;
+  t_in_isr = 1u;
+}
+
+void gwd_port_isr_exit(void) {
+  t_in_isr = 0u;
+  t_primask = 0u;
+  pthread_mutex_unlock(&g_irq_lock);
+}
+
+// =========================
+// ThreadX threads
+// =========================
+
+typedef struct {
+  pthread_t thread;
+  VOID (*entry)(ULONG);
+  ULONG input;
+} port_thread_t;
+
+static void *thread_main(void *arg) {
+  port_thread_t *t = (port_thread_t *)arg;
+  t->entry(t->input);
+  return NULL;
+}
+
+UINT tx_thread_create(TX_THREAD *thread_ptr, const CHAR *name_ptr,
+                      VOID (*entry_function)(ULONG entry_input),
+                      ULONG entry_input, VOID *stack_start, ULONG stack_size,
+                      UINT priority, UINT preempt_threshold, ULONG time_slice,
+                      UINT auto_start) {
+  (void)stack_start; // sized for the target; the host stack is the default
+  (void)stack_size;
+  (void)priority;
+  (void)preempt_threshold;
+  (void)time_slice;
+  if (!thread_ptr || !entry_function || auto_start != TX_AUTO_START)
+    return TX_THREAD_ERROR;
+
+  port_thread_t *t = (port_thread_t *)calloc(1, sizeof(*t));
+  if (!t)
+    return TX_THREAD_ERROR;
+  t->entry = entry_function;
+  t->input = entry_input;
+  if (pthread_create(&t->thread, NULL, thread_main, t) != 0) {
+    free(t);
+    return TX_THREAD_ERROR;
+  }
+  if (name_ptr) {
+    char name[16]; // pthread limit, NUL included
+    snprintf(name, sizeof(name), "%s", name_ptr);
+    (void)pthread_setname_np(t->thread, name);
+  }
+  thread_ptr->tx_thread_name = name_ptr;
+  thread_ptr->tx_thread_port = t;
+  return TX_SUCCESS;
+}
+
+ULONG tx_time_get(VOID) {
+  const uint64_t ticks =
+      port_now_us() * (uint64_t)TX_TIMER_TICKS_PER_SECOND / 1000000u;
+  return (ULONG)(uint32_t)ticks; // 32-bit on the target
+}
+
+// Like ThreadX: wake on the timer_ticks'th tick interrupt from now, so
+// sleep(1) lasts anywhere up to one tick.
+UINT tx_thread_sleep(ULONG timer_ticks) {
+  const uint64_t tick_us = 1000000u / (uint64_t)TX_TIMER_TICKS_PER_SECOND;
+  const uint64_t now = port_now_us();
+  sleep_until_us((now / tick_us + (uint64_t)timer_ticks) * tick_us);
+  return TX_SUCCESS;
+}
+
+// =========================
+// Router hooks (telemetry_hooks.c on the target)
+// =========================
+
+void *telemetryMalloc(size_t size) { return malloc(size); }
+
+void telemetryFree(void *ptr) { free(ptr); }
+
+void seds_error_msg(const char *str, size_t len) {
+  fprintf(stderr, "%.*s\n", (int)len, str);
+}
@@ -0,0 +1,228 @@
+// uart_link_tty.c
+//
+// uart_link.h on a Linux tty (USB-serial radio, or a pty for testing).
+// huart->Instance is the device path.
+//
+//  - TX: frames are encoded into a pending buffer as large as the target's
+//    two ping-pong halves and written without blocking; what the tty does
+//    not take now goes out on the next send or process_rx call. A full
+//    buffer is HAL_BUSY, as on the target.
+//  - RX: uart_link_process_rx() reads whatever is waiting and feeds the
+//    serial_frame decoder; subscribers run in the calling thread.
+
+#include "uart_link.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define TTY_TX_BUF_SIZE (2u * UART_LINK_TX_BUF_SIZE)
+
+typedef struct {
+  serial_frame_rx_cb_t cb;
+  void *user;
+} uart_link_sub_t;
+
+static int g_fd = -1;
+static uart_link_sub_t g_subs[UART_LINK_MAX_SUBSCRIBERS];
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t g_tx[TTY_TX_BUF_SIZE];
+static size_t g_tx_len;
+static serial_frame_decoder_t g_dec;
+static uart_link_stats_t g_stats;
+
+static speed_t baud_to_speed(uint32_t baud) {
+  switch (baud) {
+  case 9600u:
+    return B9600;
+  case 19200u:
+    return B19200;
+  case 38400u:
+    return B38400;
+  case 57600u:
+    return B57600;
+  case 115200u:
+    return B115200;
+  case 230400u:
+    return B230400;
+  case 460800u:
+    return B460800;
+  case 921600u:
+    return B921600;
+  case 1000000u:
+    return B1000000;
+  case 2000000u:
+    return B2000000;
+  default:
+    return B0;
+  }
+}
+
+static HAL_StatusTypeDef tty_apply_baud(uint32_t baud) {
+  struct termios t;
+  if (tcgetattr(g_fd, &t) != 0)
+    return isatty(g_fd) ? HAL_ERROR : HAL_OK; // a pipe or socket: no line
+  cfmakeraw(&t);
+  t.c_cflag |= CLOCAL | CREAD;
+  t.c_cflag &= ~(tcflag_t)CRTSCTS;
+  t.c_cc[VMIN] = 0;
+  t.c_cc[VTIME] = 0;
+  if (baud) {
+    const speed_t s = baud_to_speed(baud);
+    if (s == B0)
+      return HAL_ERROR;
+    cfsetispeed(&t, s);
+    cfsetospeed(&t, s);
+  }
+  return tcsetattr(g_fd, TCSANOW, &t) == 0 ? HAL_OK : HAL_ERROR;
+}
+
+// =========================
+// TX
+// =========================
+
+// Write what the tty takes now. g_lock held.
+static void tx_flush_locked(void) {
+  size_t off = 0;
+  while (off < g_tx_len) {
+    const ssize_t n = write(g_fd, g_tx + off, g_tx_len - off);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0 && errno != EAGAIN)
+        g_stats.uart_errors++;
+      break;
+    }
+    off += (size_t)n;
+  }
+  memmove(g_tx, g_tx + off, g_tx_len - off);
+  g_tx_len -= off;
+}
+
+HAL_StatusTypeDef uart_link_send(uint8_t type, const uint8_t *data,
+                                 size_t len) {
+  if (g_fd < 0 || (len && !data))
+    return HAL_ERROR;
+
+  pthread_mutex_lock(&g_lock);
+  tx_flush_locked();
+  const size_t n = serial_frame_encode(type, data, len, g_tx + g_tx_len,
+                                       sizeof(g_tx) - g_tx_len);
+  HAL_StatusTypeDef st = HAL_OK;
+  if (n == 0) {
+    g_stats.tx_dropped++;
+    st = len > SERIAL_FRAME_MAX_PAYLOAD ? HAL_ERROR : HAL_BUSY;
+  } else {
+    g_tx_len += n;
+    g_stats.tx_frames++;
+    g_stats.tx_bytes += (uint32_t)n;
+    tx_flush_locked();
+  }
+  pthread_mutex_unlock(&g_lock);
+  return st;
+}
+
+// =========================
+// RX
+// =========================
+
+static void uart_link_dispatch(uint8_t type, const uint8_t *payload, size_t len,
+                               void *user) {
+  (void)user;
+  for (unsigned i = 0; i < UART_LINK_MAX_SUBSCRIBERS; i++) {
+    if (g_subs[i].cb)
+      g_subs[i].cb(type, payload, len, g_subs[i].user);
+  }
+}
+
+void uart_link_process_rx(void) {
+  if (g_fd < 0)
+    return;
+
+  pthread_mutex_lock(&g_lock);
+  tx_flush_locked();
+  pthread_mutex_unlock(&g_lock);
+
+  uint8_t buf[UART_LINK_RX_BUF_SIZE];
+  for (;;) {
+    const ssize_t n = read(g_fd, buf, sizeof(buf));
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0 && errno != EAGAIN)
+        g_stats.uart_errors++;
+      break;
+    }
+    g_stats.rx_bytes += (uint32_t)n;
+    serial_frame_decoder_feed(&g_dec, buf, (size_t)n);
+  }
+  g_stats.rx_frames = g_dec.frames_ok;
+  g_stats.rx_crc_errors = g_dec.crc_errors;
+  g_stats.rx_framing_errors = g_dec.framing_errors;
+}
+
+HAL_StatusTypeDef uart_link_subscribe_rx(serial_frame_rx_cb_t cb, void *user) {
+  if (!cb)
+    return HAL_ERROR;
+
+  for (unsigned i = 0; i < UART_LINK_MAX_SUBSCRIBERS; i++) {
+    if (g_subs[i].cb == cb && g_subs[i].user == user)
+      return HAL_ERROR;
+  }
+  for (unsigned i = 0; i < UART_LINK_MAX_SUBSCRIBERS; i++) {
+    if (g_subs[i].cb == NULL) {
+      g_subs[i].cb = cb;
+      g_subs[i].user = user;
+      return HAL_OK;
+    }
+  }
+  return HAL_ERROR;
+}
+
+// =========================
+// Setup
+// =========================
+
+HAL_StatusTypeDef uart_link_init(UART_HandleTypeDef *huart, uint32_t baud) {
+  if (!huart || !huart->Instance || g_fd >= 0)
+    return HAL_ERROR;
+
+  const char *path = (const char *)huart->Instance;
+  g_fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (g_fd < 0) {
+    fprintf(stderr, "gwd: open %s: %s\n", path, strerror(errno));
+    return HAL_ERROR;
+  }
+  if (tty_apply_baud(baud) != HAL_OK) {
+    fprintf(stderr, "gwd: %s: cannot set %u baud\n", path, (unsigned)baud);
+    close(g_fd);
+    g_fd = -1;
+    return HAL_ERROR;
+  }
+  serial_frame_decoder_init(&g_dec, uart_link_dispatch, NULL);
+  g_tx_len = 0;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef uart_link_set_baud(uint32_t baud) {
+  if (g_fd < 0 || baud == 0)
+    return HAL_ERROR;
+
+  pthread_mutex_lock(&g_lock);
+  (void)tcdrain(g_fd); // queued frames go out at the old rate
+  const HAL_StatusTypeDef st = tty_apply_baud(baud);
+  pthread_mutex_unlock(&g_lock);
+  return st;
+}
+
+void uart_link_get_stats(uart_link_stats_t *out) {
+  if (!out)
+    return;
+  pthread_mutex_lock(&g_lock);
+  *out = g_stats;
+  pthread_mutex_unlock(&g_lock);
+}
@@ -0,0 +1,8 @@
+// cmsis_compiler.h (host HAL)
+//
+// can_bus.c includes CMSIS for __DMB(); the host definition lives in the
+// stm32g4xx_hal.h shim.
+
+#pragma once
+
+#include "stm32g4xx_hal.h"
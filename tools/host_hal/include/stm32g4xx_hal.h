@@ -0,0 +1,297 @@
+// stm32g4xx_hal.h (host HAL)
+//
+// Just enough of the STM32G4 HAL to build the firmware's CAN and telemetry
+// modules (can_bus.c, can_node.c, telemetry*.c) for a host. Types and
+// constants keep their HAL names and values where the firmware depends on
+// them. Each host port implements the functions declared here:
+//
+//  - tools/sim/shim/node_shim.c: simulated boards on a virtual bus
+//  - tools/gwd: a Linux process on SocketCAN
+//
+// The Cortex-M core intrinsics are functions too, so a port with real
+// threads can turn "interrupts masked" into a lock.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  HAL_OK = 0x00U,
+  HAL_ERROR = 0x01U,
+  HAL_BUSY = 0x02U,
+  HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+#define ENABLE 1U
+#define DISABLE 0U
+#define CLEAR_BIT(REG, BIT) ((REG) &= ~(BIT))
+#define SET_BIT(REG, BIT) ((REG) |= (BIT))
+
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t ms);
+uint32_t HAL_GetUIDw0(void);
+uint32_t HAL_GetUIDw1(void);
+uint32_t HAL_GetUIDw2(void);
+
+// ---- Core ----
+
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_IPSR(void); // nonzero while the port runs an interrupt callback
+#define __DMB() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+// ---- TIM3: FDCAN timestamp counter, 1 MHz, 16 bits ----
+
+typedef struct {
+  volatile uint32_t CR1;
+  volatile uint32_t SR;
+  volatile uint32_t EGR;
+  volatile uint32_t CNT;
+  volatile uint32_t PSC;
+  volatile uint32_t ARR;
+} TIM_TypeDef;
+
+#define TIM_CR1_CEN 0x1U
+#define TIM_SR_UIF 0x1U
+#define TIM_EGR_UG 0x1U
+// Refreshed from the port clock on each use; configuration writes are
+// accepted and ignored.
+TIM_TypeDef *host_hal_tim3(void);
+#define TIM3 (host_hal_tim3())
+
+// ---- RCC ----
+
+#define RCC_PERIPHCLK_FDCAN 0x00001000U
+uint32_t HAL_RCCEx_GetPeriphCLKFreq(uint32_t clk);
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+#define __HAL_RCC_TIM3_CLK_ENABLE() ((void)0)
+
+// ---- FDCAN ----
+
+typedef struct {
+  volatile uint32_t CCCR;
+  volatile uint32_t TXBRP;
+} FDCAN_GlobalTypeDef;
+
+typedef struct {
+  volatile uint32_t CKDIV;
+} FDCAN_Config_TypeDef;
+
+extern FDCAN_Config_TypeDef host_hal_fdcan_config;
+#define FDCAN_CONFIG (&host_hal_fdcan_config)
+#define FDCAN_CKDIV_PDIV 0xFU
+#define FDCAN_CCCR_INIT 0x1U
+
+typedef struct {
+  uint32_t ClockDivider;
+  uint32_t FrameFormat;
+  uint32_t Mode;
+  uint32_t AutoRetransmission;
+  uint32_t TransmitPause;
+  uint32_t ProtocolException;
+  uint32_t NominalPrescaler;
+  uint32_t NominalSyncJumpWidth;
+  uint32_t NominalTimeSeg1;
+  uint32_t NominalTimeSeg2;
+  uint32_t DataPrescaler;
+  uint32_t DataSyncJumpWidth;
+  uint32_t DataTimeSeg1;
+  uint32_t DataTimeSeg2;
+  uint32_t StdFiltersNbr;
+  uint32_t ExtFiltersNbr;
+  uint32_t TxFifoQueueMode;
+} FDCAN_InitTypeDef;
+
+typedef struct {
+  FDCAN_GlobalTypeDef *Instance;
+  FDCAN_InitTypeDef Init;
+} FDCAN_HandleTypeDef;
+
+typedef struct {
+  uint32_t Identifier;
+  uint32_t IdType;
+  uint32_t TxFrameType;
+  uint32_t DataLength;
+  uint32_t ErrorStateIndicator;
+  uint32_t BitRateSwitch;
+  uint32_t FDFormat;
+  uint32_t TxEventFifoControl;
+  uint32_t MessageMarker;
+} FDCAN_TxHeaderTypeDef;
+
+typedef struct {
+  uint32_t Identifier;
+  uint32_t IdType;
+  uint32_t RxFrameType;
+  uint32_t DataLength;
+  uint32_t ErrorStateIndicator;
+  uint32_t BitRateSwitch;
+  uint32_t FDFormat;
+  uint32_t RxTimestamp;
+  uint32_t FilterIndex;
+  uint32_t IsFilterMatchingFrame;
+} FDCAN_RxHeaderTypeDef;
+
+typedef struct {
+  uint32_t Identifier;
+  uint32_t IdType;
+  uint32_t TxFrameType;
+  uint32_t DataLength;
+  uint32_t ErrorStateIndicator;
+  uint32_t BitRateSwitch;
+  uint32_t FDFormat;
+  uint32_t TxTimestamp;
+  uint32_t MessageMarker;
+  uint32_t EventType;
+} FDCAN_TxEventFifoTypeDef;
+
+typedef struct {
+  uint32_t LastErrorCode;
+  uint32_t DataLastErrorCode;
+  uint32_t Activity;
+  uint32_t ErrorPassive;
+  uint32_t Warning;
+  uint32_t BusOff;
+  uint32_t RxESIflag;
+  uint32_t RxBRSflag;
+  uint32_t RxFDFflag;
+  uint32_t ProtocolException;
+  uint32_t TDCvalue;
+} FDCAN_ProtocolStatusTypeDef;
+
+typedef struct {
+  uint32_t TxErrorCnt;
+  uint32_t RxErrorCnt;
+  uint32_t RxErrorPassive;
+  uint32_t ErrorLogging;
+} FDCAN_ErrorCountersTypeDef;
+
+#define FDCAN_STANDARD_ID 0x00000000U
+#define FDCAN_EXTENDED_ID 0x40000000U
+#define FDCAN_DATA_FRAME 0x00000000U
+#define FDCAN_REMOTE_FRAME 0x20000000U
+#define FDCAN_ESI_ACTIVE 0x00000000U
+#define FDCAN_ESI_PASSIVE 0x80000000U
+#define FDCAN_BRS_OFF 0x00000000U
+#define FDCAN_BRS_ON 0x00100000U
+#define FDCAN_CLASSIC_CAN 0x00000000U
+#define FDCAN_FD_CAN 0x00200000U
+#define FDCAN_NO_TX_EVENTS 0x00000000U
+#define FDCAN_STORE_TX_EVENTS 0x00800000U
+#define FDCAN_TIMESTAMP_PRESC_1 0x00000000U
+#define FDCAN_TIMESTAMP_EXTERNAL 0x00000002U
+
+#define FDCAN_FRAME_CLASSIC 0x00000000U
+#define FDCAN_FRAME_FD_BRS 0x00000300U
+#define FDCAN_MODE_NORMAL 0x00000000U
+#define FDCAN_MODE_RESTRICTED_OPERATION 0x00000001U
+#define FDCAN_MODE_BUS_MONITORING 0x00000002U
+#define FDCAN_MODE_INTERNAL_LOOPBACK 0x00000003U
+#define FDCAN_MODE_EXTERNAL_LOOPBACK 0x00000004U
+
+#define FDCAN_DLC_BYTES_0 0x0U
+#define FDCAN_DLC_BYTES_1 0x1U
+#define FDCAN_DLC_BYTES_2 0x2U
+#define FDCAN_DLC_BYTES_3 0x3U
+#define FDCAN_DLC_BYTES_4 0x4U
+#define FDCAN_DLC_BYTES_5 0x5U
+#define FDCAN_DLC_BYTES_6 0x6U
+#define FDCAN_DLC_BYTES_7 0x7U
+#define FDCAN_DLC_BYTES_8 0x8U
+#define FDCAN_DLC_BYTES_12 0x9U
+#define FDCAN_DLC_BYTES_16 0xAU
+#define FDCAN_DLC_BYTES_20 0xBU
+#define FDCAN_DLC_BYTES_24 0xCU
+#define FDCAN_DLC_BYTES_32 0xDU
+#define FDCAN_DLC_BYTES_48 0xEU
+#define FDCAN_DLC_BYTES_64 0xFU
+
+#define FDCAN_RX_FIFO0 0x00000040U
+#define FDCAN_RX_FIFO1 0x00000041U
+#define FDCAN_ACCEPT_IN_RX_FIFO0 0x00000000U
+#define FDCAN_ACCEPT_IN_RX_FIFO1 0x00000001U
+#define FDCAN_REJECT 0x00000002U
+#define FDCAN_FILTER_REMOTE 0x00000000U
+#define FDCAN_REJECT_REMOTE 0x00000001U
+
+#define FDCAN_IT_RX_FIFO1_NEW_MESSAGE 0x00000008U
+#define FDCAN_IT_TX_EVT_FIFO_NEW_DATA 0x00000400U
+#define FDCAN_IT_ERROR_WARNING 0x00004000U
+#define FDCAN_IT_ERROR_PASSIVE 0x00002000U
+#define FDCAN_IT_BUS_OFF 0x00008000U
+#define FDCAN_IT_ARB_PROTOCOL_ERROR 0x00010000U
+#define FDCAN_IT_DATA_PROTOCOL_ERROR 0x00020000U
+
+#define FDCAN_PROTOCOL_ERROR_NONE 0x0U
+#define FDCAN_PROTOCOL_ERROR_NO_CHANGE 0x7U
+
+#define IS_FDCAN_NOMINAL_PRESCALER(P) (((P) >= 1U) && ((P) <= 512U))
+#define IS_FDCAN_NOMINAL_SJW(S) (((S) >= 1U) && ((S) <= 128U))
+#define IS_FDCAN_NOMINAL_TSEG1(T) (((T) >= 1U) && ((T) <= 256U))
+#define IS_FDCAN_NOMINAL_TSEG2(T) (((T) >= 1U) && ((T) <= 128U))
+#define IS_FDCAN_DATA_PRESCALER(P) (((P) >= 1U) && ((P) <= 32U))
+#define IS_FDCAN_DATA_SJW(S) (((S) >= 1U) && ((S) <= 16U))
+#define IS_FDCAN_DATA_TSEG1(T) (((T) >= 1U) && ((T) <= 32U))
+#define IS_FDCAN_DATA_TSEG2(T) (((T) >= 1U) && ((T) <= 16U))
+
+HAL_StatusTypeDef HAL_FDCAN_Init(FDCAN_HandleTypeDef *hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_Start(FDCAN_HandleTypeDef *hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_Stop(FDCAN_HandleTypeDef *hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_ConfigGlobalFilter(FDCAN_HandleTypeDef *hfdcan,
+                                              uint32_t NonMatchingStd,
+                                              uint32_t NonMatchingExt,
+                                              uint32_t RejectRemoteStd,
+                                              uint32_t RejectRemoteExt);
+HAL_StatusTypeDef HAL_FDCAN_ConfigTimestampCounter(FDCAN_HandleTypeDef *hfdcan,
+                                                  uint32_t TimestampPrescaler);
+HAL_StatusTypeDef HAL_FDCAN_EnableTimestampCounter(FDCAN_HandleTypeDef *hfdcan,
+                                                  uint32_t TimestampOperation);
+HAL_StatusTypeDef HAL_FDCAN_ActivateNotification(FDCAN_HandleTypeDef *hfdcan,
+                                                uint32_t ActiveITs,
+                                                uint32_t BufferIndexes);
+HAL_StatusTypeDef HAL_FDCAN_AddMessageToTxFifoQ(FDCAN_HandleTypeDef *hfdcan,
+                                               const FDCAN_TxHeaderTypeDef *pTxHeader,
+                                               const uint8_t *pTxData);
+uint32_t HAL_FDCAN_GetTxFifoFreeLevel(const FDCAN_HandleTypeDef *hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_AbortTxRequest(FDCAN_HandleTypeDef *hfdcan,
+                                          uint32_t BufferIndexes);
+uint32_t HAL_FDCAN_GetRxFifoFillLevel(const FDCAN_HandleTypeDef *hfdcan,
+                                      uint32_t RxFifo);
+HAL_StatusTypeDef HAL_FDCAN_GetRxMessage(FDCAN_HandleTypeDef *hfdcan,
+                                        uint32_t RxLocation,
+                                        FDCAN_RxHeaderTypeDef *pRxHeader,
+                                        uint8_t *pRxData);
+HAL_StatusTypeDef HAL_FDCAN_GetTxEvent(FDCAN_HandleTypeDef *hfdcan,
+                                      FDCAN_TxEventFifoTypeDef *pTxEvent);
+HAL_StatusTypeDef
+HAL_FDCAN_GetProtocolStatus(const FDCAN_HandleTypeDef *hfdcan,
+                            FDCAN_ProtocolStatusTypeDef *ProtocolStatus);
+HAL_StatusTypeDef
+HAL_FDCAN_GetErrorCounters(const FDCAN_HandleTypeDef *hfdcan,
+                           FDCAN_ErrorCountersTypeDef *ErrorCounters);
+
+void HAL_FDCAN_RxFifo1Callback(FDCAN_HandleTypeDef *hfdcan,
+                               uint32_t RxFifo1ITs);
+void HAL_FDCAN_TxEventFifoCallback(FDCAN_HandleTypeDef *hfdcan,
+                                   uint32_t TxEventFifoITs);
+void HAL_FDCAN_ErrorStatusCallback(FDCAN_HandleTypeDef *hfdcan,
+                                   uint32_t ErrorStatusITs);
+void HAL_FDCAN_ErrorCallback(FDCAN_HandleTypeDef *hfdcan);
+
+// ---- UART (uart_link.h only needs the handle type) ----
+
+// Instance is whatever the port's uart_link needs (a device path on Linux).
+typedef struct {
+  void *Instance;
+} UART_HandleTypeDef;
+
+#ifdef __cplusplus
+}
+#endif
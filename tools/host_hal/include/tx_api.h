@@ -0,0 +1,47 @@
+// tx_api.h (host HAL)
+//
+// The ThreadX calls the telemetry thread makes, implemented by each host
+// port (coroutines in the simulator, pthreads on Linux). The tick rate
+// matches the firmware (tx_api.h default, tx_user.h leaves it alone).
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void VOID;
+typedef char CHAR;
+typedef unsigned int UINT;
+typedef unsigned long ULONG;
+
+#define TX_SUCCESS ((UINT)0x00)
+#define TX_THREAD_ERROR ((UINT)0x0E)
+#define TX_NO_TIME_SLICE ((ULONG)0)
+#define TX_AUTO_START ((UINT)1)
+#define TX_DONT_START ((UINT)0)
+#define TX_NO_WAIT ((ULONG)0)
+#define TX_WAIT_FOREVER ((ULONG)0xFFFFFFFFUL)
+
+#ifndef TX_TIMER_TICKS_PER_SECOND
+#define TX_TIMER_TICKS_PER_SECOND (100UL)
+#endif
+
+typedef struct TX_THREAD_STRUCT {
+  const CHAR *tx_thread_name;
+  void *tx_thread_port; // the port's thread state
+} TX_THREAD;
+
+UINT tx_thread_create(TX_THREAD *thread_ptr, const CHAR *name_ptr,
+                      VOID (*entry_function)(ULONG entry_input),
+                      ULONG entry_input, VOID *stack_start, ULONG stack_size,
+                      UINT priority, UINT preempt_threshold, ULONG time_slice,
+                      UINT auto_start);
+UINT tx_thread_sleep(ULONG timer_ticks);
+ULONG tx_time_get(VOID);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,213 @@
+#!/usr/bin/env python3
+"""
+Host-side decoder for deferred error logs (LOG_ERROR_DEFERRED_* in telemetry.h).
+
+The firmware sends TELEMETRY_DEFERRED_DATA_TYPE (SEDS_DT_DEFERRED_ERROR by
+default) payloads of the form
+
+    [0x1B 'F' nwords 0] [fmt_id u32 LE] [arg u32 LE] * nwords
+
+where fmt_id is the address of the format string inside the non-loaded
+`.seds_fmt` section of the firmware ELF. This tool reads that section from the
+exact ELF that was flashed and rebuilds the text.
+
+Usage examples
+  ./tools/seds_fmt_decode.py build/Debug/gateway_board.elf --list
+  ./tools/seds_fmt_decode.py build/Debug/gateway_board.elf 1b46010021000000ff000000
+  some_ground_tool | ./tools/seds_fmt_decode.py build/Debug/gateway_board.elf -
+
+Payloads are given as hex (spaces/colons allowed). Lines that are not a
+deferred record are echoed unchanged, so plain-text errors pass through.
+"""
+from __future__ import annotations
+
+import argparse
+import re
+import struct
+import sys
+from dataclasses import dataclass
+from pathlib import Path
+
+MAGIC = b"\x1bF"
+SECTION = ".seds_fmt"
+
+
+class FriendlyError(RuntimeError):
+    pass
+
+
+# ---------------------------
+# ELF (just enough to find one section)
+# ---------------------------
+
+@dataclass(frozen=True)
+class FmtTable:
+    base: int    # section sh_addr
+    blob: bytes  # section contents
+
+    def lookup(self, fmt_id: int) -> str:
+        off = fmt_id - self.base
+        if off < 0 or off >= len(self.blob):
+            raise FriendlyError(f"format id 0x{fmt_id:08x} is outside {SECTION} "
+                                f"(0x{self.base:x}..0x{self.base + len(self.blob):x}); wrong ELF?")
+        end = self.blob.find(b"\0", off)
+        if end < 0:
+            end = len(self.blob)
+        return self.blob[off:end].decode("utf-8", errors="replace")
+
+    def strings(self) -> list[tuple[int, str]]:
+        out = []
+        off = 0
+        while off < len(self.blob):
+            end = self.blob.find(b"\0", off)
+            if end < 0:
+                end = len(self.blob)
+            if end > off:
+                out.append((self.base + off, self.blob[off:end].decode("utf-8", errors="replace")))
+            off = end + 1
+        return out
+
+
+def load_fmt_table(elf_path: Path) -> FmtTable:
+    data = elf_path.read_bytes()
+    if data[:4] != b"\x7fELF":
+        raise FriendlyError(f"{elf_path} is not an ELF file")
+    is64 = data[4] == 2
+    endian = "<" if data[5] == 1 else ">"
+
+    if is64:
+        e_shoff, = struct.unpack_from(endian + "Q", data, 0x28)
+        e_shentsize, e_shnum, e_shstrndx = struct.unpack_from(endian + "HHH", data, 0x3A)
+        sh_fmt = endian + "IIQQQQIIQQ"
+    else:
+        e_shoff, = struct.unpack_from(endian + "I", data, 0x20)
+        e_shentsize, e_shnum, e_shstrndx = struct.unpack_from(endian + "HHH", data, 0x2E)
+        sh_fmt = endian + "IIIIIIIIII"
+
+    def section(i: int) -> tuple:
+        return struct.unpack_from(sh_fmt, data, e_shoff + i * e_shentsize)
+
+    # (name, type, flags, addr, offset, size, link, info, align, entsize)
+    shstr = section(e_shstrndx)
+    names = data[shstr[4]:shstr[4] + shstr[5]]
+
+    for i in range(e_shnum):
+        sh = section(i)
+        end = names.find(b"\0", sh[0])
+        if names[sh[0]:end].decode() == SECTION:
+            return FmtTable(base=sh[3], blob=data[sh[4]:sh[4] + sh[5]])
+
+    raise FriendlyError(f"{elf_path} has no {SECTION} section "
+                        f"(built without deferred logging, or the linker script lacks it)")
+
+
+# ---------------------------
+# printf reconstruction
+# ---------------------------
+
+_SPEC_RE = re.compile(r"%(?P<flags>[-+ #0]*)(?P<width>\d*)(?:\.(?P<prec>\d+))?"
+                      r"(?P<len>hh|h|ll|l|z|j|t)?(?P<conv>[diouxXcsfFeEgGp%])")
+
+
+def render(fmt: str, words: list[int]) -> str:
+    it = iter(words)
+
+    def take() -> int:
+        try:
+            return next(it)
+        except StopIteration:
+            raise FriendlyError(f"not enough argument words for format {fmt!r}")
+
+    def sub(m: re.Match) -> str:
+        conv = m.group("conv")
+        if conv == "%":
+            return "%"
+        spec = "%" + m.group("flags") + m.group("width")
+        if m.group("prec") is not None:
+            spec += "." + m.group("prec")
+
+        if conv in "fFeEgG":
+            (val,) = struct.unpack("<f", struct.pack("<I", take()))
+            return (spec + conv) % val
+        if conv == "s":
+            return f"<str@0x{take():08x}>"
+        if conv == "p":
+            return f"0x{take():08x}"
+        if conv == "c":
+            return (spec + "c") % chr(take() & 0xFF)
+
+        val = take()
+        if m.group("len") == "ll":
+            val |= take() << 32
+            bits = 64
+        else:
+            bits = 32
+        if conv in "di" and val >= (1 << (bits - 1)):
+            val -= 1 << bits
+        return (spec + ("d" if conv in "diu" else conv)) % val
+
+    return _SPEC_RE.sub(sub, fmt)
+
+
+def decode_payload(table: FmtTable, payload: bytes) -> str:
+    if len(payload) < 8 or payload[:2] != MAGIC:
+        raise FriendlyError("not a deferred record")
+    nwords = payload[2]
+    if len(payload) < 8 + 4 * nwords:
+        raise FriendlyError(f"truncated record: {nwords} words announced, {len(payload)} bytes")
+    (fmt_id,) = struct.unpack_from("<I", payload, 4)
+    words = list(struct.unpack_from(f"<{nwords}I", payload, 8))
+    return render(table.lookup(fmt_id), words)
+
+
+def parse_hex(text: str) -> bytes | None:
+    clean = re.sub(r"[\s:,]", "", text)
+    if clean.lower().startswith("0x"):
+        clean = clean[2:]
+    try:
+        return bytes.fromhex(clean)
+    except ValueError:
+        return None
+
+
+# ---------------------------
+# CLI
+# ---------------------------
+
+def main() -> int:
+    p = argparse.ArgumentParser(prog="seds_fmt_decode.py",
+                                description="Decode deferred error logs using the firmware ELF.")
+    p.add_argument("elf", type=Path, help="Firmware ELF that produced the logs")
+    p.add_argument("payloads", nargs="*", help="Hex payloads, or '-' to read lines from stdin")
+    p.add_argument("--list", action="store_true", help="List all format strings and their IDs")
+    args = p.parse_args()
+
+    try:
+        table = load_fmt_table(args.elf)
+    except (OSError, FriendlyError) as e:
+        print(f"[ERR] {e}", file=sys.stderr)
+        return 2
+
+    if args.list:
+        for fmt_id, s in table.strings():
+            print(f"0x{fmt_id:08x}  {s!r}")
+        return 0
+
+    sources = sys.stdin if args.payloads == ["-"] else args.payloads
+    rc = 0
+    for line in sources:
+        line = line.rstrip("\n")
+        payload = parse_hex(line)
+        if payload is None or payload[:2] != MAGIC:
+            print(line)
+            continue
+        try:
+            print(decode_payload(table, payload))
+        except FriendlyError as e:
+            print(f"[ERR] {e}: {line}", file=sys.stderr)
+            rc = 1
+    return rc
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
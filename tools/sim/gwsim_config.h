@@ -0,0 +1,25 @@
+// gwsim_config.h
+//
+// Build configuration for the simulated boards, force-included ahead of the
+// firmware sources (see CMakeLists.txt). Everything not set here keeps its
+// firmware default.
+
+#pragma once
+
+// The header peek behind these is checked by ingress_peek_test against the
+// same router build, so the simulator runs with them on.
+#define TELEMETRY_ROUTE_TABLE 1
+#define TELEMETRY_INGRESS_FILTER 1
+
+// The simulator bridges bus segments over the UART, where the firmware's
+// default routing table only lets messages and errors through. Segments
+// other than the master's still need time sync, so it crosses the bridge
+// as well; the rest of the table is the firmware default.
+#define TELEMETRY_ROUTES(X)                                                    \
+  X(TELEMETRY_ROUTE_ANY_TYPE, ANY, UART, DENY, 0, 0)                           \
+  X(SEDS_DT_MESSAGE_DATA, ANY, UART, RATE, 10, 20)                             \
+  X(SEDS_DT_GENERIC_ERROR, ANY, UART, ALLOW, 0, 0)                             \
+  TELEMETRY_ROUTES_DEFERRED_(X)                                                \
+  X(SEDS_DT_TIME_SYNC_REQUEST, ANY, UART, ALLOW, 0, 0)                         \
+  X(SEDS_DT_TIME_SYNC_RESPONSE, ANY, UART, ALLOW, 0, 0)                        \
+  X(SEDS_DT_TIME_SYNC_ANNOUNCE, ANY, UART, ALLOW, 0, 0)
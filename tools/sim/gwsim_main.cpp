@@ -0,0 +1,546 @@
+// gwsim_main.cpp
+//
+// Run N gateway boards in one process on virtual CAN buses and report how
+// the stack behaves: address claim, time sync, fragmented message delivery
+// across relays, bus load and drop counters.
+//
+// Usage examples
+//   gwsim                                   # 10 boards, one bus, 10 s
+//   gwsim --nodes 10 --segments 2           # two buses bridged over UART
+//   gwsim --loss 0.01 --reorder 0.01 --dup 0.005 --log-bytes 200
+//   gwsim --bitrate 1000000 --data-bitrate 5000000 --log-hz 50
+//
+// Board 0 is the time master. With --segments S the boards are split into S
+// contiguous groups, each on its own bus; the first board of every group
+// after the first is joined by UART to the last board of the group before,
+// so traffic between groups crosses a gateway relay (and its routing table).
+//
+// Every board logs "gwsim <src> <seq> <t_us>" messages padded to --log-bytes.
+// A message counts as delivered to a board when the board reassembles a
+// packet (from CAN or UART) containing it; this assumes the router carries
+// string payloads verbatim.
+
+#include "node_loader.h"
+#include "serial_link.h"
+#include "virtual_bus.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef GWSIM_MODULE_DIR
+#define GWSIM_MODULE_DIR "."
+#endif
+
+namespace {
+
+constexpr uint64_t k_sample_us = 100000; // time sync sampling
+constexpr uint64_t k_drain_us = 2000000; // run on after the workload stops
+constexpr uint32_t k_uart_baud = 1000000; // UART_LINK_BAUD
+constexpr size_t k_uart_tx_buf = 1024;   // UART_LINK_TX_BUF_SIZE
+
+struct options {
+  unsigned nodes = 10;
+  unsigned segments = 1;
+  double seconds = 10.0;
+  double warmup = 3.0; // time sync error is sampled after this
+  gwsim::bus_config bus;
+  double log_hz = 10.0;
+  unsigned log_bytes = 100;
+  double clock_offset_ms = 500.0;
+  double clock_ppm = 100.0;
+  uint64_t seed = 1;
+  std::string modules = GWSIM_MODULE_DIR;
+};
+
+struct message {
+  uint64_t t_us;
+  uint64_t seen; // bitmask of boards that received it
+};
+
+struct sync_error {
+  uint64_t samples = 0;
+  double sum_us = 0;
+  double max_us = 0;
+};
+
+class sim;
+
+struct node : gwsim::bus_port {
+  sim *owner = nullptr;
+  unsigned index = 0;
+  unsigned segment = 0;
+  size_t port = 0;
+  gwsim::serial_link *link = nullptr;
+  int link_side = 0;
+  gwsim::node_module mod;
+  uint64_t wake_us = 0;
+  uint64_t next_log_us = 0;
+  uint32_t seq = 0;
+  uint64_t log_refused = 0;
+  sync_error sync;
+
+  void deliver(const gwsim_frame_t &f) override { mod.can_rx(&f); }
+  void sent(const gwsim_frame_t &f) override { mod.can_sent(&f); }
+};
+
+class sim {
+public:
+  explicit sim(const options &opt) : opt_(opt), rng_(opt.seed) {}
+
+  bool setup();
+  void run();
+  void report() const;
+
+private:
+  static uint64_t host_now(void *ctx);
+  static int host_can_tx(void *ctx, const gwsim_frame_t *f);
+  static uint32_t host_can_tx_free(void *ctx);
+  static int host_uart_tx(void *ctx, uint8_t type, const uint8_t *data,
+                          size_t len);
+  static void host_can_msg(void *ctx, uint32_t id, const uint8_t *data,
+                           size_t len);
+
+  void received(node &n, const uint8_t *data, size_t len);
+  void log_one(node &n);
+  void sample_sync();
+  uint64_t next_event() const;
+
+  options opt_;
+  std::mt19937_64 rng_;
+  uint64_t now_us_ = 0;
+  uint64_t end_us_ = 0;
+  std::vector<std::unique_ptr<gwsim::virtual_bus>> buses_;
+  std::vector<std::unique_ptr<gwsim::serial_link>> links_;
+  std::vector<std::unique_ptr<node>> nodes_;
+  std::unordered_map<uint64_t, message> messages_;
+  gwsim::latency_stats e2e_;
+  uint64_t logged_ = 0;
+  uint64_t delivered_ = 0;
+  uint64_t duplicates_ = 0;
+  uint64_t next_sample_us_ = 0;
+};
+
+// ---------------------------------------------------------------------------
+// Host callbacks (called from inside a board)
+// ---------------------------------------------------------------------------
+
+uint64_t sim::host_now(void *ctx) {
+  return static_cast<node *>(ctx)->owner->now_us_;
+}
+
+int sim::host_can_tx(void *ctx, const gwsim_frame_t *f) {
+  node *n = static_cast<node *>(ctx);
+  sim *s = n->owner;
+  return s->buses_[n->segment]->submit(n->port, *f, s->now_us_) ? 0 : -1;
+}
+
+uint32_t sim::host_can_tx_free(void *ctx) {
+  node *n = static_cast<node *>(ctx);
+  return n->owner->buses_[n->segment]->tx_free(n->port);
+}
+
+int sim::host_uart_tx(void *ctx, uint8_t type, const uint8_t *data,
+                      size_t len) {
+  node *n = static_cast<node *>(ctx);
+  if (!n->link)
+    return -1;
+  return n->link->send(n->link_side, type, data, len, n->owner->now_us_);
+}
+
+void sim::host_can_msg(void *ctx, uint32_t id, const uint8_t *data,
+                       size_t len) {
+  (void)id;
+  node *n = static_cast<node *>(ctx);
+  n->owner->received(*n, data, len);
+}
+
+// ---------------------------------------------------------------------------
+// Workload and delivery tracking
+// ---------------------------------------------------------------------------
+
+void sim::log_one(node &n) {
+  char text[512];
+  const unsigned size =
+      std::min<unsigned>(std::max(opt_.log_bytes, 32u), sizeof(text) - 1);
+  int len = std::snprintf(text, sizeof(text), "gwsim %u %u %" PRIu64 " ",
+                          n.index, n.seq, now_us_);
+  std::memset(text + len, '.', size - (unsigned)len);
+  text[size] = '\0';
+
+  if (n.mod.log(text, size) != 0) {
+    n.log_refused++;
+  } else if (now_us_ < end_us_ - k_drain_us) {
+    messages_[(uint64_t)n.index << 32 | n.seq] = {now_us_, 0};
+    logged_++;
+  }
+  n.seq++;
+}
+
+void sim::received(node &n, const uint8_t *data, size_t len) {
+  static const char tag[] = "gwsim ";
+  const uint8_t *p = data;
+  const uint8_t *end = data + len;
+  while (p < end) {
+    const void *hit = memmem(p, (size_t)(end - p), tag, sizeof(tag) - 1);
+    if (!hit)
+      break;
+    p = static_cast<const uint8_t *>(hit) + (sizeof(tag) - 1);
+
+    char buf[48];
+    const size_t n_copy = std::min<size_t>((size_t)(end - p), sizeof(buf) - 1);
+    std::memcpy(buf, p, n_copy);
+    buf[n_copy] = '\0';
+    unsigned src = 0, seq = 0;
+    if (std::sscanf(buf, "%u %u", &src, &seq) != 2 || src == n.index)
+      continue;
+
+    auto it = messages_.find((uint64_t)src << 32 | seq);
+    if (it == messages_.end())
+      continue;
+    const uint64_t bit = 1ull << n.index;
+    if (it->second.seen & bit) {
+      duplicates_++;
+      continue;
+    }
+    it->second.seen |= bit;
+    delivered_++;
+    e2e_.add(now_us_ - it->second.t_us);
+  }
+}
+
+void sim::sample_sync() {
+  gwsim_node_stats_t ms;
+  nodes_[0]->mod.stats(&ms);
+  for (size_t i = 1; i < nodes_.size(); i++) {
+    gwsim_node_stats_t s;
+    nodes_[i]->mod.stats(&s);
+    const double err = std::fabs((double)s.now_us - (double)ms.now_us);
+    sync_error &e = nodes_[i]->sync;
+    e.samples++;
+    e.sum_us += err;
+    e.max_us = std::max(e.max_us, err);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Setup and event loop
+// ---------------------------------------------------------------------------
+
+bool sim::setup() {
+  const unsigned per_seg = opt_.nodes / opt_.segments;
+  if (opt_.segments > 2 && per_seg < 2) {
+    std::fprintf(stderr, "gwsim: need at least 2 boards per segment\n");
+    return false;
+  }
+
+  for (unsigned s = 0; s < opt_.segments; s++)
+    buses_.emplace_back(new gwsim::virtual_bus(opt_.bus, rng_()));
+
+  std::uniform_real_distribution<double> offset(-opt_.clock_offset_ms,
+                                                opt_.clock_offset_ms);
+  std::uniform_real_distribution<double> ppm(-opt_.clock_ppm, opt_.clock_ppm);
+  const uint64_t log_period =
+      opt_.log_hz > 0 ? (uint64_t)(1e6 / opt_.log_hz) : UINT64_MAX;
+
+  for (unsigned i = 0; i < opt_.nodes; i++) {
+    std::unique_ptr<node> n(new node);
+    n->owner = this;
+    n->index = i;
+    n->segment = std::min(i / per_seg, opt_.segments - 1);
+    n->port = buses_[n->segment]->attach(n.get());
+
+    const std::string path =
+        opt_.modules + (i == 0 ? "/libgwsim_master.so" : "/libgwsim_node.so");
+    std::string err;
+    if (!n->mod.load(path, err)) {
+      std::fprintf(stderr, "gwsim: %s\n", err.c_str());
+      return false;
+    }
+    // Stagger the workload so boards do not all log in the same instant.
+    n->next_log_us = log_period == UINT64_MAX
+                         ? UINT64_MAX
+                         : 1000000u + log_period * i / opt_.nodes;
+    nodes_.push_back(std::move(n));
+  }
+
+  // UART bridges: first board of segment s <-> last board of segment s-1.
+  for (unsigned s = 1; s < opt_.segments; s++) {
+    node *up = nullptr;
+    node *down = nullptr;
+    for (auto &n : nodes_) {
+      if (n->segment == s - 1)
+        up = n.get();
+      if (n->segment == s && !down)
+        down = n.get();
+    }
+    links_.emplace_back(new gwsim::serial_link(
+        k_uart_baud, k_uart_tx_buf,
+        [up, down](int to, uint8_t type, const uint8_t *data, size_t len) {
+          node *dst = to == 0 ? up : down;
+          dst->mod.uart_rx(type, data, len);
+          if (type == 0x01) // SERIAL_FRAME_TYPE_ROUTER
+            dst->owner->received(*dst, data, len);
+        }));
+    up->link = down->link = links_.back().get();
+    up->link_side = 0;
+    down->link_side = 1;
+  }
+
+  for (auto &n : nodes_) {
+    gwsim_host_t host{};
+    host.ctx = n.get();
+    host.now_us = host_now;
+    host.can_tx = host_can_tx;
+    host.can_tx_free = host_can_tx_free;
+    host.uart_tx = host_uart_tx;
+    host.can_msg = host_can_msg;
+
+    gwsim_node_config_t cfg{};
+    cfg.uid[0] = 0x00470000u + n->index;
+    cfg.uid[1] = (uint32_t)rng_();
+    cfg.uid[2] = (uint32_t)rng_();
+    cfg.clock_offset_us = (int64_t)(offset(rng_) * 1000.0);
+    cfg.clock_ppm = (int32_t)std::lround(ppm(rng_));
+    if (n->mod.start(&host, &cfg) != 0) {
+      std::fprintf(stderr, "gwsim: board %u failed to start\n", n->index);
+      return false;
+    }
+  }
+  return true;
+}
+
+uint64_t sim::next_event() const {
+  uint64_t t = next_sample_us_;
+  for (const auto &b : buses_)
+    t = std::min(t, b->next_event_us());
+  for (const auto &l : links_)
+    t = std::min(t, l->next_event_us());
+  for (const auto &n : nodes_)
+    t = std::min({t, n->wake_us, n->next_log_us});
+  return t;
+}
+
+void sim::run() {
+  end_us_ = (uint64_t)(opt_.seconds * 1e6) + k_drain_us;
+  const uint64_t warmup_us = (uint64_t)(opt_.warmup * 1e6);
+  const uint64_t log_end_us = end_us_ - k_drain_us;
+  const uint64_t log_period =
+      opt_.log_hz > 0 ? (uint64_t)(1e6 / opt_.log_hz) : UINT64_MAX;
+  next_sample_us_ = warmup_us;
+
+  while (now_us_ <= end_us_) {
+    // Everything due now, until nothing is: boards may queue frames that
+    // arbitrate at this same instant.
+    for (bool again = true; again;) {
+      again = false;
+      for (auto &n : nodes_) {
+        if (n->wake_us <= now_us_) {
+          n->wake_us = n->mod.run();
+          again = true;
+        }
+        if (n->next_log_us <= now_us_) {
+          log_one(*n);
+          n->next_log_us = (now_us_ + log_period < log_end_us)
+                               ? n->next_log_us + log_period
+                               : UINT64_MAX;
+          again = true;
+        }
+      }
+      for (auto &b : buses_) {
+        if (b->next_event_us() <= now_us_) {
+          b->advance(now_us_);
+          again = true;
+        }
+      }
+      for (auto &l : links_) {
+        if (l->next_event_us() <= now_us_) {
+          l->advance(now_us_);
+          again = true;
+        }
+      }
+    }
+    if (next_sample_us_ <= now_us_) {
+      sample_sync();
+      next_sample_us_ += k_sample_us;
+    }
+
+    const uint64_t next = next_event();
+    if (next == UINT64_MAX)
+      break;
+    now_us_ = std::max(next, now_us_ + 1);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Report
+// ---------------------------------------------------------------------------
+
+const char *band_name(uint32_t band) {
+  switch (band) {
+  case 0x01:
+    return "claim";
+  case 0x02:
+    return "time";
+  case 0x03:
+    return "alarm";
+  case 0x04:
+    return "command";
+  case 0x08:
+    return "status";
+  case 0x10:
+    return "bulk";
+  default:
+    return "other";
+  }
+}
+
+const char *claim_state(uint8_t s) {
+  static const char *names[] = {"unclaimed", "claiming", "claimed", "failed"};
+  return s < 4 ? names[s] : "?";
+}
+
+void sim::report() const {
+  const double secs = (double)end_us_ / 1e6;
+  std::printf("%u boards, %u segment(s), %.1f s simulated (+%.1f s drain), "
+              "%u/%u bit/s, seed %" PRIu64 "\n",
+              opt_.nodes, opt_.segments, opt_.seconds,
+              (double)k_drain_us / 1e6, opt_.bus.bitrate,
+              opt_.bus.data_bitrate, opt_.seed);
+
+  for (size_t s = 0; s < buses_.size(); s++) {
+    const gwsim::bus_stats &b = buses_[s]->stats();
+    std::printf("bus %zu: %" PRIu64 " frames, %" PRIu64
+                " payload bytes, %.1f%% busy, lost %" PRIu64
+                ", duplicated %" PRIu64 ", reordered %" PRIu64 "\n",
+                s, b.frames, b.payload_bytes,
+                100.0 * (double)b.busy_us / (double)end_us_, b.lost,
+                b.duplicated, b.reordered);
+    for (const auto &kv : b.latency) {
+      const gwsim::latency_stats &l = kv.second;
+      std::printf("  %-8s %8" PRIu64 " frames  latency mean %7.1f us  "
+                  "p99 %6" PRIu64 " us  max %6" PRIu64 " us\n",
+                  band_name(kv.first), l.count, l.mean_us(),
+                  l.percentile_us(0.99), l.max_us);
+    }
+  }
+  for (size_t i = 0; i < links_.size(); i++) {
+    for (int dir = 0; dir < 2; dir++) {
+      const gwsim::serial_link_stats &l = links_[i]->stats(dir);
+      std::printf("uart %zu %s: %" PRIu64 " frames, %" PRIu64
+                  " wire bytes (%.1f%% of line rate), busy %" PRIu64 "\n",
+                  i, dir == 0 ? "up->down" : "down->up", l.frames,
+                  l.wire_bytes,
+                  100.0 * (double)l.wire_bytes * 10.0 / k_uart_baud / secs,
+                  l.busy);
+    }
+  }
+
+  const uint64_t expected = logged_ * (opt_.nodes - 1);
+  std::printf("messages: %" PRIu64 " logged, %" PRIu64 "/%" PRIu64
+              " deliveries (%.2f%%), %" PRIu64 " duplicate deliveries\n",
+              logged_, delivered_, expected,
+              expected ? 100.0 * (double)delivered_ / (double)expected : 0.0,
+              duplicates_);
+  std::printf("  end to end: mean %.2f ms  p99 %.2f ms  max %.2f ms\n",
+              e2e_.mean_us() / 1000.0, (double)e2e_.percentile_us(0.99) / 1000.0,
+              (double)e2e_.max_us / 1000.0);
+  std::printf("  goodput: %.1f kB/s of message text delivered\n",
+              (double)delivered_ * opt_.log_bytes / secs / 1000.0);
+
+  std::printf("board seg addr state     sync_us  max_us  rx_ovf "
+              "stage_drop can_drop uart_drop dedup_dup rate_lim refused\n");
+  for (const auto &n : nodes_) {
+    gwsim_node_stats_t s;
+    n->mod.stats(&s);
+    char mean[16] = "-", max[16] = "-";
+    if (n->sync.samples) {
+      std::snprintf(mean, sizeof(mean), "%.0f",
+                    n->sync.sum_us / (double)n->sync.samples);
+      std::snprintf(max, sizeof(max), "%.0f", n->sync.max_us);
+    } else if (s.time_master) {
+      std::snprintf(mean, sizeof(mean), "master");
+    }
+    std::printf("%5u %3u %4u %-9s %7s %7s %7u %10u %8u %9u %9u %8u %7" PRIu64
+                "\n",
+                n->index, n->segment, s.can_addr, claim_state(s.can_state),
+                mean, max, s.rx_overflow, s.stage_dropped,
+                s.egress_dropped[0], s.egress_dropped[1], s.dedup_duplicates,
+                s.route_rate_limited, n->log_refused);
+  }
+}
+
+int usage() {
+  std::fprintf(stderr,
+               "usage: gwsim [--nodes N] [--segments S] [--seconds T] "
+               "[--bitrate B] [--data-bitrate B]\n"
+               "             [--loss P] [--dup P] [--reorder P] [--log-hz F] "
+               "[--log-bytes N]\n"
+               "             [--clock-offset-ms MS] [--clock-ppm PPM] "
+               "[--seed N] [--modules DIR]\n");
+  return 2;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  options opt;
+  for (int i = 1; i < argc; i++) {
+    const std::string s = argv[i];
+    const char *v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    if (!v)
+      return usage();
+    i++;
+    if (s == "--nodes")
+      opt.nodes = unsigned(std::strtoul(v, nullptr, 0));
+    else if (s == "--segments")
+      opt.segments = unsigned(std::strtoul(v, nullptr, 0));
+    else if (s == "--seconds")
+      opt.seconds = std::strtod(v, nullptr);
+    else if (s == "--bitrate")
+      opt.bus.bitrate = uint32_t(std::strtoul(v, nullptr, 0));
+    else if (s == "--data-bitrate")
+      opt.bus.data_bitrate = uint32_t(std::strtoul(v, nullptr, 0));
+    else if (s == "--loss")
+      opt.bus.loss = std::strtod(v, nullptr);
+    else if (s == "--dup")
+      opt.bus.dup = std::strtod(v, nullptr);
+    else if (s == "--reorder")
+      opt.bus.reorder = std::strtod(v, nullptr);
+    else if (s == "--log-hz")
+      opt.log_hz = std::strtod(v, nullptr);
+    else if (s == "--log-bytes")
+      opt.log_bytes = unsigned(std::strtoul(v, nullptr, 0));
+    else if (s == "--clock-offset-ms")
+      opt.clock_offset_ms = std::strtod(v, nullptr);
+    else if (s == "--clock-ppm")
+      opt.clock_ppm = std::strtod(v, nullptr);
+    else if (s == "--seed")
+      opt.seed = std::strtoull(v, nullptr, 0);
+    else if (s == "--modules")
+      opt.modules = v;
+    else
+      return usage();
+  }
+  // 63 addresses (can_node.h) and one bit per board in the delivery masks.
+  if (opt.nodes < 2 || opt.nodes > 63 || opt.segments < 1 ||
+      opt.segments > opt.nodes || opt.bus.bitrate == 0 || opt.seconds <= 0)
+    return usage();
+  if (opt.warmup >= opt.seconds)
+    opt.warmup = opt.seconds / 2;
+
+  sim s(opt);
+  if (!s.setup())
+    return 1;
+  s.run();
+  s.report();
+  return 0;
+}
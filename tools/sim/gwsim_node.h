@@ -0,0 +1,90 @@
+// gwsim_node.h
+//
+// Interface between the simulator and one simulated board.
+//
+// A board is the firmware (can_bus.c, can_node.c, telemetry*.c,
+// telemetry_thread.c) built with the shims in shim/ into a loadable module.
+// The simulator loads one private copy of the module per board, so every
+// board has its own globals exactly as on hardware, and drives it through
+// the gwsim_node_* entry points below. Everything the board does to the
+// outside world (CAN frames, UART frames, its clock) goes through the
+// gwsim_host_t callbacks.
+//
+// Single threaded: the simulator calls into one board at a time, and the
+// board's telemetry thread only runs inside gwsim_node_run().
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* One CAN frame; flags are CAN_BUS_FRAME_F_* (can_bus.h). */
+typedef struct {
+  uint32_t id;
+  uint8_t flags;
+  uint8_t len;
+  uint8_t data[64];
+  uint64_t sof_us;   /* set by the bus: sim time the frame started */
+  uint8_t tx_event;  /* sender asked for a TX event, with tx_marker */
+  uint8_t tx_marker;
+} gwsim_frame_t;
+
+typedef struct {
+  void *ctx;
+  /* Simulation time; the board derives its own (skewed) clock from it. */
+  uint64_t (*now_us)(void *ctx);
+  /* Queue a frame in the board's TX FIFO. 0 on success, -1 if full. */
+  int (*can_tx)(void *ctx, const gwsim_frame_t *frame);
+  uint32_t (*can_tx_free)(void *ctx);
+  /* Send one framed UART payload. 0 sent, 1 busy, -1 no link. */
+  int (*uart_tx)(void *ctx, uint8_t type, const uint8_t *data, size_t len);
+  /* Every message the board reassembled from CAN (for delivery stats). */
+  void (*can_msg)(void *ctx, uint32_t id, const uint8_t *data, size_t len);
+} gwsim_host_t;
+
+typedef struct {
+  uint32_t uid[3];         /* device UID: node name for the address claim */
+  int64_t clock_offset_us; /* board clock = sim time * (1 + ppm) + offset */
+  int32_t clock_ppm;
+} gwsim_node_config_t;
+
+typedef struct {
+  uint8_t can_addr;  /* can_node_addr() */
+  uint8_t can_state; /* can_node_state() */
+  uint8_t bus_state; /* can_bus_get_state() */
+  uint8_t time_master;
+  uint64_t now_us;       /* telemetry_now_us(): the synchronized clock */
+  uint32_t rx_overflow;  /* can_bus RX ring drops */
+  uint32_t tx_dropped;   /* can_bus sends refused while bus-off */
+  uint32_t stage_dropped;
+  uint32_t egress_dropped[3]; /* per side: can, uart, usb */
+  uint32_t egress_sent[3];
+  uint32_t dedup_duplicates;
+  uint32_t route_rate_limited;
+  uint32_t route_denied;
+} gwsim_node_stats_t;
+
+/* Bring the board up: CAN init, telemetry thread created (not yet run). */
+typedef int (*gwsim_node_start_fn)(const gwsim_host_t *host,
+                                   const gwsim_node_config_t *cfg);
+/* A frame completed on the bus; runs the FIFO1 interrupt. */
+typedef void (*gwsim_node_can_rx_fn)(const gwsim_frame_t *frame);
+/* The board's own frame completed on the bus; runs the TX event interrupt. */
+typedef void (*gwsim_node_can_sent_fn)(const gwsim_frame_t *frame);
+/* A UART frame arrived. */
+typedef void (*gwsim_node_uart_rx_fn)(uint8_t type, const uint8_t *data,
+                                      size_t len);
+/* Run the telemetry thread until it sleeps. Returns the sim time (us) it
+ * wants to run again. */
+typedef uint64_t (*gwsim_node_run_fn)(void);
+/* Log a message string the way an application thread would. */
+typedef int (*gwsim_node_log_fn)(const char *text, size_t len);
+typedef void (*gwsim_node_stats_fn)(gwsim_node_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,84 @@
+// node_loader.cpp
+
+#include "node_loader.h"
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+namespace gwsim {
+
+namespace {
+
+bool copy_to_temp(const std::string &src, std::string &dst, std::string &err) {
+  const char *tmp = std::getenv("TMPDIR");
+  std::string tmpl = std::string(tmp && *tmp ? tmp : "/tmp") + "/gwsim-XXXXXX";
+  std::vector<char> name(tmpl.begin(), tmpl.end());
+  name.push_back('\0');
+  const int fd = mkstemp(name.data());
+  if (fd < 0) {
+    err = "cannot create a temporary module copy";
+    return false;
+  }
+  close(fd);
+  dst = name.data();
+
+  std::ifstream in(src, std::ios::binary);
+  std::ofstream out(dst, std::ios::binary | std::ios::trunc);
+  if (!in || !out) {
+    err = "cannot copy " + src;
+    unlink(dst.c_str());
+    return false;
+  }
+  out << in.rdbuf();
+  out.close();
+  if (!out) {
+    err = "cannot copy " + src;
+    unlink(dst.c_str());
+    return false;
+  }
+  return true;
+}
+
+template <typename T> bool resolve(void *h, const char *name, T &out) {
+  out = reinterpret_cast<T>(dlsym(h, name));
+  return out != nullptr;
+}
+
+} // namespace
+
+node_module::~node_module() {
+  if (handle)
+    dlclose(handle);
+}
+
+bool node_module::load(const std::string &path, std::string &err) {
+  std::string copy;
+  if (!copy_to_temp(path, copy, err))
+    return false;
+
+  handle = dlopen(copy.c_str(), RTLD_NOW | RTLD_LOCAL);
+  unlink(copy.c_str());
+  if (!handle) {
+    const char *e = dlerror();
+    err = e ? e : "dlopen failed";
+    return false;
+  }
+
+  if (!resolve(handle, "gwsim_node_start", start) ||
+      !resolve(handle, "gwsim_node_can_rx", can_rx) ||
+      !resolve(handle, "gwsim_node_can_sent", can_sent) ||
+      !resolve(handle, "gwsim_node_uart_rx", uart_rx) ||
+      !resolve(handle, "gwsim_node_run", run) ||
+      !resolve(handle, "gwsim_node_log", log) ||
+      !resolve(handle, "gwsim_node_stats", stats)) {
+    err = path + ": missing gwsim_node_* entry point";
+    return false;
+  }
+  return true;
+}
+
+} // namespace gwsim
@@ -0,0 +1,35 @@
+// node_loader.h
+//
+// Loads one private instance of a board module (see gwsim_node.h). The
+// dynamic loader shares a library that is opened twice, so every instance
+// is a fresh copy of the module file opened with RTLD_LOCAL; the copy is
+// unlinked as soon as it is mapped.
+
+#pragma once
+
+#include "gwsim_node.h"
+
+#include <string>
+
+namespace gwsim {
+
+struct node_module {
+  void *handle = nullptr;
+  gwsim_node_start_fn start = nullptr;
+  gwsim_node_can_rx_fn can_rx = nullptr;
+  gwsim_node_can_sent_fn can_sent = nullptr;
+  gwsim_node_uart_rx_fn uart_rx = nullptr;
+  gwsim_node_run_fn run = nullptr;
+  gwsim_node_log_fn log = nullptr;
+  gwsim_node_stats_fn stats = nullptr;
+
+  node_module() = default;
+  node_module(const node_module &) = delete;
+  node_module &operator=(const node_module &) = delete;
+  ~node_module();
+
+  // Returns false and fills err on failure.
+  bool load(const std::string &path, std::string &err);
+};
+
+} // namespace gwsim
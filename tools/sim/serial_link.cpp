@@ -0,0 +1,68 @@
+// serial_link.cpp
+
+#include "serial_link.h"
+
+#include "serial_frame.h"
+
+#include <algorithm>
+
+namespace gwsim {
+
+serial_link::serial_link(uint32_t baud, size_t tx_buf_bytes,
+                         deliver_fn deliver)
+    : baud_(baud), tx_buf_bytes_(tx_buf_bytes), deliver_(std::move(deliver)) {}
+
+size_t serial_link::outstanding(const direction &d, uint64_t now_us) const {
+  if (d.wire_free_us <= now_us)
+    return 0;
+  const uint64_t us = d.wire_free_us - now_us;
+  return (size_t)((us * baud_ / 10u + 999999u) / 1000000u);
+}
+
+int serial_link::send(int from, uint8_t type, const uint8_t *data, size_t len,
+                      uint64_t now_us) {
+  direction &d = dir_[from & 1];
+
+  uint8_t enc[SERIAL_FRAME_ENCODED_MAX(SERIAL_FRAME_MAX_PAYLOAD)];
+  const size_t wire = serial_frame_encode(type, data, len, enc, sizeof(enc));
+  if (wire == 0 || outstanding(d, now_us) + wire > 2u * tx_buf_bytes_) {
+    d.stats.busy++;
+    return 1;
+  }
+
+  const uint64_t start = std::max(d.wire_free_us, now_us);
+  const uint64_t dur = ((uint64_t)wire * 10u * 1000000u + baud_ - 1u) / baud_;
+  d.wire_free_us = start + dur;
+
+  frame f;
+  f.type = type;
+  f.payload.assign(data, data + len);
+  f.arrive_us = d.wire_free_us;
+  f.wire_bytes = wire;
+  d.q.push_back(std::move(f));
+  return 0;
+}
+
+uint64_t serial_link::next_event_us() const {
+  uint64_t t = UINT64_MAX;
+  for (const direction &d : dir_) {
+    if (!d.q.empty())
+      t = std::min(t, d.q.front().arrive_us);
+  }
+  return t;
+}
+
+void serial_link::advance(uint64_t now_us) {
+  for (int from = 0; from < 2; from++) {
+    direction &d = dir_[from];
+    while (!d.q.empty() && d.q.front().arrive_us <= now_us) {
+      frame f = std::move(d.q.front());
+      d.q.pop_front();
+      d.stats.frames++;
+      d.stats.wire_bytes += f.wire_bytes;
+      deliver_(from ^ 1, f.type, f.payload.data(), f.payload.size());
+    }
+  }
+}
+
+} // namespace gwsim
@@ -0,0 +1,64 @@
+// serial_link.h
+//
+// Point-to-point UART between two segment gateways (uart_link.c on both
+// ends). Each direction is a byte pipe at the configured baud, 10 bits per
+// byte. Frames are sized with the real serial_frame.h encoding and arrive
+// whole once their last byte has crossed the wire. A sender sees busy once
+// both uart_link ping-pong halves would be full, as on the target.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace gwsim {
+
+struct serial_link_stats {
+  uint64_t frames = 0;
+  uint64_t wire_bytes = 0;
+  uint64_t busy = 0; // sends refused
+};
+
+class serial_link {
+public:
+  // deliver(to_side, type, payload, len); to_side is 0 or 1.
+  using deliver_fn =
+      std::function<void(int, uint8_t, const uint8_t *, size_t)>;
+
+  serial_link(uint32_t baud, size_t tx_buf_bytes, deliver_fn deliver);
+
+  // Queue a frame from side `from` (0 or 1). 0 sent, 1 busy.
+  int send(int from, uint8_t type, const uint8_t *data, size_t len,
+           uint64_t now_us);
+
+  uint64_t next_event_us() const;
+  void advance(uint64_t now_us);
+
+  const serial_link_stats &stats(int from) const { return dir_[from].stats; }
+
+private:
+  struct frame {
+    uint8_t type;
+    std::vector<uint8_t> payload;
+    uint64_t arrive_us;
+    size_t wire_bytes;
+  };
+
+  struct direction {
+    std::deque<frame> q;
+    uint64_t wire_free_us = 0; // when the last queued byte leaves
+    serial_link_stats stats;
+  };
+
+  size_t outstanding(const direction &d, uint64_t now_us) const;
+
+  uint32_t baud_;
+  size_t tx_buf_bytes_;
+  deliver_fn deliver_;
+  direction dir_[2];
+};
+
+} // namespace gwsim
@@ -0,0 +1,598 @@
+// node_shim.c
+//
+// The hardware and RTOS underneath one simulated board, plus the
+// gwsim_node_* entry points (gwsim_node.h).
+//
+//  - Clock: the board clock is the simulation clock with a fixed offset and
+//    a ppm error, so time sync has something to correct. HAL_GetTick(),
+//    the timebase (timebase.h, in place of timebase.c and TIM2), TIM3 and
+//    tx_time_get() all read it.
+//  - FDCAN: TX frames go straight to the virtual bus, which models the TX
+//    FIFO (depth and arbitration). RX frames land in a 3-deep FIFO1 and the
+//    FIFO1 callback runs at once, as the interrupt would. Frames sent with
+//    FDCAN_STORE_TX_EVENTS land in a 3-deep TX event FIFO when the bus
+//    reports them sent, and the TX event callback runs. RX and TX event
+//    timestamps are TIM3 at the frame's start on the bus, as the controller
+//    with the external timestamp source takes them. No error model: the
+//    controller stays error active.
+//  - uart_link: replaced at the API level (frames in, frames out); the
+//    simulator models the wire.
+//  - Router heap: plain malloc instead of the ThreadX pools in
+//    telemetry_hooks.c.
+//  - ThreadX: each created thread is a ucontext coroutine with its own host
+//    stack. tx_thread_sleep() switches back to gwsim_node_run().
+//
+// Firmware code runs in zero simulated time; latency comes from the thread
+// period, queueing and the bus.
+
+#include "gwsim_node.h"
+
+#include "GB-Threads.h"
+#include "can_bus.h"
+#include "can_node.h"
+#include "stm32g4xx_hal.h"
+#include "telemetry.h"
+#include "timebase.h"
+#include "tx_api.h"
+#include "uart_link.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+#ifndef TELEMETRY_TIME_MASTER
+#define TELEMETRY_TIME_MASTER 0
+#endif
+
+#define GWSIM_EXPORT __attribute__((visibility("default")))
+
+#define SIM_THREADS 4
+#define SIM_STACK_BYTES (256u * 1024u)
+#define SIM_RX_FIFO_DEPTH 3u // FDCAN RX FIFO1 elements on the G4
+#define SIM_TX_EVENT_DEPTH 3u // FDCAN TX event FIFO elements on the G4
+#define SIM_FDCAN_CLOCK_HZ 80000000u
+#define SIM_PCLK1_HZ 170000000u
+
+static gwsim_host_t g_host;
+static gwsim_node_config_t g_cfg;
+
+FDCAN_Config_TypeDef host_hal_fdcan_config;
+
+// =========================
+// Clock
+// =========================
+
+static uint64_t sim_now_us(void) { return g_host.now_us(g_host.ctx); }
+
+static uint64_t node_clock_at(uint64_t sim_us) {
+  const int64_t sim = (int64_t)sim_us;
+  const int64_t t = sim + sim / 1000000 * g_cfg.clock_ppm +
+                    (sim % 1000000) * g_cfg.clock_ppm / 1000000 +
+                    g_cfg.clock_offset_us;
+  return t > 0 ? (uint64_t)t : 0u;
+}
+
+static uint64_t node_clock_us(void) { return node_clock_at(sim_now_us()); }
+
+// Inverse of node_clock_us(), for wakeups.
+static uint64_t sim_us_at(uint64_t node_us) {
+  const double sim = ((double)node_us - (double)g_cfg.clock_offset_us) /
+                     (1.0 + (double)g_cfg.clock_ppm * 1e-6);
+  return sim > 0.0 ? (uint64_t)sim + 1u : 0u;
+}
+
+// Interrupts don't exist here: each board is single threaded, so PRIMASK is
+// only tracked for code that saves and restores it.
+static uint32_t g_primask;
+
+uint32_t __get_PRIMASK(void) { return g_primask; }
+void __set_PRIMASK(uint32_t primask) { g_primask = primask; }
+void __disable_irq(void) { g_primask = 1u; }
+void __enable_irq(void) { g_primask = 0u; }
+uint32_t __get_IPSR(void) { return 0u; }
+
+uint32_t HAL_GetTick(void) { return (uint32_t)(node_clock_us() / 1000u); }
+
+void timebase_init(void) {}
+uint64_t timebase_now_ns(void) { return node_clock_us() * 1000u; }
+uint64_t timebase_now_us(void) { return node_clock_us(); }
+uint64_t timebase_now_ms(void) { return node_clock_us() / 1000u; }
+void timebase_irq_handler(void) {}
+
+TIM_TypeDef *host_hal_tim3(void) {
+  static TIM_TypeDef tim3;
+  tim3.CNT = (uint32_t)(node_clock_us() & 0xFFFFu);
+  tim3.SR = 0;
+  return &tim3;
+}
+
+uint32_t HAL_RCCEx_GetPeriphCLKFreq(uint32_t clk) {
+  (void)clk;
+  return SIM_FDCAN_CLOCK_HZ;
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void) { return SIM_PCLK1_HZ; }
+
+uint32_t HAL_GetUIDw0(void) { return g_cfg.uid[0]; }
+uint32_t HAL_GetUIDw1(void) { return g_cfg.uid[1]; }
+uint32_t HAL_GetUIDw2(void) { return g_cfg.uid[2]; }
+
+ULONG tx_time_get(VOID) {
+  const uint64_t ticks =
+      node_clock_us() * (uint64_t)TX_TIMER_TICKS_PER_SECOND / 1000000u;
+  return (ULONG)(uint32_t)ticks; // 32-bit on the target
+}
+
+// =========================
+// ThreadX threads as coroutines
+// =========================
+
+typedef struct {
+  ucontext_t ctx;
+  void *stack;
+  VOID (*entry)(ULONG);
+  ULONG input;
+  uint64_t wake_us;
+  uint8_t used;
+} sim_thread_t;
+
+static sim_thread_t g_threads[SIM_THREADS];
+static sim_thread_t *g_current;
+static ucontext_t g_host_ctx;
+
+static void thread_trampoline(void) {
+  sim_thread_t *t = g_current;
+  t->entry(t->input);
+  // A returning thread never runs again.
+  t->wake_us = UINT64_MAX;
+  swapcontext(&t->ctx, &g_host_ctx);
+}
+
+UINT tx_thread_create(TX_THREAD *thread_ptr, const CHAR *name_ptr,
+                      VOID (*entry_function)(ULONG entry_input),
+                      ULONG entry_input, VOID *stack_start, ULONG stack_size,
+                      UINT priority, UINT preempt_threshold, ULONG time_slice,
+                      UINT auto_start) {
+  (void)stack_start; // firmware stacks are sized for the target, not the host
+  (void)stack_size;
+  (void)priority;
+  (void)preempt_threshold;
+  (void)time_slice;
+
+  sim_thread_t *t = NULL;
+  for (unsigned i = 0; i < SIM_THREADS; i++) {
+    if (!g_threads[i].used) {
+      t = &g_threads[i];
+      break;
+    }
+  }
+  if (!t || !thread_ptr || !entry_function)
+    return TX_THREAD_ERROR;
+
+  t->stack = malloc(SIM_STACK_BYTES);
+  if (!t->stack)
+    return TX_THREAD_ERROR;
+  getcontext(&t->ctx);
+  t->ctx.uc_stack.ss_sp = t->stack;
+  t->ctx.uc_stack.ss_size = SIM_STACK_BYTES;
+  t->ctx.uc_link = NULL;
+  makecontext(&t->ctx, thread_trampoline, 0);
+  t->entry = entry_function;
+  t->input = entry_input;
+  t->wake_us = (auto_start == TX_AUTO_START) ? 0u : UINT64_MAX;
+  t->used = 1;
+
+  thread_ptr->tx_thread_name = name_ptr;
+  thread_ptr->tx_thread_port = t;
+  return TX_SUCCESS;
+}
+
+UINT tx_thread_sleep(ULONG timer_ticks) {
+  sim_thread_t *t = g_current;
+  if (!t)
+    return TX_SUCCESS; // called from the simulator itself: nothing to yield
+
+  // Wake when the tick counter has advanced timer_ticks times.
+  const uint64_t tick_us = 1000000u / (uint64_t)TX_TIMER_TICKS_PER_SECOND;
+  const uint64_t now = node_clock_us();
+  const uint64_t ticks = (timer_ticks == 0) ? 0u : (uint64_t)timer_ticks;
+  t->wake_us = sim_us_at((now / tick_us + ticks) * tick_us);
+  if (t->wake_us <= sim_now_us())
+    t->wake_us = sim_now_us() + 1u;
+
+  g_current = NULL;
+  swapcontext(&t->ctx, &g_host_ctx);
+  g_current = t;
+  return TX_SUCCESS;
+}
+
+void HAL_Delay(uint32_t ms) {
+  if (!g_current)
+    return;
+  const ULONG ticks =
+      (ULONG)(((uint64_t)ms * TX_TIMER_TICKS_PER_SECOND + 999u) / 1000u);
+  (void)tx_thread_sleep(ticks ? ticks : 1u);
+}
+
+// =========================
+// FDCAN
+// =========================
+
+static FDCAN_GlobalTypeDef g_fdcan_regs;
+static FDCAN_HandleTypeDef g_hfdcan = {.Instance = &g_fdcan_regs};
+static gwsim_frame_t g_rx_fifo[SIM_RX_FIFO_DEPTH];
+static uint32_t g_rx_count;
+static FDCAN_TxEventFifoTypeDef g_tx_events[SIM_TX_EVENT_DEPTH];
+static uint32_t g_tx_event_count;
+static uint8_t g_started;
+
+static const uint8_t k_dlc_len[16] = {0, 1,  2,  3,  4,  5,  6,  7,
+                                      8, 12, 16, 20, 24, 32, 48, 64};
+
+static uint32_t len_to_dlc(uint8_t len) {
+  for (uint32_t dlc = 0; dlc < 16u; dlc++) {
+    if (k_dlc_len[dlc] >= len)
+      return dlc;
+  }
+  return 15u;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_Init(FDCAN_HandleTypeDef *hfdcan) {
+  (void)hfdcan;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_Start(FDCAN_HandleTypeDef *hfdcan) {
+  CLEAR_BIT(hfdcan->Instance->CCCR, FDCAN_CCCR_INIT);
+  g_started = 1;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_Stop(FDCAN_HandleTypeDef *hfdcan) {
+  SET_BIT(hfdcan->Instance->CCCR, FDCAN_CCCR_INIT);
+  g_started = 0;
+  g_rx_count = 0;
+  g_tx_event_count = 0;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ConfigGlobalFilter(FDCAN_HandleTypeDef *hfdcan,
+                                              uint32_t NonMatchingStd,
+                                              uint32_t NonMatchingExt,
+                                              uint32_t RejectRemoteStd,
+                                              uint32_t RejectRemoteExt) {
+  (void)hfdcan;
+  (void)NonMatchingStd;
+  (void)NonMatchingExt;
+  (void)RejectRemoteStd;
+  (void)RejectRemoteExt;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ConfigTimestampCounter(FDCAN_HandleTypeDef *hfdcan,
+                                                  uint32_t TimestampPrescaler) {
+  (void)hfdcan;
+  (void)TimestampPrescaler;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_EnableTimestampCounter(FDCAN_HandleTypeDef *hfdcan,
+                                                  uint32_t TimestampOperation) {
+  (void)hfdcan;
+  (void)TimestampOperation;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ActivateNotification(FDCAN_HandleTypeDef *hfdcan,
+                                                uint32_t ActiveITs,
+                                                uint32_t BufferIndexes) {
+  (void)hfdcan;
+  (void)ActiveITs;
+  (void)BufferIndexes;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_AddMessageToTxFifoQ(FDCAN_HandleTypeDef *hfdcan,
+                                               const FDCAN_TxHeaderTypeDef *pTxHeader,
+                                               const uint8_t *pTxData) {
+  (void)hfdcan;
+  if (!g_started)
+    return HAL_ERROR;
+
+  gwsim_frame_t f;
+  memset(&f, 0, sizeof(f));
+  f.id = pTxHeader->Identifier;
+  if (pTxHeader->IdType == FDCAN_EXTENDED_ID)
+    f.flags |= CAN_BUS_FRAME_F_EXT;
+  if (pTxHeader->TxFrameType == FDCAN_REMOTE_FRAME)
+    f.flags |= CAN_BUS_FRAME_F_RTR;
+  if (pTxHeader->FDFormat == FDCAN_FD_CAN)
+    f.flags |= CAN_BUS_FRAME_F_FD;
+  if (pTxHeader->BitRateSwitch == FDCAN_BRS_ON)
+    f.flags |= CAN_BUS_FRAME_F_BRS;
+  f.len = k_dlc_len[pTxHeader->DataLength & 0xFu];
+  if (f.len > 8 && !(f.flags & CAN_BUS_FRAME_F_FD))
+    f.len = 8;
+  if (!(f.flags & CAN_BUS_FRAME_F_RTR))
+    memcpy(f.data, pTxData, f.len);
+  if (pTxHeader->TxEventFifoControl == FDCAN_STORE_TX_EVENTS) {
+    f.tx_event = 1;
+    f.tx_marker = (uint8_t)pTxHeader->MessageMarker;
+  }
+
+  return (g_host.can_tx(g_host.ctx, &f) == 0) ? HAL_OK : HAL_ERROR;
+}
+
+uint32_t HAL_FDCAN_GetTxFifoFreeLevel(const FDCAN_HandleTypeDef *hfdcan) {
+  (void)hfdcan;
+  return g_started ? g_host.can_tx_free(g_host.ctx) : 0u;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_AbortTxRequest(FDCAN_HandleTypeDef *hfdcan,
+                                          uint32_t BufferIndexes) {
+  (void)hfdcan;
+  (void)BufferIndexes;
+  return HAL_OK;
+}
+
+uint32_t HAL_FDCAN_GetRxFifoFillLevel(const FDCAN_HandleTypeDef *hfdcan,
+                                      uint32_t RxFifo) {
+  (void)hfdcan;
+  return (RxFifo == FDCAN_RX_FIFO1) ? g_rx_count : 0u;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_GetRxMessage(FDCAN_HandleTypeDef *hfdcan,
+                                        uint32_t RxLocation,
+                                        FDCAN_RxHeaderTypeDef *pRxHeader,
+                                        uint8_t *pRxData) {
+  (void)hfdcan;
+  if (RxLocation != FDCAN_RX_FIFO1 || g_rx_count == 0)
+    return HAL_ERROR;
+
+  const gwsim_frame_t *f = &g_rx_fifo[0];
+  memset(pRxHeader, 0, sizeof(*pRxHeader));
+  pRxHeader->Identifier = f->id;
+  pRxHeader->IdType =
+      (f->flags & CAN_BUS_FRAME_F_EXT) ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID;
+  pRxHeader->RxFrameType =
+      (f->flags & CAN_BUS_FRAME_F_RTR) ? FDCAN_REMOTE_FRAME : FDCAN_DATA_FRAME;
+  pRxHeader->FDFormat =
+      (f->flags & CAN_BUS_FRAME_F_FD) ? FDCAN_FD_CAN : FDCAN_CLASSIC_CAN;
+  pRxHeader->BitRateSwitch =
+      (f->flags & CAN_BUS_FRAME_F_BRS) ? FDCAN_BRS_ON : FDCAN_BRS_OFF;
+  pRxHeader->ErrorStateIndicator = FDCAN_ESI_ACTIVE;
+  pRxHeader->DataLength = len_to_dlc(f->len);
+  pRxHeader->RxTimestamp = (uint32_t)(node_clock_at(f->sof_us) & 0xFFFFu);
+  memcpy(pRxData, f->data, f->len);
+
+  memmove(&g_rx_fifo[0], &g_rx_fifo[1], (g_rx_count - 1u) * sizeof(g_rx_fifo[0]));
+  g_rx_count--;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_GetTxEvent(FDCAN_HandleTypeDef *hfdcan,
+                                      FDCAN_TxEventFifoTypeDef *pTxEvent) {
+  (void)hfdcan;
+  if (g_tx_event_count == 0)
+    return HAL_ERROR;
+  *pTxEvent = g_tx_events[0];
+  memmove(&g_tx_events[0], &g_tx_events[1],
+          (g_tx_event_count - 1u) * sizeof(g_tx_events[0]));
+  g_tx_event_count--;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_FDCAN_GetProtocolStatus(const FDCAN_HandleTypeDef *hfdcan,
+                            FDCAN_ProtocolStatusTypeDef *ProtocolStatus) {
+  (void)hfdcan;
+  memset(ProtocolStatus, 0, sizeof(*ProtocolStatus));
+  ProtocolStatus->LastErrorCode = FDCAN_PROTOCOL_ERROR_NO_CHANGE;
+  ProtocolStatus->DataLastErrorCode = FDCAN_PROTOCOL_ERROR_NO_CHANGE;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_FDCAN_GetErrorCounters(const FDCAN_HandleTypeDef *hfdcan,
+                           FDCAN_ErrorCountersTypeDef *ErrorCounters) {
+  (void)hfdcan;
+  memset(ErrorCounters, 0, sizeof(*ErrorCounters));
+  return HAL_OK;
+}
+
+// =========================
+// uart_link (API level)
+// =========================
+
+static serial_frame_rx_cb_t g_uart_cb[UART_LINK_MAX_SUBSCRIBERS];
+static void *g_uart_user[UART_LINK_MAX_SUBSCRIBERS];
+static uart_link_stats_t g_uart_stats;
+
+HAL_StatusTypeDef uart_link_init(UART_HandleTypeDef *huart, uint32_t baud) {
+  (void)huart;
+  (void)baud;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef uart_link_set_baud(uint32_t baud) {
+  (void)baud;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef uart_link_send(uint8_t type, const uint8_t *data,
+                                 size_t len) {
+  if (len > SERIAL_FRAME_MAX_PAYLOAD) {
+    g_uart_stats.tx_dropped++;
+    return HAL_ERROR;
+  }
+  const int r = g_host.uart_tx(g_host.ctx, type, data, len);
+  if (r == 1) {
+    g_uart_stats.tx_dropped++;
+    return HAL_BUSY;
+  }
+  // No link attached: the bytes go nowhere, as with nothing on the radio.
+  g_uart_stats.tx_frames++;
+  g_uart_stats.tx_bytes += (uint32_t)len;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef uart_link_subscribe_rx(serial_frame_rx_cb_t cb, void *user) {
+  if (!cb)
+    return HAL_ERROR;
+  for (unsigned i = 0; i < UART_LINK_MAX_SUBSCRIBERS; i++) {
+    if (!g_uart_cb[i]) {
+      g_uart_cb[i] = cb;
+      g_uart_user[i] = user;
+      return HAL_OK;
+    }
+  }
+  return HAL_ERROR;
+}
+
+void uart_link_process_rx(void) {}
+
+void uart_link_get_stats(uart_link_stats_t *out) {
+  if (out)
+    *out = g_uart_stats;
+}
+
+// =========================
+// Router hooks (telemetry_hooks.c on the target)
+// =========================
+
+void *telemetryMalloc(size_t size) { return malloc(size); }
+
+void telemetryFree(void *ptr) { free(ptr); }
+
+void seds_error_msg(const char *str, size_t len) {
+  fprintf(stderr, "%.*s\n", (int)len, str);
+}
+
+// =========================
+// gwsim_node_* entry points
+// =========================
+
+static void on_can_msg(uint32_t id, uint8_t flags, const uint8_t *data,
+                       size_t len, void *user) {
+  (void)flags;
+  (void)user;
+  if (g_host.can_msg)
+    g_host.can_msg(g_host.ctx, id, data, len);
+}
+
+GWSIM_EXPORT int gwsim_node_start(const gwsim_host_t *host,
+                                  const gwsim_node_config_t *cfg) {
+  if (!host || !cfg)
+    return -1;
+  g_host = *host;
+  g_cfg = *cfg;
+
+  g_hfdcan.Init.FrameFormat = FDCAN_FRAME_FD_BRS;
+  g_hfdcan.Init.Mode = FDCAN_MODE_NORMAL;
+  g_hfdcan.Init.AutoRetransmission = ENABLE;
+  can_bus_init(&g_hfdcan);
+  if (can_bus_subscribe_msgs(on_can_msg, NULL) != HAL_OK)
+    return -1;
+
+  create_telemetry_thread();
+  return 0;
+}
+
+GWSIM_EXPORT void gwsim_node_can_rx(const gwsim_frame_t *frame) {
+  if (!g_started || !frame)
+    return;
+  if (g_rx_count < SIM_RX_FIFO_DEPTH)
+    g_rx_fifo[g_rx_count++] = *frame;
+  // else: FIFO overrun, the frame is lost as on the controller
+  HAL_FDCAN_RxFifo1Callback(&g_hfdcan, FDCAN_IT_RX_FIFO1_NEW_MESSAGE);
+}
+
+GWSIM_EXPORT void gwsim_node_can_sent(const gwsim_frame_t *frame) {
+  if (!g_started || !frame || !frame->tx_event)
+    return;
+  if (g_tx_event_count < SIM_TX_EVENT_DEPTH) {
+    FDCAN_TxEventFifoTypeDef *e = &g_tx_events[g_tx_event_count++];
+    memset(e, 0, sizeof(*e));
+    e->Identifier = frame->id;
+    e->IdType = (frame->flags & CAN_BUS_FRAME_F_EXT) ? FDCAN_EXTENDED_ID
+                                                     : FDCAN_STANDARD_ID;
+    e->DataLength = len_to_dlc(frame->len);
+    e->TxTimestamp = (uint32_t)(node_clock_at(frame->sof_us) & 0xFFFFu);
+    e->MessageMarker = frame->tx_marker;
+  }
+  // else: TX event FIFO full, the event is lost as on the controller
+  HAL_FDCAN_TxEventFifoCallback(&g_hfdcan, FDCAN_IT_TX_EVT_FIFO_NEW_DATA);
+}
+
+GWSIM_EXPORT void gwsim_node_uart_rx(uint8_t type, const uint8_t *data,
+                                     size_t len) {
+  g_uart_stats.rx_frames++;
+  g_uart_stats.rx_bytes += (uint32_t)len;
+  for (unsigned i = 0; i < UART_LINK_MAX_SUBSCRIBERS; i++) {
+    if (g_uart_cb[i])
+      g_uart_cb[i](type, data, len, g_uart_user[i]);
+  }
+}
+
+GWSIM_EXPORT uint64_t gwsim_node_run(void) {
+  uint64_t next = UINT64_MAX;
+  for (unsigned i = 0; i < SIM_THREADS; i++) {
+    sim_thread_t *t = &g_threads[i];
+    if (!t->used)
+      continue;
+    while (t->wake_us <= sim_now_us()) {
+      g_current = t;
+      swapcontext(&g_host_ctx, &t->ctx);
+      g_current = NULL;
+    }
+    if (t->wake_us < next)
+      next = t->wake_us;
+  }
+  return next;
+}
+
+GWSIM_EXPORT int gwsim_node_log(const char *text, size_t len) {
+  return (int)log_telemetry_asynchronous(SEDS_DT_MESSAGE_DATA, text, len, 1);
+}
+
+GWSIM_EXPORT void gwsim_node_stats(gwsim_node_stats_t *out) {
+  if (!out)
+    return;
+  memset(out, 0, sizeof(*out));
+  out->can_addr = can_node_addr();
+  out->can_state = (uint8_t)can_node_state();
+  out->bus_state = (uint8_t)can_bus_get_state();
+  out->time_master = TELEMETRY_TIME_MASTER ? 1u : 0u;
+  out->now_us = telemetry_now_us();
+
+  can_bus_stats_t cs;
+  can_bus_get_stats(&cs);
+  out->rx_overflow = cs.rx_overflow;
+  out->tx_dropped = cs.tx_dropped;
+
+  TelemetryStageStats ss;
+  telemetry_stage_get_stats(&ss);
+  out->stage_dropped = ss.dropped;
+
+#if TELEMETRY_EGRESS_QUEUES
+  for (int32_t side = 0; side < 3; side++) {
+    TelemetryEgressStats es;
+    telemetry_egress_get_stats(side, &es);
+    out->egress_dropped[side] = es.dropped_newest + es.dropped_oldest +
+                                es.expired + es.failed;
+    out->egress_sent[side] = es.sent;
+  }
+#endif
+#if TELEMETRY_DEDUP
+  TelemetryDedupStats ds;
+  telemetry_dedup_get_stats(&ds);
+  out->dedup_duplicates = ds.duplicates;
+#endif
+#if TELEMETRY_ROUTE_TABLE
+  TelemetryRouteStats rs;
+  telemetry_route_get_stats(&rs);
+  out->route_rate_limited = rs.rate_limited;
+  out->route_denied = rs.denied;
+#endif
+}
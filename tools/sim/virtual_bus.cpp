@@ -0,0 +1,164 @@
+// virtual_bus.cpp
+
+#include "virtual_bus.h"
+
+#include "can_bus.h"
+
+#include <algorithm>
+
+namespace gwsim {
+
+namespace {
+
+uint64_t arb_key(const gwsim_frame_t &f) {
+  return gwtiming::arbitration_key(f.id, (f.flags & CAN_BUS_FRAME_F_EXT) != 0);
+}
+
+uint32_t band_of(const gwsim_frame_t &f) {
+  const uint32_t base =
+      (f.flags & CAN_BUS_FRAME_F_EXT) ? (f.id >> 18) & 0x7FFu : f.id & 0x7FFu;
+  return base >> 6;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Frame timing
+// ---------------------------------------------------------------------------
+
+uint64_t frame_time_ns(const gwsim_frame_t &f, const bus_config &cfg) {
+  gwtiming::frame_shape shape;
+  shape.ext = (f.flags & CAN_BUS_FRAME_F_EXT) != 0;
+  shape.fd = (f.flags & CAN_BUS_FRAME_F_FD) != 0;
+  shape.brs = (f.flags & CAN_BUS_FRAME_F_BRS) != 0;
+  shape.rtr = (f.flags & CAN_BUS_FRAME_F_RTR) != 0;
+  shape.len = f.len;
+  gwtiming::bit_rates rates;
+  rates.nominal = cfg.bitrate;
+  rates.data = cfg.data_bitrate;
+  return gwtiming::frame_time_ns(shape, rates);
+}
+
+// ---------------------------------------------------------------------------
+// Bus
+// ---------------------------------------------------------------------------
+
+virtual_bus::virtual_bus(const bus_config &cfg, uint64_t seed)
+    : cfg_(cfg), rng_(seed) {}
+
+size_t virtual_bus::attach(bus_port *port) {
+  port_state p;
+  p.port = port;
+  ports_.push_back(p);
+  return ports_.size() - 1;
+}
+
+bool virtual_bus::chance(double p) { return p > 0.0 && unit_(rng_) < p; }
+
+bool virtual_bus::submit(size_t port, const gwsim_frame_t &f, uint64_t now_us) {
+  port_state &p = ports_.at(port);
+  if (p.fifo.size() >= cfg_.tx_fifo)
+    return false;
+  p.fifo.push_back({f, now_us});
+  if (!busy_ && !arbitrate_) {
+    // Everything submitted at this instant competes in the same round.
+    arbitrate_ = true;
+    arbitrate_us_ = now_us;
+  }
+  return true;
+}
+
+uint32_t virtual_bus::tx_free(size_t port) const {
+  const size_t used = ports_.at(port).fifo.size();
+  return used >= cfg_.tx_fifo ? 0u : (uint32_t)(cfg_.tx_fifo - used);
+}
+
+uint64_t virtual_bus::next_event_us() const {
+  if (busy_)
+    return tx_end_us_;
+  if (arbitrate_)
+    return arbitrate_us_;
+  return UINT64_MAX;
+}
+
+void virtual_bus::start_next(uint64_t t_us) {
+  size_t best = ports_.size();
+  uint64_t best_key = UINT64_MAX;
+  for (size_t i = 0; i < ports_.size(); i++) {
+    if (ports_[i].fifo.empty())
+      continue;
+    const uint64_t key = arb_key(ports_[i].fifo.front().frame);
+    if (key < best_key) {
+      best_key = key;
+      best = i;
+    }
+  }
+  if (best == ports_.size())
+    return;
+
+  tx_port_ = best;
+  tx_ = ports_[best].fifo.front();
+  ports_[best].fifo.pop_front();
+  const uint64_t ns = frame_time_ns(tx_.frame, cfg_);
+  tx_.frame.sof_us = t_us;
+  tx_start_us_ = t_us;
+  tx_end_us_ = t_us + (ns + 999u) / 1000u;
+  busy_ = true;
+}
+
+void virtual_bus::complete(uint64_t t_us) {
+  busy_ = false;
+  stats_.frames++;
+  stats_.payload_bytes += tx_.frame.len;
+  stats_.busy_us += t_us - tx_start_us_;
+  stats_.latency[band_of(tx_.frame)].add(t_us - tx_.submit_us);
+  ports_[tx_port_].port->sent(tx_.frame);
+
+  for (size_t i = 0; i < ports_.size(); i++) {
+    if (i == tx_port_)
+      continue;
+    port_state &p = ports_[i];
+    if (chance(cfg_.loss)) {
+      stats_.lost++;
+      continue;
+    }
+    if (!p.holding && chance(cfg_.reorder)) {
+      // Deliver after the next frame this receiver sees.
+      p.holding = true;
+      p.held = tx_.frame;
+      stats_.reordered++;
+      continue;
+    }
+    p.port->deliver(tx_.frame);
+    if (chance(cfg_.dup)) {
+      stats_.duplicated++;
+      p.port->deliver(tx_.frame);
+    }
+    if (p.holding) {
+      p.holding = false;
+      p.port->deliver(p.held);
+    }
+  }
+}
+
+void virtual_bus::advance(uint64_t now_us) {
+  for (;;) {
+    if (busy_) {
+      if (tx_end_us_ > now_us)
+        return;
+      const uint64_t end = tx_end_us_;
+      complete(end);
+      // Bus idle after the intermission: the next round starts at once.
+      start_next(end);
+      continue;
+    }
+    if (arbitrate_ && arbitrate_us_ <= now_us) {
+      arbitrate_ = false;
+      start_next(arbitrate_us_);
+      continue;
+    }
+    return;
+  }
+}
+
+} // namespace gwsim
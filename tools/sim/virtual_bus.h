@@ -0,0 +1,121 @@
+// virtual_bus.h
+//
+// In-memory CAN / CAN FD bus for the simulator.
+//
+//  - Every attached port has a TX FIFO of the FDCAN's depth. Only the head
+//    of each FIFO competes, as in FIFO mode on the controller.
+//  - When the bus goes idle the lowest identifier among the heads wins
+//    (11-bit base ID first, a standard frame beats an extended one with the
+//    same base) and occupies the bus for its bit time. The bit time counts
+//    the arbitration and ACK/EOF/IFS fields at the nominal rate, the FD data
+//    phase at the data rate when BRS is set, and worst-case bit stuffing.
+//  - Frames reach every other port when they complete, stamped with the
+//    time they started (sof_us), and the sender is told its frame went out.
+//    Loss, duplication and reordering are drawn per receiver, so they model
+//    a receiver missing a frame rather than the bus as a whole (which CAN
+//    would retransmit).
+//
+// Time is in microseconds of simulation time. Frame durations are rounded
+// up to a whole microsecond.
+
+#pragma once
+
+#include "can_timing.h"
+#include "gwsim_node.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace gwsim {
+
+struct bus_config {
+  uint32_t bitrate = 500000;       // nominal (arbitration) bit rate
+  uint32_t data_bitrate = 2000000; // FD data phase with BRS
+  unsigned tx_fifo = 3;            // FDCAN TX FIFO elements per port
+  double loss = 0.0;               // per receiver: frame never delivered
+  double dup = 0.0;                // per receiver: delivered twice
+  double reorder = 0.0;            // per receiver: swapped with the next one
+};
+
+class bus_port {
+public:
+  virtual ~bus_port() = default;
+  virtual void deliver(const gwsim_frame_t &f) = 0;
+  // This port's own frame completed.
+  virtual void sent(const gwsim_frame_t &f) { (void)f; }
+};
+
+using gwtiming::latency_stats;
+
+struct bus_stats {
+  uint64_t frames = 0;
+  uint64_t payload_bytes = 0;
+  uint64_t busy_us = 0;
+  uint64_t lost = 0;
+  uint64_t duplicated = 0;
+  uint64_t reordered = 0;
+  // Submit to end of frame (FIFO wait + arbitration + wire), per ID band
+  // (upper bits of the 11-bit ID, see can_node.h).
+  std::map<uint32_t, latency_stats> latency;
+};
+
+// Bus time of one frame, in nanoseconds (can_timing.h, worst-case stuffing).
+uint64_t frame_time_ns(const gwsim_frame_t &f, const bus_config &cfg);
+
+class virtual_bus {
+public:
+  virtual_bus(const bus_config &cfg, uint64_t seed);
+
+  size_t attach(bus_port *port);
+
+  // Queue a frame in the port's TX FIFO. False if the FIFO is full.
+  bool submit(size_t port, const gwsim_frame_t &f, uint64_t now_us);
+  uint32_t tx_free(size_t port) const;
+
+  // Time of the next bus event (end of frame or pending arbitration).
+  uint64_t next_event_us() const;
+
+  // Run the bus up to now_us: finish frames, deliver them, start the next.
+  void advance(uint64_t now_us);
+
+  const bus_stats &stats() const { return stats_; }
+
+private:
+  struct queued {
+    gwsim_frame_t frame;
+    uint64_t submit_us;
+  };
+
+  struct port_state {
+    bus_port *port = nullptr;
+    std::deque<queued> fifo;
+    bool holding = false; // a frame held back for reordering
+    gwsim_frame_t held{};
+  };
+
+  void start_next(uint64_t t_us);
+  void complete(uint64_t t_us);
+  bool chance(double p);
+
+  bus_config cfg_;
+  std::mt19937_64 rng_;
+  std::uniform_real_distribution<double> unit_{0.0, 1.0};
+  std::vector<port_state> ports_;
+
+  bool busy_ = false;
+  size_t tx_port_ = 0;
+  queued tx_{};
+  uint64_t tx_start_us_ = 0;
+  uint64_t tx_end_us_ = 0;
+
+  bool arbitrate_ = false; // frames waiting while the bus is idle
+  uint64_t arbitrate_us_ = 0;
+
+  bus_stats stats_;
+};
+
+} // namespace gwsim
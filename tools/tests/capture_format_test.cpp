@@ -0,0 +1,256 @@
+// capture_format_test.cpp
+//
+// capture_writer -> capture_reader round trips: a cleanly closed capture read
+// through the footer index, and copies of the file taken before close and cut
+// at various points, which the reader must index by walking the checkpoint
+// chain back from EOF (prev_checkpoint) and finish with an unindexed tail.
+// Every readable record must come back once, in order; a cut record and
+// anything after a broken chain must not be lost or misread.
+//
+// Usage: capture_format_test <scratch directory>
+
+#include "capture_reader.h"
+#include "capture_writer.h"
+
+#include "test_check.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t kT0 = 1700000000000000ull;
+constexpr uint64_t kStepUs = 1000;
+constexpr uint32_t kSpanUs = 50000; // a block every 50 records
+
+std::string g_dir;
+
+std::string path(const char *name) { return g_dir + "/" + name; }
+
+std::vector<uint8_t> read_file(const std::string &p) {
+  std::vector<uint8_t> out;
+  std::FILE *fp = std::fopen(p.c_str(), "rb");
+  if (!fp)
+    return out;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), fp)) > 0)
+    out.insert(out.end(), buf, buf + n);
+  std::fclose(fp);
+  return out;
+}
+
+void write_file(const std::string &p, const std::vector<uint8_t> &data,
+                size_t len) {
+  std::FILE *fp = std::fopen(p.c_str(), "wb");
+  CHECK(fp != nullptr);
+  if (!fp)
+    return;
+  CHECK(std::fwrite(data.data(), 1, len, fp) == len);
+  std::fclose(fp);
+}
+
+// Record i: a CAN frame carrying i, or every 7th a router packet carrying i.
+bool add(gwcap::capture_writer &w, uint32_t i) {
+  const uint64_t t = kT0 + i * kStepUs;
+  if (i % 7 == 6) {
+    uint8_t pkt[5] = {0xA5};
+    std::memcpy(&pkt[1], &i, 4);
+    return w.add_router(t, pkt, sizeof(pkt));
+  }
+  gwcap::can_frame f;
+  f.dev_ts_us = i;
+  f.id = 0x100 + (i % 5);
+  f.flags = gwcap::CAN_F_FD;
+  f.len = 12;
+  std::memcpy(f.data, &i, 4);
+  return w.add_can(t, f);
+}
+
+uint32_t record_index(const gwcap::record_view &v) {
+  uint32_t i = ~0u;
+  if (v.type == gwcap::REC_ROUTER && v.len == 5) {
+    std::memcpy(&i, v.payload + 1, 4);
+  } else {
+    gwcap::can_frame f;
+    if (gwcap::capture_reader::decode_can(v, f))
+      std::memcpy(&i, f.data, 4);
+  }
+  return i;
+}
+
+// Records 0..n-1, each once and in order.
+void check_all(const gwcap::capture_reader &r, uint32_t n) {
+  uint32_t next = 0;
+  bool in_order = true;
+  const uint64_t got = r.scan(gwcap::query{}, [&](const gwcap::record_view &v) {
+    in_order = in_order && record_index(v) == next &&
+               v.t_us == kT0 + next * kStepUs;
+    next++;
+    return true;
+  });
+  CHECK(in_order);
+  CHECK(got == n && next == n);
+}
+
+// Time and ID queries answered through the index and the tail alike.
+void check_queries(const gwcap::capture_reader &r, uint32_t n) {
+  gwcap::query q;
+  q.from_us = kT0 + 40 * kStepUs;
+  q.to_us = kT0 + (n - 1) * kStepUs;
+  uint64_t got = r.scan(q, [](const gwcap::record_view &) { return true; });
+  CHECK(got == n - 40);
+
+  gwcap::query ids;
+  ids.ids = {0x102};
+  uint32_t expect = 0;
+  for (uint32_t i = 0; i < n; i++)
+    expect += (i % 7 != 6 && i % 5 == 2);
+  bool only_id = true;
+  got = r.scan(ids, [&](const gwcap::record_view &v) {
+    gwcap::can_frame f;
+    only_id = only_id && gwcap::capture_reader::decode_can(v, f) &&
+              f.id == 0x102;
+    return true;
+  });
+  CHECK(only_id);
+  CHECK(got == expect);
+}
+
+uint64_t indexed_records(const gwcap::capture_reader &r) {
+  uint64_t n = 0;
+  for (const auto &b : r.blocks())
+    n += b.records;
+  return n;
+}
+
+void test_round_trip() {
+  constexpr uint32_t kRecords = 1000;
+  constexpr uint32_t kSnapAt = 325; // mid-block: 6 checkpoints + 25 tail
+  const std::string full = path("full.gwcap");
+
+  gwcap::writer_options opt;
+  opt.block_span_us = kSpanUs;
+  gwcap::capture_writer w;
+  CHECK(w.open(full, opt));
+  std::vector<uint8_t> snap;
+  for (uint32_t i = 0; i < kRecords; i++) {
+    CHECK(add(w, i));
+    if (i + 1 == kSnapAt) {
+      w.flush();
+      snap = read_file(full); // what a power cut here would leave
+    }
+  }
+  CHECK(w.close());
+  CHECK(w.records() == kRecords);
+
+  // Clean close: the footer index covers everything.
+  {
+    gwcap::capture_reader r;
+    CHECK(r.open(full));
+    CHECK(r.source() == gwcap::index_source::footer);
+    CHECK(r.blocks().size() == kRecords * kStepUs / kSpanUs);
+    CHECK(indexed_records(r) == kRecords);
+    CHECK(r.tail().records == 0);
+    check_all(r, kRecords);
+    check_queries(r, kRecords);
+  }
+
+  // Never closed: checkpoints recovered from the prev chain, the records
+  // after the last one in the tail.
+  {
+    const std::string p = path("unclosed.gwcap");
+    write_file(p, snap, snap.size());
+    gwcap::capture_reader r;
+    CHECK(r.open(p));
+    CHECK(r.source() == gwcap::index_source::recovered);
+    CHECK(r.blocks().size() == kSnapAt * kStepUs / kSpanUs);
+    CHECK(indexed_records(r) + r.tail().records == kSnapAt);
+    CHECK(r.tail().records == kSnapAt % (kSpanUs / kStepUs));
+    CHECK(r.tail().t_last_us == kT0 + (kSnapAt - 1) * kStepUs);
+    check_all(r, kSnapAt);
+    check_queries(r, kSnapAt);
+  }
+
+  // Cut inside the last record: it is dropped, everything before it stays.
+  {
+    const std::string p = path("cut_record.gwcap");
+    write_file(p, snap, snap.size() - 3);
+    gwcap::capture_reader r;
+    CHECK(r.open(p));
+    CHECK(r.source() == gwcap::index_source::recovered);
+    check_all(r, kSnapAt - 1);
+  }
+
+  // Cut inside the footer of a closed capture: recovered like a crash, and
+  // the final checkpoint written by close() leaves no tail.
+  {
+    const std::vector<uint8_t> data = read_file(full);
+    const std::string p = path("cut_footer.gwcap");
+    write_file(p, data, data.size() - sizeof(gwcap::trailer) / 2);
+    gwcap::capture_reader r;
+    CHECK(r.open(p));
+    CHECK(r.source() == gwcap::index_source::recovered);
+    CHECK(indexed_records(r) == kRecords);
+    CHECK(r.tail().records == 0);
+    check_all(r, kRecords);
+  }
+
+  // A broken chain (first checkpoint damaged): nothing is trusted as
+  // indexed, the whole file is read as tail.
+  {
+    std::vector<uint8_t> data = snap;
+    gwcap::capture_reader r0;
+    CHECK(r0.open(path("unclosed.gwcap")));
+    CHECK(!r0.blocks().empty());
+    if (!r0.blocks().empty()) {
+      const uint64_t first = r0.blocks().front().block_end;
+      data[first + sizeof(gwcap::record_header)] ^= 0xFF; // sync word
+    }
+    const std::string p = path("broken_chain.gwcap");
+    write_file(p, data, data.size());
+    gwcap::capture_reader r;
+    CHECK(r.open(p));
+    CHECK(r.source() == gwcap::index_source::none);
+    CHECK(r.blocks().empty());
+    CHECK(r.tail().records == kSnapAt);
+    check_all(r, kSnapAt);
+  }
+}
+
+// Killed before the first block closed: no checkpoint at all.
+void test_no_checkpoint() {
+  const std::string p = path("no_checkpoint.gwcap");
+  gwcap::writer_options opt;
+  opt.block_span_us = kSpanUs;
+  gwcap::capture_writer w;
+  CHECK(w.open(p, opt));
+  for (uint32_t i = 0; i < 20; i++)
+    CHECK(add(w, i));
+  w.flush();
+  const std::vector<uint8_t> data = read_file(p);
+  CHECK(w.close());
+  write_file(p, data, data.size());
+
+  gwcap::capture_reader r;
+  CHECK(r.open(p));
+  CHECK(r.source() == gwcap::index_source::none);
+  CHECK(r.tail().records == 20);
+  CHECK(r.tail().t_first_us == kT0);
+  check_all(r, 20);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::fprintf(stderr, "usage: capture_format_test <scratch directory>\n");
+    return 2;
+  }
+  g_dir = argv[1];
+  test_round_trip();
+  test_no_checkpoint();
+  return test_failures();
+}
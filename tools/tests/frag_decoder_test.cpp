@@ -0,0 +1,228 @@
+// frag_decoder_test.cpp
+//
+// gwdec::reassembler against hand-built fragment streams: whole frames,
+// fragments out of order and duplicated, a partial message superseded by a
+// new seq, the reassembly timeout, and many interleaved messages whose
+// streams share probe chains, so completing them in random order exercises
+// the backward-shift erase.
+
+#include "frag_decoder.h"
+
+#include "test_check.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+struct got_packet {
+  uint32_t id;
+  bool fragmented;
+  uint8_t seq;
+  uint64_t t_first_us;
+  uint64_t t_last_us;
+  std::vector<uint8_t> data;
+};
+
+std::vector<got_packet> g_got;
+
+void collect(const gwdec::packet &p, void *) {
+  g_got.push_back({p.id, p.fragmented, p.seq, p.t_first_us, p.t_last_us,
+                   std::vector<uint8_t>(p.data, p.data + p.len)});
+}
+
+constexpr size_t kDataCap = CAN_BUS_FRAG_WIRE_LEN - sizeof(can_bus_frag_hdr_t);
+
+// The frames can_bus_send_large() puts on the bus for one message.
+std::vector<gwdec::frame> fragments(uint32_t id, uint8_t seq,
+                                    const std::vector<uint8_t> &msg,
+                                    uint64_t t_us) {
+  const size_t cnt = (msg.size() + kDataCap - 1) / kDataCap;
+  std::vector<gwdec::frame> out;
+  for (size_t i = 0; i < cnt; i++) {
+    gwdec::frame f{};
+    f.t_us = t_us + i;
+    f.id = id;
+    f.flags = gwdec::F_FD;
+    f.len = CAN_BUS_FRAG_WIRE_LEN;
+    can_bus_frag_hdr_t h{};
+    h.magic = CAN_BUS_FRAG_MAGIC;
+    h.seq = seq;
+    h.frag_idx = uint8_t(i);
+    h.frag_cnt = uint8_t(cnt);
+    h.flags = uint8_t((i == 0 ? CAN_BUS_FRAG_F_FIRST : 0) |
+                      (i + 1 == cnt ? CAN_BUS_FRAG_F_LAST : 0));
+    h.total_len = uint16_t(msg.size());
+    std::memcpy(f.data, &h, sizeof(h));
+    const size_t off = i * kDataCap;
+    const size_t take = msg.size() - off < kDataCap ? msg.size() - off : kDataCap;
+    std::memcpy(f.data + sizeof(h), &msg[off], take);
+    out.push_back(f);
+  }
+  return out;
+}
+
+std::vector<uint8_t> message(size_t len, uint8_t salt) {
+  std::vector<uint8_t> m(len);
+  for (size_t i = 0; i < len; i++)
+    m[i] = uint8_t(i * 7u + salt);
+  return m;
+}
+
+void test_whole_frame() {
+  g_got.clear();
+  gwdec::reassembler r(gwdec::options{});
+  gwdec::frame f{};
+  f.t_us = 10;
+  f.id = 0x42;
+  f.len = 8;
+  std::memcpy(f.data, "\x01\x02\x03\x04\x05\x06\x07\x08", 8);
+  r.push(f, collect, nullptr);
+  CHECK(g_got.size() == 1);
+  CHECK(!g_got[0].fragmented && g_got[0].id == 0x42);
+  CHECK(g_got[0].data.size() == 8 && g_got[0].data[7] == 8);
+  CHECK(r.get_stats().whole == 1 && r.get_stats().fragments == 0);
+}
+
+void test_out_of_order_and_duplicates() {
+  g_got.clear();
+  gwdec::reassembler r(gwdec::options{});
+  const std::vector<uint8_t> msg = message(150, 3); // 3 fragments
+  const auto fr = fragments(0x100, 9, msg, 1000);
+  CHECK(fr.size() == 3);
+
+  r.push(fr[2], collect, nullptr);
+  r.push(fr[0], collect, nullptr);
+  r.push(fr[2], collect, nullptr); // duplicate
+  r.push(fr[0], collect, nullptr); // duplicate
+  CHECK(g_got.empty());
+  r.push(fr[1], collect, nullptr);
+
+  CHECK(g_got.size() == 1);
+  CHECK(g_got[0].fragmented && g_got[0].seq == 9);
+  CHECK(g_got[0].data == msg);
+  CHECK(g_got[0].t_first_us == fr[2].t_us && g_got[0].t_last_us == fr[2].t_us);
+  const gwdec::stats &s = r.get_stats();
+  CHECK(s.duplicates == 2 && s.packets == 1 && s.fragments == 5);
+  r.finish();
+  CHECK(r.get_stats().incomplete == 0);
+}
+
+void test_superseded() {
+  g_got.clear();
+  gwdec::reassembler r(gwdec::options{});
+  const std::vector<uint8_t> old_msg = message(120, 1);
+  const std::vector<uint8_t> new_msg = message(100, 2);
+  const auto old_fr = fragments(0x200, 4, old_msg, 0);
+  const auto new_fr = fragments(0x200, 5, new_msg, 100);
+
+  r.push(old_fr[0], collect, nullptr);
+  for (const auto &f : new_fr)
+    r.push(f, collect, nullptr);
+  r.push(old_fr[1], collect, nullptr); // late: starts a partial of its own
+
+  CHECK(g_got.size() == 1);
+  CHECK(g_got[0].seq == 5 && g_got[0].data == new_msg);
+  CHECK(r.get_stats().superseded == 1);
+  r.finish();
+  CHECK(r.get_stats().incomplete == 1);
+}
+
+void test_timeout() {
+  g_got.clear();
+  gwdec::options opt;
+  opt.timeout_us = 1000;
+  gwdec::reassembler r(opt);
+  const std::vector<uint8_t> msg = message(100, 5);
+  auto fr = fragments(0x300, 1, msg, 0);
+
+  // A gap longer than the timeout drops the partial message...
+  fr[1].t_us = fr[0].t_us + opt.timeout_us + 1;
+  r.push(fr[0], collect, nullptr);
+  r.push(fr[1], collect, nullptr);
+  CHECK(g_got.empty());
+  CHECK(r.get_stats().timed_out == 1);
+  r.finish();
+
+  // ... a timestamp that goes backwards does not.
+  gwdec::reassembler r2(opt);
+  fr = fragments(0x300, 2, msg, 50000);
+  fr[1].t_us = 10;
+  r2.push(fr[0], collect, nullptr);
+  r2.push(fr[1], collect, nullptr);
+  CHECK(g_got.size() == 1 && g_got[0].data == msg);
+  CHECK(r2.get_stats().timed_out == 0);
+}
+
+void test_no_stream() {
+  g_got.clear();
+  gwdec::options opt;
+  opt.max_streams = 2;
+  gwdec::reassembler r(opt);
+  const std::vector<uint8_t> msg = message(100, 6);
+  for (uint32_t id = 1; id <= 3; id++)
+    r.push(fragments(id, 0, msg, 0)[0], collect, nullptr);
+  CHECK(r.get_stats().no_stream == 1);
+  r.finish();
+  CHECK(r.get_stats().incomplete == 2);
+}
+
+// Streams of 64 IDs at once in a table of 128 slots: probe chains form, and
+// completing messages in random order erases from the middle of them.
+void test_interleaved() {
+  constexpr unsigned kIds = 64;
+  gwdec::options opt;
+  opt.max_streams = kIds;
+  opt.timeout_us = ~uint64_t(0) / 2;
+  gwdec::reassembler r(opt);
+
+  for (unsigned round = 0; round < 20; round++) {
+    g_got.clear();
+    std::vector<std::vector<uint8_t>> msgs;
+    std::vector<gwdec::frame> all;
+    for (unsigned i = 0; i < kIds; i++) {
+      // Extended and TX frames with the same numeric ID are separate streams.
+      const uint32_t id = (i * 0x35u + round) & 0x7FFu;
+      msgs.push_back(message(60 + (i * 37u + round) % 400u, uint8_t(i + round)));
+      auto fr = fragments(id, uint8_t(round), msgs.back(), round * 100000u);
+      for (auto &f : fr)
+        f.flags |= uint8_t((i & 1) ? gwdec::F_EXT : 0) |
+                   uint8_t((i & 2) ? gwdec::F_TX : 0);
+      all.insert(all.end(), fr.begin(), fr.end());
+    }
+    for (size_t i = all.size(); i > 1; i--)
+      std::swap(all[i - 1], all[size_t(std::rand()) % i]);
+    for (const auto &f : all)
+      r.push(f, collect, nullptr);
+
+    CHECK(g_got.size() == kIds);
+    unsigned matched = 0;
+    for (unsigned i = 0; i < kIds; i++) {
+      for (const auto &p : g_got) {
+        if (p.seq == uint8_t(round) && p.data == msgs[i]) {
+          matched++;
+          break;
+        }
+      }
+    }
+    CHECK(matched == kIds);
+  }
+  const gwdec::stats &s = r.get_stats();
+  CHECK(s.no_stream == 0 && s.superseded == 0 && s.duplicates == 0);
+  r.finish();
+  CHECK(r.get_stats().incomplete == 0);
+}
+
+} // namespace
+
+int main() {
+  std::srand(1);
+  test_whole_frame();
+  test_out_of_order_and_duplicates();
+  test_superseded();
+  test_timeout();
+  test_no_stream();
+  test_interleaved();
+  return test_failures();
+}
@@ -0,0 +1,178 @@
+// gorilla_test.c
+//
+// Round trips through telemetry_gorilla.c: XOR-coded 4- and 8-byte values,
+// stored values of other sizes, every timestamp bucket, microsecond
+// timestamps with jitter, and malformed packets that must be rejected rather
+// than misread.
+
+#include "telemetry_gorilla.h"
+
+#include "test_check.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_N 64u
+#define MAX_SAMPLE 32u
+
+static uint8_t g_samples[MAX_N * MAX_SAMPLE];
+static uint8_t g_decoded[MAX_N * MAX_SAMPLE];
+static uint8_t g_packet[TELEMETRY_GORILLA_MAX_ENCODED(MAX_N, MAX_SAMPLE)];
+static uint32_t g_ts_off[MAX_N];
+static uint64_t g_ts[MAX_N];
+
+// expect_xor: the values compress, so they must not fall back to verbatim.
+static void round_trip(uint16_t n, uint8_t elem_size, uint8_t elem_count,
+                       uint64_t t0, int expect_xor) {
+  const size_t raw = (size_t)n * elem_size * elem_count;
+  const size_t len =
+      telemetry_gorilla_encode(g_packet, sizeof(g_packet), g_samples, g_ts_off,
+                               n, elem_size, elem_count, 2u, t0);
+  CHECK(len >= TELEMETRY_GORILLA_HEADER_BYTES);
+  CHECK(len <= TELEMETRY_GORILLA_MAX_ENCODED(n, elem_size * elem_count));
+  CHECK(telemetry_gorilla_is_packet(g_packet, len));
+
+  TelemetryGorillaHeader h;
+  memset(g_decoded, 0xA5, sizeof(g_decoded));
+  const int got = telemetry_gorilla_decode(g_packet, len, &h, g_decoded,
+                                           sizeof(g_decoded), g_ts, MAX_N);
+  CHECK(got == n);
+  CHECK(h.n == n && h.elem_size == elem_size && h.elem_count == elem_count);
+  CHECK(h.kind == 2u && h.t0 == t0);
+  if (elem_size != 4 && elem_size != 8)
+    CHECK(h.stored);
+  else if (expect_xor)
+    CHECK(!h.stored);
+  CHECK(memcmp(g_decoded, g_samples, raw) == 0);
+  for (uint16_t i = 1; i < n; i++)
+    CHECK(g_ts[i] == t0 + g_ts_off[i]);
+  CHECK(g_ts[0] == t0);
+
+  // Every truncation is detected.
+  for (size_t cut = 0; cut < len; cut++) {
+    CHECK(telemetry_gorilla_decode(g_packet, cut, &h, g_decoded,
+                                   sizeof(g_decoded), g_ts, MAX_N) < 0);
+  }
+  // Output buffers that are too small are refused.
+  if (raw > 0) {
+    CHECK(telemetry_gorilla_decode(g_packet, len, &h, g_decoded, raw - 1u,
+                                   g_ts, MAX_N) < 0);
+  }
+  if (n > 1) {
+    CHECK(telemetry_gorilla_decode(g_packet, len, &h, g_decoded,
+                                   sizeof(g_decoded), g_ts, n - 1u) < 0);
+  }
+}
+
+// Slowly varying values: what the XOR coding is for.
+static void fill_smooth(uint16_t n, uint8_t elem_size, uint8_t elem_count) {
+  for (uint16_t i = 0; i < n; i++) {
+    for (uint8_t e = 0; e < elem_count; e++) {
+      uint8_t *p = &g_samples[((size_t)i * elem_count + e) * elem_size];
+      if (elem_size == 4) {
+        const float v = 20.0f + (float)e + 0.01f * (float)(i / 3u);
+        memcpy(p, &v, 4);
+      } else if (elem_size == 8) {
+        const double v = -3.5 * (double)e + 1e-3 * (double)i;
+        memcpy(p, &v, 8);
+      } else {
+        for (uint8_t b = 0; b < elem_size; b++)
+          p[b] = (uint8_t)(i + e + b);
+      }
+    }
+  }
+}
+
+static void fill_random(uint16_t n, uint8_t elem_size, uint8_t elem_count) {
+  for (size_t i = 0; i < (size_t)n * elem_size * elem_count; i++)
+    g_samples[i] = (uint8_t)rand();
+}
+
+static void ts_regular(uint16_t n, uint32_t period) {
+  for (uint16_t i = 0; i < n; i++)
+    g_ts_off[i] = i * period;
+}
+
+// Deltas that land in every delta-of-delta bucket, including the 36-bit one.
+static void ts_jittery(uint16_t n) {
+  static const uint32_t steps[] = {10, 10, 70, 9, 300, 5, 2000, 1, 100000, 10};
+  uint32_t t = 0;
+  for (uint16_t i = 0; i < n; i++) {
+    g_ts_off[i] = t;
+    t += steps[i % (sizeof(steps) / sizeof(steps[0]))];
+  }
+}
+
+// A 100 Hz stream stamped in us, with a few us of scheduling jitter.
+static void ts_sampled_us(uint16_t n) {
+  g_ts_off[0] = 0;
+  for (uint16_t i = 1; i < n; i++)
+    g_ts_off[i] = i * 10000u + (uint32_t)(rand() % 41);
+}
+
+// Past the first delta (a full 40-bit code), microsecond jitter on a regular
+// period stays in the short codes: at most 12 bits per timestamp. Checked on
+// stored values so the size is exact.
+static void test_us_timestamps(void) {
+  const uint16_t n = MAX_N;
+  fill_random(n, 2, 1);
+  ts_sampled_us(n);
+  round_trip(n, 2, 1, 5000000123ull, 0);
+  const size_t len = telemetry_gorilla_encode(
+      g_packet, sizeof(g_packet), g_samples, g_ts_off, n, 2, 1, 2u, 0);
+  CHECK(len > 0);
+  CHECK(len <= TELEMETRY_GORILLA_HEADER_BYTES +
+                   (40u + (n - 2u) * 12u + 7u) / 8u + (size_t)n * 2u);
+}
+
+static void test_round_trips(void) {
+  static const uint8_t sizes[] = {4, 8, 1, 2};
+  for (size_t s = 0; s < sizeof(sizes); s++) {
+    const uint8_t size = sizes[s];
+    const uint8_t count = (uint8_t)(MAX_SAMPLE / size < 3u ? 1u : 3u);
+    const uint16_t ns[] = {1, 2, 17, MAX_N};
+    for (size_t k = 0; k < sizeof(ns) / sizeof(ns[0]); k++) {
+      fill_smooth(ns[k], size, count);
+      ts_regular(ns[k], 10);
+      round_trip(ns[k], size, count, 123456789ull, ns[k] > 2);
+
+      fill_random(ns[k], size, count);
+      ts_jittery(ns[k]);
+      round_trip(ns[k], size, count, 0, 0);
+    }
+  }
+}
+
+static void test_rejects(void) {
+  const uint32_t v = 7;
+  const uint32_t off = 0;
+
+  // Arguments the encoder cannot represent.
+  CHECK(telemetry_gorilla_encode(g_packet, sizeof(g_packet), &v, &off, 0, 4, 1,
+                                 0, 0) == 0);
+  CHECK(telemetry_gorilla_encode(g_packet, sizeof(g_packet), &v, &off, 1, 0, 1,
+                                 0, 0) == 0);
+  CHECK(telemetry_gorilla_encode(g_packet, TELEMETRY_GORILLA_HEADER_BYTES - 1u,
+                                 &v, &off, 1, 4, 1, 0, 0) == 0);
+
+  // Not a batch, and a header claiming XOR coding for a 2-byte value.
+  const size_t len = telemetry_gorilla_encode(g_packet, sizeof(g_packet), &v,
+                                              &off, 1, 4, 1, 0, 0);
+  CHECK(len > 0);
+  TelemetryGorillaHeader h;
+  g_packet[1] = 'F';
+  CHECK(!telemetry_gorilla_is_packet(g_packet, len));
+  CHECK(telemetry_gorilla_header(g_packet, len, &h) < 0);
+  g_packet[1] = TELEMETRY_GORILLA_MAGIC1;
+  g_packet[3] = 2;
+  CHECK(telemetry_gorilla_header(g_packet, len, &h) < 0);
+}
+
+int main(void) {
+  srand(1);
+  test_round_trips();
+  test_us_timestamps();
+  test_rejects();
+  return test_failures();
+}
@@ -0,0 +1,324 @@
+// gs_usb_test.c
+//
+// gs_usb_proto.c against the wire layout the Linux gs_usb driver uses:
+// control requests, host frame pack/unpack, and the conversion between host
+// frames and can_bus frames.
+
+#include "gs_usb_proto.h"
+
+#include "test_check.h"
+
+#include <stdint.h>
+#include <string.h>
+
+static uint32_t rd32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+static void wr32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+// ---- Fake device ----
+
+typedef struct {
+  int starts;
+  int stops;
+  int fail_start;
+  int identify;
+  uint32_t flags;
+  int got_data;
+  gs_usb_bittiming_t nominal;
+} fake_t;
+
+static int op_start(void *user, const gs_usb_bittiming_t *nominal,
+                    const gs_usb_bittiming_t *data, uint32_t flags) {
+  fake_t *f = (fake_t *)user;
+  if (f->fail_start)
+    return -1;
+  f->starts++;
+  f->nominal = *nominal;
+  f->got_data = data != NULL;
+  f->flags = flags;
+  return 0;
+}
+
+static void op_stop(void *user) { ((fake_t *)user)->stops++; }
+
+static uint32_t op_timestamp(void *user) {
+  (void)user;
+  return 0x12345678u;
+}
+
+static void op_identify(void *user, int on) { ((fake_t *)user)->identify = on; }
+
+static void op_get_state(void *user, uint32_t *state, uint32_t *rxerr,
+                         uint32_t *txerr) {
+  (void)user;
+  *state = GS_USB_STATE_ERROR_PASSIVE;
+  *rxerr = 130;
+  *txerr = 7;
+}
+
+static const gs_usb_ops_t k_ops = {op_start, op_stop, op_timestamp,
+                                   op_identify, op_get_state};
+
+static const gs_usb_caps_t k_caps = {
+    .features = GS_USB_FEATURE_LISTEN_ONLY | GS_USB_FEATURE_LOOP_BACK |
+                GS_USB_FEATURE_HW_TIMESTAMP | GS_USB_FEATURE_IDENTIFY |
+                GS_USB_FEATURE_FD | GS_USB_FEATURE_BT_CONST_EXT |
+                GS_USB_FEATURE_GET_STATE,
+    .fclk_can = 80000000u,
+    .nominal = {1, 256, 1, 128, 128, 1, 512, 1},
+    .data = {1, 32, 1, 16, 16, 1, 32, 1},
+    .sw_version = 2,
+    .hw_version = 1,
+};
+
+static int set_timing(gs_usb_dev_t *dev, uint8_t req, uint32_t prop,
+                      uint32_t seg1, uint32_t seg2, uint32_t sjw,
+                      uint32_t brp) {
+  uint8_t out[20];
+  wr32(out, prop);
+  wr32(out + 4, seg1);
+  wr32(out + 8, seg2);
+  wr32(out + 12, sjw);
+  wr32(out + 16, brp);
+  return gs_usb_control(dev, req, 0, out, sizeof(out), NULL, 0);
+}
+
+static int set_mode(gs_usb_dev_t *dev, uint32_t mode, uint32_t flags) {
+  uint8_t out[8];
+  wr32(out, mode);
+  wr32(out + 4, flags);
+  return gs_usb_control(dev, GS_USB_BREQ_MODE, 0, out, sizeof(out), NULL, 0);
+}
+
+// ---- Control requests ----
+
+static void test_host_format(void) {
+  gs_usb_dev_t dev;
+  fake_t fk = {0};
+  gs_usb_init(&dev, &k_caps, &k_ops, &fk);
+
+  uint8_t out[4];
+  wr32(out, GS_USB_HOST_FORMAT_LE);
+  CHECK(gs_usb_control(&dev, GS_USB_BREQ_HOST_FORMAT, 1, out, 4, NULL, 0) == 0);
+  wr32(out, 0xEFBE0000u);
+  CHECK(gs_usb_control(&dev, GS_USB_BREQ_HOST_FORMAT, 1, out, 4, NULL, 0) < 0);
+  CHECK(gs_usb_control(&dev, GS_USB_BREQ_HOST_FORMAT, 1, out, 3, NULL, 0) < 0);
+}
+
+static void test_capabilities(void) {
+  gs_usb_dev_t dev;
+  fake_t fk = {0};
+  gs_usb_init(&dev, &k_caps, &k_ops, &fk);
+  uint8_t in[128];
+
+  // DEVICE_CONFIG: reserved, icount = 0 (one channel), versions.
+  CHECK(gs_usb_control(&dev, GS_USB_BREQ_DEVICE_CONFIG, 0, NULL, 0, in,
+                       sizeof(in)) == 12);
+  CHECK(in[3] == 0);
+  CHECK(rd32(in + 4) == 2 && rd32(in + 8) == 1);
+
+  // BT_CONST: features, fclk, then the nominal limits.
+  CHECK(gs_usb_control(&dev, GS_USB_BREQ_BT_CONST, 0, NULL, 0, in,
+                       sizeof(in)) == 40);
+  CHECK(rd32(in) == k_caps.features && rd32(in + 4) == 80000000u);
+  CHECK(rd32(in + 8) == 1 && rd32(in + 12) == 256);   // tseg1
+  CHECK(rd32(in + 16) == 1 && rd32(in + 20) == 128);  // tseg2
+  CHECK(rd32(in + 24) == 128);                        // sjw_max
+  CHECK(rd32(in + 28) == 1 && rd32(in + 32) == 512);  // brp
+  CHECK(rd32(in + 36) == 1);                          // brp_inc
+
+  // BT_CONST_EXT adds the data phase limits.
+  CHECK(gs_usb_control(&dev, GS_USB_BREQ_BT_CONST_EXT, 0, NULL, 0, in,
+                       sizeof(in)) == 72);
+  CHECK(rd32(in + 40) == 1 && rd32(in + 44) == 32);
+  CHECK(rd32(in + 68) == 1);
+
+  // Replies that do not fit stall instead of truncating.
+  CHECK(gs_usb_control(&dev, GS_USB_BREQ_BT_CONST, 0, NULL, 0, in, 39) < 0);
+  CHECK(gs_usb_control(&dev, GS_USB_BREQ_DEVICE_CONFIG, 0, NULL, 0, in, 11) <
+        0);
+
+  // Only channel 0 exists; unknown requests stall.
+  CHECK(gs_usb_control(&dev, GS_USB_BREQ_BT_CONST, 1, NULL, 0, in,
+                       sizeof(in)) < 0);
+  CHECK(gs_usb_control(&dev, 0x7F, 0, NULL, 0, in, sizeof(in)) < 0);
+
+  CHECK(gs_usb_control(&dev, GS_USB_BREQ_TIMESTAMP, 0, NULL, 0, in,
+                       sizeof(in)) == 4);
+  CHECK(rd32(in) == 0x12345678u);
+
+  uint8_t out[4];
+  wr32(out, 1);
+  CHECK(gs_usb_control(&dev, GS_USB_BREQ_IDENTIFY, 0, out, 4, NULL, 0) == 0);
+  CHECK(fk.identify == 1);
+}
+
+static void test_mode(void) {
+  gs_usb_dev_t dev;
+  fake_t fk = {0};
+  gs_usb_init(&dev, &k_caps, &k_ops, &fk);
+  uint8_t in[16];
+
+  // Start needs a nominal bit timing.
+  CHECK(set_mode(&dev, GS_USB_MODE_START, 0) < 0);
+  CHECK(fk.starts == 0);
+
+  // tseg1 = prop + seg1 out of range, sjw 0, brp too large.
+  CHECK(set_timing(&dev, GS_USB_BREQ_BITTIMING, 200, 100, 10, 4, 2) < 0);
+  CHECK(set_timing(&dev, GS_USB_BREQ_BITTIMING, 1, 100, 10, 0, 2) < 0);
+  CHECK(set_timing(&dev, GS_USB_BREQ_BITTIMING, 1, 100, 10, 4, 1000) < 0);
+  CHECK(set_timing(&dev, GS_USB_BREQ_BITTIMING, 1, 126, 32, 32, 2) == 0);
+
+  // FD needs a data bit timing, and only reported features are accepted.
+  CHECK(set_mode(&dev, GS_USB_MODE_START, GS_USB_FEATURE_FD) < 0);
+  CHECK(set_mode(&dev, GS_USB_MODE_START, GS_USB_FEATURE_ONE_SHOT) < 0);
+  CHECK(fk.starts == 0);
+
+  CHECK(gs_usb_control(&dev, GS_USB_BREQ_GET_STATE, 0, NULL, 0, in,
+                       sizeof(in)) == 12);
+  CHECK(rd32(in) == GS_USB_STATE_STOPPED);
+
+  CHECK(set_mode(&dev, GS_USB_MODE_START, GS_USB_FEATURE_HW_TIMESTAMP) == 0);
+  CHECK(fk.starts == 1 && !fk.got_data);
+  CHECK(fk.nominal.phase_seg1 == 126 && fk.nominal.brp == 2);
+  CHECK(fk.flags == GS_USB_FEATURE_HW_TIMESTAMP);
+  CHECK(dev.started);
+
+  CHECK(gs_usb_control(&dev, GS_USB_BREQ_GET_STATE, 0, NULL, 0, in,
+                       sizeof(in)) == 12);
+  CHECK(rd32(in) == GS_USB_STATE_ERROR_PASSIVE);
+  CHECK(rd32(in + 4) == 130 && rd32(in + 8) == 7);
+
+  // Restarting with FD stops first and passes the data timing.
+  CHECK(set_timing(&dev, GS_USB_BREQ_DATA_BITTIMING, 1, 14, 4, 4, 1) == 0);
+  CHECK(set_mode(&dev, GS_USB_MODE_START, GS_USB_FEATURE_FD) == 0);
+  CHECK(fk.stops == 1 && fk.starts == 2 && fk.got_data);
+
+  CHECK(set_mode(&dev, GS_USB_MODE_RESET, 0) == 0);
+  CHECK(fk.stops == 2 && !dev.started && dev.mode_flags == 0);
+
+  // A start the device refuses leaves it stopped.
+  fk.fail_start = 1;
+  CHECK(set_mode(&dev, GS_USB_MODE_START, 0) < 0);
+  CHECK(!dev.started && dev.mode_flags == 0);
+}
+
+// ---- Host frames ----
+
+static void test_pack_unpack(void) {
+  gs_usb_dev_t dev;
+  fake_t fk = {0};
+  gs_usb_init(&dev, &k_caps, &k_ops, &fk);
+  uint8_t wire[GS_USB_FRAME_MAX_LEN];
+
+  gs_usb_frame_t f;
+  memset(&f, 0, sizeof(f));
+  f.echo_id = 3;
+  f.can_id = 0x123;
+  f.len = 5;
+  memcpy(f.data, "hello", 5);
+
+  // Classic, no timestamps: 12-byte header + 8 data bytes, zero padded.
+  CHECK(gs_usb_frame_pack(&dev, &f, wire, sizeof(wire)) == 20);
+  CHECK(rd32(wire) == 3 && rd32(wire + 4) == 0x123);
+  CHECK(wire[8] == 5 && wire[9] == 0 && wire[10] == 0);
+  CHECK(memcmp(&wire[12], "hello\0\0\0", 8) == 0);
+  CHECK(gs_usb_frame_pack(&dev, &f, wire, 19) == 0);
+
+  gs_usb_frame_t g;
+  CHECK(gs_usb_frame_unpack(wire, 20, &g) == 0);
+  CHECK(g.echo_id == 3 && g.can_id == 0x123 && g.len == 5);
+  CHECK(memcmp(g.data, "hello", 5) == 0);
+  CHECK(gs_usb_frame_unpack(wire, 19, &g) < 0);
+
+  // Classic DLC above 8 still carries 8 bytes.
+  wire[8] = 12;
+  CHECK(gs_usb_frame_unpack(wire, 20, &g) == 0 && g.len == 8);
+  wire[8] = 16;
+  CHECK(gs_usb_frame_unpack(wire, 20, &g) < 0);
+
+  // FD with timestamps: 64 data bytes, DLC for 48, timestamp appended.
+  CHECK(set_timing(&dev, GS_USB_BREQ_BITTIMING, 1, 126, 32, 32, 2) == 0);
+  CHECK(set_timing(&dev, GS_USB_BREQ_DATA_BITTIMING, 1, 14, 4, 4, 1) == 0);
+  CHECK(set_mode(&dev, GS_USB_MODE_START,
+                 GS_USB_FEATURE_FD | GS_USB_FEATURE_HW_TIMESTAMP) == 0);
+  f.flags = GS_USB_FLAG_FD | GS_USB_FLAG_BRS;
+  f.len = 48;
+  for (unsigned i = 0; i < 48; i++)
+    f.data[i] = (uint8_t)(i * 3u);
+  f.timestamp_us = 0xCAFEF00Du;
+  CHECK(gs_usb_frame_size(&dev, f.flags) == 12u + 64u + 4u);
+  CHECK(gs_usb_frame_pack(&dev, &f, wire, sizeof(wire)) == 80);
+  CHECK(wire[8] == 14);
+  CHECK(rd32(&wire[76]) == 0xCAFEF00Du);
+  CHECK(gs_usb_frame_unpack(wire, 80, &g) == 0);
+  CHECK(g.len == 48 && g.flags == f.flags);
+  CHECK(memcmp(g.data, f.data, 48) == 0);
+
+  CHECK(gs_usb_len_to_dlc(8) == 8 && gs_usb_len_to_dlc(9) == 9);
+  CHECK(gs_usb_len_to_dlc(33) == 14 && gs_usb_len_to_dlc(64) == 15);
+  CHECK(gs_usb_dlc_to_len(13) == 32);
+}
+
+// ---- Bus frames ----
+
+static void test_bus_conversion(void) {
+  can_bus_frame_t b;
+  memset(&b, 0, sizeof(b));
+  b.timestamp_us = 0x100000005ull;
+  b.id = 0x1ABCDEF0u;
+  b.flags = CAN_BUS_FRAME_F_EXT | CAN_BUS_FRAME_F_FD | CAN_BUS_FRAME_F_BRS |
+            CAN_BUS_FRAME_F_ESI;
+  b.len = 12;
+  for (unsigned i = 0; i < 12; i++)
+    b.data[i] = (uint8_t)(0xA0u + i);
+
+  gs_usb_frame_t h;
+  gs_usb_frame_from_bus(&b, GS_USB_ECHO_ID_RX, &h);
+  CHECK(h.echo_id == GS_USB_ECHO_ID_RX);
+  CHECK(h.can_id == (0x1ABCDEF0u | GS_USB_CAN_EFF_FLAG));
+  CHECK(h.flags == (GS_USB_FLAG_FD | GS_USB_FLAG_BRS | GS_USB_FLAG_ESI));
+  CHECK(h.len == 12 && h.channel == 0 && h.timestamp_us == 5u);
+  CHECK(memcmp(h.data, b.data, 12) == 0);
+
+  can_bus_frame_t back;
+  gs_usb_frame_to_bus(&h, &back);
+  CHECK(back.id == b.id && back.len == 12);
+  CHECK(back.flags ==
+        (CAN_BUS_FRAME_F_EXT | CAN_BUS_FRAME_F_FD | CAN_BUS_FRAME_F_BRS));
+  CHECK(back.timestamp_us == 0);
+  CHECK(memcmp(back.data, b.data, 12) == 0);
+
+  // Standard RTR: len is the requested DLC, identifier masked to 11 bits.
+  memset(&h, 0, sizeof(h));
+  h.can_id = 0xFFFu | GS_USB_CAN_RTR_FLAG;
+  h.len = 4;
+  gs_usb_frame_to_bus(&h, &back);
+  CHECK(back.id == 0x7FFu);
+  CHECK(back.flags == CAN_BUS_FRAME_F_RTR && back.len == 4);
+
+  memset(&b, 0, sizeof(b));
+  b.id = 0x7FF;
+  b.flags = CAN_BUS_FRAME_F_RTR | CAN_BUS_FRAME_F_TX;
+  b.len = 2;
+  gs_usb_frame_from_bus(&b, 9, &h);
+  CHECK(h.echo_id == 9);
+  CHECK(h.can_id == (0x7FFu | GS_USB_CAN_RTR_FLAG) && h.flags == 0);
+}
+
+int main(void) {
+  test_host_format();
+  test_capabilities();
+  test_mode();
+  test_pack_unpack();
+  test_bus_conversion();
+  return test_failures();
+}
@@ -0,0 +1,100 @@
+// ingress_peek_test.c
+//
+// telemetry_peek_data_type() against packets serialized by the sedsprintf_rs
+// router itself: every type in TELEMETRY_SCHEMA is logged through a
+// serialized side and the peeked type must match. Catches a header layout
+// change that TELEMETRY_INGRESS_TYPE_OFFSET no longer describes.
+
+#include "telemetry_ingress.h"
+#include "telemetry_schema.h"
+
+#include "test_check.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Router hooks (telemetry_hooks.c on the target).
+void *telemetryMalloc(size_t size) { return malloc(size); }
+
+void telemetryFree(void *ptr) { free(ptr); }
+
+void seds_error_msg(const char *str, size_t len) {
+  fprintf(stderr, "%.*s\n", (int)len, str);
+}
+
+static uint8_t g_tx[1024];
+static size_t g_tx_len;
+static unsigned g_tx_count;
+
+static SedsResult capture_tx(const uint8_t *bytes, size_t len, void *user) {
+  (void)user;
+  g_tx_count++;
+  g_tx_len = len < sizeof(g_tx) ? len : sizeof(g_tx);
+  memcpy(g_tx, bytes, g_tx_len);
+  return SEDS_OK;
+}
+
+static SedsResult ignore_packet(const SedsPacketView *pkt, void *user) {
+  (void)pkt;
+  (void)user;
+  return SEDS_OK;
+}
+
+static uint64_t fixed_now_ms(void *user) {
+  (void)user;
+  return 123456u;
+}
+
+// Log one packet of data_type the way telemetry.c does for its shape and
+// check the peek on what reached the side.
+static void check_type(SedsRouter *r, SedsDataType data_type, size_t count) {
+  static const uint64_t values[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  static const char text[] = "ingress peek";
+  const unsigned before = g_tx_count;
+  SedsResult res;
+
+  if (count == 0) {
+    res = seds_router_log_string_ex(r, data_type, text, sizeof(text) - 1u,
+                                    NULL, 0);
+  } else {
+    res = seds_router_log_ts(r, data_type, 1000u, values, count);
+  }
+  CHECK(res == SEDS_OK);
+  CHECK(g_tx_count == before + 1u);
+  if (res != SEDS_OK || g_tx_count != before + 1u)
+    return;
+
+  const int32_t peeked = telemetry_peek_data_type(g_tx, g_tx_len);
+  CHECK(g_tx_len >= TELEMETRY_INGRESS_MIN_LEN);
+  CHECK(peeked == (int32_t)data_type);
+  if (peeked != (int32_t)data_type)
+    fprintf(stderr, "  type %d peeked as %ld\n", (int)data_type, (long)peeked);
+}
+
+int main(void) {
+  const SedsLocalEndpointDesc locals[] = {
+      {
+          .endpoint = (uint32_t)SEDS_EP_SD_CARD,
+          .packet_handler = ignore_packet,
+          .serialized_handler = NULL,
+          .user = NULL,
+      },
+  };
+  SedsRouter *r = seds_router_new(Seds_RM_Sink, fixed_now_ms, NULL, locals,
+                                  sizeof(locals) / sizeof(locals[0]));
+  CHECK(r != NULL);
+  if (!r)
+    return test_failures();
+  CHECK(seds_router_add_side_serialized(r, "test", 4, capture_tx, NULL,
+                                        false) >= 0);
+
+#define CHECK_SCHEMA_TYPE_(dt, count, band) check_type(r, dt, count);
+  TELEMETRY_SCHEMA(CHECK_SCHEMA_TYPE_)
+#undef CHECK_SCHEMA_TYPE_
+
+  // A header cut short is not a type.
+  CHECK(telemetry_peek_data_type(g_tx, 0) == -1);
+
+  return test_failures();
+}
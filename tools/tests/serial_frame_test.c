@@ -0,0 +1,166 @@
+// serial_frame_test.c
+//
+// serial_frame.c: COBS + CRC-16 round trips at the COBS run boundaries,
+// arbitrary chunking, resynchronization after corrupted or truncated frames,
+// and oversize frames on both ends.
+
+#include "serial_frame.h"
+
+#include "test_check.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define WIRE_MAX (4u * SERIAL_FRAME_ENCODED_MAX(SERIAL_FRAME_MAX_PAYLOAD))
+
+typedef struct {
+  unsigned frames;
+  uint8_t type;
+  uint8_t payload[SERIAL_FRAME_MAX_PAYLOAD];
+  size_t len;
+} rx_t;
+
+static void on_frame(uint8_t type, const uint8_t *payload, size_t len,
+                     void *user) {
+  rx_t *rx = (rx_t *)user;
+  rx->frames++;
+  rx->type = type;
+  rx->len = len;
+  memcpy(rx->payload, payload, len);
+}
+
+static uint8_t g_wire[WIRE_MAX];
+static uint8_t g_payload[SERIAL_FRAME_MAX_PAYLOAD];
+
+static void fill(size_t len, int pattern) {
+  for (size_t i = 0; i < len; i++) {
+    switch (pattern) {
+    case 0:
+      g_payload[i] = 0x00;
+      break;
+    case 1:
+      g_payload[i] = 0xFF;
+      break;
+    default:
+      g_payload[i] = (uint8_t)(i * 37u + 11u); // zeros every 256 bytes
+      break;
+    }
+  }
+}
+
+// Encode, check the wire has zeros only as the delimiter, decode in chunks
+// of `step` bytes and compare.
+static void round_trip(uint8_t type, size_t len, int pattern, size_t step) {
+  fill(len, pattern);
+  const size_t n =
+      serial_frame_encode(type, g_payload, len, g_wire, sizeof(g_wire));
+  CHECK(n > 0 && n <= SERIAL_FRAME_ENCODED_MAX(len));
+  CHECK(memchr(g_wire, 0x00, n) == &g_wire[n - 1]);
+
+  serial_frame_decoder_t d;
+  rx_t rx = {0};
+  serial_frame_decoder_init(&d, on_frame, &rx);
+  for (size_t off = 0; off < n; off += step)
+    serial_frame_decoder_feed(&d, &g_wire[off], n - off < step ? n - off : step);
+
+  CHECK(rx.frames == 1 && d.frames_ok == 1);
+  CHECK(d.crc_errors == 0 && d.framing_errors == 0);
+  CHECK(rx.type == type && rx.len == len);
+  CHECK(memcmp(rx.payload, g_payload, len) == 0);
+}
+
+static void test_crc(void) {
+  // CRC-16/CCITT-FALSE check value.
+  CHECK(serial_frame_crc16(0xFFFFu, (const uint8_t *)"123456789", 9) ==
+        0x29B1u);
+}
+
+static void test_round_trips(void) {
+  static const size_t lens[] = {0, 1, 2, 250, 251, 252, 253, 254,
+                                255, 256, 508, 509, 510, 511, 512};
+  for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+    for (int pattern = 0; pattern < 3; pattern++) {
+      round_trip(SERIAL_FRAME_TYPE_ROUTER, lens[i], pattern, WIRE_MAX);
+      round_trip(0x00, lens[i], pattern, 1);
+      round_trip(SERIAL_FRAME_TYPE_CAN, lens[i], pattern, 7);
+    }
+  }
+}
+
+static void test_encoder_limits(void) {
+  fill(SERIAL_FRAME_MAX_PAYLOAD, 2);
+  CHECK(serial_frame_encode(1, g_payload, SERIAL_FRAME_MAX_PAYLOAD + 1u,
+                            g_wire, sizeof(g_wire)) == 0);
+  CHECK(serial_frame_encode(1, g_payload, 10, g_wire,
+                            SERIAL_FRAME_ENCODED_MAX(10) - 1u) == 0);
+  CHECK(serial_frame_encode(1, NULL, 10, g_wire, sizeof(g_wire)) == 0);
+  CHECK(serial_frame_encode(1, NULL, 0, g_wire, sizeof(g_wire)) > 0);
+}
+
+static void test_resync(void) {
+  serial_frame_decoder_t d;
+  rx_t rx = {0};
+  serial_frame_decoder_init(&d, on_frame, &rx);
+  fill(40, 2);
+
+  // Garbage with no delimiter in front of a good frame: one framing or CRC
+  // error for the garbage, then the frame.
+  size_t n = 0;
+  static const uint8_t junk[] = {0x13, 0x37, 0xC0, 0xFF, 0xEE};
+  memcpy(g_wire, junk, sizeof(junk));
+  n += sizeof(junk);
+  g_wire[n++] = 0x00;
+  // Idle fill between frames.
+  g_wire[n++] = 0x00;
+  g_wire[n++] = 0x00;
+
+  // Frame with a flipped bit, then a good one.
+  const size_t a = serial_frame_encode(1, g_payload, 40, &g_wire[n], 200);
+  g_wire[n + 10] ^= 0x04;
+  n += a;
+  n += serial_frame_encode(2, g_payload, 40, &g_wire[n], 200);
+
+  // Frame cut short by a delimiter, then a good one.
+  const size_t c = serial_frame_encode(3, g_payload, 40, &g_wire[n], 200);
+  g_wire[n + c / 2] = 0x00;
+  n += c;
+  n += serial_frame_encode(4, g_payload, 40, &g_wire[n], 200);
+
+  serial_frame_decoder_feed(&d, g_wire, n);
+  CHECK(rx.frames == 2);
+  CHECK(rx.type == 4 && rx.len == 40);
+  CHECK(memcmp(rx.payload, g_payload, 40) == 0);
+  CHECK(d.crc_errors + d.framing_errors >= 4);
+}
+
+static void test_oversize(void) {
+  serial_frame_decoder_t d;
+  rx_t rx = {0};
+  serial_frame_decoder_init(&d, on_frame, &rx);
+
+  // A run of non-zero bytes longer than any valid frame, fed in pieces, is
+  // one framing error; the next frame decodes.
+  memset(g_wire, 0x5A, sizeof(g_wire));
+  const size_t run = sizeof(d.buf) + 100u;
+  serial_frame_decoder_feed(&d, g_wire, run / 2);
+  serial_frame_decoder_feed(&d, g_wire, run - run / 2);
+  CHECK(rx.frames == 0);
+
+  fill(SERIAL_FRAME_MAX_PAYLOAD, 1);
+  size_t n = 0;
+  g_wire[n++] = 0x00;
+  n += serial_frame_encode(7, g_payload, SERIAL_FRAME_MAX_PAYLOAD, &g_wire[n],
+                           sizeof(g_wire) - n);
+  serial_frame_decoder_feed(&d, g_wire, n);
+  CHECK(d.framing_errors == 1);
+  CHECK(rx.frames == 1 && rx.type == 7 && rx.len == SERIAL_FRAME_MAX_PAYLOAD);
+}
+
+int main(void) {
+  test_crc();
+  test_round_trips();
+  test_encoder_limits();
+  test_resync();
+  test_oversize();
+  return test_failures();
+}
@@ -0,0 +1,24 @@
+// test_check.h
+//
+// Minimal checks for the host tests: report the failing expression and keep
+// going, so one run lists every failure. main() returns test_failures().
+
+#pragma once
+
+#include <stdio.h>
+
+static int test_failed_ = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      test_failed_++;                                                          \
+    }                                                                          \
+  } while (0)
+
+static inline int test_failures(void) {
+  if (test_failed_)
+    fprintf(stderr, "%d check(s) failed\n", test_failed_);
+  return test_failed_ ? 1 : 0;
+}
@@ -0,0 +1,346 @@
+// bus_model.cpp
+
+#include "bus_model.h"
+
+#include "can_bus_frag.h"
+#include "can_node.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace gwtiming {
+
+namespace {
+
+constexpr unsigned k_bulk = 0;
+constexpr unsigned k_high = 1;
+constexpr uint32_t k_record_hdr = 8; // egress ring record header
+constexpr uint32_t k_frag_data =
+    CAN_BUS_FRAG_WIRE_LEN - (uint32_t)sizeof(can_bus_frag_hdr_t);
+
+uint32_t record_bytes(uint32_t len) { return (k_record_hdr + len + 3u) & ~3u; }
+
+} // namespace
+
+unsigned bus_model::fragments(uint32_t bytes) {
+  return std::max(1u, (bytes + k_frag_data - 1u) / k_frag_data);
+}
+
+// ---------------------------------------------------------------------------
+// Setup
+// ---------------------------------------------------------------------------
+
+size_t bus_model::class_of(const source &s) {
+  for (size_t i = 0; i < stats_.classes.size(); i++) {
+    if (stats_.classes[i].name == s.name)
+      return i;
+  }
+  class_stats c;
+  c.name = s.name;
+  stats_.classes.push_back(c);
+  return stats_.classes.size() - 1;
+}
+
+bus_model::bus_model(const model_config &cfg,
+                     const std::vector<source> &sources)
+    : cfg_(cfg), rng_(cfg.seed) {
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+  for (const source &s : sources) {
+    release r;
+    r.src = s;
+    r.cls = class_of(s);
+    r.period_ns = std::max<uint64_t>(1, (uint64_t)(1e9 / s.rate_hz));
+    r.next_ns = cfg_.zero_phase ? 0 : (uint64_t)(unit(rng_) * (double)r.period_ns);
+
+    class_stats &c = stats_.classes[r.cls];
+    char where[16];
+    c.rate_hz += s.rate_hz;
+    if (s.kind == source_kind::packet) {
+      size_t n = 0;
+      while (n < nodes_.size() && nodes_[n].addr != s.addr)
+        n++;
+      if (n == nodes_.size()) {
+        node nd;
+        nd.addr = s.addr;
+        nd.sender = senders_.size();
+        nd.next_poll = (uint64_t)(unit(rng_) * (double)cfg_.poll_ns);
+        nd.q[k_bulk].cap = cfg_.queue_bytes;
+        nd.q[k_high].cap = cfg_.high_queue_bytes;
+        nodes_.push_back(nd);
+        sender snd;
+        snd.node = (int)n;
+        senders_.push_back(snd);
+        node_stats ns;
+        ns.addr = s.addr;
+        stats_.nodes.push_back(ns);
+      }
+      r.sender = nodes_[n].sender;
+      c.bytes = std::max(c.bytes, s.bytes);
+      c.frames = std::max(c.frames, fragments(s.bytes));
+      c.high = s.band <= cfg_.high_last_band &&
+               record_bytes(s.bytes) <= cfg_.high_queue_bytes;
+      std::snprintf(where, sizeof(where), "%u", s.addr);
+      stats_.nodes[n].offered_fps += s.rate_hz * fragments(s.bytes);
+
+      const frame_shape shape{false, true, cfg_.brs, false,
+                              (uint8_t)CAN_BUS_FRAG_WIRE_LEN};
+      stats_.offered_load += s.rate_hz * fragments(s.bytes) *
+                             (double)frame_time_ns(shape, cfg_.rates) / 1e9;
+    } else {
+      r.sender = senders_.size();
+      sender snd;
+      snd.mailbox = true;
+      senders_.push_back(snd);
+      c.bytes = std::max<uint32_t>(c.bytes, s.len);
+      c.frames = 1;
+      c.high = true;
+      std::snprintf(where, sizeof(where), s.ext ? "0x%08X" : "0x%03X", s.id);
+
+      const frame_shape shape{s.ext, s.fd, s.brs, false, s.len};
+      stats_.offered_load +=
+          s.rate_hz * (double)frame_time_ns(shape, cfg_.rates) / 1e9;
+    }
+    if (c.where.empty())
+      c.where = where;
+    else if (c.where.find(where) == std::string::npos)
+      c.where += std::string(",") + where;
+    releases_.push_back(r);
+  }
+}
+
+uint64_t bus_model::draw_period(uint64_t period_ns) {
+  if (cfg_.jitter <= 0)
+    return period_ns;
+  // Each period is off by up to jitter / 2 either way, so the rate holds on
+  // average while releases drift against each other.
+  std::uniform_real_distribution<double> j(-cfg_.jitter / 2, cfg_.jitter / 2);
+  const double p = (double)period_ns * (1.0 + j(rng_));
+  return p < 1.0 ? 1u : (uint64_t)p;
+}
+
+// ---------------------------------------------------------------------------
+// Gateway transmit path
+// ---------------------------------------------------------------------------
+
+void bus_model::release_one(release &r, uint64_t now) {
+  class_stats &c = stats_.classes[r.cls];
+  c.released++;
+  const source &s = r.src;
+
+  if (s.kind == source_kind::frame) {
+    sender &snd = senders_[r.sender];
+    // The instance on the wire (if any) finishes; one still waiting for
+    // arbitration is replaced.
+    const size_t keep = (busy_ && tx_sender_ == r.sender) ? 1u : 0u;
+    if (snd.fifo.size() > keep) {
+      c.overwritten++;
+      snd.fifo.resize(keep);
+    }
+    tx_frame f;
+    f.key = arbitration_key(s.id, s.ext);
+    f.shape = frame_shape{s.ext, s.fd, s.brs, false, s.len};
+    f.cls = r.cls;
+    f.t_release = now;
+    f.last = true;
+    snd.fifo.push_back(f);
+    return;
+  }
+
+  node &n = nodes_[(size_t)senders_[r.sender].node];
+  packet p;
+  p.cls = r.cls;
+  p.id = CAN_NODE_ID(s.band, s.addr);
+  p.bytes = s.bytes;
+  p.t_release = now;
+  p.frags = fragments(s.bytes);
+  enqueue(n, p, s.band <= cfg_.high_last_band);
+}
+
+void bus_model::enqueue(node &n, const packet &p, bool high) {
+  class_stats &c = stats_.classes[p.cls];
+  if (p.bytes > cfg_.max_packet) {
+    // Too big to queue: one direct attempt, and what does not fit the FIFO
+    // is never sent.
+    packet direct = p;
+    if (!push_fragments(senders_[n.sender], direct))
+      c.lost++;
+    return;
+  }
+
+  const uint32_t rec = record_bytes(p.bytes);
+  queue &q = n.q[(high && rec <= cfg_.high_queue_bytes) ? k_high : k_bulk];
+  while (q.used + rec > q.cap && !q.packets.empty()) {
+    stats_.classes[q.packets.front().cls].evicted++;
+    q.used -= record_bytes(q.packets.front().bytes);
+    q.packets.pop_front();
+  }
+  q.packets.push_back(p);
+  q.used += rec;
+
+  node_stats &ns = stats_.nodes[(size_t)senders_[n.sender].node];
+  const unsigned which = (&q == &n.q[k_high]) ? k_high : k_bulk;
+  ns.max_queue_bytes[which] = std::max(ns.max_queue_bytes[which], q.used);
+}
+
+// can_bus_send_large_continue(): queue fragments while the FIFO has room.
+bool bus_model::push_fragments(sender &s, packet &p) {
+  while (p.sent < p.frags && s.fifo.size() < cfg_.tx_fifo) {
+    tx_frame f;
+    f.key = arbitration_key(p.id, false);
+    f.shape = frame_shape{false, true, cfg_.brs, false,
+                          (uint8_t)CAN_BUS_FRAG_WIRE_LEN};
+    f.cls = p.cls;
+    f.t_release = p.t_release;
+    f.last = (p.sent + 1u == p.frags);
+    s.fifo.push_back(f);
+    p.sent++;
+  }
+  return p.sent == p.frags;
+}
+
+// telemetry_egress_poll() for the CAN side.
+void bus_model::poll(node &n, uint64_t now) {
+  sender &snd = senders_[n.sender];
+  unsigned budget = cfg_.poll_budget;
+
+  for (int c = (int)k_high; c >= (int)k_bulk && budget > 0; c--) {
+    queue &q = n.q[c];
+    bool busy = false;
+    for (; budget > 0; budget--) {
+      while (!q.active && !q.packets.empty()) {
+        packet p = q.packets.front();
+        q.packets.pop_front();
+        q.used -= record_bytes(p.bytes);
+        if (cfg_.max_age_ns && now - p.t_release > cfg_.max_age_ns) {
+          stats_.classes[p.cls].expired++;
+          continue;
+        }
+        q.cur = p;
+        q.active = true;
+      }
+      if (!q.active)
+        break;
+      if (!push_fragments(snd, q.cur)) {
+        stats_.nodes[(size_t)snd.node].fifo_full++;
+        busy = true;
+        break;
+      }
+      q.active = false;
+    }
+    if (busy)
+      break;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Bus
+// ---------------------------------------------------------------------------
+
+void bus_model::start_next(uint64_t now) {
+  size_t best = senders_.size();
+  uint64_t best_key = UINT64_MAX;
+  for (size_t i = 0; i < senders_.size(); i++) {
+    if (senders_[i].fifo.empty())
+      continue;
+    const uint64_t key = senders_[i].fifo.front().key;
+    if (key < best_key) {
+      best_key = key;
+      best = i;
+    }
+  }
+  if (best == senders_.size())
+    return;
+
+  const tx_frame &f = senders_[best].fifo.front();
+  uint64_t ns = frame_time_ns(f.shape, cfg_.rates);
+  tx_error_ = false;
+  if (cfg_.frame_errors > 0) {
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    if (unit(rng_) < cfg_.frame_errors) {
+      tx_error_ = true;
+      ns += error_frame_ns(cfg_.rates);
+    }
+  }
+  busy_ = true;
+  tx_sender_ = best;
+  tx_start_ = now;
+  tx_end_ = now + ns;
+}
+
+void bus_model::account_busy(uint64_t from, uint64_t to, uint64_t key) {
+  stats_.busy_ns += to - from;
+  stats_.band_ns[(uint8_t)((key >> 20) >> CAN_NODE_ADDR_BITS)] += to - from;
+  while (from < to) {
+    const uint64_t w = from / cfg_.window_ns;
+    const uint64_t w_end = (w + 1) * cfg_.window_ns;
+    const uint64_t part = std::min(to, w_end) - from;
+    if (windows_.size() <= w)
+      windows_.resize(w + 1, 0);
+    windows_[w] += part;
+    from += part;
+  }
+}
+
+void bus_model::complete(uint64_t now) {
+  busy_ = false;
+  sender &snd = senders_[tx_sender_];
+  const tx_frame f = snd.fifo.front();
+  class_stats &c = stats_.classes[f.cls];
+  account_busy(tx_start_, now, f.key);
+  c.bus_ns += now - tx_start_;
+
+  if (tx_error_) {
+    stats_.error_frames++;
+    return; // automatic retransmission: still at the head
+  }
+  snd.fifo.pop_front();
+  stats_.frames++;
+  c.bus_frames++;
+  if (f.last) {
+    c.delivered++;
+    c.latency.add((now - f.t_release) / 1000u);
+  }
+}
+
+void bus_model::run(uint64_t duration_ns) {
+  uint64_t now = 0;
+  for (;;) {
+    uint64_t next = busy_ ? tx_end_ : UINT64_MAX;
+    for (const release &r : releases_)
+      next = std::min(next, r.next_ns);
+    for (const node &n : nodes_)
+      next = std::min(next, n.next_poll);
+    if (next > duration_ns)
+      break;
+    now = next;
+
+    if (busy_ && tx_end_ == now)
+      complete(now);
+    for (release &r : releases_) {
+      if (r.next_ns == now) {
+        release_one(r, now);
+        r.next_ns += draw_period(r.period_ns);
+      }
+    }
+    for (node &n : nodes_) {
+      if (n.next_poll == now) {
+        poll(n, now);
+        n.next_poll += cfg_.poll_ns;
+      }
+    }
+    if (!busy_)
+      start_next(now);
+  }
+
+  stats_.elapsed_ns = duration_ns;
+  if (busy_)
+    account_busy(tx_start_, duration_ns, senders_[tx_sender_].fifo.front().key);
+  // The last window is partial; leave it out of the peak unless it is the
+  // only one.
+  const size_t full = duration_ns / cfg_.window_ns;
+  for (size_t w = 0; w < windows_.size() && (w < full || full == 0); w++)
+    stats_.peak_window_ns = std::max(stats_.peak_window_ns, windows_[w]);
+}
+
+} // namespace gwtiming
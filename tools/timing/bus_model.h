@@ -0,0 +1,189 @@
+// bus_model.h
+//
+// Discrete-event model of the gateway's CAN transmit path and the bus, for
+// predicting latency and saturation from a workload (workload.h) without
+// running the firmware.
+//
+// What is modelled, per gateway node (telemetry_egress.c, can_bus.c):
+//  - A HIGH and a BULK egress queue with the firmware's byte budgets and
+//    8-byte record overhead, DROP_OLDEST when full, and packets older than
+//    the maximum age dropped when taken. Bands up to COMMAND are HIGH;
+//    HIGH packets too big for the high queue, and all others, are BULK.
+//    Packets over the maximum queued size get one direct attempt.
+//  - One egress poll per telemetry loop. A poll serves HIGH before BULK,
+//    hands at most poll_budget packets to CAN, and stops at the first
+//    packet that does not fully fit the TX FIFO; the rest of that packet
+//    goes out on later polls. A new packet is first offered at the poll
+//    after it was logged.
+//  - Packets are fragmented as can_bus_send_large() does: 64-byte FD frames
+//    carrying 56 bytes each, on CAN_NODE_ID(band, addr).
+//  - A TX FIFO of tx_fifo frames sent in order: only its head arbitrates,
+//    so a HIGH fragment waits behind BULK fragments already queued.
+// Other devices (workload "frame" entries) send from a single mailbox.
+//
+// The bus picks the lowest identifier among the heads whenever it goes
+// idle. Frame times come from can_timing.h. With frame_errors > 0 a frame
+// is corrupted with that probability, costs an error frame and is sent
+// again.
+//
+// Latency is from the moment a packet is logged (or a frame is due) to the
+// end of its last frame on the bus. The receiver's own loop, up to one
+// poll period, comes on top.
+
+#pragma once
+
+#include "can_timing.h"
+#include "telemetry_priority.h"
+#include "workload.h"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace gwtiming {
+
+struct model_config {
+  bit_rates rates;
+  bool brs = false;      // gateway fragments use BRS (can_bus.c sends without)
+  uint64_t poll_ns = 10000000; // telemetry loop: one ThreadX tick
+  unsigned tx_fifo = 3;        // FDCAN TX FIFO elements
+  unsigned poll_budget = 8;    // TELEMETRY_EGRESS_POLL_BUDGET
+  uint32_t queue_bytes = 2048;     // TELEMETRY_EGRESS_QUEUE_BYTES
+  uint32_t high_queue_bytes = 512; // TELEMETRY_EGRESS_HIGH_QUEUE_BYTES
+  uint32_t max_packet = 640;       // TELEMETRY_EGRESS_MAX_PACKET
+  uint64_t max_age_ns = 1000000000; // TELEMETRY_EGRESS_MAX_AGE_MS
+  uint8_t high_last_band = TELEMETRY_CAN_BAND_HIGH_LAST;
+  double frame_errors = 0;  // probability a frame is corrupted
+  double jitter = 0;        // period spread, fraction of the period
+  bool zero_phase = false;  // release everything at t = 0 (critical instant)
+  uint64_t window_ns = 100000000; // bus load window for the peak figure
+  uint64_t seed = 1;
+};
+
+struct class_stats {
+  std::string name;
+  std::string where;     // node addresses or identifier
+  double rate_hz = 0;    // summed over the class's entries
+  uint32_t bytes = 0;    // largest packet or frame in the class
+  unsigned frames = 0;   // frames per message
+  bool high = false;
+  uint64_t released = 0;
+  uint64_t delivered = 0;
+  uint64_t evicted = 0;     // DROP_OLDEST
+  uint64_t expired = 0;     // older than max_age when taken
+  uint64_t lost = 0;        // oversize packet that did not fit the FIFO
+  uint64_t overwritten = 0; // mailbox frame replaced before it was sent
+  uint64_t bus_frames = 0;
+  uint64_t bus_ns = 0;
+  latency_stats latency;
+
+  uint64_t dropped() const { return evicted + expired + lost + overwritten; }
+};
+
+struct node_stats {
+  uint8_t addr = 0;
+  double offered_fps = 0; // frames per second the workload asks for
+  uint64_t fifo_full = 0; // polls that stopped at a full TX FIFO
+  uint32_t max_queue_bytes[2] = {0, 0}; // BULK, HIGH
+};
+
+struct model_stats {
+  uint64_t elapsed_ns = 0;
+  uint64_t busy_ns = 0;
+  uint64_t peak_window_ns = 0; // busiest window's bus time
+  uint64_t frames = 0;
+  uint64_t error_frames = 0;
+  double offered_load = 0; // workload bus time per second, no queueing
+  std::map<uint8_t, uint64_t> band_ns; // by 11-bit base ID >> 6
+  std::vector<class_stats> classes;
+  std::vector<node_stats> nodes;
+};
+
+class bus_model {
+public:
+  bus_model(const model_config &cfg, const std::vector<source> &sources);
+
+  void run(uint64_t duration_ns);
+
+  const model_stats &stats() const { return stats_; }
+
+  // Frames the gateway uses for a packet of this size.
+  static unsigned fragments(uint32_t bytes);
+
+private:
+  struct tx_frame {
+    uint64_t key = 0;
+    frame_shape shape;
+    size_t cls = 0;
+    uint64_t t_release = 0;
+    bool last = false;
+  };
+
+  struct packet {
+    size_t cls = 0;
+    uint32_t id = 0;
+    uint32_t bytes = 0;
+    uint64_t t_release = 0;
+    unsigned frags = 0;
+    unsigned sent = 0;
+  };
+
+  struct queue {
+    std::deque<packet> packets;
+    uint32_t used = 0;
+    uint32_t cap = 0;
+    bool active = false; // cur is in flight
+    packet cur;
+  };
+
+  struct sender {
+    std::deque<tx_frame> fifo;
+    bool mailbox = false;
+    int node = -1; // gateway node index
+  };
+
+  struct node {
+    uint8_t addr = 0;
+    size_t sender = 0;
+    uint64_t next_poll = 0;
+    queue q[2]; // BULK, HIGH
+  };
+
+  struct release {
+    source src;
+    size_t cls = 0;
+    size_t sender = 0;
+    uint64_t period_ns = 0;
+    uint64_t next_ns = 0;
+  };
+
+  size_t class_of(const source &s);
+  void release_one(release &r, uint64_t now);
+  void enqueue(node &n, const packet &p, bool high);
+  void poll(node &n, uint64_t now);
+  bool push_fragments(sender &s, packet &p);
+  void start_next(uint64_t now);
+  void complete(uint64_t now);
+  void account_busy(uint64_t from, uint64_t to, uint64_t key);
+  uint64_t draw_period(uint64_t period_ns);
+
+  model_config cfg_;
+  std::mt19937_64 rng_;
+  std::vector<release> releases_;
+  std::vector<node> nodes_;
+  std::vector<sender> senders_;
+  std::vector<uint64_t> windows_;
+
+  bool busy_ = false;
+  size_t tx_sender_ = 0;
+  bool tx_error_ = false;
+  uint64_t tx_start_ = 0;
+  uint64_t tx_end_ = 0;
+
+  model_stats stats_;
+};
+
+} // namespace gwtiming
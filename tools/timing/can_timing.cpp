@@ -0,0 +1,94 @@
+// can_timing.cpp
+
+#include "can_timing.h"
+
+#include <algorithm>
+
+namespace gwtiming {
+
+namespace {
+
+constexpr uint8_t k_dlc_len[16] = {0, 1, 2, 3, 4, 5, 6, 7,
+                                   8, 12, 16, 20, 24, 32, 48, 64};
+
+uint32_t stuffed(uint32_t bits, double ratio) {
+  return bits + (uint32_t)((double)(bits - 1u) * ratio);
+}
+
+} // namespace
+
+uint8_t fd_padded_len(uint8_t len) {
+  for (uint8_t l : k_dlc_len) {
+    if (l >= len)
+      return l;
+  }
+  return 64;
+}
+
+uint64_t frame_time_ns(const frame_shape &f, const bit_rates &r) {
+  const uint64_t nom_ns = 1000000000ull / r.nominal;
+
+  if (!f.fd) {
+    // SOF + ID + RTR + IDE + r0 + DLC + data + CRC15 are stuffed; CRC
+    // delimiter, ACK, EOF and intermission are not (3 + 7 + 3).
+    const uint32_t n = f.rtr ? 0u : std::min<uint32_t>(f.len, 8u);
+    const uint32_t stuffed_bits = (f.ext ? 54u : 34u) + 8u * n;
+    return (uint64_t)(stuffed(stuffed_bits, r.stuff_ratio) + 13u) * nom_ns;
+  }
+
+  // FD: SOF + ID + r1 + IDE + FDF + res + BRS at the nominal rate, ESI + DLC
+  // + data + stuff count + CRC in the data phase, CRC delimiter back at the
+  // nominal rate with ACK, EOF and intermission.
+  const uint32_t n = fd_padded_len(f.len);
+  const uint64_t data_ns =
+      f.brs ? 1000000000ull / std::max<uint32_t>(r.data, 1u) : nom_ns;
+
+  const uint32_t arb_bits = stuffed(f.ext ? 37u : 17u, r.stuff_ratio);
+  const uint32_t crc_bits = (n > 16) ? 21u : 17u;
+  // Dynamic stuffing before the CRC field, then fixed stuff bits: the stuff
+  // count (4 bits) and the CRC carry one every four bits.
+  const uint32_t data_bits = stuffed(5u + 8u * n, r.stuff_ratio) + 4u +
+                             crc_bits + (4u + crc_bits + 3u) / 4u;
+  const uint32_t tail_bits = 1u + 1u + 1u + 7u + 3u;
+
+  return (uint64_t)arb_bits * nom_ns + (uint64_t)data_bits * data_ns +
+         (uint64_t)tail_bits * nom_ns;
+}
+
+uint64_t error_frame_ns(const bit_rates &r) {
+  return 31ull * (1000000000ull / r.nominal);
+}
+
+uint64_t arbitration_key(uint32_t id, bool ext) {
+  if (ext) {
+    const uint32_t base = (id >> 18) & 0x7FFu;
+    return ((uint64_t)base << 20) | (1u << 19) | (id & 0x3FFFFu);
+  }
+  return (uint64_t)(id & 0x7FFu) << 20;
+}
+
+// ---------------------------------------------------------------------------
+// Latency stats
+// ---------------------------------------------------------------------------
+
+void latency_stats::add(uint64_t us) {
+  count++;
+  sum_us += us;
+  max_us = std::max(max_us, us);
+  samples.push_back((uint32_t)std::min<uint64_t>(us, UINT32_MAX));
+}
+
+double latency_stats::mean_us() const {
+  return count ? (double)sum_us / (double)count : 0.0;
+}
+
+uint64_t latency_stats::percentile_us(double p) const {
+  if (samples.empty())
+    return 0;
+  std::vector<uint32_t> s(samples);
+  const size_t k = std::min(s.size() - 1, (size_t)(p * (double)(s.size() - 1)));
+  std::nth_element(s.begin(), s.begin() + (ptrdiff_t)k, s.end());
+  return s[k];
+}
+
+} // namespace gwtiming
@@ -0,0 +1,66 @@
+// can_timing.h
+//
+// Bus time of CAN and CAN FD frames, shared by the bus timing model
+// (gwtiming) and the multi-board simulator's virtual bus.
+//
+// The bit count covers SOF to the end of intermission. Fields before the
+// CRC delimiter are subject to bit stuffing; stuff_ratio is the number of
+// stuff bits per stuffed bit, 0.25 being the worst case (one after every
+// four bits once the first run of five is out). FD frames also carry the
+// fixed stuff bits of the stuff count and CRC fields, which do not depend
+// on the data. With BRS the FD data phase (ESI to CRC) runs at the data
+// bit rate.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gwtiming {
+
+constexpr double k_stuff_worst = 0.25;
+
+struct bit_rates {
+  uint32_t nominal = 500000;     // arbitration phase
+  uint32_t data = 2000000;       // FD data phase with BRS
+  double stuff_ratio = k_stuff_worst;
+};
+
+struct frame_shape {
+  bool ext = false; // 29-bit identifier
+  bool fd = false;
+  bool brs = false; // FD only
+  bool rtr = false; // classic only
+  uint8_t len = 0;  // payload bytes; FD lengths are padded to a DLC size
+};
+
+// Smallest FD payload size (DLC step) holding len bytes.
+uint8_t fd_padded_len(uint8_t len);
+
+// Bus time of one frame, in nanoseconds.
+uint64_t frame_time_ns(const frame_shape &f, const bit_rates &r);
+
+// Bus time of an error frame following a corrupted frame (worst case:
+// 6 + 6 flag bits, 8 delimiter bits, 3 intermission, plus the 8 bits a
+// receiver may take to notice), in nanoseconds.
+uint64_t error_frame_ns(const bit_rates &r);
+
+// Arbitration order of two frames: lower key wins. Base ID first, then a
+// standard frame beats an extended one with the same base, then the 18-bit
+// extension.
+uint64_t arbitration_key(uint32_t id, bool ext);
+
+// Latency samples with mean, percentiles and maximum.
+struct latency_stats {
+  uint64_t count = 0;
+  uint64_t sum_us = 0;
+  uint64_t max_us = 0;
+  std::vector<uint32_t> samples;
+
+  void add(uint64_t us);
+  double mean_us() const;
+  uint64_t percentile_us(double p) const;
+};
+
+} // namespace gwtiming
@@ -0,0 +1,175 @@
+// gwtiming_main.cpp
+//
+// Predict CAN latency and bus load for a planned workload before flight:
+// ID bands, node addresses and logging rates in, per message class latency
+// (mean, percentiles, worst seen) and bus utilization out. See workload.h
+// for the input format and bus_model.h for what is modelled.
+//
+// Usage examples
+//   gwtiming gateway.workload                      # 60 s at 500k/2M
+//   gwtiming --brs --seconds 600 gateway.workload  # what BRS would buy
+//   gwtiming --zero-phase --jitter 0.1 gateway.workload
+//   gwtiming --frame-errors 0.001 --stuff-ratio 0.1 gateway.workload
+//
+// The worst case reported is the worst one simulated. --zero-phase starts
+// every source at the same instant, which for periodic traffic is when the
+// longest queues build up; with random phases (the default) run long
+// enough, or with a few seeds, to hit the unlucky alignments.
+
+#include "bus_model.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+struct options {
+  double seconds = 60.0;
+  gwtiming::model_config model;
+  std::string workload;
+};
+
+double pct(uint64_t part, uint64_t whole) {
+  return whole ? 100.0 * (double)part / (double)whole : 0.0;
+}
+
+double ms(uint64_t us) { return (double)us / 1000.0; }
+
+void report(const options &opt, const gwtiming::model_stats &st) {
+  const gwtiming::model_config &m = opt.model;
+  std::printf("%s: %.1f s, %u/%u bit/s, BRS %s, stuffing %.2f, poll %.1f ms, "
+              "seed %" PRIu64 "\n",
+              opt.workload.c_str(), opt.seconds, m.rates.nominal, m.rates.data,
+              m.brs ? "on" : "off", m.rates.stuff_ratio,
+              (double)m.poll_ns / 1e6, m.seed);
+  std::printf("bus: %.1f%% busy (peak %.1f%% over %.0f ms), offered %.1f%%, "
+              "%" PRIu64 " frames, %" PRIu64 " error frames\n",
+              pct(st.busy_ns, st.elapsed_ns),
+              pct(st.peak_window_ns, m.window_ns), (double)m.window_ns / 1e6,
+              100.0 * st.offered_load, st.frames, st.error_frames);
+  for (const auto &kv : st.band_ns) {
+    std::printf("  band %-8s %5.1f%%\n", gwtiming::band_name(kv.first).c_str(),
+                pct(kv.second, st.elapsed_ns));
+  }
+
+  std::printf("\n%-16s %-12s %7s %5s %3s %4s %9s %9s %7s %8s %8s %8s %8s\n",
+              "class", "from", "rate/s", "bytes", "frm", "prio", "released",
+              "delivered", "dropped", "mean ms", "p50", "p99", "max");
+  for (const gwtiming::class_stats &c : st.classes) {
+    const gwtiming::latency_stats &l = c.latency;
+    std::printf("%-16s %-12s %7.2f %5u %3u %4s %9" PRIu64 " %9" PRIu64
+                " %7" PRIu64 " %8.2f %8.2f %8.2f %8.2f\n",
+                c.name.c_str(), c.where.c_str(), c.rate_hz, c.bytes, c.frames,
+                c.high ? "high" : "bulk", c.released, c.delivered, c.dropped(),
+                l.mean_us() / 1000.0, ms(l.percentile_us(0.5)),
+                ms(l.percentile_us(0.99)), ms(l.max_us));
+    if (c.dropped()) {
+      std::printf("%-16s   evicted %" PRIu64 ", expired %" PRIu64
+                  ", lost %" PRIu64 ", overwritten %" PRIu64 "\n",
+                  "", c.evicted, c.expired, c.lost, c.overwritten);
+    }
+  }
+
+  // A poll hands the FIFO at most tx_fifo frames, so a node cannot send
+  // faster than that per loop whatever the bus load.
+  const double cap_fps = (double)m.tx_fifo * 1e9 / (double)m.poll_ns;
+  if (!st.nodes.empty()) {
+    std::printf("\n%4s %12s %10s %10s %11s %11s\n", "node", "offered fr/s",
+                "cap fr/s", "fifo full", "max q bulk", "max q high");
+  }
+  for (const gwtiming::node_stats &n : st.nodes) {
+    std::printf("%4u %12.1f %10.1f %10" PRIu64 " %11u %11u\n", n.addr,
+                n.offered_fps, cap_fps, n.fifo_full, n.max_queue_bytes[0],
+                n.max_queue_bytes[1]);
+  }
+
+  bool warned = false;
+  if (st.offered_load >= 1.0) {
+    std::printf("\nwarning: the workload needs %.0f%% of the bus\n",
+                100.0 * st.offered_load);
+    warned = true;
+  }
+  for (const gwtiming::node_stats &n : st.nodes) {
+    if (n.offered_fps > cap_fps) {
+      std::printf("%swarning: node %u offers %.0f frames/s, more than the "
+                  "%.0f/s one poll per loop can queue\n",
+                  warned ? "" : "\n", n.addr, n.offered_fps, cap_fps);
+      warned = true;
+    }
+  }
+}
+
+int usage() {
+  std::fprintf(stderr,
+               "usage: gwtiming [--seconds T] [--bitrate B] [--data-bitrate B] "
+               "[--brs] [--poll-ms MS]\n"
+               "                [--stuff-ratio R] [--frame-errors P] "
+               "[--jitter F] [--zero-phase] [--seed N]\n"
+               "                <workload>\n");
+  return 2;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  options opt;
+  for (int i = 1; i < argc; i++) {
+    const std::string s = argv[i];
+    if (s == "--brs") {
+      opt.model.brs = true;
+      continue;
+    }
+    if (s == "--zero-phase") {
+      opt.model.zero_phase = true;
+      continue;
+    }
+    if (s.size() < 2 || s[0] != '-') {
+      if (!opt.workload.empty())
+        return usage();
+      opt.workload = s;
+      continue;
+    }
+    const char *v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    if (!v)
+      return usage();
+    i++;
+    if (s == "--seconds")
+      opt.seconds = std::strtod(v, nullptr);
+    else if (s == "--bitrate")
+      opt.model.rates.nominal = uint32_t(std::strtoul(v, nullptr, 0));
+    else if (s == "--data-bitrate")
+      opt.model.rates.data = uint32_t(std::strtoul(v, nullptr, 0));
+    else if (s == "--poll-ms")
+      opt.model.poll_ns = uint64_t(std::strtod(v, nullptr) * 1e6);
+    else if (s == "--stuff-ratio")
+      opt.model.rates.stuff_ratio = std::strtod(v, nullptr);
+    else if (s == "--frame-errors")
+      opt.model.frame_errors = std::strtod(v, nullptr);
+    else if (s == "--jitter")
+      opt.model.jitter = std::strtod(v, nullptr);
+    else if (s == "--seed")
+      opt.model.seed = std::strtoull(v, nullptr, 0);
+    else
+      return usage();
+  }
+  const gwtiming::model_config &m = opt.model;
+  if (opt.workload.empty() || opt.seconds <= 0 || m.rates.nominal == 0 ||
+      m.rates.data == 0 || m.poll_ns == 0 || m.rates.stuff_ratio < 0 ||
+      m.rates.stuff_ratio > gwtiming::k_stuff_worst || m.frame_errors < 0 ||
+      m.frame_errors >= 1 || m.jitter < 0 || m.jitter > 1)
+    return usage();
+
+  std::vector<gwtiming::source> sources;
+  std::string err;
+  if (!gwtiming::load_workload(opt.workload, sources, err)) {
+    std::fprintf(stderr, "gwtiming: %s\n", err.c_str());
+    return 1;
+  }
+
+  gwtiming::bus_model model(opt.model, sources);
+  model.run((uint64_t)(opt.seconds * 1e9));
+  report(opt, model.stats());
+  return 0;
+}
@@ -0,0 +1,187 @@
+// workload.cpp
+
+#include "workload.h"
+
+#include "can_node.h"
+#include "telemetry_priority.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace gwtiming {
+
+namespace {
+
+struct band_entry {
+  const char *name;
+  uint8_t band;
+};
+
+constexpr band_entry k_bands[] = {
+    {"CLAIM", CAN_NODE_BAND_CLAIM},
+    {"TIME", TELEMETRY_CAN_BAND_TIME},
+    {"ALARM", TELEMETRY_CAN_BAND_ALARM},
+    {"COMMAND", TELEMETRY_CAN_BAND_COMMAND},
+    {"STATUS", TELEMETRY_CAN_BAND_STATUS},
+    {"BULK", TELEMETRY_CAN_BAND_BULK},
+};
+
+constexpr uint32_t k_max_band = 0x7FFu >> CAN_NODE_ADDR_BITS;
+
+bool parse_u32(const std::string &s, uint32_t &out) {
+  char *end = nullptr;
+  const unsigned long v = std::strtoul(s.c_str(), &end, 0);
+  if (s.empty() || *end != '\0' || v > UINT32_MAX)
+    return false;
+  out = (uint32_t)v;
+  return true;
+}
+
+bool parse_rate(const std::string &s, double &out) {
+  char *end = nullptr;
+  out = std::strtod(s.c_str(), &end);
+  return !s.empty() && *end == '\0' && out > 0;
+}
+
+bool parse_band(const std::string &s, uint8_t &out) {
+  for (const band_entry &b : k_bands) {
+    if (s == b.name) {
+      out = b.band;
+      return true;
+    }
+  }
+  uint32_t v = 0;
+  if (!parse_u32(s, v) || v > k_max_band)
+    return false;
+  out = (uint8_t)v;
+  return true;
+}
+
+bool parse_packet(std::istringstream &in, source &src, std::string &why) {
+  std::string addr, band, rate, bytes;
+  if (!(in >> addr >> band >> rate >> bytes)) {
+    why = "expected: packet <addr> <band> <rate_hz> <bytes> [name]";
+    return false;
+  }
+  uint32_t v = 0;
+  if (!parse_u32(addr, v) || v >= CAN_NODE_ADDR_ANON) {
+    why = "bad address '" + addr + "'";
+    return false;
+  }
+  src.addr = (uint8_t)v;
+  if (!parse_band(band, src.band)) {
+    why = "bad band '" + band + "'";
+    return false;
+  }
+  if (!parse_rate(rate, src.rate_hz)) {
+    why = "bad rate '" + rate + "'";
+    return false;
+  }
+  // can_bus_send_large(): u16 length, at most 255 fragments.
+  if (!parse_u32(bytes, src.bytes) || src.bytes == 0 || src.bytes > 0xFFFFu) {
+    why = "bad size '" + bytes + "'";
+    return false;
+  }
+  in >> src.name;
+  if (src.name.empty())
+    src.name = band_name(src.band);
+  return true;
+}
+
+bool parse_frame(std::istringstream &in, source &src, std::string &why) {
+  std::string id, rate, len, format;
+  if (!(in >> id >> rate >> len)) {
+    why = "expected: frame <id> <rate_hz> <len> [classic|fd|fd-brs] [name]";
+    return false;
+  }
+  if (!parse_u32(id, src.id) || src.id > 0x1FFFFFFFu) {
+    why = "bad identifier '" + id + "'";
+    return false;
+  }
+  src.ext = src.id > 0x7FFu;
+  if (!parse_rate(rate, src.rate_hz)) {
+    why = "bad rate '" + rate + "'";
+    return false;
+  }
+  if (in >> format) {
+    if (format == "fd" || format == "fd-brs") {
+      src.fd = true;
+      src.brs = format == "fd-brs";
+    } else if (format != "classic") {
+      src.name = format; // no format given, this is the name
+    }
+  }
+  uint32_t n = 0;
+  if (!parse_u32(len, n) || n > (src.fd ? 64u : 8u)) {
+    why = "bad length '" + len + "'";
+    return false;
+  }
+  src.len = (uint8_t)n;
+  if (src.name.empty())
+    in >> src.name;
+  if (src.name.empty()) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), src.ext ? "0x%08X" : "0x%03X", src.id);
+    src.name = buf;
+  }
+  return true;
+}
+
+} // namespace
+
+std::string band_name(uint8_t band) {
+  for (const band_entry &b : k_bands) {
+    if (b.band == band)
+      return b.name;
+  }
+  char buf[8];
+  std::snprintf(buf, sizeof(buf), "0x%02X", band);
+  return buf;
+}
+
+bool load_workload(const std::string &path, std::vector<source> &out,
+                   std::string &err) {
+  std::ifstream f(path);
+  if (!f) {
+    err = path + ": cannot open";
+    return false;
+  }
+
+  std::string line;
+  for (unsigned lineno = 1; std::getline(f, line); lineno++) {
+    const size_t hash = line.find('#');
+    if (hash != std::string::npos)
+      line.resize(hash);
+    std::istringstream in(line);
+    std::string kind;
+    if (!(in >> kind))
+      continue;
+
+    source src;
+    std::string why;
+    bool ok = false;
+    if (kind == "packet") {
+      src.kind = source_kind::packet;
+      ok = parse_packet(in, src, why);
+    } else if (kind == "frame") {
+      src.kind = source_kind::frame;
+      ok = parse_frame(in, src, why);
+    } else {
+      why = "unknown entry '" + kind + "'";
+    }
+    if (!ok) {
+      err = path + ":" + std::to_string(lineno) + ": " + why;
+      return false;
+    }
+    out.push_back(src);
+  }
+  if (out.empty()) {
+    err = path + ": no traffic";
+    return false;
+  }
+  return true;
+}
+
+} // namespace gwtiming
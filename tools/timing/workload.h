@@ -0,0 +1,54 @@
+// workload.h
+//
+// Traffic description for gwtiming: what every node puts on the bus and how
+// often. One entry per line, '#' starts a comment:
+//
+//   packet <addr> <band> <rate_hz> <bytes> [name]
+//       A router packet of <bytes> serialized bytes, logged <rate_hz> times a
+//       second by the gateway node at CAN address <addr> (0..62). It is sent
+//       on CAN_NODE_ID(band, addr) through the node's egress queues and
+//       can_bus_send_large(), i.e. as 64-byte FD fragments. <band> is TIME,
+//       ALARM, COMMAND, STATUS, BULK or a number (telemetry_priority.h).
+//
+//   frame <id> <rate_hz> <len> [classic|fd|fd-brs] [name]
+//       A periodic frame from another device on the bus, sent from its own
+//       mailbox: a new instance overwrites one that has not won arbitration
+//       yet. <id> above 0x7FF is sent as an extended identifier.
+//
+// Entries with the same name are reported together as one message class;
+// the default name is the band (packets) or the identifier (frames).
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gwtiming {
+
+enum class source_kind { packet, frame };
+
+struct source {
+  source_kind kind = source_kind::packet;
+  std::string name;
+  double rate_hz = 0;
+  // packet
+  uint8_t addr = 0;
+  uint8_t band = 0;
+  uint32_t bytes = 0;
+  // frame
+  uint32_t id = 0;
+  bool ext = false;
+  bool fd = false;
+  bool brs = false;
+  uint8_t len = 0;
+};
+
+// Parse a workload file. False with a "file:line: reason" message on error.
+bool load_workload(const std::string &path, std::vector<source> &out,
+                   std::string &err);
+
+// Telemetry band name (TIME, ALARM, ...) or the number in hex.
+std::string band_name(uint8_t band);
+
+} // namespace gwtiming